@@ -1,5 +1,6 @@
 ﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
 
+using System.IO;
 using UnrealBuildTool;
 
 public class ChunkStream : ModuleRules
@@ -52,12 +53,53 @@ public class ChunkStream : ModuleRules
 				"Engine",
 				"Slate",
 				"SlateCore",
-				"HTTP"
+				"HTTP",
+				"Projects"
 				// ... add private dependencies that you statically link with here ...	
 			}
 			);
 		
 		
+		// zlib for gzip / deflate decompression of downloads
+		AddEngineThirdPartyPrivateStaticDependencies(Target, "zlib");
+
+		// Optional zstd decompression, place the zstd headers in ThirdParty/zstd/include
+		// and the static library in ThirdParty/zstd/lib/<Platform> to enable it
+		string ZstdPath = Path.Combine(PluginDirectory, "Source", "ThirdParty", "zstd");
+		string ZstdLibrary = null;
+		if (Target.Platform == UnrealTargetPlatform.Win64)
+		{
+			ZstdLibrary = Path.Combine(ZstdPath, "lib", "Win64", "zstd_static.lib");
+		}
+		else if (Target.Platform == UnrealTargetPlatform.Linux)
+		{
+			ZstdLibrary = Path.Combine(ZstdPath, "lib", "Linux", "libzstd.a");
+		}
+		else if (Target.Platform == UnrealTargetPlatform.Android)
+		{
+			ZstdLibrary = Path.Combine(ZstdPath, "lib", "Android", "arm64-v8a", "libzstd.a");
+		}
+		bool bWithZstd = ZstdLibrary != null && File.Exists(ZstdLibrary) && Directory.Exists(Path.Combine(ZstdPath, "include"));
+		if (bWithZstd)
+		{
+			PrivateIncludePaths.Add(Path.Combine(ZstdPath, "include"));
+			PublicAdditionalLibraries.Add(ZstdLibrary);
+		}
+		PublicDefinitions.Add("WITH_CHUNKSTREAM_ZSTD=" + (bWithZstd ? "1" : "0"));
+
+		// Optional io_uring writes on Linux, place the liburing headers in ThirdParty/liburing/include
+		// and the static library in ThirdParty/liburing/lib/Linux to enable it
+		string LiburingPath = Path.Combine(PluginDirectory, "Source", "ThirdParty", "liburing");
+		string LiburingLibrary = Path.Combine(LiburingPath, "lib", "Linux", "liburing.a");
+		bool bWithIoUring = Target.Platform == UnrealTargetPlatform.Linux && File.Exists(LiburingLibrary)
+			&& Directory.Exists(Path.Combine(LiburingPath, "include"));
+		if (bWithIoUring)
+		{
+			PrivateIncludePaths.Add(Path.Combine(LiburingPath, "include"));
+			PublicAdditionalLibraries.Add(LiburingLibrary);
+		}
+		PublicDefinitions.Add("WITH_CHUNKSTREAM_IO_URING=" + (bWithIoUring ? "1" : "0"));
+		
 		DynamicallyLoadedModuleNames.AddRange(
 			new string[]
 			{
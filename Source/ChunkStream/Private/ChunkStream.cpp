@@ -3,8 +3,14 @@
 #include "ChunkStream.h"
 
 #include "HttpModule.h"
+#include "Misc/CoreDelegates.h"
 #include "ChunkStreamDownloader.h"
 #include "ChunkStreamLogs.h"
+#include "ChunkStreamMemoryBudget.h"
+#include "ChunkStreamStats.h"
+#include "ChunkStreamTrace.h"
+
+DEFINE_STAT(STAT_ChunkStreamStallsDetected);
 
 #define LOCTEXT_NAMESPACE "FChunkStreamModule"
 
@@ -31,9 +37,27 @@ TAutoConsoleVariable<int32> CVarHttpMaxReadBufferSize(
 TAutoConsoleVariable<int32> CVarMaxConcurrentDownloads(
 	TEXT("ChunkStream.MaxConcurrentDownloads"),
 	3,
-	TEXT("Max number of downloads that can be running at once."),
+	TEXT("Max number of downloads that can be running at once. Each also needs a connection of ChunkStream.MaxConnections to start."),
 	ECVF_Default);
 
+static FAutoConsoleCommand CmdChunkStreamStats(
+	TEXT("ChunkStream.Stats"),
+	TEXT("Prints rates, ETA, byte counts, retries, stalls and time spent waiting for every registered download and their total"),
+	FConsoleCommandWithOutputDeviceDelegate::CreateLambda([](FOutputDevice& Ar)
+	{
+		FChunkStreamModule& Module = FModuleManager::Get().GetModuleChecked<FChunkStreamModule>(TEXT("ChunkStream"));
+		const TArray<FChunkStreamDownloadStats> Stats = Module.GetDownloadStats();
+		for (const FChunkStreamDownloadStats& Download : Stats)
+		{
+			Ar.Logf(TEXT("%s"), *Download.ToString());
+		}
+		Ar.Logf(TEXT("Total: %s"), *FChunkStreamDownloadStats::Aggregate(Stats).ToString());
+		const FChunkStreamMemoryBudget& Budget = FChunkStreamMemoryBudget::Get();
+		Ar.Logf(TEXT("Chunk memory: %.1f of %.1f MB%s"), Budget.GetReserved() / (1024.0 * 1024.0), Budget.GetBudget() / (1024.0 * 1024.0),
+			Budget.IsUnderMemoryPressure() ? TEXT(" (lowered after a memory warning)") : TEXT(""));
+		Ar.Logf(TEXT("Connections: %d of %d"), Module.GetConnectionPool().GetNumConnections(),
+			FChunkStreamConnectionPool::GetMaxConnections());
+	}));
 
 
 void FChunkStreamModule::StartupModule()
@@ -42,11 +66,21 @@ void FChunkStreamModule::StartupModule()
 	{
 		UpdateHttpVars();
 	}));
+	// the platform is running low, downloads hold back on new chunk buffers for a while
+	MemoryTrimHandle = FCoreDelegates::GetMemoryTrimDelegate().AddLambda([]
+	{
+		FChunkStreamMemoryBudget::Get().OnMemoryPressure();
+	});
+	// partial downloads from runs that didn't finish them
+	TempFiles.StartSweep();
 }
 
 void FChunkStreamModule::ShutdownModule()
 {
 	IConsoleManager::Get().UnregisterConsoleVariableSink_Handle(KitchenSinkHandle);
+	FCoreDelegates::GetMemoryTrimDelegate().Remove(MemoryTrimHandle);
+	ConnectionPool.Shutdown();
+	TempFiles.WaitForSweep();
 }
 
 void FChunkStreamModule::UpdateHttpVars()
@@ -89,6 +123,7 @@ int32 FChunkStreamModule::GetNumDownloadsThatCanStart()
 
 	
 	int32 ActiveDownloads = 0;
+	int32 WaitingDownloads = 0;
 	for (int32 i = RegisteredDownloaders.Num() - 1; i >= 0; i--)
 	{
 		auto Downloader = RegisteredDownloaders[i];
@@ -96,14 +131,49 @@ int32 FChunkStreamModule::GetNumDownloadsThatCanStart()
 		{
 			if (Downloader->IsActive())
 				ActiveDownloads++;
+			else if (!Downloader->IsPaused())
+				WaitingDownloads++;
 		}
 		else
 		{
 			RegisteredDownloaders.RemoveAt(i);
 		}
 	}
+	ChunkStreamTrace::SetDownloadCounts(ActiveDownloads, WaitingDownloads);
+
+	// and each needs a connection, hedges and range helpers of the running ones may hold the rest until they finish
+	return FMath::Min(MaxDownloads - ActiveDownloads, ConnectionPool.GetNumFreeConnections());
+}
 
-	return MaxDownloads - ActiveDownloads;
+int32 FChunkStreamModule::GetNumActiveDownloads() const
+{
+	int32 ActiveDownloads = 0;
+	for (const TWeakObjectPtr<UChunkStreamDownloader>& Downloader : RegisteredDownloaders)
+	{
+		if (Downloader.IsValid() && IsValid(Downloader.Get()) && Downloader->IsActive())
+		{
+			ActiveDownloads++;
+		}
+	}
+	return ActiveDownloads;
+}
+
+bool FChunkStreamModule::IsWaitingForConnection() const
+{
+	const int32 MaxDownloads = FMath::Clamp(CVarMaxConcurrentDownloads.GetValueOnAnyThread(), 1, 1000);
+	int32 ActiveDownloads = 0;
+	bool bAnyWaiting = false;
+	for (const TWeakObjectPtr<UChunkStreamDownloader>& Downloader : RegisteredDownloaders)
+	{
+		if (Downloader.IsValid() && IsValid(Downloader.Get()))
+		{
+			if (Downloader->IsActive())
+				ActiveDownloads++;
+			else if (!Downloader->IsPaused())
+				bAnyWaiting = true;
+		}
+	}
+	return bAnyWaiting && ActiveDownloads < MaxDownloads && FChunkStreamConnectionPool::GetMaxConnections() > 0;
 }
 
 bool FChunkStreamModule::CanStartMoreDownloads() 
@@ -139,13 +209,18 @@ void FChunkStreamModule::UnRegisterDownloader( UChunkStreamDownloader* Downloade
 			RegisteredDownloaders.RemoveAt(i);
 		}
 	}
+	StartWaitingDownloads();
+}
+
+void FChunkStreamModule::StartWaitingDownloads()
+{
 	int32 NewToStart = GetNumDownloadsThatCanStart();
 	int32 Started=0;
 	if (NewToStart > 0)
 	{
 		for (auto& DownloaderToStart : RegisteredDownloaders)
 		{
-			if (DownloaderToStart.IsValid() && !DownloaderToStart->IsActive())
+			if (DownloaderToStart.IsValid() && !DownloaderToStart->IsActive() && !DownloaderToStart->IsPaused())
 			{
 				DownloaderToStart->Activate();
 				NewToStart-=1;
@@ -160,6 +235,24 @@ void FChunkStreamModule::UnRegisterDownloader( UChunkStreamDownloader* Downloade
 	}
 }
 
+TArray<FChunkStreamDownloadStats> FChunkStreamModule::GetDownloadStats() const
+{
+	TArray<FChunkStreamDownloadStats> Stats;
+	for (const TWeakObjectPtr<UChunkStreamDownloader>& Downloader : RegisteredDownloaders)
+	{
+		if (Downloader.IsValid() && IsValid(Downloader.Get()))
+		{
+			Stats.Add(Downloader->GetStats());
+		}
+	}
+	return Stats;
+}
+
+FChunkStreamDownloadStats FChunkStreamModule::GetAggregateStats() const
+{
+	return FChunkStreamDownloadStats::Aggregate(GetDownloadStats());
+}
+
 #undef LOCTEXT_NAMESPACE
 	
 IMPLEMENT_MODULE(FChunkStreamModule, ChunkStream);
\ No newline at end of file
@@ -0,0 +1,646 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#include "ChunkStreamBenchmark.h"
+#include "ChunkStreamConnectionPool.h"
+
+#include "ChunkStreamDownloader.h"
+#include "ChunkStreamLogs.h"
+#include "ChunkStreamMemoryTransport.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/LowLevelMemTracker.h"
+#include "HAL/PlatformMemory.h"
+#include "Interfaces/IPluginManager.h"
+#include "Misc/DateTime.h"
+#include "Misc/EngineVersion.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include <atomic>
+
+#if PLATFORM_WINDOWS
+#include "Windows/WindowsHWrapper.h"
+#elif PLATFORM_UNIX || PLATFORM_ANDROID
+#include <time.h>
+#endif
+
+namespace ChunkStreamBenchmark
+{
+	static std::atomic<bool> GCpuTimingEnabled(false);
+	static std::atomic<uint64> GCpuNanoseconds[static_cast<int32>(ECpuCounter::Num)];
+
+	static void ResetCpuCounters()
+	{
+		for (std::atomic<uint64>& Counter : GCpuNanoseconds)
+		{
+			Counter.store(0);
+		}
+	}
+
+	static double GetCpuSeconds(ECpuCounter Counter)
+	{
+		return static_cast<double>(GCpuNanoseconds[static_cast<int32>(Counter)].load()) / 1e9;
+	}
+}
+
+uint64 ChunkStreamBenchmark::GetThreadCpuNanoseconds()
+{
+#if PLATFORM_WINDOWS
+	FILETIME CreationTime, ExitTime, KernelTime, UserTime;
+	if (!::GetThreadTimes(::GetCurrentThread(), &CreationTime, &ExitTime, &KernelTime, &UserTime))
+	{
+		return 0;
+	}
+	// 100ns units
+	const uint64 Kernel = (static_cast<uint64>(KernelTime.dwHighDateTime) << 32) | KernelTime.dwLowDateTime;
+	const uint64 User = (static_cast<uint64>(UserTime.dwHighDateTime) << 32) | UserTime.dwLowDateTime;
+	return (Kernel + User) * 100;
+#elif PLATFORM_UNIX || PLATFORM_ANDROID
+	timespec Time;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &Time) != 0)
+	{
+		return 0;
+	}
+	return static_cast<uint64>(Time.tv_sec) * 1000000000ull + static_cast<uint64>(Time.tv_nsec);
+#else
+	return 0;
+#endif
+}
+
+ChunkStreamBenchmark::FScopedCpuTimer::FScopedCpuTimer(ECpuCounter InCounter)
+	: Counter(InCounter)
+	, StartNanoseconds(GCpuTimingEnabled.load(std::memory_order_relaxed) ? GetThreadCpuNanoseconds() : 0)
+{
+}
+
+ChunkStreamBenchmark::FScopedCpuTimer::~FScopedCpuTimer()
+{
+	if (StartNanoseconds == 0)
+	{
+		return;
+	}
+	const uint64 EndNanoseconds = GetThreadCpuNanoseconds();
+	if (EndNanoseconds > StartNanoseconds)
+	{
+		GCpuNanoseconds[static_cast<int32>(Counter)].fetch_add(EndNanoseconds - StartNanoseconds, std::memory_order_relaxed);
+	}
+}
+
+namespace
+{
+	// "64K", "4M", "10G" or a byte count
+	bool ParseByteSize(FString Text, uint64& OutBytes)
+	{
+		Text.TrimStartAndEndInline();
+		if (Text.IsEmpty())
+		{
+			return false;
+		}
+		uint64 Multiplier = 1;
+		const TCHAR Suffix = FChar::ToUpper(Text[Text.Len() - 1]);
+		if (Suffix == TEXT('K') || Suffix == TEXT('M') || Suffix == TEXT('G'))
+		{
+			Multiplier = Suffix == TEXT('K') ? 1024ull : Suffix == TEXT('M') ? 1024ull * 1024 : 1024ull * 1024 * 1024;
+			Text.LeftChopInline(1);
+		}
+		if (Text.IsEmpty() || !Text.IsNumeric())
+		{
+			return false;
+		}
+		OutBytes = static_cast<uint64>(FCString::Atod(*Text) * static_cast<double>(Multiplier));
+		return OutBytes > 0;
+	}
+
+	bool ParseIntList(const FString& Text, TArray<int32>& OutValues, int32 MinValue)
+	{
+		TArray<FString> Parts;
+		Text.ParseIntoArray(Parts, TEXT(","));
+		TArray<int32> Values;
+		for (const FString& Part : Parts)
+		{
+			if (!Part.IsNumeric() || FCString::Atoi(*Part) < MinValue)
+			{
+				return false;
+			}
+			Values.Add(FCString::Atoi(*Part));
+		}
+		if (Values.Num() < 1)
+		{
+			return false;
+		}
+		OutValues = MoveTemp(Values);
+		return true;
+	}
+
+	FString FormatBytes(uint64 Bytes)
+	{
+		if (Bytes >= 1024ull * 1024 * 1024 && Bytes % (1024ull * 1024 * 1024) == 0)
+		{
+			return FString::Printf(TEXT("%lluG"), Bytes / (1024ull * 1024 * 1024));
+		}
+		if (Bytes >= 1024ull * 1024 && Bytes % (1024ull * 1024) == 0)
+		{
+			return FString::Printf(TEXT("%lluM"), Bytes / (1024ull * 1024));
+		}
+		if (Bytes >= 1024 && Bytes % 1024 == 0)
+		{
+			return FString::Printf(TEXT("%lluK"), Bytes / 1024);
+		}
+		return FString::Printf(TEXT("%llu"), Bytes);
+	}
+
+	FString GetPluginVersion()
+	{
+		TSharedPtr<IPlugin> Plugin = IPluginManager::Get().FindPlugin(TEXT("ChunkStream"));
+		return Plugin ? Plugin->GetDescriptor().VersionName : FString();
+	}
+
+	FString EscapeJSON(const FString& Text)
+	{
+		// ReplaceCharWithEscapedChar escapes ' which JSON doesn't
+		return Text.ReplaceCharWithEscapedChar().Replace(TEXT("\\'"), TEXT("'"));
+	}
+
+	TSharedPtr<FChunkStreamBenchmark> GConsoleBenchmark;
+
+	FAutoConsoleCommand BenchmarkCommand(
+		TEXT("ChunkStream.Benchmark"),
+		TEXT("Downloads synthetic files from an in-process server for every combination of the swept settings and writes MB/s, memory, CPU time and time to first byte as CSV and JSON under Saved/ChunkStreamBenchmark.\n")
+		TEXT(" Sizes=1K,1M,64M,1G ChunkSizes=1,8,32 Concurrency=1,4 Ranges=1,0 Repeat=1 Rate=0 Latency=0 Timeout=3600 Output=<Dir>\n")
+		TEXT(" 'ChunkStream.Benchmark stop' cancels a running sweep"),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+		{
+			if (Args.Num() > 0 && Args[0].Equals(TEXT("stop"), ESearchCase::IgnoreCase))
+			{
+				if (GConsoleBenchmark)
+				{
+					GConsoleBenchmark->Stop();
+				}
+				return;
+			}
+			if (GConsoleBenchmark && GConsoleBenchmark->IsRunning())
+			{
+				LOG_WARN("A benchmark is already running, 'ChunkStream.Benchmark stop' cancels it");
+				return;
+			}
+			FChunkStreamBenchmarkSettings Settings;
+			if (!Settings.ParseArguments(FString::Join(Args, TEXT(" "))))
+			{
+				return;
+			}
+			GConsoleBenchmark = MakeShared<FChunkStreamBenchmark>(Settings);
+			GConsoleBenchmark->Start(FOnChunkStreamBenchmarkComplete::CreateLambda([](const TArray<FChunkStreamBenchmarkResult>& Results)
+			{
+				if (GConsoleBenchmark)
+				{
+					LOG("Benchmark finished %d cases, results in '%s' and '%s'", Results.Num(), *GConsoleBenchmark->GetCSVPath(), *GConsoleBenchmark->GetJSONPath());
+				}
+			}));
+		}));
+}
+
+bool FChunkStreamBenchmarkSettings::ParseArguments(const FString& Arguments)
+{
+	TArray<FString> Tokens;
+	Arguments.ParseIntoArrayWS(Tokens);
+	for (const FString& Token : Tokens)
+	{
+		FString Key, Value;
+		if (!Token.Split(TEXT("="), &Key, &Value) || Value.IsEmpty())
+		{
+			LOG_ERROR("Expected Key=Value, got '%s'", *Token);
+			return false;
+		}
+		bool bParsed = true;
+		if (Key.Equals(TEXT("Sizes"), ESearchCase::IgnoreCase))
+		{
+			TArray<FString> Parts;
+			Value.ParseIntoArray(Parts, TEXT(","));
+			TArray<uint64> Sizes;
+			for (const FString& Part : Parts)
+			{
+				uint64 Size = 0;
+				bParsed &= ParseByteSize(Part, Size);
+				Sizes.Add(Size);
+			}
+			bParsed &= Sizes.Num() > 0;
+			if (bParsed)
+			{
+				FileSizes = MoveTemp(Sizes);
+			}
+		}
+		else if (Key.Equals(TEXT("ChunkSizes"), ESearchCase::IgnoreCase))
+		{
+			bParsed = ParseIntList(Value, ChunkSizesMB, 1);
+		}
+		else if (Key.Equals(TEXT("Concurrency"), ESearchCase::IgnoreCase))
+		{
+			bParsed = ParseIntList(Value, Concurrencies, 1);
+		}
+		else if (Key.Equals(TEXT("Ranges"), ESearchCase::IgnoreCase))
+		{
+			TArray<int32> Values;
+			bParsed = ParseIntList(Value, Values, 0);
+			if (bParsed)
+			{
+				AcceptRanges.Reset();
+				for (int32 RangeValue : Values)
+				{
+					AcceptRanges.AddUnique(RangeValue != 0);
+				}
+			}
+		}
+		else if (Key.Equals(TEXT("Repeat"), ESearchCase::IgnoreCase))
+		{
+			bParsed = Value.IsNumeric() && FCString::Atoi(*Value) > 0;
+			Repetitions = FMath::Max(1, FCString::Atoi(*Value));
+		}
+		else if (Key.Equals(TEXT("Rate"), ESearchCase::IgnoreCase))
+		{
+			uint64 Rate = 0;
+			bParsed = Value == TEXT("0") || ParseByteSize(Value, Rate);
+			BytesPerSecond = static_cast<double>(Rate);
+		}
+		else if (Key.Equals(TEXT("Latency"), ESearchCase::IgnoreCase))
+		{
+			bParsed = Value.IsNumeric();
+			LatencySeconds = FMath::Max(0.f, FCString::Atof(*Value));
+		}
+		else if (Key.Equals(TEXT("Timeout"), ESearchCase::IgnoreCase))
+		{
+			bParsed = Value.IsNumeric() && FCString::Atod(*Value) > 0.0;
+			CaseTimeoutSeconds = FCString::Atod(*Value);
+		}
+		else if (Key.Equals(TEXT("Output"), ESearchCase::IgnoreCase))
+		{
+			OutputDirectory = Value.TrimQuotes();
+		}
+		else
+		{
+			bParsed = false;
+		}
+		
+		if (!bParsed)
+		{
+			LOG_ERROR("Couldn't parse benchmark argument '%s'", *Token);
+			return false;
+		}
+	}
+	return true;
+}
+
+FChunkStreamBenchmark::FChunkStreamBenchmark(const FChunkStreamBenchmarkSettings& InSettings)
+	: Settings(InSettings)
+{
+	for (int32 Repetition = 0; Repetition < FMath::Max(1, Settings.Repetitions); Repetition++)
+	{
+		for (uint64 FileSize : Settings.FileSizes)
+		{
+			for (bool bAcceptRanges : Settings.AcceptRanges)
+			{
+				for (int32 ChunkSizeMB : Settings.ChunkSizesMB)
+				{
+					for (int32 Concurrency : Settings.Concurrencies)
+					{
+						FChunkStreamBenchmarkCase& Case = Cases.AddDefaulted_GetRef();
+						Case.FileSize = FileSize;
+						Case.ChunkSizeMB = ChunkSizeMB;
+						Case.Concurrency = FMath::Max(1, Concurrency);
+						Case.bAcceptRanges = bAcceptRanges;
+						Case.Repetition = Repetition;
+					}
+				}
+			}
+		}
+	}
+	
+	OutputDirectory = Settings.OutputDirectory.IsEmpty() ? FPaths::ProjectSavedDir() / TEXT("ChunkStreamBenchmark") : Settings.OutputDirectory;
+	// unique per instance so two benchmarks never serve each other's files
+	Scheme = FString::Printf(TEXT("chunkstream-bench-%s"), *FGuid::NewGuid().ToString(EGuidFormats::Digits).ToLower());
+}
+
+FChunkStreamBenchmark::~FChunkStreamBenchmark()
+{
+	if (TickHandle.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(TickHandle);
+		TickHandle.Reset();
+	}
+	for (const TSharedRef<FRunningDownload>& Download : Downloads)
+	{
+		if (!Download->bDone && Download->Downloader)
+		{
+			Download->Downloader->CancelDownload();
+		}
+	}
+	ChunkStreamBenchmark::GCpuTimingEnabled.store(false);
+	RestoreCVars();
+	if (Server)
+	{
+		ChunkStreamTransport::RegisterScheme(Scheme, nullptr);
+	}
+}
+
+void FChunkStreamBenchmark::Start(const FOnChunkStreamBenchmarkComplete& OnComplete)
+{
+	check(IsInGameThread());
+	if (IsRunning())
+	{
+		LOG_WARN("Benchmark already running");
+		return;
+	}
+	OnBenchmarkComplete = OnComplete;
+	Results.Reset();
+	NextCase = 0;
+	
+	Server = MakeShared<FChunkStreamMemoryTransport, ESPMode::ThreadSafe>();
+	ChunkStreamTransport::RegisterScheme(Scheme, Server);
+	IFileManager::Get().MakeDirectory(*(OutputDirectory / TEXT("Files")), true);
+	
+	LOG("Benchmark of %d cases started, writing to '%s'", Cases.Num(), *OutputDirectory);
+	TickHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateSP(this, &FChunkStreamBenchmark::Tick));
+}
+
+void FChunkStreamBenchmark::Stop()
+{
+	if (!IsRunning())
+	{
+		return;
+	}
+	LOG("Benchmark stopped after %d of %d cases", Results.Num(), Cases.Num());
+	if (bCaseRunning)
+	{
+		FinishCase(true);
+	}
+	NextCase = Cases.Num();
+	Finish();
+}
+
+bool FChunkStreamBenchmark::Tick(float DeltaTime)
+{
+	if (!bCaseRunning)
+	{
+		if (NextCase >= Cases.Num())
+		{
+			Finish();
+			return false;
+		}
+		StartCase(Cases[NextCase++]);
+		return true;
+	}
+	
+	SampleMemory();
+	bool bAllDone = true;
+	for (const TSharedRef<FRunningDownload>& Download : Downloads)
+	{
+		bAllDone &= Download->bDone;
+	}
+	if (bAllDone)
+	{
+		FinishCase(false);
+	}
+	else if (FPlatformTime::Seconds() - CaseStartTime > Settings.CaseTimeoutSeconds)
+	{
+		LOG_ERROR("Benchmark case timed out after %.0f seconds", Settings.CaseTimeoutSeconds);
+		FinishCase(true);
+	}
+	return true;
+}
+
+void FChunkStreamBenchmark::StartCase(const FChunkStreamBenchmarkCase& Case)
+{
+	SetIntCVar(TEXT("ChunkStream.MaxChunkSize"), Case.ChunkSizeMB);
+	SetIntCVar(TEXT("ChunkStream.MaxConcurrentDownloads"), Case.Concurrency);
+	// downloads also wait for a free pool connection, so the pool has to fit the case's concurrency. 0 has no cap to raise
+	const int32* SavedMaxConnections = SavedCVars.Find(TEXT("ChunkStream.MaxConnections"));
+	const int32 MaxConnections = SavedMaxConnections ? *SavedMaxConnections : FChunkStreamConnectionPool::GetMaxConnections();
+	if (MaxConnections > 0)
+	{
+		SetIntCVar(TEXT("ChunkStream.MaxConnections"), FMath::Max(MaxConnections, Case.Concurrency));
+	}
+	
+	FChunkStreamMemoryFileSettings FileSettings;
+	FileSettings.FileSize = Case.FileSize;
+	FileSettings.bAcceptRanges = Case.bAcceptRanges;
+	FileSettings.BytesPerSecond = Settings.BytesPerSecond;
+	FileSettings.LatencySeconds = Settings.LatencySeconds;
+	FileSettings.PacketSize = FMath::Max(1, Settings.PacketSize);
+	const FString FileURL = FString::Printf(TEXT("%s://files/%d.bin"), *Scheme, NextCase);
+	Server->AddFile(FileURL, FileSettings);
+	
+	Downloads.Reset();
+	for (int32 i = 0; i < Case.Concurrency; i++)
+	{
+		TSharedRef<FRunningDownload> Download = MakeShared<FRunningDownload>();
+		Download->SavePath = OutputDirectory / TEXT("Files") / FString::Printf(TEXT("%d-%d.bin"), NextCase, i);
+		IFileManager::Get().Delete(*Download->SavePath, false, true, true);
+		Download->Downloader.Reset(UChunkStreamDownloader::DownloadFileToStorage(nullptr, FileURL, Download->SavePath));
+		
+		TWeakPtr<FRunningDownload> WeakDownload = Download;
+		Download->Downloader->Native_DownloadProgress.AddLambda([WeakDownload](FChunkStreamResultParams Params)
+		{
+			TSharedPtr<FRunningDownload> PinnedDownload = WeakDownload.Pin();
+			if (PinnedDownload && PinnedDownload->FirstByteTime < 0.0 && Params.Progress > 0.f)
+			{
+				PinnedDownload->FirstByteTime = FPlatformTime::Seconds();
+			}
+		});
+		Download->Downloader->Native_DownloadFinished.AddLambda([WeakDownload](FChunkStreamResultParams Params)
+		{
+			if (TSharedPtr<FRunningDownload> PinnedDownload = WeakDownload.Pin())
+			{
+				PinnedDownload->Result = Params.DownloadTaskResult;
+				PinnedDownload->bDone = true;
+			}
+		});
+		Downloads.Add(Download);
+	}
+	
+	ChunkStreamBenchmark::ResetCpuCounters();
+	ChunkStreamBenchmark::GCpuTimingEnabled.store(true);
+	CaseStartUsedPhysical = FPlatformMemory::GetStats().UsedPhysical;
+	CasePeakUsedPhysical = CaseStartUsedPhysical;
+	bCaseRunning = true;
+	CaseStartTime = FPlatformTime::Seconds();
+	for (const TSharedRef<FRunningDownload>& Download : Downloads)
+	{
+		Download->Downloader->Activate();
+	}
+}
+
+void FChunkStreamBenchmark::FinishCase(bool bTimedOut)
+{
+	const double EndTime = FPlatformTime::Seconds();
+	ChunkStreamBenchmark::GCpuTimingEnabled.store(false);
+	SampleMemory();
+	bCaseRunning = false;
+	
+	const FChunkStreamBenchmarkCase& Case = Cases[NextCase - 1];
+	FChunkStreamBenchmarkResult& Result = Results.AddDefaulted_GetRef();
+	Result.Case = Case;
+	Result.Seconds = EndTime - CaseStartTime;
+	Result.bSucceeded = !bTimedOut;
+	Result.PeakUsedPhysical = CasePeakUsedPhysical;
+	Result.PeakUsedPhysicalDelta = static_cast<int64>(CasePeakUsedPhysical) - static_cast<int64>(CaseStartUsedPhysical);
+	Result.HttpThreadCpuSeconds = ChunkStreamBenchmark::GetCpuSeconds(ChunkStreamBenchmark::ECpuCounter::HttpThread);
+	Result.WorkerCpuSeconds = ChunkStreamBenchmark::GetCpuSeconds(ChunkStreamBenchmark::ECpuCounter::Worker);
+	
+	double TotalFirstByteMs = 0.0;
+	for (const TSharedRef<FRunningDownload>& Download : Downloads)
+	{
+		if (!Download->bDone)
+		{
+			Download->Downloader->CancelDownload();
+		}
+		// files too small for a progress event with data get theirs at completion
+		const double FirstByteMs = ((Download->FirstByteTime >= 0.0 ? Download->FirstByteTime : EndTime) - CaseStartTime) * 1000.0;
+		TotalFirstByteMs += FirstByteMs;
+		Result.MaxTimeToFirstByteMs = FMath::Max(Result.MaxTimeToFirstByteMs, FirstByteMs);
+		
+		const int64 FileSize = IFileManager::Get().FileSize(*Download->SavePath);
+		if (Download->Result != EChunkStreamDownloadResult::Success || FileSize != static_cast<int64>(Case.FileSize))
+		{
+			Result.bSucceeded = false;
+		}
+		IFileManager::Get().Delete(*Download->SavePath, false, true, true);
+	}
+	Result.MeanTimeToFirstByteMs = TotalFirstByteMs / FMath::Max(1, Downloads.Num());
+	Result.MegabytesPerSecond = Result.Seconds > 0.0
+		? static_cast<double>(Case.FileSize) * Case.Concurrency / (1024.0 * 1024.0) / Result.Seconds
+		: 0.0;
+	
+	Result.LLMTagPeaks = MoveTemp(CaseLLMTagPeaks);
+	CaseLLMTagPeaks.Reset();
+	
+	Server->RemoveFile(FString::Printf(TEXT("%s://files/%d.bin"), *Scheme, NextCase - 1));
+	Downloads.Reset();
+	
+	LOG("Benchmark %d/%d: %s file, %d MB chunks, %d at once, ranges %s: %s %.1f MB/s, TTFB %.1f ms, peak RSS +%lld MB, HTTP CPU %.3fs, worker CPU %.3fs",
+		NextCase, Cases.Num(), *FormatBytes(Case.FileSize), Case.ChunkSizeMB, Case.Concurrency, Case.bAcceptRanges ? TEXT("on") : TEXT("off"),
+		Result.bSucceeded ? TEXT("ok") : TEXT("FAILED"), Result.MegabytesPerSecond, Result.MeanTimeToFirstByteMs,
+		Result.PeakUsedPhysicalDelta / (1024 * 1024), Result.HttpThreadCpuSeconds, Result.WorkerCpuSeconds);
+}
+
+void FChunkStreamBenchmark::Finish()
+{
+	if (TickHandle.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(TickHandle);
+		TickHandle.Reset();
+	}
+	RestoreCVars();
+	ChunkStreamTransport::RegisterScheme(Scheme, nullptr);
+	Server.Reset();
+	
+	const FString BaseName = OutputDirectory / FString::Printf(TEXT("ChunkStreamBenchmark-%s"), *FDateTime::Now().ToString());
+	CSVPath = BaseName + TEXT(".csv");
+	JSONPath = BaseName + TEXT(".json");
+	if (!FFileHelper::SaveStringToFile(ToCSV(Results), *CSVPath) || !FFileHelper::SaveStringToFile(ToJSON(Results), *JSONPath))
+	{
+		LOG_ERROR("Couldn't save benchmark results to '%s'", *OutputDirectory);
+	}
+	
+	// the delegate may release the last reference to us
+	TSharedRef<FChunkStreamBenchmark> KeepAlive = AsShared();
+	OnBenchmarkComplete.ExecuteIfBound(Results);
+}
+
+void FChunkStreamBenchmark::SampleMemory()
+{
+	CasePeakUsedPhysical = FMath::Max<uint64>(CasePeakUsedPhysical, FPlatformMemory::GetStats().UsedPhysical);
+	
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+	if (FLowLevelMemTracker::IsEnabled())
+	{
+		TMap<FName, uint64> TagAmounts;
+		FLowLevelMemTracker::Get().GetTagsNamesWithAmount(TagAmounts, ELLMTracker::Default, ELLMTagSet::None);
+		for (const TPair<FName, uint64>& TagAmount : TagAmounts)
+		{
+			FString TagName = TagAmount.Key.ToString();
+			if (!TagName.StartsWith(TEXT("ChunkStream/")))
+			{
+				continue;
+			}
+			TPair<FString, int64>* Peak = CaseLLMTagPeaks.FindByPredicate([&TagName](const TPair<FString, int64>& Existing) { return Existing.Key == TagName; });
+			if (!Peak)
+			{
+				Peak = &CaseLLMTagPeaks.Emplace_GetRef(MoveTemp(TagName), 0);
+			}
+			Peak->Value = FMath::Max(Peak->Value, static_cast<int64>(TagAmount.Value));
+		}
+	}
+#endif
+}
+
+void FChunkStreamBenchmark::SetIntCVar(const TCHAR* Name, int32 Value)
+{
+	IConsoleVariable* CVar = IConsoleManager::Get().FindConsoleVariable(Name);
+	if (!CVar)
+	{
+		LOG_ERROR("Missing console variable '%s'", Name);
+		return;
+	}
+	if (!SavedCVars.Contains(Name))
+	{
+		SavedCVars.Add(Name, CVar->GetInt());
+	}
+	CVar->Set(Value, ECVF_SetByCode);
+}
+
+void FChunkStreamBenchmark::RestoreCVars()
+{
+	for (const TPair<FString, int32>& Saved : SavedCVars)
+	{
+		if (IConsoleVariable* CVar = IConsoleManager::Get().FindConsoleVariable(*Saved.Key))
+		{
+			CVar->Set(Saved.Value, ECVF_SetByCode);
+		}
+	}
+	SavedCVars.Reset();
+}
+
+FString FChunkStreamBenchmark::ToCSV(const TArray<FChunkStreamBenchmarkResult>& InResults)
+{
+	FString CSV = TEXT("plugin_version,file_size_bytes,chunk_size_mb,concurrency,accept_ranges,repetition,succeeded,seconds,mb_per_second,")
+		TEXT("ttfb_mean_ms,ttfb_max_ms,peak_rss_bytes,peak_rss_delta_bytes,http_thread_cpu_seconds,worker_cpu_seconds,llm_peak_bytes\n");
+	const FString PluginVersion = GetPluginVersion();
+	for (const FChunkStreamBenchmarkResult& Result : InResults)
+	{
+		// tag=bytes pairs separated by ';' so the column stays one field
+		FString LLMTags;
+		for (const TPair<FString, int64>& Tag : Result.LLMTagPeaks)
+		{
+			LLMTags += FString::Printf(TEXT("%s%s=%lld"), LLMTags.IsEmpty() ? TEXT("") : TEXT(";"), *Tag.Key, Tag.Value);
+		}
+		CSV += FString::Printf(TEXT("%s,%llu,%d,%d,%d,%d,%d,%.4f,%.3f,%.3f,%.3f,%llu,%lld,%.4f,%.4f,%s\n"),
+			*PluginVersion, Result.Case.FileSize, Result.Case.ChunkSizeMB, Result.Case.Concurrency, Result.Case.bAcceptRanges ? 1 : 0,
+			Result.Case.Repetition, Result.bSucceeded ? 1 : 0, Result.Seconds, Result.MegabytesPerSecond,
+			Result.MeanTimeToFirstByteMs, Result.MaxTimeToFirstByteMs, Result.PeakUsedPhysical, Result.PeakUsedPhysicalDelta,
+			Result.HttpThreadCpuSeconds, Result.WorkerCpuSeconds, *LLMTags);
+	}
+	return CSV;
+}
+
+FString FChunkStreamBenchmark::ToJSON(const TArray<FChunkStreamBenchmarkResult>& InResults)
+{
+	FString JSON = FString::Printf(TEXT("{\n\t\"plugin_version\": \"%s\",\n\t\"engine_version\": \"%s\",\n\t\"platform\": \"%s\",\n\t\"date\": \"%s\",\n\t\"results\": ["),
+		*EscapeJSON(GetPluginVersion()), *EscapeJSON(FEngineVersion::Current().ToString()), *EscapeJSON(FString(FPlatformProperties::IniPlatformName())),
+		*FDateTime::UtcNow().ToIso8601());
+	for (int32 i = 0; i < InResults.Num(); i++)
+	{
+		const FChunkStreamBenchmarkResult& Result = InResults[i];
+		FString LLMTags;
+		for (const TPair<FString, int64>& Tag : Result.LLMTagPeaks)
+		{
+			LLMTags += FString::Printf(TEXT("%s\"%s\": %lld"), LLMTags.IsEmpty() ? TEXT("") : TEXT(", "), *EscapeJSON(Tag.Key), Tag.Value);
+		}
+		JSON += FString::Printf(TEXT("%s\n\t\t{\"file_size_bytes\": %llu, \"chunk_size_mb\": %d, \"concurrency\": %d, \"accept_ranges\": %s, \"repetition\": %d, ")
+			TEXT("\"succeeded\": %s, \"seconds\": %.4f, \"mb_per_second\": %.3f, \"ttfb_mean_ms\": %.3f, \"ttfb_max_ms\": %.3f, ")
+			TEXT("\"peak_rss_bytes\": %llu, \"peak_rss_delta_bytes\": %lld, \"http_thread_cpu_seconds\": %.4f, \"worker_cpu_seconds\": %.4f, \"llm_peak_bytes\": {%s}}"),
+			i > 0 ? TEXT(",") : TEXT(""), Result.Case.FileSize, Result.Case.ChunkSizeMB, Result.Case.Concurrency,
+			Result.Case.bAcceptRanges ? TEXT("true") : TEXT("false"), Result.Case.Repetition, Result.bSucceeded ? TEXT("true") : TEXT("false"),
+			Result.Seconds, Result.MegabytesPerSecond, Result.MeanTimeToFirstByteMs, Result.MaxTimeToFirstByteMs,
+			Result.PeakUsedPhysical, Result.PeakUsedPhysicalDelta, Result.HttpThreadCpuSeconds, Result.WorkerCpuSeconds, *LLMTags);
+	}
+	JSON += TEXT("\n\t]\n}\n");
+	return JSON;
+}
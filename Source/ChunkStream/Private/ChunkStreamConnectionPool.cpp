@@ -0,0 +1,147 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#include "ChunkStreamConnectionPool.h"
+#include "ChunkStream.h"
+#include "ChunkStreamLogs.h"
+#include "HAL/IConsoleManager.h"
+#include "StreamChunkDownloader.h"
+
+TAutoConsoleVariable<int32> CVarMaxConnections(
+	TEXT("ChunkStream.MaxConnections"),
+	6,
+	TEXT("Requests all downloads may have open together. Each running download holds one for its chunks, downloads past that wait to start.")
+	TEXT(" The rest go to hedges and to fetching ranges from the end of the download with the most left.")
+	TEXT(" 0 = no limit besides ChunkStream.MaxConcurrentDownloads and no range helpers. Default: 6"),
+	ECVF_Default);
+
+TAutoConsoleVariable<int32> CVarMinStealSizeKB(
+	TEXT("ChunkStream.MinStealSizeKB"),
+	1024,
+	TEXT("Smallest range in KB an idle connection takes from another download, less isn't worth a request of its own. Default: 1024"),
+	ECVF_Default);
+
+static constexpr float RebalanceInterval = 0.1f;
+
+void FChunkStreamConnectionPool::Register(const TSharedRef<FStreamChunkDownloader>& Downloader)
+{
+	check(IsInGameThread());
+	Downloaders.AddUnique(Downloader);
+	if (!TickHandle.IsValid())
+	{
+		TickHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FChunkStreamConnectionPool::Tick), RebalanceInterval);
+	}
+}
+
+bool FChunkStreamConnectionPool::Tick(float DeltaTime)
+{
+	Rebalance();
+	if (Downloaders.Num() == 0)
+	{
+		// registering the next download starts it again
+		TickHandle.Reset();
+		return false;
+	}
+	return true;
+}
+
+void FChunkStreamConnectionPool::Rebalance()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FChunkStreamConnectionPool::Rebalance)
+	Downloaders.RemoveAll([](const TWeakPtr<FStreamChunkDownloader>& Downloader)
+	{
+		const TSharedPtr<FStreamChunkDownloader> Pinned = Downloader.Pin();
+		return !Pinned || Pinned->IsChunkLoopFinished();
+	});
+	if (GetMaxConnections() <= 0)
+	{
+		return;
+	}
+	// helpers finishing free connections for downloads waiting to start, they get them before any more helpers
+	FChunkStreamModule& Module = FModuleManager::Get().GetModuleChecked<FChunkStreamModule>(TEXT("ChunkStream"));
+	if (Module.IsWaitingForConnection())
+	{
+		Module.StartWaitingDownloads();
+	}
+	const uint64 MinStealBytes = static_cast<uint64>(FMath::Max(CVarMinStealSizeKB.GetValueOnGameThread(), 4)) * 1024;
+	
+	while (CanOpenExtraConnection())
+	{
+		// the most left to fetch ends last, it gets the next connection
+		TSharedPtr<FStreamChunkDownloader> Neediest;
+		uint64 MostStealable = 0;
+		for (const TWeakPtr<FStreamChunkDownloader>& Downloader : Downloaders)
+		{
+			const TSharedPtr<FStreamChunkDownloader> Pinned = Downloader.Pin();
+			const uint64 Stealable = Pinned ? Pinned->GetStealableBytes() : 0;
+			if (Stealable > MostStealable)
+			{
+				MostStealable = Stealable;
+				Neediest = Pinned;
+			}
+		}
+		if (!Neediest || !Neediest->StartRangeHelper(MinStealBytes))
+		{
+			return;
+		}
+	}
+}
+
+int32 FChunkStreamConnectionPool::GetNumConnections() const
+{
+	int32 NumConnections = 0;
+	for (const TWeakPtr<FStreamChunkDownloader>& Downloader : Downloaders)
+	{
+		if (const TSharedPtr<FStreamChunkDownloader> Pinned = Downloader.Pin())
+		{
+			NumConnections += Pinned->GetNumConnections();
+		}
+	}
+	return NumConnections;
+}
+
+int32 FChunkStreamConnectionPool::GetNumExtraConnections() const
+{
+	int32 NumConnections = 0;
+	for (const TWeakPtr<FStreamChunkDownloader>& Downloader : Downloaders)
+	{
+		if (const TSharedPtr<FStreamChunkDownloader> Pinned = Downloader.Pin())
+		{
+			NumConnections += Pinned->GetNumExtraConnections();
+		}
+	}
+	return NumConnections;
+}
+
+int32 FChunkStreamConnectionPool::GetNumFreeConnections() const
+{
+	const int32 MaxConnections = GetMaxConnections();
+	if (MaxConnections <= 0)
+	{
+		return MAX_int32;
+	}
+	// a running download holds its connection between chunks too, and before it has registered here
+	const FChunkStreamModule& Module = FModuleManager::Get().GetModuleChecked<FChunkStreamModule>(TEXT("ChunkStream"));
+	return FMath::Max(MaxConnections - Module.GetNumActiveDownloads() - GetNumExtraConnections(), 0);
+}
+
+bool FChunkStreamConnectionPool::CanOpenExtraConnection() const
+{
+	if (GetMaxConnections() <= 0)
+	{
+		return true;
+	}
+	const FChunkStreamModule& Module = FModuleManager::Get().GetModuleChecked<FChunkStreamModule>(TEXT("ChunkStream"));
+	return GetNumFreeConnections() > 0 && !Module.IsWaitingForConnection();
+}
+
+int32 FChunkStreamConnectionPool::GetMaxConnections()
+{
+	return FMath::Max(CVarMaxConnections.GetValueOnAnyThread(), 0);
+}
+
+void FChunkStreamConnectionPool::Shutdown()
+{
+	FTSTicker::GetCoreTicker().RemoveTicker(TickHandle);
+	TickHandle.Reset();
+	Downloaders.Reset();
+}
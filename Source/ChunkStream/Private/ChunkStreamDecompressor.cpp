@@ -0,0 +1,564 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+
+#include "ChunkStreamDecompressor.h"
+#include "ChunkStreamLogs.h"
+#include "ChunkStreamMemoryBudget.h"
+#include "Async/Async.h"
+#include "GenericPlatform/GenericPlatformFile.h"
+
+THIRD_PARTY_INCLUDES_START
+#include "zlib.h"
+#if WITH_CHUNKSTREAM_ZSTD
+#include "zstd.h"
+#include "zstd_errors.h"
+#endif
+THIRD_PARTY_INCLUDES_END
+
+// Size of the scratch buffer decoders write into before it goes to storage
+static constexpr int64 DecodeBufferSize = 1024 * 1024;
+// Bytes needed to tell the formats apart (zstd magic is the longest)
+static constexpr int32 DetectHeaderSize = 4;
+// zstd frames up to this size are buffered and decoded on workers, larger ones are streamed
+static constexpr uint64 MaxParallelFrameBytes = 64 * 1024 * 1024;
+// Most a frame header may declare it decodes to for the frame to get a buffer of that size, the header comes from the server
+static constexpr uint64 MaxParallelContentBytes = 4 * MaxParallelFrameBytes;
+
+struct FChunkStreamDecompressor::FZlibState
+{
+	z_stream Stream;
+	bool bInitialized = false;
+	// Current deflate stream / gzip member has ended
+	bool bStreamEnded = false;
+	// Bytes after the end of the stream that were ignored
+	uint64 TrailingBytes = 0;
+
+	FZlibState()
+	{
+		FMemory::Memzero(Stream);
+	}
+	~FZlibState()
+	{
+		if (bInitialized)
+		{
+			inflateEnd(&Stream);
+		}
+	}
+};
+
+#if WITH_CHUNKSTREAM_ZSTD
+struct FChunkStreamDecompressor::FZstdState
+{
+	// Result of decoding one frame on a worker
+	struct FDecodedFrame
+	{
+		TArray64<uint8> Data;
+		FString Error;
+	};
+	// A frame decoding on a worker and the budget its buffers are counted against until it is written
+	struct FFrameInFlight
+	{
+		TFuture<FDecodedFrame> Result;
+		FChunkStreamMemoryReservation Memory;
+	};
+
+	// Decoder for frames too big to buffer
+	ZSTD_DStream* Stream = nullptr;
+	// Currently streaming a large frame through Stream
+	bool bStreamingFrame = false;
+	// Bytes of frames that haven't fully arrived yet
+	TArray64<uint8> Pending;
+	// Frames being decoded on workers, in file order
+	TArray<FFrameInFlight> InFlight;
+	int32 MaxInFlight = 2;
+
+	FZstdState()
+	{
+		MaxInFlight = FMath::Max(2, FPlatformMisc::NumberOfCoresIncludingHyperthreads() / 2);
+	}
+	~FZstdState()
+	{
+		for (FFrameInFlight& Frame : InFlight)
+		{
+			Frame.Result.Wait();
+		}
+		if (Stream)
+		{
+			ZSTD_freeDStream(Stream);
+		}
+	}
+
+	// Decodes a whole frame whose header declared ContentSize, decoding stops there whatever the frame holds
+	static FDecodedFrame DecodeFrame(const TArray64<uint8>& Frame, uint64 ContentSize)
+	{
+		FDecodedFrame Result;
+		Result.Data.SetNumUninitialized(static_cast<int64>(ContentSize));
+		const size_t Decoded = ZSTD_decompress(Result.Data.GetData(), Result.Data.Num(), Frame.GetData(), Frame.Num());
+		if (ZSTD_isError(Decoded))
+		{
+			Result.Error = UTF8_TO_TCHAR(ZSTD_getErrorName(Decoded));
+		}
+		Result.Data.SetNum(ZSTD_isError(Decoded) ? 0 : static_cast<int64>(Decoded), EAllowShrinking::No);
+		return Result;
+	}
+};
+#else
+struct FChunkStreamDecompressor::FZstdState
+{
+};
+#endif
+
+FChunkStreamDecompressor::FChunkStreamDecompressor(EChunkStreamDecompression InFormat, IFileHandle* InOutput, bool bInTransportDecoded)
+	: Format(InFormat), Output(InOutput), bTransportDecoded(bInTransportDecoded)
+{
+	check(Output);
+}
+
+FChunkStreamDecompressor::~FChunkStreamDecompressor()
+{
+}
+
+EChunkStreamDecompression FChunkStreamDecompressor::DetectFormat(const uint8* Data, uint64 Num)
+{
+	if (Num >= 2 && Data[0] == 0x1F && Data[1] == 0x8B)
+	{
+		return EChunkStreamDecompression::Gzip;
+	}
+	if (Num >= 4 && Data[0] == 0x28 && Data[1] == 0xB5 && Data[2] == 0x2F && Data[3] == 0xFD)
+	{
+		return EChunkStreamDecompression::Zstd;
+	}
+	// zlib header: deflate method with a valid header checksum
+	if (Num >= 2 && (Data[0] & 0x0F) == 8 && ((static_cast<uint32>(Data[0]) << 8) | Data[1]) % 31 == 0)
+	{
+		return EChunkStreamDecompression::Deflate;
+	}
+	return EChunkStreamDecompression::None;
+}
+
+bool FChunkStreamDecompressor::IsZstdAvailable()
+{
+	return WITH_CHUNKSTREAM_ZSTD != 0;
+}
+
+bool FChunkStreamDecompressor::Process(const uint8* Data, uint64 Num)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FChunkStreamDecompressor::Process)
+	if (Num == 0)
+	{
+		return true;
+	}
+	if (!bStarted)
+	{
+		// hold the first bytes back until the format can be detected
+		const int32 Needed = DetectHeaderSize - HeaderBytes.Num();
+		if (Needed > 0)
+		{
+			const int32 Take = static_cast<int32>(FMath::Min<uint64>(Needed, Num));
+			HeaderBytes.Append(Data, Take);
+			Data += Take;
+			Num -= Take;
+			if (HeaderBytes.Num() < DetectHeaderSize)
+			{
+				return true;
+			}
+		}
+		if (!BeginDecoding(HeaderBytes.GetData(), HeaderBytes.Num()))
+		{
+			return false;
+		}
+		TArray<uint8> Header = MoveTemp(HeaderBytes);
+		if (!DecodeBytes(Header.GetData(), Header.Num()))
+		{
+			return false;
+		}
+	}
+	return DecodeBytes(Data, Num);
+}
+
+bool FChunkStreamDecompressor::BeginDecoding(const uint8* Data, uint64 Num)
+{
+	bStarted = true;
+	const EChunkStreamDecompression Detected = DetectFormat(Data, Num);
+	
+	if (Format == EChunkStreamDecompression::Auto)
+	{
+		Format = Detected;
+		if (Format == EChunkStreamDecompression::None)
+		{
+			LOG("Download isn't gzip, zlib or zstd, writing it as downloaded");
+			bPassThrough = true;
+			return true;
+		}
+	}
+	else if (Format != Detected && !(Format == EChunkStreamDecompression::Deflate && Detected == EChunkStreamDecompression::None))
+	{
+		// raw deflate has no header so it is the only format that can't be checked here
+		if (bTransportDecoded)
+		{
+			LOG_WARN("Response was already decoded by the HTTP layer, writing it as downloaded");
+			bPassThrough = true;
+			return true;
+		}
+		Error = FString::Printf(TEXT("Download does not start with the expected %s header"), *UEnum::GetValueAsString(Format));
+		return false;
+	}
+	
+	OutputBuffer.SetNumUninitialized(DecodeBufferSize);
+	if (Format == EChunkStreamDecompression::Zstd)
+	{
+#if WITH_CHUNKSTREAM_ZSTD
+		Zstd = MakeUnique<FZstdState>();
+		return true;
+#else
+		Error = TEXT("zstd download but the plugin was built without zstd (WITH_CHUNKSTREAM_ZSTD)");
+		return false;
+#endif
+	}
+	
+	Zlib = MakeUnique<FZlibState>();
+	int32 WindowBits = 15;
+	if (Format == EChunkStreamDecompression::Gzip)
+	{
+		WindowBits = 15 + 16;
+	}
+	else if (Detected == EChunkStreamDecompression::None)
+	{
+		// deflate without the zlib wrapper, which some servers send for "deflate"
+		WindowBits = -15;
+	}
+	if (inflateInit2(&Zlib->Stream, WindowBits) != Z_OK)
+	{
+		Error = TEXT("Failed to initialise zlib");
+		return false;
+	}
+	Zlib->bInitialized = true;
+	return true;
+}
+
+bool FChunkStreamDecompressor::DecodeBytes(const uint8* Data, uint64 Num)
+{
+	if (bPassThrough)
+	{
+		return WriteOutput(Data, Num);
+	}
+	if (Zstd)
+	{
+		return ProcessZstd(Data, Num);
+	}
+	return ProcessZlib(Data, Num);
+}
+
+bool FChunkStreamDecompressor::ProcessZlib(const uint8* Data, uint64 Num)
+{
+	check(Zlib);
+	z_stream& Stream = Zlib->Stream;
+	while (Num > 0)
+	{
+		// zlib counts in uInt, so feed huge chunks in slices
+		const uInt Slice = static_cast<uInt>(FMath::Min<uint64>(Num, MAX_uint32 >> 1));
+		Stream.next_in = const_cast<Bytef*>(Data);
+		Stream.avail_in = Slice;
+		
+		while (Stream.avail_in > 0)
+		{
+			if (Zlib->bStreamEnded)
+			{
+				// another gzip member follows, anything else is padding after the stream
+				if (Format == EChunkStreamDecompression::Gzip && Stream.next_in[0] == 0x1F)
+				{
+					inflateReset(&Stream);
+					Zlib->bStreamEnded = false;
+				}
+				else
+				{
+					Zlib->TrailingBytes += Stream.avail_in;
+					Stream.avail_in = 0;
+					break;
+				}
+			}
+			
+			Stream.next_out = OutputBuffer.GetData();
+			Stream.avail_out = static_cast<uInt>(OutputBuffer.Num());
+			const int Ret = inflate(&Stream, Z_NO_FLUSH);
+			const uint64 Produced = OutputBuffer.Num() - Stream.avail_out;
+			if (Produced > 0 && !WriteOutput(OutputBuffer.GetData(), Produced))
+			{
+				return false;
+			}
+			
+			if (Ret == Z_STREAM_END)
+			{
+				Zlib->bStreamEnded = true;
+			}
+			else if (Ret != Z_OK && !(Ret == Z_BUF_ERROR && Produced > 0))
+			{
+				// Z_BUF_ERROR without output means no progress is possible, the data is corrupt
+				Error = FString::Printf(TEXT("zlib error %d: %s"), Ret, Stream.msg ? UTF8_TO_TCHAR(Stream.msg) : TEXT("unknown"));
+				return false;
+			}
+		}
+		Data += Slice;
+		Num -= Slice;
+	}
+	return true;
+}
+
+bool FChunkStreamDecompressor::ProcessZstd(const uint8* Data, uint64 Num)
+{
+#if WITH_CHUNKSTREAM_ZSTD
+	check(Zstd);
+	
+	// writes decoded frames that are done, in order, optionally waiting for all of them
+	auto DrainFrames = [this](bool bWaitAll) -> bool
+	{
+		while (Zstd->InFlight.Num() > 0 && (bWaitAll || Zstd->InFlight[0].Result.IsReady()))
+		{
+			const FZstdState::FDecodedFrame& Frame = Zstd->InFlight[0].Result.Get();
+			if (!Frame.Error.IsEmpty())
+			{
+				Error = FString::Printf(TEXT("zstd frame failed to decode: %s"), *Frame.Error);
+				return false;
+			}
+			if (!WriteOutput(Frame.Data.GetData(), Frame.Data.Num()))
+			{
+				return false;
+			}
+			// gives the frame's buffers back to the budget
+			Zstd->InFlight.RemoveAt(0);
+		}
+		return true;
+	};
+	
+	// feeds bytes of a large frame through the streaming decoder, returns how many belonged to it
+	auto StreamFrame = [this](const uint8* InData, uint64 InNum, uint64& OutConsumed) -> bool
+	{
+		ZSTD_inBuffer In = { InData, static_cast<size_t>(InNum), 0 };
+		while (In.pos < In.size)
+		{
+			ZSTD_outBuffer Out = { OutputBuffer.GetData(), static_cast<size_t>(OutputBuffer.Num()), 0 };
+			const size_t Ret = ZSTD_decompressStream(Zstd->Stream, &Out, &In);
+			if (ZSTD_isError(Ret))
+			{
+				Error = FString::Printf(TEXT("zstd error: %s"), UTF8_TO_TCHAR(ZSTD_getErrorName(Ret)));
+				return false;
+			}
+			if (Out.pos > 0 && !WriteOutput(OutputBuffer.GetData(), Out.pos))
+			{
+				return false;
+			}
+			if (Ret == 0)
+			{
+				// frame finished, the rest goes back to parallel decoding
+				Zstd->bStreamingFrame = false;
+				break;
+			}
+		}
+		OutConsumed = In.pos;
+		return true;
+	};
+	
+	// starts streaming a frame through the single decoder, once the frames before it are written
+	auto BeginStreamingFrame = [this, &DrainFrames, &StreamFrame](const uint8* InData, uint64 InNum, uint64& OutConsumed) -> bool
+	{
+		if (!DrainFrames(true))
+		{
+			return false;
+		}
+		if (!Zstd->Stream)
+		{
+			Zstd->Stream = ZSTD_createDStream();
+		}
+		ZSTD_initDStream(Zstd->Stream);
+		Zstd->bStreamingFrame = true;
+		return StreamFrame(InData, InNum, OutConsumed);
+	};
+	
+	if (Zstd->bStreamingFrame)
+	{
+		uint64 Consumed = 0;
+		if (!StreamFrame(Data, Num, Consumed))
+		{
+			return false;
+		}
+		Data += Consumed;
+		Num -= Consumed;
+		if (Num == 0)
+		{
+			return true;
+		}
+	}
+	
+	Zstd->Pending.Append(Data, Num);
+	uint64 Offset = 0;
+	while (Offset < static_cast<uint64>(Zstd->Pending.Num()))
+	{
+		const uint8* FrameStart = Zstd->Pending.GetData() + Offset;
+		const uint64 Available = Zstd->Pending.Num() - Offset;
+		const size_t FrameSize = ZSTD_findFrameCompressedSize(FrameStart, Available);
+		
+		if (!ZSTD_isError(FrameSize))
+		{
+			const unsigned long long ContentSize = ZSTD_getFrameContentSize(FrameStart, FrameSize);
+			if (ContentSize == ZSTD_CONTENTSIZE_ERROR)
+			{
+				Error = TEXT("Invalid zstd frame header");
+				return false;
+			}
+			if (Zstd->InFlight.Num() >= Zstd->MaxInFlight)
+			{
+				Zstd->InFlight[0].Result.Wait();
+				if (!DrainFrames(false))
+				{
+					return false;
+				}
+			}
+			// a small frame can claim gigabytes, only a declared size within limits that the budget covers gets a buffer of its own
+			FChunkStreamMemoryReservation Memory;
+			if (ContentSize != ZSTD_CONTENTSIZE_UNKNOWN && ContentSize <= MaxParallelContentBytes)
+			{
+				Memory = FChunkStreamMemoryBudget::Get().TryReserve(ContentSize + FrameSize, ContentSize + FrameSize);
+			}
+			if (!Memory.IsValid())
+			{
+				// anything else goes through the fixed size output buffer
+				uint64 Consumed = 0;
+				if (!BeginStreamingFrame(FrameStart, FrameSize, Consumed))
+				{
+					return false;
+				}
+				Offset += Consumed;
+				continue;
+			}
+			
+			// complete frame, decode it on a worker
+			TArray64<uint8> Frame(FrameStart, static_cast<int64>(FrameSize));
+			FZstdState::FFrameInFlight& InFlight = Zstd->InFlight.AddDefaulted_GetRef();
+			InFlight.Memory = MoveTemp(Memory);
+			InFlight.Result = Async(EAsyncExecution::ThreadPool, [Frame = MoveTemp(Frame), ContentSize]()
+			{
+				TRACE_CPUPROFILER_EVENT_SCOPE(FChunkStreamDecompressor::DecodeFrame)
+				return FZstdState::DecodeFrame(Frame, ContentSize);
+			});
+			Offset += FrameSize;
+			continue;
+		}
+		
+		if (ZSTD_getErrorCode(FrameSize) != ZSTD_error_srcSize_wrong)
+		{
+			Error = FString::Printf(TEXT("Invalid zstd data: %s"), UTF8_TO_TCHAR(ZSTD_getErrorName(FrameSize)));
+			return false;
+		}
+		
+		// frame isn't complete yet, stream it instead if it's too big to buffer
+		if (Available > MaxParallelFrameBytes)
+		{
+			uint64 Consumed = 0;
+			if (!BeginStreamingFrame(FrameStart, Available, Consumed))
+			{
+				return false;
+			}
+			Offset += Consumed;
+			if (Zstd->bStreamingFrame)
+			{
+				break;
+			}
+			continue;
+		}
+		break;
+	}
+	Zstd->Pending.RemoveAt(0, static_cast<int64>(Offset), EAllowShrinking::No);
+	
+	return DrainFrames(false);
+#else
+	Error = TEXT("zstd support not compiled in");
+	return false;
+#endif
+}
+
+bool FChunkStreamDecompressor::Finish()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FChunkStreamDecompressor::Finish)
+	if (!bStarted)
+	{
+		// download was shorter than the detection header
+		if (HeaderBytes.Num() == 0)
+		{
+			return true;
+		}
+		if (!BeginDecoding(HeaderBytes.GetData(), HeaderBytes.Num()))
+		{
+			return false;
+		}
+		TArray<uint8> Header = MoveTemp(HeaderBytes);
+		if (!DecodeBytes(Header.GetData(), Header.Num()))
+		{
+			return false;
+		}
+	}
+	if (bPassThrough)
+	{
+		return true;
+	}
+	
+	if (Zlib)
+	{
+		if (!Zlib->bStreamEnded)
+		{
+			Error = TEXT("Compressed stream ended early, the download is truncated");
+			return false;
+		}
+		if (Zlib->TrailingBytes > 0)
+		{
+			LOG_WARN("Ignored %llu bytes after the end of the compressed stream", Zlib->TrailingBytes);
+		}
+	}
+#if WITH_CHUNKSTREAM_ZSTD
+	if (Zstd)
+	{
+		while (Zstd->InFlight.Num() > 0)
+		{
+			const FZstdState::FDecodedFrame& Frame = Zstd->InFlight[0].Result.Get();
+			if (!Frame.Error.IsEmpty())
+			{
+				Error = FString::Printf(TEXT("zstd frame failed to decode: %s"), *Frame.Error);
+				return false;
+			}
+			if (!WriteOutput(Frame.Data.GetData(), Frame.Data.Num()))
+			{
+				return false;
+			}
+			Zstd->InFlight.RemoveAt(0);
+		}
+		if (Zstd->bStreamingFrame || Zstd->Pending.Num() > 0)
+		{
+			Error = TEXT("zstd stream ended mid frame, the download is truncated");
+			return false;
+		}
+	}
+#endif
+	LOG("Decompressed download to %llu bytes", BytesWritten);
+	return true;
+}
+
+void FChunkStreamDecompressor::Abort()
+{
+	// workers finish on their own copies, just drop the decoders
+	Zstd.Reset();
+	Zlib.Reset();
+}
+
+bool FChunkStreamDecompressor::WriteOutput(const uint8* Data, uint64 Num)
+{
+	if (Num == 0)
+	{
+		return true;
+	}
+	if (!Output->Write(Data, static_cast<int64>(Num)))
+	{
+		Error = FString::Printf(TEXT("Failed to write %llu decoded bytes to storage"), Num);
+		return false;
+	}
+	BytesWritten += Num;
+	return true;
+}
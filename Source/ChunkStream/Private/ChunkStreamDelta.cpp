@@ -0,0 +1,591 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+
+#include "ChunkStreamDelta.h"
+#include "ChunkStreamDownloader.h"
+#include "ChunkStreamLogs.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+static constexpr uint32 BlockIndexMagic = 0x49425343; // "CSBI"
+static constexpr uint32 BlockIndexVersion = 1;
+// Bytes of the old file each scan task rolls over
+static constexpr int64 ScanSegmentSize = 16 * 1024 * 1024;
+// Buffer for hashing and copying files
+static constexpr int64 FileIOBufferSize = 1024 * 1024;
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Block index
+// ---------------------------------------------------------------------------------------------------------------------
+
+void FChunkStreamBlockIndex::Build(const uint8* Data, uint64 Num, int32 InBlockSize, FChunkStreamBlockIndex& OutIndex)
+{
+	check(InBlockSize > 0);
+	OutIndex.BlockSize = InBlockSize;
+	OutIndex.FileSize = Num;
+	const int32 NumBlocks = static_cast<int32>((Num + InBlockSize - 1) / InBlockSize);
+	OutIndex.WeakSums.SetNumUninitialized(NumBlocks);
+	OutIndex.StrongSums.SetNum(NumBlocks);
+	ParallelFor(NumBlocks, [&OutIndex, Data](int32 Block)
+	{
+		const uint8* BlockData = Data + OutIndex.GetBlockStart(Block);
+		const uint64 BlockBytes = OutIndex.GetBlockBytes(Block);
+		ChunkStreamDelta::FRollingChecksum Sum;
+		Sum.Init(BlockData, BlockBytes);
+		OutIndex.WeakSums[Block] = Sum.Get();
+		FSHA1::HashBuffer(BlockData, BlockBytes, OutIndex.StrongSums[Block].Hash);
+	});
+	FSHA1::HashBuffer(Data, Num, OutIndex.FileHash.Hash);
+}
+
+bool FChunkStreamBlockIndex::Build(const FString& FilePath, int32 InBlockSize, FChunkStreamBlockIndex& OutIndex)
+{
+	TArray64<uint8> Data;
+	if (!FFileHelper::LoadFileToArray(Data, *FilePath))
+	{
+		LOG_ERROR("Failed to read '%s' to build its block index", *FilePath);
+		return false;
+	}
+	Build(Data.GetData(), Data.Num(), InBlockSize, OutIndex);
+	return true;
+}
+
+bool FChunkStreamBlockIndex::Serialize(FArchive& Ar)
+{
+	uint32 Magic = BlockIndexMagic;
+	uint32 Version = BlockIndexVersion;
+	Ar << Magic;
+	Ar << Version;
+	if (Ar.IsLoading() && (Magic != BlockIndexMagic || Version != BlockIndexVersion))
+	{
+		Ar.SetError();
+		return false;
+	}
+	Ar << BlockSize;
+	Ar << FileSize;
+	Ar << FileHash;
+	Ar << WeakSums;
+	Ar << StrongSums;
+	if (Ar.IsError())
+	{
+		return false;
+	}
+	// a block per BlockSize bytes, with sums for each
+	return BlockSize > 0
+		&& WeakSums.Num() == StrongSums.Num()
+		&& static_cast<uint64>(WeakSums.Num()) == (FileSize + BlockSize - 1) / BlockSize;
+}
+
+bool FChunkStreamBlockIndex::SaveToFile(const FString& FilePath)
+{
+	TArray<uint8> Data;
+	FMemoryWriter Writer(Data);
+	return Serialize(Writer) && FFileHelper::SaveArrayToFile(Data, *FilePath);
+}
+
+bool FChunkStreamBlockIndex::LoadFromFile(const FString& FilePath)
+{
+	TArray<uint8> Data;
+	return FFileHelper::LoadFileToArray(Data, *FilePath) && LoadFromMemory(Data);
+}
+
+bool FChunkStreamBlockIndex::LoadFromMemory(const TArray<uint8>& Data)
+{
+	FMemoryReader Reader(Data);
+	return Serialize(Reader);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Matching
+// ---------------------------------------------------------------------------------------------------------------------
+
+namespace ChunkStreamDelta
+{
+	// Weak sum to blocks, with a bit per 16 bit hash so most windows are rejected without a map lookup
+	struct FBlockLookup
+	{
+		TMap<uint32, TArray<int32>> Blocks;
+		TBitArray<> Filter;
+
+		static uint32 Hash16(uint32 WeakSum) { return (WeakSum ^ (WeakSum >> 16)) & 0xffff; }
+
+		explicit FBlockLookup(const FChunkStreamBlockIndex& Index)
+		{
+			Filter.Init(false, 1 << 16);
+			for (int32 Block = 0; Block < Index.GetNumBlocks(); Block++)
+			{
+				// the rolling window is always a full block
+				if (Index.GetBlockBytes(Block) == static_cast<uint64>(Index.BlockSize))
+				{
+					Blocks.FindOrAdd(Index.WeakSums[Block]).Add(Block);
+					Filter[Hash16(Index.WeakSums[Block])] = true;
+				}
+			}
+		}
+	};
+
+	/**
+	 * Rolls over windows starting in [0, NumStarts) of Data, a buffer of Num bytes at BaseOffset in the old file.
+	 * A match skips the window past it like rsync, so overlapping copies aren't hashed.
+	 */
+	static void ScanSegment(const FChunkStreamBlockIndex& Index, const FBlockLookup& Lookup, const uint8* Data, int64 Num, int64 NumStarts,
+		int64 BaseOffset, TArray<TPair<int32, int64>>& OutMatches)
+	{
+		TRACE_CPUPROFILER_EVENT_SCOPE(ChunkStreamDelta::ScanSegment)
+		const int64 BlockSize = Index.BlockSize;
+		FRollingChecksum Sum;
+		bool bNeedsInit = true;
+		int64 Pos = 0;
+		while (Pos < NumStarts && Pos + BlockSize <= Num)
+		{
+			if (bNeedsInit)
+			{
+				Sum.Init(Data + Pos, BlockSize);
+				bNeedsInit = false;
+			}
+			const uint32 WeakSum = Sum.Get();
+			if (Lookup.Filter[FBlockLookup::Hash16(WeakSum)])
+			{
+				if (const TArray<int32>* Candidates = Lookup.Blocks.Find(WeakSum))
+				{
+					FSHAHash Strong;
+					FSHA1::HashBuffer(Data + Pos, BlockSize, Strong.Hash);
+					bool bMatched = false;
+					for (const int32 Block : *Candidates)
+					{
+						// identical blocks of the new file all come from here
+						if (Strong == Index.StrongSums[Block])
+						{
+							OutMatches.Emplace(Block, BaseOffset + Pos);
+							bMatched = true;
+						}
+					}
+					if (bMatched)
+					{
+						Pos += BlockSize;
+						bNeedsInit = true;
+						continue;
+					}
+				}
+			}
+			if (Pos + BlockSize < Num)
+			{
+				Sum.Roll(Data[Pos], Data[Pos + BlockSize], BlockSize);
+			}
+			Pos++;
+		}
+	}
+
+	// First match for each block wins, segments are merged in file order so the result doesn't depend on scheduling
+	static void MergeMatches(const TArray<TArray<TPair<int32, int64>>>& SegmentMatches, TArray<int64>& OutOldOffsets)
+	{
+		for (const TArray<TPair<int32, int64>>& Matches : SegmentMatches)
+		{
+			for (const TPair<int32, int64>& Match : Matches)
+			{
+				if (OutOldOffsets[Match.Key] < 0)
+				{
+					OutOldOffsets[Match.Key] = Match.Value;
+				}
+			}
+		}
+	}
+
+	void FindReusableBlocks(const FChunkStreamBlockIndex& Index, const uint8* OldData, uint64 OldSize, TArray<int64>& OutOldOffsets)
+	{
+		OutOldOffsets.Init(-1, Index.GetNumBlocks());
+		const FBlockLookup Lookup(Index);
+		const int32 NumSegments = static_cast<int32>((OldSize + ScanSegmentSize - 1) / ScanSegmentSize);
+		TArray<TArray<TPair<int32, int64>>> SegmentMatches;
+		SegmentMatches.SetNum(NumSegments);
+		ParallelFor(NumSegments, [&](int32 Segment)
+		{
+			const int64 Start = static_cast<int64>(Segment) * ScanSegmentSize;
+			// windows starting in this segment run up to a block into the next one
+			const int64 Num = FMath::Min<int64>(ScanSegmentSize + Index.BlockSize - 1, OldSize - Start);
+			ScanSegment(Index, Lookup, OldData + Start, Num, ScanSegmentSize, Start, SegmentMatches[Segment]);
+		});
+		MergeMatches(SegmentMatches, OutOldOffsets);
+	}
+
+	bool FindReusableBlocks(const FChunkStreamBlockIndex& Index, const FString& OldFilePath, TArray<int64>& OutOldOffsets)
+	{
+		TRACE_CPUPROFILER_EVENT_SCOPE(ChunkStreamDelta::FindReusableBlocks)
+		OutOldOffsets.Init(-1, Index.GetNumBlocks());
+		IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+		const int64 OldSize = PlatformFile.FileSize(*OldFilePath);
+		if (OldSize < 0)
+		{
+			LOG_WARN("No old file at '%s', everything will be downloaded", *OldFilePath);
+			return false;
+		}
+		const FBlockLookup Lookup(Index);
+		const int32 NumSegments = static_cast<int32>((OldSize + ScanSegmentSize - 1) / ScanSegmentSize);
+		TArray<TArray<TPair<int32, int64>>> SegmentMatches;
+		SegmentMatches.SetNum(NumSegments);
+		std::atomic<bool> bReadFailed{false};
+		ParallelFor(NumSegments, [&](int32 Segment)
+		{
+			// each task reads its own segment, so memory stays at a segment per worker
+			const int64 Start = static_cast<int64>(Segment) * ScanSegmentSize;
+			const int64 Num = FMath::Min<int64>(ScanSegmentSize + Index.BlockSize - 1, OldSize - Start);
+			TArray64<uint8> Buffer;
+			Buffer.SetNumUninitialized(Num);
+			TUniquePtr<IFileHandle> Handle(PlatformFile.OpenRead(*OldFilePath));
+			if (!Handle || !Handle->Seek(Start) || !Handle->Read(Buffer.GetData(), Num))
+			{
+				bReadFailed = true;
+				return;
+			}
+			ScanSegment(Index, Lookup, Buffer.GetData(), Num, ScanSegmentSize, Start, SegmentMatches[Segment]);
+		});
+		if (bReadFailed)
+		{
+			LOG_WARN("Failed to read the old file '%s', blocks in the parts that couldn't be read will be downloaded", *OldFilePath);
+		}
+		MergeMatches(SegmentMatches, OutOldOffsets);
+		return !bReadFailed;
+	}
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Delta download
+// ---------------------------------------------------------------------------------------------------------------------
+
+FChunkStreamDeltaDownload::FChunkStreamDeltaDownload(const FString& InURL, const FChunkStreamBlockIndex& InIndex)
+	: URL(InURL), Index(InIndex)
+{
+}
+
+FChunkStreamDeltaDownload::~FChunkStreamDeltaDownload()
+{
+	if (Downloader)
+	{
+		Downloader->Shutdown();
+	}
+	delete TempFile;
+}
+
+void FChunkStreamDeltaDownload::Start(const FString& OldFilePath, const FString& InSavePath, const FOnDownloadCompleteSignature& OnComplete)
+{
+	check(IsInGameThread());
+	if (bRunning)
+	{
+		LOG_WARN("Delta download of '%s' is already running", *URL);
+		OnComplete.ExecuteIfBound(EChunkStreamDownloadResult::ValidationFailed);
+		return;
+	}
+	bRunning = true;
+	bCanceled = false;
+	OldPath = OldFilePath;
+	SavePath = InSavePath;
+	TempPath = SavePath + TEXT(".csdelta");
+	CompleteDelegate = OnComplete;
+	ReusedBytes = 0;
+	FetchedBytes = 0;
+	{
+		FScopeLock Lock(&QueueLock);
+		PendingChunks.Reset();
+		bDraining = false;
+		bDownloadDone = false;
+		DownloadResult = EChunkStreamDownloadResult::InProgress;
+	}
+	
+	Async(EAsyncExecution::ThreadPool, [This = AsShared()]() { This->ReuseOldBlocks(); });
+}
+
+void FChunkStreamDeltaDownload::ReuseOldBlocks()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FChunkStreamDeltaDownload::ReuseOldBlocks)
+	TArray<int64> OldOffsets;
+	ChunkStreamDelta::FindReusableBlocks(Index, OldPath, OldOffsets);
+	
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*FPaths::GetPath(TempPath));
+	TempFile = PlatformFile.OpenWrite(*TempPath);
+	TUniquePtr<IFileHandle> OldFile(PlatformFile.OpenRead(*OldPath));
+	bool bFailed = TempFile == nullptr;
+	if (bFailed)
+	{
+		LOG_ERROR("Failed to open '%s' to assemble the update", *TempPath);
+	}
+	
+	// copy runs of blocks that are contiguous in both files with one read, and gather what has to be downloaded
+	TArray<StreamChunkDownloader::FByteRange> Missing;
+	TArray64<uint8> Buffer;
+	int32 Block = 0;
+	while (!bFailed && !bCanceled && Block < Index.GetNumBlocks())
+	{
+		const uint64 NewStart = Index.GetBlockStart(Block);
+		const int64 OldStart = OldOffsets[Block];
+		int32 RunEnd = Block + 1;
+		if (OldStart < 0 || !OldFile)
+		{
+			while (RunEnd < Index.GetNumBlocks() && (OldOffsets[RunEnd] < 0 || !OldFile))
+			{
+				RunEnd++;
+			}
+			const uint64 NewEnd = Index.GetBlockStart(RunEnd - 1) + Index.GetBlockBytes(RunEnd - 1) - 1;
+			Missing.Emplace(NewStart, NewEnd);
+			Block = RunEnd;
+			continue;
+		}
+		while (RunEnd < Index.GetNumBlocks() && OldOffsets[RunEnd] == OldStart + static_cast<int64>(Index.GetBlockStart(RunEnd) - NewStart)
+			&& Index.GetBlockStart(RunEnd) - NewStart < static_cast<uint64>(FileIOBufferSize))
+		{
+			RunEnd++;
+		}
+		const int64 RunBytes = Index.GetBlockStart(RunEnd - 1) + Index.GetBlockBytes(RunEnd - 1) - NewStart;
+		Buffer.SetNumUninitialized(RunBytes, EAllowShrinking::No);
+		if (!OldFile->Seek(OldStart) || !OldFile->Read(Buffer.GetData(), RunBytes)
+			|| !TempFile->Seek(NewStart) || !TempFile->Write(Buffer.GetData(), RunBytes))
+		{
+			LOG_ERROR("Failed to copy blocks from '%s' into '%s'", *OldPath, *TempPath);
+			bFailed = true;
+			break;
+		}
+		ReusedBytes += RunBytes;
+		Block = RunEnd;
+	}
+	OldFile.Reset();
+	
+	uint64 MissingBytes = 0;
+	for (const StreamChunkDownloader::FByteRange& Range : Missing)
+	{
+		MissingBytes += Range.Num();
+	}
+	LOG("Updating '%s': reusing %llu bytes of the old file, downloading %llu in %d ranges", *SavePath, ReusedBytes.load(), MissingBytes, Missing.Num());
+	
+	TWeakPtr<FChunkStreamDeltaDownload> WeakThis = AsShared();
+	AsyncTask(ENamedThreads::GameThread, [WeakThis, bFailed, Missing = MoveTemp(Missing)]() mutable
+	{
+		TSharedPtr<FChunkStreamDeltaDownload> Delta = WeakThis.Pin();
+		if (!Delta)
+		{
+			return;
+		}
+		if (bFailed || Delta->bCanceled)
+		{
+			Delta->EndDeltaDownload(bFailed ? EChunkStreamDownloadResult::FileSystemError : EChunkStreamDownloadResult::UserCancelled);
+		}
+		else
+		{
+			Delta->StartMissingDownload(MoveTemp(Missing));
+		}
+	});
+}
+
+void FChunkStreamDeltaDownload::StartMissingDownload(TArray<StreamChunkDownloader::FByteRange>&& Ranges)
+{
+	if (Ranges.Num() == 0)
+	{
+		// the old file had every block
+		EndDeltaDownload(EChunkStreamDownloadResult::Success);
+		return;
+	}
+	Downloader = MakeShared<FStreamChunkDownloader>(URL, FString());
+	// the index gives the size, so no HEAD request is needed
+	Downloader->SetKnownFileInfo(Index.FileSize, true);
+	Downloader->SetRequestedRanges(Ranges);
+	Downloader->BeginDownload(FChunkStreamDownloaderUtils::GetMaxChunkSize(),
+		FStreamDownloadProgressSignature(),
+		FOnSingleChunkCompleteSignature::CreateSP(this, &FChunkStreamDeltaDownload::OnDeltaChunk),
+		FOnDownloadCompleteSignature::CreateSP(this, &FChunkStreamDeltaDownload::EndDeltaDownload));
+}
+
+void FChunkStreamDeltaDownload::OnDeltaChunk(TUniquePtr<StreamChunkDownloader::FChunkInfo>&& Chunk)
+{
+	FScopeLock Lock(&QueueLock);
+	if (bDownloadDone)
+	{
+		return;
+	}
+	PendingChunks.Add(MoveTemp(Chunk));
+	if (!bDraining)
+	{
+		bDraining = true;
+		Async(EAsyncExecution::ThreadPool, [This = AsShared()]() { This->DrainDeltaChunks(); });
+	}
+}
+
+void FChunkStreamDeltaDownload::EndDeltaDownload(EChunkStreamDownloadResult Result)
+{
+	FScopeLock Lock(&QueueLock);
+	if (bDownloadDone)
+	{
+		return;
+	}
+	bDownloadDone = true;
+	DownloadResult = Result;
+	if (!bDraining)
+	{
+		bDraining = true;
+		Async(EAsyncExecution::ThreadPool, [This = AsShared()]() { This->DrainDeltaChunks(); });
+	}
+}
+
+void FChunkStreamDeltaDownload::DrainDeltaChunks()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FChunkStreamDeltaDownload::DrainDeltaChunks)
+	bool bFailed = false;
+	for (;;)
+	{
+		TUniquePtr<StreamChunkDownloader::FChunkInfo> Chunk;
+		{
+			FScopeLock Lock(&QueueLock);
+			if (PendingChunks.Num() == 0)
+			{
+				if (!bDownloadDone)
+				{
+					bDraining = false;
+					return;
+				}
+				break;
+			}
+			Chunk = MoveTemp(PendingChunks[0]);
+			PendingChunks.RemoveAt(0);
+		}
+		
+		const int64 Num = Chunk->EndOffset - Chunk->StartOffset + 1;
+		if (!bFailed && (!TempFile->Seek(Chunk->StartOffset) || !TempFile->Write(Chunk->Data.GetData(), Num)))
+		{
+			LOG_ERROR("Failed to write downloaded blocks to '%s'", *TempPath);
+			bFailed = true;
+			TWeakPtr<FChunkStreamDeltaDownload> WeakThis = AsShared();
+			AsyncTask(ENamedThreads::GameThread, [WeakThis]()
+			{
+				TSharedPtr<FChunkStreamDeltaDownload> Delta = WeakThis.Pin();
+				if (Delta && Delta->Downloader)
+				{
+					Delta->Downloader->Shutdown();
+				}
+			});
+			FScopeLock Lock(&QueueLock);
+			if (!bDownloadDone)
+			{
+				bDownloadDone = true;
+				DownloadResult = EChunkStreamDownloadResult::FileSystemError;
+			}
+		}
+		FetchedBytes += Num;
+	}
+	
+	EChunkStreamDownloadResult Result = DownloadResult;
+	if (Result == EChunkStreamDownloadResult::Success && bCanceled)
+	{
+		Result = EChunkStreamDownloadResult::UserCancelled;
+	}
+	delete TempFile;
+	TempFile = nullptr;
+	if (Result == EChunkStreamDownloadResult::Success)
+	{
+		Result = FinalizeFile();
+	}
+	if (Result != EChunkStreamDownloadResult::Success)
+	{
+		FPlatformFileManager::Get().GetPlatformFile().DeleteFile(*TempPath);
+	}
+	
+	TWeakPtr<FChunkStreamDeltaDownload> WeakThis = AsShared();
+	AsyncTask(ENamedThreads::GameThread, [WeakThis, Result]()
+	{
+		if (TSharedPtr<FChunkStreamDeltaDownload> Delta = WeakThis.Pin())
+		{
+			Delta->Finish(Result);
+		}
+	});
+}
+
+EChunkStreamDownloadResult FChunkStreamDeltaDownload::FinalizeFile()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FChunkStreamDeltaDownload::FinalizeFile)
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	{
+		TUniquePtr<IFileHandle> Assembled(PlatformFile.OpenRead(*TempPath));
+		if (!Assembled || Assembled->Size() != static_cast<int64>(Index.FileSize))
+		{
+			LOG_ERROR("Assembled update '%s' is the wrong size", *TempPath);
+			return EChunkStreamDownloadResult::ValidationFailed;
+		}
+		FSHA1 Hash;
+		TArray64<uint8> Buffer;
+		Buffer.SetNumUninitialized(FileIOBufferSize);
+		for (int64 Offset = 0; Offset < static_cast<int64>(Index.FileSize); Offset += FileIOBufferSize)
+		{
+			const int64 Num = FMath::Min<int64>(FileIOBufferSize, Index.FileSize - Offset);
+			if (!Assembled->Read(Buffer.GetData(), Num))
+			{
+				return EChunkStreamDownloadResult::FileSystemError;
+			}
+			Hash.Update(Buffer.GetData(), Num);
+		}
+		Hash.Final();
+		FSHAHash Result;
+		Hash.GetHash(Result.Hash);
+		if (Result != Index.FileHash)
+		{
+			LOG_ERROR("Assembled update of '%s' doesn't match the index hash, the index may be for another version", *SavePath);
+			return EChunkStreamDownloadResult::ValidationFailed;
+		}
+	}
+	// SavePath may be the old file, it is only let go of once the new version is in its place
+	const FString AsidePath = SavePath + TEXT(".old");
+	const bool bHadFile = PlatformFile.FileExists(*SavePath);
+	if (bHadFile)
+	{
+		PlatformFile.DeleteFile(*AsidePath);
+		if (!PlatformFile.MoveFile(*AsidePath, *SavePath))
+		{
+			LOG_ERROR("Failed to replace '%s', it may be open", *SavePath);
+			return EChunkStreamDownloadResult::FileSystemError;
+		}
+	}
+	if (!PlatformFile.MoveFile(*SavePath, *TempPath))
+	{
+		LOG_ERROR("Failed to move '%s' to '%s'", *TempPath, *SavePath);
+		if (bHadFile && !PlatformFile.MoveFile(*SavePath, *AsidePath))
+		{
+			LOG_ERROR("Failed to put '%s' back, it is at '%s'", *SavePath, *AsidePath);
+		}
+		return EChunkStreamDownloadResult::FileSystemError;
+	}
+	if (bHadFile)
+	{
+		PlatformFile.DeleteFile(*AsidePath);
+	}
+	return EChunkStreamDownloadResult::Success;
+}
+
+void FChunkStreamDeltaDownload::Finish(EChunkStreamDownloadResult Result)
+{
+	Downloader.Reset();
+	{
+		FScopeLock Lock(&QueueLock);
+		PendingChunks.Reset();
+		bDraining = false;
+	}
+	bRunning = false;
+	LOG("Update of '%s' finished, %llu bytes reused and %llu downloaded", *SavePath, ReusedBytes.load(), FetchedBytes.load());
+	CompleteDelegate.ExecuteIfBound(Result);
+}
+
+void FChunkStreamDeltaDownload::Cancel()
+{
+	check(IsInGameThread());
+	if (!bRunning)
+	{
+		return;
+	}
+	bCanceled = true;
+	if (Downloader)
+	{
+		Downloader->Shutdown();
+		// the worker throws the temp file away and completes with UserCancelled
+		EndDeltaDownload(EChunkStreamDownloadResult::UserCancelled);
+	}
+}
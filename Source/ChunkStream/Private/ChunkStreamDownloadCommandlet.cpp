@@ -0,0 +1,316 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#include "ChunkStreamDownloadCommandlet.h"
+#include "ChunkStreamDownloader.h"
+#include "ChunkStreamLogs.h"
+#include "Algo/Count.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "Containers/Ticker.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/ThreadManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+#include "UObject/StrongObjectPtr.h"
+
+namespace
+{
+	constexpr double BytesPerMB = 1024.0 * 1024.0;
+	// Time the loop sleeps between pumping the ticker, short enough to keep the HTTP thread's responses flowing
+	constexpr float PumpSleepSeconds = 0.002f;
+	// Time left for canceled downloads to wind down before the commandlet returns
+	constexpr double CancelGraceSeconds = 5.0;
+
+	struct FManifestDownload
+	{
+		TStrongObjectPtr<UChunkStreamDownloader> Downloader;
+		FChunkStreamManifestEntry Entry;
+		// The downloader destroys itself once it completes, so its stats are kept here
+		FChunkStreamDownloadStats FinalStats;
+		EChunkStreamDownloadResult Result = EChunkStreamDownloadResult::InProgress;
+		bool bDone = false;
+	};
+
+	// Runs what the engine loop would, there is no world to tick
+	void PumpGameThread(double& LastPumpTime)
+	{
+		const double Now = FPlatformTime::Seconds();
+		FTaskGraphInterface::Get().ProcessThreadUntilIdle(ENamedThreads::GameThread);
+		FTSTicker::GetCoreTicker().Tick(static_cast<float>(Now - LastPumpTime));
+		FThreadManager::Get().Tick();
+		LastPumpTime = Now;
+		FPlatformProcess::Sleep(PumpSleepSeconds);
+	}
+}
+
+UChunkStreamDownloadCommandlet::UChunkStreamDownloadCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+	ShowErrorCount = true;
+	HelpDescription = TEXT("Downloads the files of a manifest with ChunkStream, without a game world");
+	HelpUsage = TEXT("-run=ChunkStreamDownload -Manifest=<File> [-Output=<Dir>] [-Concurrency=16] [-Timeout=<Seconds>] [-StatsInterval=5] [-SkipExisting]");
+	HelpParamNames = { TEXT("Manifest"), TEXT("Output"), TEXT("Concurrency"), TEXT("Timeout"), TEXT("StatsInterval"), TEXT("SkipExisting") };
+	HelpParamDescriptions = {
+		TEXT("Text file with a line per file: its URLs, primary first, and optionally the path to save it to"),
+		TEXT("Directory relative save paths are under, Saved/ChunkStreamDownload by default"),
+		TEXT("Downloads running at once, sets ChunkStream.MaxConcurrentDownloads and raises ChunkStream.MaxConnections to at least as many"),
+		TEXT("Seconds before unfinished downloads are canceled and fail the run, 0 waits forever"),
+		TEXT("Seconds between throughput logs"),
+		TEXT("Skips files already at their save path")
+	};
+}
+
+int32 UChunkStreamDownloadCommandlet::Main(const FString& Params)
+{
+	FString ManifestPath;
+	if (!FParse::Value(*Params, TEXT("Manifest="), ManifestPath))
+	{
+		LOG_ERROR("No -Manifest=<File> given. Usage: %s", *HelpUsage);
+		return 1;
+	}
+	FString OutputDirectory = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("ChunkStreamDownload"));
+	FParse::Value(*Params, TEXT("Output="), OutputDirectory);
+	OutputDirectory = FPaths::ConvertRelativePathToFull(OutputDirectory);
+	int32 Concurrency = 16;
+	FParse::Value(*Params, TEXT("Concurrency="), Concurrency);
+	Concurrency = FMath::Clamp(Concurrency, 1, 1000);
+	double TimeoutSeconds = 0.0;
+	FParse::Value(*Params, TEXT("Timeout="), TimeoutSeconds);
+	double StatsInterval = 5.0;
+	FParse::Value(*Params, TEXT("StatsInterval="), StatsInterval);
+	StatsInterval = FMath::Max(StatsInterval, 0.1);
+	const bool bSkipExisting = FParse::Param(*Params, TEXT("SkipExisting"));
+
+	FString ManifestText;
+	if (!FFileHelper::LoadFileToString(ManifestText, *ManifestPath))
+	{
+		LOG_ERROR("Couldn't read the manifest '%s'", *ManifestPath);
+		return 1;
+	}
+	TArray<FChunkStreamManifestEntry> Entries;
+	FString ManifestError;
+	if (!ParseManifest(ManifestText, OutputDirectory, Entries, ManifestError))
+	{
+		LOG_ERROR("Manifest '%s': %s", *ManifestPath, *ManifestError);
+		return 1;
+	}
+
+	IConsoleVariable* MaxDownloads = IConsoleManager::Get().FindConsoleVariable(TEXT("ChunkStream.MaxConcurrentDownloads"));
+	const int32 OldMaxDownloads = MaxDownloads->GetInt();
+	MaxDownloads->Set(Concurrency);
+	// each running download holds a pool connection, fewer connections than downloads would cap them instead. 0 has no cap to raise
+	IConsoleVariable* MaxConnections = IConsoleManager::Get().FindConsoleVariable(TEXT("ChunkStream.MaxConnections"));
+	const int32 OldMaxConnections = MaxConnections->GetInt();
+	if (OldMaxConnections > 0)
+	{
+		MaxConnections->Set(FMath::Max(OldMaxConnections, Concurrency));
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	TArray<TSharedRef<FManifestDownload>> Downloads;
+	int32 NumSkipped = 0;
+	for (FChunkStreamManifestEntry& Entry : Entries)
+	{
+		if (bSkipExisting && IFileManager::Get().FileExists(*Entry.SavePath))
+		{
+			NumSkipped++;
+			continue;
+		}
+		TSharedRef<FManifestDownload> Download = MakeShared<FManifestDownload>();
+		Download->Entry = MoveTemp(Entry);
+		Download->Downloader.Reset(UChunkStreamDownloader::DownloadFileToStorageFromMirrors(nullptr, Download->Entry.URLs, Download->Entry.SavePath));
+		TWeakPtr<FManifestDownload> WeakDownload = Download;
+		Download->Downloader->Native_DownloadFinished.AddLambda([WeakDownload](FChunkStreamResultParams ResultParams)
+		{
+			TSharedPtr<FManifestDownload> PinnedDownload = WeakDownload.Pin();
+			if (!PinnedDownload || PinnedDownload->bDone)
+			{
+				return;
+			}
+			PinnedDownload->FinalStats = ResultParams.Downloader->GetStats();
+			PinnedDownload->Result = ResultParams.DownloadTaskResult;
+			PinnedDownload->bDone = true;
+			if (ResultParams.DownloadTaskResult == EChunkStreamDownloadResult::Success)
+			{
+				LOG("Downloaded '%s' to '%s', %.2f MB at %.2f MB/s", *PinnedDownload->Entry.URLs[0], *PinnedDownload->Entry.SavePath,
+					static_cast<double>(PinnedDownload->FinalStats.BytesWritten) / BytesPerMB, PinnedDownload->FinalStats.AverageBytesPerSecond / BytesPerMB);
+			}
+			else
+			{
+				LOG_ERROR("Failed to download '%s' (manifest line %d): %s", *PinnedDownload->Entry.URLs[0], PinnedDownload->Entry.Line,
+					*PinnedDownload->FinalStats.ToString());
+			}
+		});
+		Downloads.Add(Download);
+	}
+	LOG("Downloading %d files of '%s' to '%s', %d at once%s", Downloads.Num(), *ManifestPath, *OutputDirectory, Concurrency,
+		NumSkipped > 0 ? *FString::Printf(TEXT(", %d already there"), NumSkipped) : TEXT(""));
+	for (const TSharedRef<FManifestDownload>& Download : Downloads)
+	{
+		// downloads past ChunkStream.MaxConcurrentDownloads wait for a slot
+		Download->Downloader->Activate();
+	}
+
+	auto CountDone = [&Downloads]()
+	{
+		return static_cast<int32>(Algo::CountIf(Downloads, [](const TSharedRef<FManifestDownload>& Download) { return Download->bDone; }));
+	};
+	double LastPumpTime = FPlatformTime::Seconds();
+	double NextStatsTime = StartTime + StatsInterval;
+	bool bTimedOut = false;
+	bool bInterrupted = false;
+	while (CountDone() < Downloads.Num())
+	{
+		PumpGameThread(LastPumpTime);
+		if (LastPumpTime >= NextStatsTime)
+		{
+			NextStatsTime = LastPumpTime + StatsInterval;
+			LOG("%d of %d files done | %s", CountDone(), Downloads.Num(), *UChunkStreamDownloader::GetAggregateDownloadStats().ToString());
+		}
+		bTimedOut = TimeoutSeconds > 0.0 && LastPumpTime - StartTime > TimeoutSeconds;
+		bInterrupted = IsEngineExitRequested();
+		if (bTimedOut || bInterrupted)
+		{
+			break;
+		}
+	}
+
+	if (bTimedOut || bInterrupted)
+	{
+		LOG_ERROR("%s, canceling the %d unfinished downloads", bTimedOut ? *FString::Printf(TEXT("Timed out after %.0fs"), TimeoutSeconds) : TEXT("Exit requested"),
+			Downloads.Num() - CountDone());
+		for (const TSharedRef<FManifestDownload>& Download : Downloads)
+		{
+			if (!Download->bDone && Download->Downloader.IsValid())
+			{
+				Download->Downloader->CancelDownload();
+			}
+		}
+		// lets the cancellations reach the write tasks and temp files, so a later run can resume them
+		const double CancelTime = FPlatformTime::Seconds();
+		while (CountDone() < Downloads.Num() && FPlatformTime::Seconds() - CancelTime < CancelGraceSeconds)
+		{
+			PumpGameThread(LastPumpTime);
+		}
+	}
+
+	const double Seconds = FPlatformTime::Seconds() - StartTime;
+	TArray<FChunkStreamDownloadStats> FinalStats;
+	int32 NumFailed = 0;
+	for (const TSharedRef<FManifestDownload>& Download : Downloads)
+	{
+		if (Download->bDone)
+		{
+			FinalStats.Add(Download->FinalStats);
+		}
+		if (!Download->bDone || Download->Result != EChunkStreamDownloadResult::Success)
+		{
+			NumFailed++;
+		}
+	}
+	const FChunkStreamDownloadStats Total = FChunkStreamDownloadStats::Aggregate(FinalStats);
+	LOG("Finished in %.1fs: %d downloaded, %d failed, %d skipped | %.2f MB received, %.2f MB written, %.2f MB/s overall | %d retries, %d stalls",
+		Seconds, Downloads.Num() - NumFailed, NumFailed, NumSkipped, static_cast<double>(Total.BytesDownloaded) / BytesPerMB,
+		static_cast<double>(Total.BytesWritten) / BytesPerMB, Seconds > 0.0 ? static_cast<double>(Total.BytesDownloaded) / BytesPerMB / Seconds : 0.0,
+		Total.Retries, Total.Stalls);
+
+	MaxDownloads->Set(OldMaxDownloads);
+	MaxConnections->Set(OldMaxConnections);
+	return NumFailed > 0 ? 1 : 0;
+}
+
+bool UChunkStreamDownloadCommandlet::ParseManifest(const FString& ManifestText, const FString& OutputDirectory,
+	TArray<FChunkStreamManifestEntry>& OutEntries, FString& OutError)
+{
+	OutEntries.Reset();
+	TArray<FString> Lines;
+	ManifestText.ParseIntoArrayLines(Lines, false);
+	TSet<FString> SavePaths;
+	for (int32 LineIndex = 0; LineIndex < Lines.Num(); LineIndex++)
+	{
+		const FString Line = Lines[LineIndex].TrimStartAndEnd();
+		if (Line.IsEmpty() || Line.StartsWith(TEXT("#")))
+		{
+			continue;
+		}
+		FChunkStreamManifestEntry Entry;
+		Entry.Line = LineIndex + 1;
+		TArray<FString> Tokens;
+		Line.ParseIntoArrayWS(Tokens);
+		for (const FString& Token : Tokens)
+		{
+			if (Token.Contains(TEXT("://")))
+			{
+				Entry.URLs.Add(Token);
+			}
+			else if (Entry.SavePath.IsEmpty())
+			{
+				Entry.SavePath = FPaths::IsRelative(Token) ? FPaths::Combine(OutputDirectory, Token) : Token;
+			}
+			else
+			{
+				OutError = FString::Printf(TEXT("line %d has more than one save path"), Entry.Line);
+				return false;
+			}
+		}
+		if (Entry.URLs.Num() < 1)
+		{
+			OutError = FString::Printf(TEXT("line %d has no URL"), Entry.Line);
+			return false;
+		}
+		if (Entry.SavePath.IsEmpty())
+		{
+			Entry.SavePath = GetMirrorPathForURL(Entry.URLs[0], OutputDirectory);
+			if (Entry.SavePath.IsEmpty())
+			{
+				OutError = FString::Printf(TEXT("line %d, '%s' doesn't name a file, give it a save path"), Entry.Line, *Entry.URLs[0]);
+				return false;
+			}
+		}
+		FPaths::NormalizeFilename(Entry.SavePath);
+		FPaths::CollapseRelativeDirectories(Entry.SavePath);
+		bool bAlreadyInSet = false;
+		SavePaths.Add(Entry.SavePath, &bAlreadyInSet);
+		if (bAlreadyInSet)
+		{
+			// two downloads would write the same temp file
+			OutError = FString::Printf(TEXT("line %d saves to '%s' like an earlier line"), Entry.Line, *Entry.SavePath);
+			return false;
+		}
+		OutEntries.Add(MoveTemp(Entry));
+	}
+	if (OutEntries.Num() < 1)
+	{
+		OutError = TEXT("no files to download");
+		return false;
+	}
+	return true;
+}
+
+FString UChunkStreamDownloadCommandlet::GetMirrorPathForURL(const FString& URL, const FString& OutputDirectory)
+{
+	FString Location = URL;
+	int32 SchemeEnd = Location.Find(TEXT("://"));
+	if (SchemeEnd != INDEX_NONE)
+	{
+		Location.RightChopInline(SchemeEnd + 3);
+	}
+	int32 QueryStart = INDEX_NONE;
+	if (Location.FindChar(TEXT('?'), QueryStart) || Location.FindChar(TEXT('#'), QueryStart))
+	{
+		Location.LeftInline(QueryStart);
+	}
+	// a port isn't a valid path character everywhere
+	Location.ReplaceCharInline(TEXT(':'), TEXT('_'));
+	TArray<FString> Parts;
+	Location.ParseIntoArray(Parts, TEXT("/"));
+	if (Parts.Num() < 2 || Location.EndsWith(TEXT("/")) || Parts.Contains(TEXT("..")) || Parts.Contains(TEXT(".")))
+	{
+		return FString();
+	}
+	return FPaths::Combine(OutputDirectory, FString::Join(Parts, TEXT("/")));
+}
@@ -0,0 +1,282 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+
+#include "ChunkStreamDownloadReader.h"
+#include "ChunkStreamLogs.h"
+#include "HAL/PlatformFileManager.h"
+
+// How often a waiting read checks the chunk in flight for its bytes
+static constexpr double ReceivedPollSeconds = 0.05;
+
+FChunkStreamDownloadReadState::~FChunkStreamDownloadReadState()
+{
+	delete ReadHandle;
+	for (FWaiter& Waiter : Waiters)
+	{
+		Waiter.Promise.SetValue(false);
+	}
+}
+
+void FChunkStreamDownloadReadState::SetFilePath(const FString& InFilePath)
+{
+	FScopeLock Lock(&FileLock);
+	delete ReadHandle;
+	ReadHandle = nullptr;
+	FilePath = InFilePath;
+}
+
+void FChunkStreamDownloadReadState::OnRangeWritten(uint64 Start, uint64 End, uint64 InTotalFileSize)
+{
+	if (InTotalFileSize > 0)
+	{
+		TotalFileSize = InTotalFileSize;
+	}
+	TArray<FWaiter> Ready;
+	{
+		FScopeLock Lock(&RangeLock);
+		StreamChunkDownloader::FByteRange::AddMerged(WrittenRanges, StreamChunkDownloader::FByteRange(Start, End));
+		for (int32 i = Waiters.Num() - 1; i >= 0; i--)
+		{
+			if (IsWritten(Waiters[i].Start, Waiters[i].End))
+			{
+				Ready.Add(MoveTemp(Waiters[i]));
+				Waiters.RemoveAtSwap(i);
+			}
+		}
+	}
+	// outside the lock, continuations can read straight away
+	for (FWaiter& Waiter : Ready)
+	{
+		Waiter.Promise.SetValue(true);
+	}
+}
+
+void FChunkStreamDownloadReadState::ReleaseFile(TFunctionRef<void()> WhileReleased)
+{
+	FScopeLock Lock(&FileLock);
+	delete ReadHandle;
+	ReadHandle = nullptr;
+	WhileReleased();
+}
+
+void FChunkStreamDownloadReadState::Finish(bool bSuccess, const FString& FinalPath)
+{
+	if (bFinished.exchange(true))
+	{
+		return;
+	}
+	{
+		FScopeLock Lock(&FileLock);
+		delete ReadHandle;
+		ReadHandle = nullptr;
+		FilePath = bSuccess ? FinalPath : FString();
+	}
+	
+	TArray<TPair<TPromise<bool>, bool>> Pending;
+	{
+		FScopeLock Lock(&RangeLock);
+		for (FWaiter& Waiter : Waiters)
+		{
+			// a complete download still can't satisfy a wait past its end
+			Pending.Emplace(MoveTemp(Waiter.Promise), bSuccess && IsWritten(Waiter.Start, Waiter.End));
+		}
+		Waiters.Empty();
+	}
+	for (TPair<TPromise<bool>, bool>& Waiter : Pending)
+	{
+		Waiter.Key.SetValue(Waiter.Value);
+	}
+}
+
+uint64 FChunkStreamDownloadReadState::GetWrittenBytesAt(uint64 Offset)
+{
+	FScopeLock Lock(&RangeLock);
+	const int32 Index = StreamChunkDownloader::FByteRange::FindContaining(WrittenRanges, Offset);
+	return Index == INDEX_NONE ? 0 : WrittenRanges[Index].End - Offset + 1;
+}
+
+bool FChunkStreamDownloadReadState::IsWritten(uint64 Start, uint64 End) const
+{
+	const int32 Index = StreamChunkDownloader::FByteRange::FindContaining(WrittenRanges, Start);
+	return Index != INDEX_NONE && WrittenRanges[Index].End >= End;
+}
+
+TFuture<bool> FChunkStreamDownloadReadState::WhenWritten(uint64 Offset, uint64 Bytes)
+{
+	FScopeLock Lock(&RangeLock);
+	if (Bytes == 0 || IsWritten(Offset, Offset + Bytes - 1))
+	{
+		return MakeFulfilledPromise<bool>(true).GetFuture();
+	}
+	if (bFinished)
+	{
+		return MakeFulfilledPromise<bool>(false).GetFuture();
+	}
+	FWaiter& Waiter = Waiters.AddDefaulted_GetRef();
+	Waiter.Start = Offset;
+	Waiter.End = Offset + Bytes - 1;
+	return Waiter.Promise.GetFuture();
+}
+
+bool FChunkStreamDownloadReadState::ReadFromFile(uint8* Destination, uint64 Offset, uint64 Bytes)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FChunkStreamDownloadReadState::ReadFromFile)
+	FScopeLock Lock(&FileLock);
+	if (!ReadHandle)
+	{
+		if (FilePath.IsEmpty())
+		{
+			return false;
+		}
+		// the downloader still has it open for writing
+		ReadHandle = FPlatformFileManager::Get().GetPlatformFile().OpenRead(*FilePath, true);
+		if (!ReadHandle)
+		{
+			LOG_WARN("Failed to open '%s' for reading while it downloads", *FilePath);
+			return false;
+		}
+	}
+	return ReadHandle->Seek(static_cast<int64>(Offset)) && ReadHandle->Read(Destination, static_cast<int64>(Bytes));
+}
+
+uint64 FChunkStreamDownloadReadState::CopyReceivedBytes(uint8* Destination, uint64 Offset, uint64 MaxBytes)
+{
+	if (TSharedPtr<FStreamChunkDownloader> PinnedDownloader = Downloader.Pin())
+	{
+		return PinnedDownloader->CopyReceivedBytes(Destination, Offset, MaxBytes);
+	}
+	return 0;
+}
+
+void FChunkStreamDownloadReadState::Prioritize(uint64 Offset)
+{
+	if (TSharedPtr<FStreamChunkDownloader> PinnedDownloader = Downloader.Pin())
+	{
+		PinnedDownloader->PrioritizeOffset(Offset);
+	}
+}
+
+uint64 FChunkStreamDownloadReadState::GetFileSize() const
+{
+	if (TotalFileSize > 0)
+	{
+		return TotalFileSize;
+	}
+	const TSharedPtr<FStreamChunkDownloader> PinnedDownloader = Downloader.Pin();
+	return PinnedDownloader ? PinnedDownloader->GetTotalFileSize() : 0;
+}
+
+bool FChunkStreamDownloadReader::IsAvailable(int64 Offset, int64 Bytes) const
+{
+	if (Offset < 0 || Bytes < 0)
+	{
+		return false;
+	}
+	return Bytes == 0 || State->GetWrittenBytesAt(Offset) >= static_cast<uint64>(Bytes);
+}
+
+TFuture<bool> FChunkStreamDownloadReader::WhenAvailable(int64 Offset, int64 Bytes)
+{
+	if (Offset < 0 || Bytes < 0)
+	{
+		return MakeFulfilledPromise<bool>(false).GetFuture();
+	}
+	if (!IsAvailable(Offset, Bytes))
+	{
+		State->Prioritize(Offset + State->GetWrittenBytesAt(Offset));
+	}
+	return State->WhenWritten(Offset, Bytes);
+}
+
+bool FChunkStreamDownloadReader::ReadAt(uint8* Destination, int64 Bytes, int64 Offset, float TimeoutSeconds)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FChunkStreamDownloadReader::ReadAt)
+	const uint64 FileSize = State->GetFileSize();
+	if (Offset < 0 || Bytes < 0 || (FileSize > 0 && static_cast<uint64>(Offset + Bytes) > FileSize))
+	{
+		return false;
+	}
+	const double Deadline = TimeoutSeconds > 0.0f ? FPlatformTime::Seconds() + TimeoutSeconds : 0.0;
+	const uint64 End = Offset + Bytes;
+	uint64 Cursor = Offset;
+	
+	// the wait for the gap the read is stuck on
+	TFuture<bool> Written;
+	uint64 WaitingOffset = MAX_uint64;
+	
+	while (Cursor < End)
+	{
+		uint8* Out = Destination + (Cursor - Offset);
+		if (const uint64 OnDisk = FMath::Min(State->GetWrittenBytesAt(Cursor), End - Cursor))
+		{
+			if (!State->ReadFromFile(Out, Cursor, OnDisk))
+			{
+				return false;
+			}
+			Cursor += OnDisk;
+			continue;
+		}
+		if (const uint64 Received = State->CopyReceivedBytes(Out, Cursor, End - Cursor))
+		{
+			Cursor += Received;
+			continue;
+		}
+		if (State->IsFinished())
+		{
+			// ended without these bytes
+			return false;
+		}
+		if (IsInGameThread())
+		{
+			// chunks complete on the game thread, waiting here could hold up the very bytes being waited on
+			LOG_WARN("Bytes at %llu haven't downloaded yet, reads can't wait for them on the game thread", Cursor);
+			return false;
+		}
+		if (Deadline > 0.0 && FPlatformTime::Seconds() >= Deadline)
+		{
+			return false;
+		}
+		if (WaitingOffset != Cursor)
+		{
+			State->Prioritize(Cursor);
+			Written = State->WhenWritten(Cursor, 1);
+			WaitingOffset = Cursor;
+		}
+		// woken when the bytes are written, checks the chunk in flight in between
+		Written.WaitFor(FTimespan::FromSeconds(ReceivedPollSeconds));
+	}
+	return true;
+}
+
+bool FChunkStreamDownloadReader::Seek(int64 NewPosition)
+{
+	const int64 FileSize = Size();
+	if (NewPosition < 0 || (FileSize >= 0 && NewPosition > FileSize))
+	{
+		return false;
+	}
+	Position = NewPosition;
+	return true;
+}
+
+bool FChunkStreamDownloadReader::SeekFromEnd(int64 NewPositionRelativeToEnd)
+{
+	const int64 FileSize = Size();
+	return FileSize >= 0 && Seek(FileSize + NewPositionRelativeToEnd);
+}
+
+bool FChunkStreamDownloadReader::Read(uint8* Destination, int64 BytesToRead)
+{
+	if (!ReadAt(Destination, BytesToRead, Position))
+	{
+		return false;
+	}
+	Position += BytesToRead;
+	return true;
+}
+
+int64 FChunkStreamDownloadReader::Size()
+{
+	const uint64 FileSize = State->GetFileSize();
+	return FileSize > 0 ? static_cast<int64>(FileSize) : -1;
+}
@@ -5,6 +5,12 @@
 #include "StreamChunkDownloader.h"
 #include "ChunkStream.h"
 #include "ChunkStreamLogs.h"
+#include "ChunkStreamDecompressor.h"
+#include "ChunkStreamZip.h"
+#include "ChunkStreamBenchmark.h"
+#include "ChunkStreamTrace.h"
+#include "ChunkStreamUncachedWriter.h"
+#include "ChunkStreamIoUringWriter.h"
 #include "HAL/FileManager.h"
 #include "HAL/PlatformFile.h"
 #include "HAL/PlatformFileManager.h"
@@ -12,8 +18,13 @@
 //#include "GenericPlatform/GenericPlatformFile.h"
 #include "Misc/FileHelper.h"
 #include "Misc/Paths.h"
+#if PLATFORM_WINDOWS
+#include "Windows/WindowsHWrapper.h"
+#endif
 
 static constexpr uint64 MB = 1024 * 1024;
+// Most a buffered file writer holds before it is flushed while more chunks are queued
+static constexpr int32 MaxUnflushedWriteMB = 64;
 uint64 inline MbToBytes(const uint64& InVal) { return InVal * MB;}
 uint64 inline MbToBytes(const int64& InVal) { return static_cast<uint64>(InVal) * MB;}
 uint64 inline MbToBytes(const int32& InVal) { return static_cast<uint64>(FMath::Abs(InVal)) * MB;}
@@ -25,6 +36,33 @@ TAutoConsoleVariable<int32> CVarFileDownloadMaxChunkSize(TEXT("ChunkStream.MaxCh
 	TEXT(" 100 = 100MB\n")
 	);
 
+TAutoConsoleVariable<int32> CVarUncachedWriteMinSize(TEXT("ChunkStream.UncachedWriteMinSize"),
+	0,
+	TEXT("Downloads of at least this many MB are written around the OS page cache (O_DIRECT, or dropping pages after each write)")
+	TEXT(" so they don't evict the game's own assets. Linux and Android only.\n")
+	TEXT(" 0 = off (default)\n")
+	TEXT(" 4096 = downloads of 4GB and up\n")
+	);
+
+TAutoConsoleVariable<bool> CVarIoUringWrites(TEXT("ChunkStream.IoUringWrites"),
+	true,
+	TEXT("Write downloads through io_uring where the build has liburing and the kernel allows it, see ChunkStream.IoUringQueueDepth.")
+	TEXT(" Downloads written around the page cache don't use it.\n")
+	);
+
+TAutoConsoleVariable<float> CVarResumeSaveInterval(TEXT("ChunkStream.ResumeSaveInterval"),
+	1.f,
+	TEXT("Seconds between rewrites of a download's resume metadata as chunks are written, it is also saved on pause and when the file closes.")
+	TEXT(" A crash loses at most this long of written chunks from what can be resumed.\n")
+	TEXT(" 0 = after every chunk\n")
+	);
+
+TAutoConsoleVariable<bool> CVarMappedWrites(TEXT("ChunkStream.MappedWrites"),
+	false,
+	TEXT("Preallocate and map the temp file of downloads with a known size, and receive into it directly instead of into chunk buffers.")
+	TEXT(" Not on Windows, decoded downloads aren't mapped. Read when a download starts.\n")
+	);
+
 uint64 FChunkStreamDownloaderUtils::GetMaxChunkSize()
 {
 	int32 ValueInMB = CVarFileDownloadMaxChunkSize.GetValueOnAnyThread();
@@ -50,15 +88,113 @@ uint64 FChunkStreamDownloaderUtils::GetMaxChunkSize()
 	}
 }
 
+TUniquePtr<IChunkStreamFileWriter> FChunkStreamDownloaderUtils::CreateFileWriter(const FString& FilePath, uint64 TotalFileSize)
+{
+	TUniquePtr<IChunkStreamFileWriter> Writer;
+	const int32 UncachedMinSize = CVarUncachedWriteMinSize.GetValueOnAnyThread();
+	if (UncachedMinSize > 0 && TotalFileSize >= MbToBytes(UncachedMinSize))
+	{
+		Writer = FChunkStreamUncachedWriter::Open(FilePath);
+	}
+	if (!Writer && CVarIoUringWrites.GetValueOnAnyThread())
+	{
+		Writer = FChunkStreamIoUringWriter::Open(FilePath);
+	}
+	if (Writer)
+	{
+		LOG("Writing '%s' with the %s writer", *FilePath, Writer->GetName());
+	}
+	return Writer;
+}
+
+FChunkStreamDownloadStats FChunkStreamDownloadStats::Aggregate(const TArray<FChunkStreamDownloadStats>& Stats)
+{
+	FChunkStreamDownloadStats Total;
+	double RemainingBytes = 0.0;
+	bool bAllSizesKnown = true;
+	for (const FChunkStreamDownloadStats& Download : Stats)
+	{
+		Total.NumDownloads += Download.NumDownloads;
+		Total.CurrentBytesPerSecond += Download.CurrentBytesPerSecond;
+		Total.AverageBytesPerSecond += Download.AverageBytesPerSecond;
+		Total.TotalBytes += Download.TotalBytes;
+		Total.BytesDownloaded += Download.BytesDownloaded;
+		Total.BytesWritten += Download.BytesWritten;
+		Total.BufferedBytes += Download.BufferedBytes;
+		Total.Chunks += Download.Chunks;
+		Total.Retries += Download.Retries;
+		Total.Stalls += Download.Stalls;
+		// a sum of thresholds means nothing, the slowest link is what the others are compared with
+		Total.StallThresholdSeconds = FMath::Max(Total.StallThresholdSeconds, Download.StallThresholdSeconds);
+		Total.PacketGapMs = FMath::Max(Total.PacketGapMs, Download.PacketGapMs);
+		Total.SecondsWaitingForSlot += Download.SecondsWaitingForSlot;
+		Total.SecondsWaitingForWrite += Download.SecondsWaitingForWrite;
+		// downloads run side by side, the longest covers the others
+		Total.SecondsActive = FMath::Max(Total.SecondsActive, Download.SecondsActive);
+		
+		bAllSizesKnown &= Download.TotalBytes > 0;
+		RemainingBytes += static_cast<double>(Download.TotalBytes) * (1.0 - Download.Progress);
+	}
+	Total.Progress = Total.TotalBytes > 0 ? static_cast<float>(1.0 - RemainingBytes / static_cast<double>(Total.TotalBytes)) : 0.f;
+	Total.UpdateETA();
+	if (!bAllSizesKnown)
+	{
+		Total.ETASeconds = -1.0;
+	}
+	return Total;
+}
+
+void FChunkStreamDownloadStats::UpdateETA()
+{
+	const double RemainingBytes = static_cast<double>(TotalBytes) * (1.0 - Progress);
+	const double Rate = CurrentBytesPerSecond > 0.0 ? CurrentBytesPerSecond : AverageBytesPerSecond;
+	if (TotalBytes <= 0)
+	{
+		ETASeconds = -1.0;
+	}
+	else if (RemainingBytes <= 0.0)
+	{
+		ETASeconds = 0.0;
+	}
+	else
+	{
+		ETASeconds = Rate > 0.0 ? RemainingBytes / Rate : -1.0;
+	}
+}
+
+FString FChunkStreamDownloadStats::ToString() const
+{
+	const UEnum* ResultEnum = StaticEnum<EChunkStreamDownloadResult>();
+	const FString Name = URL.IsEmpty() ? FString::Printf(TEXT("%d downloads"), NumDownloads) : URL;
+	const FString State = URL.IsEmpty() || !ResultEnum ? FString() : ResultEnum->GetNameStringByValue(static_cast<int64>(DownloadTaskResult));
+	const FString ETA = ETASeconds < 0.0 ? FString(TEXT("unknown")) : FString::Printf(TEXT("%.0fs"), ETASeconds);
+	return FString::Printf(TEXT("%s %s %.1f%% | %.2f MB/s now, %.2f MB/s avg, ETA %s | downloaded %.2f MB, written %.2f MB, buffered %.2f MB")
+		TEXT(" | %d chunks, %d retries, %d stalls (threshold %.2fs, packet gap %.1fms) | waited %.1fs for a slot, %.2fs for writes"),
+		*Name, *State,
+		Progress * 100.f, CurrentBytesPerSecond / MB, AverageBytesPerSecond / MB, *ETA,
+		static_cast<double>(BytesDownloaded) / MB, static_cast<double>(BytesWritten) / MB, static_cast<double>(BufferedBytes) / MB,
+		Chunks, Retries, Stalls, StallThresholdSeconds, PacketGapMs, SecondsWaitingForSlot, SecondsWaitingForWrite);
+}
+
 void UChunkStreamDownloader::BeginDestroy()
 {
 	FChunkStreamModule& Module = FModuleManager::Get().GetModuleChecked<FChunkStreamModule>(TEXT("ChunkStream"));
 	Module.UnRegisterDownloader(this);
+	if (!TempDownloadDir.IsEmpty())
+	{
+		// an unfinished temp file stays for a later run to resume
+		Module.GetTempFiles().Release(TempDownloadDir);
+	}
 	
 	if (StreamChunkDownloader)
 	{
 		StreamChunkDownloader->Shutdown();
 	}
+	if (ReadState)
+	{
+		// wakes any readers still waiting, a completed download has already finished it
+		ReadState->Finish(false, FString());
+	}
 	Native_DownloadProgress.Clear();
 	Native_DownloadFinished.Clear();
 	OnProgress.Clear();
@@ -97,12 +233,38 @@ UChunkStreamDownloader* UChunkStreamDownloader::DownloadFileToStorage(const UObj
 		Downloader->RegisterWithGameInstance(WorldContext);
 	}
 	Downloader->StreamChunkDownloader = MakeShared<FStreamChunkDownloader>(URL, TEXT("application/json"));
+	Downloader->ReadState = MakeShared<FChunkStreamDownloadReadState>(Downloader->StreamChunkDownloader);
 	Downloader->FileSavePath=LocationToSaveTo;
 	Downloader->CurrentResultParams.Downloader = Downloader;
 	Downloader->URL=URL;
 	return Downloader;
 }
 
+UChunkStreamDownloader* UChunkStreamDownloader::DownloadFileToStorageFromMirrors(const UObject* WorldContext,
+	const TArray<FString>& URLs, const FString& LocationToSaveTo)
+{
+	if (URLs.Num() < 1)
+	{
+		// Activate fails it
+		LOG_ERROR("No URLs given to download '%s' from", *LocationToSaveTo);
+	}
+	UChunkStreamDownloader* Downloader = DownloadFileToStorage(WorldContext, URLs.Num() > 0 ? URLs[0] : FString(), LocationToSaveTo);
+	for (int32 i = 1; i < URLs.Num(); i++)
+	{
+		Downloader->StreamChunkDownloader->AddMirrorURL(URLs[i]);
+		Downloader->MirrorURLs.Add(URLs[i]);
+	}
+	return Downloader;
+}
+
+UChunkStreamDownloader* UChunkStreamDownloader::DownloadAndExtractZip(const UObject* WorldContext, const FString& URL,
+	const FString& ExtractToDirectory)
+{
+	UChunkStreamDownloader* Downloader = DownloadFileToStorage(WorldContext, URL, FString());
+	Downloader->ExtractDirectory = ExtractToDirectory;
+	return Downloader;
+}
+
 FString UChunkStreamDownloader::LoadFileToString(const FString FilePath)
 {
 	FString Result;
@@ -118,11 +280,32 @@ void UChunkStreamDownloader::Activate()
 {
 	Super::Activate();
 	
+	if (URL.IsEmpty())
+	{
+		if (!bCompleted)
+		{
+			LOG_ERROR("No URL to download '%s' from", *FileSavePath);
+			ReadState->Finish(false, FileSavePath);
+			Completed(EChunkStreamDownloadResult::ValidationFailed);
+		}
+		return;
+	}
+	
 	{
 		FChunkStreamModule& Module = FModuleManager::Get().GetModuleChecked<FChunkStreamModule>(TEXT("ChunkStream"));
 		Module.RegisterDownloader(this);
+		if (bPaused)
+		{
+			// paused before it started, Resume activates it
+			CurrentResultParams.DownloadTaskResult = EChunkStreamDownloadResult::Paused;
+			return;
+		}
 		if (!Module.CanStartMoreDownloads())
 		{
+			if (WaitingForSlotSinceTime == 0.0)
+			{
+				WaitingForSlotSinceTime = FPlatformTime::Seconds();
+			}
 			CurrentResultParams.Progress=0.0f;
 			CurrentResultParams.DownloadTaskResult = EChunkStreamDownloadResult::WaitingForOtherDownload;
 			LOG("Cant start download for '%s' Waiting for space to start", *URL);
@@ -130,9 +313,84 @@ void UChunkStreamDownloader::Activate()
 		}
 		
 	}
+	StartStatsClock();
+
+	if (StreamChunkDownloader->IsPaused())
+	{
+		// the temp file is still open with everything so far, carry on from there
+		StreamChunkDownloader->Resume();
+		LOG("Resumed Download of '%s'", *URL);
+		CurrentResultParams.DownloadTaskResult = EChunkStreamDownloadResult::InProgress;
+		Native_DownloadProgress.Broadcast(CurrentResultParams);
+		OnProgress.Broadcast(CurrentResultParams);
+		return;
+	}
+	if (bClaimingResumable)
+	{
+		// resumed while the claim was running, it starts the transfer when it's done
+		return;
+	}
 		
 	TempDownloadDir = GetTempPathForSavePath(FileSavePath);
+	if (!UsesSequentialProcessor())
+	{
+		ReadState->SetFilePath(TempDownloadDir);
+	}
+	
+	FChunkStreamTempFiles& TempFiles = FModuleManager::Get().GetModuleChecked<FChunkStreamModule>(TEXT("ChunkStream")).GetTempFiles();
+	TempFiles.Acquire(TempDownloadDir);
+	if (UsesSequentialProcessor())
+	{
+		// decoded downloads aren't written at file offsets, so they start over
+		StartTransfer(false);
+		return;
+	}
+	
+	// carry on from what an earlier run of the same URL left, which may have to be copied over from another volume
+	bClaimingResumable = true;
+	TWeakObjectPtr<UChunkStreamDownloader> WeakThis = this;
+	TempFiles.ClaimResumableAsync(URL, TempDownloadDir, [WeakThis](bool bClaimed, FChunkStreamResumeData&& Data)
+	{
+		UChunkStreamDownloader* Downloader = WeakThis.Get();
+		if (!IsValid(Downloader))
+		{
+			return;
+		}
+		Downloader->bClaimingResumable = false;
+		if (Downloader->bCanceled || Downloader->bCompleted || Downloader->bPaused)
+		{
+			// a paused download claims again when it is resumed, finding the file at its own temp path this time
+			return;
+		}
+		Downloader->ResumeData = MoveTemp(Data);
+		Downloader->StartTransfer(bClaimed);
+	});
+}
+
+void UChunkStreamDownloader::StartTransfer(bool bResuming)
+{
+	if (bResuming)
+	{
+		StreamChunkDownloader->SetResumeData(ResumeData.WrittenRanges, ResumeData.TotalFileSize, ResumeData.ETag, ResumeData.LastModified,
+			FOnResumeCheckedSignature::CreateUObject(this, &UChunkStreamDownloader::OnResumeChecked));
+	}
+	else
+	{
+		ResumeData = FChunkStreamResumeData();
+		bResumeDataDirty = false;
+		FChunkStreamResumeData::Delete(TempDownloadDir);
+	}
 	
+	// we decode ourselves, so ask for the stored bytes rather than a transfer encoding that would disable ranges
+	StreamChunkDownloader->SetRequestIdentityEncoding(UsesSequentialProcessor());
+	if (CVarMappedWrites.GetValueOnGameThread() && !UsesSequentialProcessor())
+	{
+		StreamChunkDownloader->SetMappedOutput(TempDownloadDir);
+	}
+	// hedges and range helpers come out of the connections every download shares
+	StreamChunkDownloader->SetConnectionPool(&FModuleManager::Get().GetModuleChecked<FChunkStreamModule>(TEXT("ChunkStream")).GetConnectionPool());
+	// a decoder needs the bytes in order, extra connections would only fetch what it can't use yet
+	StreamChunkDownloader->SetAllowRangeHelpers(!UsesSequentialProcessor());
 	StreamChunkDownloader->BeginDownload(FChunkStreamDownloaderUtils::GetMaxChunkSize(),
 		FStreamDownloadProgressSignature::CreateUObject(this,&UChunkStreamDownloader::OnDownloadProgress),
 		FOnSingleChunkCompleteSignature::CreateUObject(this,&UChunkStreamDownloader::OnChunkCompleted),
@@ -141,7 +399,15 @@ void UChunkStreamDownloader::Activate()
 	
 	LOG("Started Download of '%s'",*URL)
 	
-	if (!OpenFileForWriting(TempDownloadDir))
+	if (IsExtractingZip())
+	{
+		// entries are written by the extractor, there is no download file
+		CurrentResultParams.DownloadTaskResult = EChunkStreamDownloadResult::InProgress;
+		CurrentResultParams.Progress=0.0f;
+		Native_DownloadProgress.Broadcast(CurrentResultParams);
+		OnProgress.Broadcast(CurrentResultParams);
+	}
+	else if (!OpenFileForWriting(TempDownloadDir, bResuming))
 	{
 		CurrentResultParams.DownloadTaskResult = EChunkStreamDownloadResult::FileSystemError;
 		CurrentResultParams.Progress=0.0f;
@@ -162,19 +428,177 @@ void UChunkStreamDownloader::Activate()
 
 bool UChunkStreamDownloader::CancelDownload()
 {
+	const bool bStarted = StreamChunkDownloader->HasStarted();
 	bCanceled = StreamChunkDownloader->CancelDownload();
 	CurrentResultParams.DownloadTaskResult = EChunkStreamDownloadResult::UserCancelled;
+	if (!bStarted && !bCompleted)
+	{
+		// waiting for a slot or paused before it started, no completion is on its way so it finishes here
+		ReadState->Finish(false, FileSavePath);
+		Completed(EChunkStreamDownloadResult::UserCancelled);
+	}
 
 	return bCanceled;
 }
 
+bool UChunkStreamDownloader::Pause()
+{
+	if (bPaused || bCompleted || bCanceled || !StreamChunkDownloader.IsValid())
+	{
+		return false;
+	}
+	if (StreamChunkDownloader->HasStarted() && !StreamChunkDownloader->Pause())
+	{
+		return false;
+	}
+	bPaused = true;
+	StopStatsClock();
+	LOG("Paused Download of '%s'", *URL);
+	// chunks written since the last save would otherwise wait for the file to close
+	TWeakObjectPtr<UChunkStreamDownloader> WeakThis = this;
+	AsyncTask(ENamedThreads::Type::AnyBackgroundThreadNormalTask, [WeakThis]()
+		{
+			if (IsValid(WeakThis.Get()) && !WeakThis.IsStale())
+			{
+				FScopeLock WriteLock(&WeakThis->WriteFileLock);
+				WeakThis->FlushFileWriter();
+				WeakThis->FlushResumeData();
+			}
+		});
+	CurrentResultParams.DownloadTaskResult = EChunkStreamDownloadResult::Paused;
+	Native_DownloadProgress.Broadcast(CurrentResultParams);
+	OnProgress.Broadcast(CurrentResultParams);
+	
+	// no longer active, so its slot can go to a waiting download
+	FChunkStreamModule& Module = FModuleManager::Get().GetModuleChecked<FChunkStreamModule>(TEXT("ChunkStream"));
+	Module.StartWaitingDownloads();
+	return true;
+}
+
+bool UChunkStreamDownloader::Resume()
+{
+	if (!bPaused || bCompleted || bCanceled)
+	{
+		return false;
+	}
+	bPaused = false;
+	// takes a slot if one is free, otherwise waits for one
+	Activate();
+	return true;
+}
+
+void UChunkStreamDownloader::SetDecompression(EChunkStreamDecompression InDecompression)
+{
+	if (StreamChunkDownloader && StreamChunkDownloader->HasStarted())
+	{
+		LOG_WARN("Decompression must be set before the download starts '%s'", *URL);
+		return;
+	}
+	if (InDecompression == EChunkStreamDecompression::Zstd && !FChunkStreamDecompressor::IsZstdAvailable())
+	{
+		LOG_WARN("Plugin was built without zstd, '%s' will fail to decode", *URL);
+	}
+	Decompression = InDecompression;
+}
+
+TSharedPtr<FChunkStreamDownloadReader> UChunkStreamDownloader::OpenReader()
+{
+	if (UsesSequentialProcessor())
+	{
+		LOG_WARN("Can't read '%s' while it downloads, decompressed and extracted downloads aren't written at file offsets", *URL);
+		return nullptr;
+	}
+	return MakeShared<FChunkStreamDownloadReader>(ReadState.ToSharedRef());
+}
+
+FChunkStreamDownloadStats UChunkStreamDownloader::GetStats() const
+{
+	const double Now = FPlatformTime::Seconds();
+	FChunkStreamDownloadStats Stats;
+	Stats.URL = URL;
+	Stats.NumDownloads = 1;
+	Stats.DownloadTaskResult = CurrentResultParams.DownloadTaskResult;
+	Stats.Progress = CurrentResultParams.Progress;
+	Stats.BytesWritten = StatsBytesWritten.load(std::memory_order_relaxed);
+	Stats.BufferedBytes = StatsBufferedBytes.load(std::memory_order_relaxed);
+	Stats.Chunks = StatsChunks.load(std::memory_order_relaxed);
+	Stats.SecondsWaitingForWrite = FPlatformTime::ToSeconds64(StatsWriteWaitCycles.load(std::memory_order_relaxed));
+	Stats.SecondsWaitingForSlot = WaitingForSlotSeconds + (WaitingForSlotSinceTime > 0.0 ? Now - WaitingForSlotSinceTime : 0.0);
+	Stats.SecondsActive = ActiveSeconds + (ActiveSinceTime > 0.0 ? Now - ActiveSinceTime : 0.0);
+	if (StreamChunkDownloader.IsValid())
+	{
+		Stats.TotalBytes = StreamChunkDownloader->GetBytesToDownload();
+		Stats.BytesDownloaded = StreamChunkDownloader->GetBytesReceived();
+		Stats.Retries = StreamChunkDownloader->GetNumRetries();
+		Stats.Stalls = StreamChunkDownloader->GetNumStalls();
+		Stats.StallThresholdSeconds = StreamChunkDownloader->GetStallThreshold();
+		Stats.PacketGapMs = StreamChunkDownloader->GetPacketGap() * 1000.f;
+		// a paused download still has its last window for a moment
+		Stats.CurrentBytesPerSecond = ActiveSinceTime > 0.0 ? StreamChunkDownloader->GetCurrentBytesPerSecond() : 0.0;
+	}
+	Stats.AverageBytesPerSecond = Stats.SecondsActive > 0.0 ? Stats.BytesDownloaded / Stats.SecondsActive : 0.0;
+	if (bCompleted && Stats.DownloadTaskResult == EChunkStreamDownloadResult::Success)
+	{
+		Stats.Progress = 1.f;
+	}
+	Stats.UpdateETA();
+	return Stats;
+}
+
+TArray<FChunkStreamDownloadStats> UChunkStreamDownloader::GetAllDownloadStats()
+{
+	FChunkStreamModule& Module = FModuleManager::Get().GetModuleChecked<FChunkStreamModule>(TEXT("ChunkStream"));
+	return Module.GetDownloadStats();
+}
+
+FChunkStreamDownloadStats UChunkStreamDownloader::GetAggregateDownloadStats()
+{
+	FChunkStreamModule& Module = FModuleManager::Get().GetModuleChecked<FChunkStreamModule>(TEXT("ChunkStream"));
+	return Module.GetAggregateStats();
+}
+
+void UChunkStreamDownloader::StartStatsClock()
+{
+	const double Now = FPlatformTime::Seconds();
+	if (WaitingForSlotSinceTime > 0.0)
+	{
+		WaitingForSlotSeconds += Now - WaitingForSlotSinceTime;
+		WaitingForSlotSinceTime = 0.0;
+	}
+	if (ActiveSinceTime == 0.0)
+	{
+		ActiveSinceTime = Now;
+	}
+}
+
+void UChunkStreamDownloader::StopStatsClock()
+{
+	const double Now = FPlatformTime::Seconds();
+	if (WaitingForSlotSinceTime > 0.0)
+	{
+		WaitingForSlotSeconds += Now - WaitingForSlotSinceTime;
+		WaitingForSlotSinceTime = 0.0;
+	}
+	if (ActiveSinceTime > 0.0)
+	{
+		ActiveSeconds += Now - ActiveSinceTime;
+		ActiveSinceTime = 0.0;
+	}
+}
+
 bool UChunkStreamDownloader::IsActive() const
 {
-	return !bCanceled && StreamChunkDownloader.IsValid() && !StreamChunkDownloader->IsCanceled() && StreamChunkDownloader->HasStarted();
+	return !bCanceled && !bPaused && (bClaimingResumable || (StreamChunkDownloader.IsValid() && !StreamChunkDownloader->IsCanceled()
+		&& StreamChunkDownloader->HasStarted() && !StreamChunkDownloader->IsPaused()));
 }
 
 void UChunkStreamDownloader::OnDownloadProgress(uint64 BytesReceived, float InProgress)
 {
+	if (bPaused)
+	{
+		// late progress from the request the pause canceled
+		return;
+	}
 	CurrentResultParams.Progress=InProgress;
 	CurrentResultParams.DownloadTaskResult = EChunkStreamDownloadResult::InProgress;
 	if (StreamChunkDownloader)
@@ -194,11 +618,24 @@ void UChunkStreamDownloader::OnChunkCompleted(TUniquePtr<StreamChunkDownloader::
 	}
 	
 	check(ChunkData);
+	const uint32 TraceId = StreamChunkDownloader ? StreamChunkDownloader->GetTraceId() : 0;
+	const uint64 QueuedBytes = ChunkData->Data.Num();
+	ChunkStreamTrace::WriteQueued(QueuedBytes);
+	StatsChunks.fetch_add(1, std::memory_order_relaxed);
+	StatsBufferedBytes.fetch_add(QueuedBytes, std::memory_order_relaxed);
+	NumQueuedWrites.fetch_add(1);
 	TWeakObjectPtr<UChunkStreamDownloader> WeakThis = this;
-	AsyncTask(ENamedThreads::Type::AnyHiPriThreadNormalTask, [WeakThis,  ChunkData = MoveTemp(ChunkData)]() mutable 
+	AsyncTask(ENamedThreads::Type::AnyHiPriThreadNormalTask, [WeakThis, TraceId, QueuedBytes, QueuedCycles = FPlatformTime::Cycles64(),  ChunkData = MoveTemp(ChunkData)]() mutable 
 		{
+			// ends the queued write even if the downloader is gone
+			ChunkStreamTrace::FScopedWrite WriteTrace(TraceId, ChunkData->StartOffset, ChunkData->Data.Num());
 			if (IsValid(WeakThis.Get()) && !WeakThis.IsStale() )
+			{
+				WeakThis->StatsWriteWaitCycles.fetch_add(FPlatformTime::Cycles64() - QueuedCycles, std::memory_order_relaxed);
+				WeakThis->NumQueuedWrites.fetch_sub(1);
 				WeakThis->WriteChunkToFile(MoveTemp(ChunkData) );
+				WeakThis->StatsBufferedBytes.fetch_sub(QueuedBytes, std::memory_order_relaxed);
+			}
 			else
 			{
 				LOG_ERROR("OnChunkReceived:: Invalid downloader object!");
@@ -209,10 +646,11 @@ void UChunkStreamDownloader::OnChunkCompleted(TUniquePtr<StreamChunkDownloader::
 void UChunkStreamDownloader::WriteChunkToFile(TUniquePtr<StreamChunkDownloader::FChunkInfo>&& ChunkData)
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE(UChunkStreamDownloader::WriteChunkToFile)
+	ChunkStreamBenchmark::FScopedCpuTimer CpuTimer(ChunkStreamBenchmark::ECpuCounter::Worker);
 	FScopeLock WriteLock(&WriteFileLock);
 	bChunkPendingWrite.store(true);
 	check(ChunkData);
-	if (!OpenFile)
+	if (!OpenFile && !IsExtractingZip())
 	{
 #if !UE_BUILD_SHIPPING
 		check(0);
@@ -226,6 +664,45 @@ void UChunkStreamDownloader::WriteChunkToFile(TUniquePtr<StreamChunkDownloader::
 	
 	uint64 BytesWritten = (ChunkData->EndOffset - ChunkData->StartOffset) + 1;
 	
+	if (UsesSequentialProcessor())
+	{
+		if (!SequentialProcessor)
+		{
+			SequentialProcessor = CreateSequentialProcessor();
+		}
+		if (!ProcessChunkInOrder(MoveTemp(ChunkData)))
+		{
+			LOG_ERROR("Failed to process downloaded data for '%s': %s", *URL, *SequentialProcessor->GetError());
+			bChunkPendingWrite.store(false);
+			// the completion takes the lock itself
+			WriteLock.Unlock();
+			if (StreamChunkDownloader.IsValid())
+			{
+				StreamChunkDownloader->Shutdown();
+			}
+			OnDownloadComplete(EChunkStreamDownloadResult::InvalidResponse);
+			return;
+		}
+		// chunks held back for the ones before them count once given, they are consumed in order
+		StatsBytesWritten.fetch_add(BytesWritten, std::memory_order_relaxed);
+		bChunkPendingWrite.store(false);
+		return;
+	}
+	
+	if (ChunkData->MappedFile)
+	{
+		// already in the file, its space was claimed when it was mapped. A chunk that can be resumed from has to be on storage first
+		MappedFile = ChunkData->MappedFile;
+		if (MappedFile->Flush(ChunkData->StartOffset, BytesWritten, CanSaveResumeData()))
+		{
+			StatsBytesWritten.fetch_add(BytesWritten, std::memory_order_relaxed);
+			ReadState->OnRangeWritten(ChunkData->StartOffset, ChunkData->EndOffset, ChunkData->TotalFileSize);
+			SaveResumeData(ChunkData->StartOffset, ChunkData->EndOffset);
+		}
+		bChunkPendingWrite.store(false);
+		return;
+	}
+	
 	uint64 TotalDiskSpace = 0;
 	uint64 FreeDiskSpace = 0;
 	if (FPlatformMisc::GetDiskTotalAndFreeSpace(FPaths::GetPath(TempDownloadDir), TotalDiskSpace, FreeDiskSpace))
@@ -239,6 +716,7 @@ void UChunkStreamDownloader::WriteChunkToFile(TUniquePtr<StreamChunkDownloader::
 			LOG_ERROR("Insufficient disk space! Required: %llu bytes, Available: %llu bytes", 
 				RequiredSpace, FreeDiskSpace);
 			bChunkPendingWrite.store(false);
+			WriteLock.Unlock();
 			
 			if (StreamChunkDownloader.IsValid())
 			{
@@ -254,13 +732,47 @@ void UChunkStreamDownloader::WriteChunkToFile(TUniquePtr<StreamChunkDownloader::
 		LOG_WARN("Unable to check disk space for path: %s", *TempDownloadDir);
 	}
 	
-	// seek to correct position and write
-	OpenFile->Seek(ChunkData->StartOffset);
+	// decided on the first write, once the size is known
+	if (!bFileWriterChecked)
+	{
+		bFileWriterChecked = true;
+		FileWriter = FChunkStreamDownloaderUtils::CreateFileWriter(TempDownloadDir, ChunkData->TotalFileSize);
+	}
+	
+	bool bWritten = false;
+	if (FileWriter)
+	{
+		bWritten = FileWriter->Write(ChunkData->Data.GetData(), BytesWritten, ChunkData->StartOffset);
+	}
+	else
+	{
+		// seek to correct position and write
+		OpenFile->Seek(ChunkData->StartOffset);
+		bWritten = OpenFile->Write(ChunkData->Data.GetData(),BytesWritten);
+		if (bWritten)
+		{
+			// flushes the in memory version of the file to storage
+			OpenFile->Flush();
+		}
+	}
 
-	if (OpenFile->Write(ChunkData->Data.GetData(),BytesWritten)	)
+	if (bWritten && FileWriter && FileWriter->IsBuffered())
 	{
-		// flushes the in memory version of the file to storage
-		OpenFile->Flush();
+		StatsBytesWritten.fetch_add(BytesWritten, std::memory_order_relaxed);
+		// readers and the resume data learn of it once it is on storage. Writes stay in flight while more chunks are on their way
+		UnflushedRanges.Emplace(ChunkData->StartOffset, ChunkData->EndOffset);
+		UnflushedBytes += BytesWritten;
+		UnflushedTotalFileSize = ChunkData->TotalFileSize;
+		if (NumQueuedWrites.load() == 0 || UnflushedBytes >= MbToBytes(MaxUnflushedWriteMB))
+		{
+			FlushFileWriter();
+		}
+	}
+	else if (bWritten)
+	{
+		StatsBytesWritten.fetch_add(BytesWritten, std::memory_order_relaxed);
+		ReadState->OnRangeWritten(ChunkData->StartOffset, ChunkData->EndOffset, ChunkData->TotalFileSize);
+		SaveResumeData(ChunkData->StartOffset, ChunkData->EndOffset);
 		LOG_VERBOSE("Written chunk [%lld-%lld] of %lld total bytes", 
 			ChunkData->StartOffset, ChunkData->EndOffset, ChunkData->TotalFileSize);
 	}
@@ -272,6 +784,75 @@ void UChunkStreamDownloader::WriteChunkToFile(TUniquePtr<StreamChunkDownloader::
 	bChunkPendingWrite.store(false);
 }
 
+void UChunkStreamDownloader::FlushFileWriter()
+{
+	if (!FileWriter || UnflushedRanges.Num() == 0)
+	{
+		return;
+	}
+	const bool bFlushed = FileWriter->Flush();
+	for (const StreamChunkDownloader::FByteRange& Range : UnflushedRanges)
+	{
+		if (bFlushed)
+		{
+			ReadState->OnRangeWritten(Range.Start, Range.End, UnflushedTotalFileSize);
+			SaveResumeData(Range.Start, Range.End);
+		}
+		else
+		{
+			LOG_ERROR("Failed to write chunk region [%llu-%llu] to drive storage!", Range.Start, Range.End);
+		}
+	}
+	UnflushedRanges.Reset();
+	UnflushedBytes = 0;
+}
+
+TUniquePtr<IChunkStreamSequentialProcessor> UChunkStreamDownloader::CreateSequentialProcessor()
+{
+	if (IsExtractingZip())
+	{
+		return MakeUnique<FChunkStreamZipExtractor>(ExtractDirectory);
+	}
+	const bool bTransportDecoded = StreamChunkDownloader.IsValid() && !StreamChunkDownloader->GetResponseEncoding().IsEmpty();
+	return MakeUnique<FChunkStreamDecompressor>(Decompression, OpenFile, bTransportDecoded);
+}
+
+bool UChunkStreamDownloader::ProcessChunkInOrder(TUniquePtr<StreamChunkDownloader::FChunkInfo>&& ChunkData)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UChunkStreamDownloader::ProcessChunkInOrder)
+	check(SequentialProcessor);
+	if (ChunkData->StartOffset > NextSequentialOffset)
+	{
+		// wait for the chunks before it
+		OutOfOrderChunks.Add(ChunkData->StartOffset, MoveTemp(ChunkData));
+		return true;
+	}
+	
+	TUniquePtr<StreamChunkDownloader::FChunkInfo> Next = MoveTemp(ChunkData);
+	while (Next)
+	{
+		// skip anything already processed, eg a retried range that overlaps
+		if (Next->EndOffset >= NextSequentialOffset)
+		{
+			const uint64 Skip = NextSequentialOffset - Next->StartOffset;
+			const uint64 Num = Next->EndOffset - NextSequentialOffset + 1;
+			if (!SequentialProcessor->Process(Next->Data.GetData() + Skip, Num))
+			{
+				return false;
+			}
+			NextSequentialOffset = Next->EndOffset + 1;
+		}
+		Next.Reset();
+		
+		if (TUniquePtr<StreamChunkDownloader::FChunkInfo>* Waiting = OutOfOrderChunks.Find(NextSequentialOffset))
+		{
+			Next = MoveTemp(*Waiting);
+			OutOfOrderChunks.Remove(NextSequentialOffset);
+		}
+	}
+	return true;
+}
+
 void UChunkStreamDownloader::OnDownloadComplete(EChunkStreamDownloadResult Result)
 {
 	if (StreamChunkDownloader)
@@ -293,34 +874,64 @@ void UChunkStreamDownloader::OnDownloadComplete(EChunkStreamDownloadResult Resul
 				// writing is running so dont complete until its done, wait untill its free
 				FPlatformProcess::Sleep(0.05);
 			}
-			// close it now so we can move it
-			WeakDownloader->CloseFile();
-			// move file to final location
-			if (Result == EChunkStreamDownloadResult::Success)
+			// flush anything the processor still holds before the file is closed
+			if (WeakDownloader->SequentialProcessor)
 			{
-				uint8 MoveAttempts = 0;
-				// try move to final save location
-				while (!WeakDownloader->MoveTempFileToFinalSave())
+				FScopeLock WriteLock(&WeakDownloader->WriteFileLock);
+				if (Result == EChunkStreamDownloadResult::Success)
 				{
-					MoveAttempts++;
-					FPlatformProcess::Sleep(0.5);
-					if (MoveAttempts >= 8)
+					if (WeakDownloader->OutOfOrderChunks.Num() > 0 || !WeakDownloader->SequentialProcessor->Finish())
 					{
-						Result = EChunkStreamDownloadResult::FileSystemError;
-						LOG_ERROR("Failed to move to final saving location!");
-						break;
+						LOG_ERROR("Download ended with unprocessed data: %s", *WeakDownloader->SequentialProcessor->GetError());
+						Result = EChunkStreamDownloadResult::InvalidResponse;
 					}
 				}
+				else
+				{
+					WeakDownloader->SequentialProcessor->Abort();
+				}
+				WeakDownloader->OutOfOrderChunks.Empty();
+				WeakDownloader->SequentialProcessor.Reset();
 			}
-			// delete temp file if not successful
-			else
+			// close it now so we can move it
+			WeakDownloader->CloseFile();
+			// finished either way, nothing is left to resume
+			FChunkStreamResumeData::Delete(WeakDownloader->TempDownloadDir);
+			// readers are held off while the file moves, they reopen it at its final path
+			WeakDownloader->ReadState->ReleaseFile([&WeakDownloader, &Result]()
 			{
-				if (IFileManager::Get().FileExists(*WeakDownloader->TempDownloadDir))
+				// move file to final location
+				if (WeakDownloader->IsExtractingZip())
 				{
-					if (IFileManager::Get().Delete(*WeakDownloader->TempDownloadDir))
-						LOG("Deleted temp file after download failed");
+					// nothing was written to the temp path
 				}
-			}
+				else if (Result == EChunkStreamDownloadResult::Success)
+				{
+					uint8 MoveAttempts = 0;
+					// try move to final save location
+					while (!WeakDownloader->MoveTempFileToFinalSave())
+					{
+						MoveAttempts++;
+						FPlatformProcess::Sleep(0.5);
+						if (MoveAttempts >= 8)
+						{
+							Result = EChunkStreamDownloadResult::FileSystemError;
+							LOG_ERROR("Failed to move to final saving location!");
+							break;
+						}
+					}
+				}
+				// delete temp file if not successful
+				else
+				{
+					if (IFileManager::Get().FileExists(*WeakDownloader->TempDownloadDir))
+					{
+						if (IFileManager::Get().Delete(*WeakDownloader->TempDownloadDir))
+							LOG("Deleted temp file after download failed");
+					}
+				}
+			});
+			WeakDownloader->ReadState->Finish(Result == EChunkStreamDownloadResult::Success, WeakDownloader->FileSavePath);
 			
 			
 				
@@ -344,6 +955,11 @@ void UChunkStreamDownloader::Completed(EChunkStreamDownloadResult InResult)
 	FChunkStreamModule& Module = FModuleManager::Get().GetModuleChecked<FChunkStreamModule>(TEXT("ChunkStream"));
 	
 	bCompleted = true;
+	StopStatsClock();
+	if (!TempDownloadDir.IsEmpty())
+	{
+		Module.GetTempFiles().Release(TempDownloadDir);
+	}
 	CurrentResultParams.DownloadTaskResult = InResult;
 	Native_DownloadFinished.Broadcast(CurrentResultParams);
 	OnComplete.Broadcast(CurrentResultParams);
@@ -354,7 +970,7 @@ void UChunkStreamDownloader::Completed(EChunkStreamDownloadResult InResult)
 	ConditionalBeginDestroy();
 }
 
-bool UChunkStreamDownloader::OpenFileForWriting(const FString& InFilePath)
+bool UChunkStreamDownloader::OpenFileForWriting(const FString& InFilePath, bool bKeepExisting)
 {
 	FScopeLock WriteLock(&WriteFileLock);
 	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
@@ -375,7 +991,7 @@ bool UChunkStreamDownloader::OpenFileForWriting(const FString& InFilePath)
 	}
 
 	// Delete the file if it already exists
-	if (FPaths::FileExists(*InFilePath))
+	if (!bKeepExisting && FPaths::FileExists(*InFilePath))
 	{
 		IFileManager& FileManager = IFileManager::Get();
 		if (!FileManager.Delete(*InFilePath))
@@ -385,10 +1001,18 @@ bool UChunkStreamDownloader::OpenFileForWriting(const FString& InFilePath)
 		}
 	}
 
-	OpenFile = PlatformFile.OpenWrite(*InFilePath);
+	// readable so readers from OpenReader can share it, appending keeps what is there and every write seeks anyway
+	OpenFile = PlatformFile.OpenWrite(*InFilePath, bKeepExisting, true);
 	if (OpenFile != nullptr)
 	{
 		LOG("File '%s' opened", *InFilePath);
+#if PLATFORM_WINDOWS
+		// the dot only hides it on other platforms
+		if (FChunkStreamTempFiles::IsTempFileName(InFilePath))
+		{
+			::SetFileAttributesW(*FPaths::ConvertRelativePathToFull(InFilePath), FILE_ATTRIBUTE_HIDDEN);
+		}
+#endif
 		return true;
 	}
 	else
@@ -398,6 +1022,70 @@ bool UChunkStreamDownloader::OpenFileForWriting(const FString& InFilePath)
 	return false;
 }
 
+void UChunkStreamDownloader::OnResumeChecked(bool bAccepted)
+{
+	FScopeLock WriteLock(&WriteFileLock);
+	if (bAccepted)
+	{
+		for (const StreamChunkDownloader::FByteRange& Range : ResumeData.WrittenRanges)
+		{
+			ReadState->OnRangeWritten(Range.Start, Range.End, ResumeData.TotalFileSize);
+		}
+		return;
+	}
+	// the server's file changed, none of it can be kept
+	if (OpenFile)
+	{
+		OpenFile->Truncate(0);
+	}
+	ResumeData = FChunkStreamResumeData();
+	bResumeDataDirty = false;
+	FChunkStreamResumeData::Delete(TempDownloadDir);
+}
+
+bool UChunkStreamDownloader::CanSaveResumeData() const
+{
+	return StreamChunkDownloader.IsValid() && StreamChunkDownloader->DoesServerAcceptRanges() && StreamChunkDownloader->GetTotalFileSize() > 0
+		&& (!StreamChunkDownloader->GetETag().IsEmpty() || !StreamChunkDownloader->GetLastModified().IsEmpty());
+}
+
+void UChunkStreamDownloader::SaveResumeData(uint64 Start, uint64 End)
+{
+	if (!CanSaveResumeData())
+	{
+		// nothing to check the file against later, it can't be resumed
+		return;
+	}
+	if (ResumeData.URL.IsEmpty())
+	{
+		ResumeData.URL = URL;
+		ResumeData.TotalFileSize = StreamChunkDownloader->GetTotalFileSize();
+		ResumeData.ETag = StreamChunkDownloader->GetETag();
+		ResumeData.LastModified = StreamChunkDownloader->GetLastModified();
+	}
+	StreamChunkDownloader::FByteRange::AddMerged(ResumeData.WrittenRanges, StreamChunkDownloader::FByteRange(Start, End));
+	bResumeDataDirty = true;
+	// rewriting the sidecar on every chunk holds up the writes behind it
+	if (FPlatformTime::Seconds() - LastResumeSaveTime >= CVarResumeSaveInterval.GetValueOnAnyThread())
+	{
+		FlushResumeData();
+	}
+}
+
+void UChunkStreamDownloader::FlushResumeData()
+{
+	if (!bResumeDataDirty)
+	{
+		return;
+	}
+	bResumeDataDirty = false;
+	LastResumeSaveTime = FPlatformTime::Seconds();
+	if (!ResumeData.Save(TempDownloadDir))
+	{
+		LOG_WARN("Failed to save resume data for '%s'", *TempDownloadDir);
+	}
+}
+
 void UChunkStreamDownloader::CloseFile()
 {
 	if (OpenFile)
@@ -415,6 +1103,15 @@ void UChunkStreamDownloader::CloseFile()
 
 		
 		FScopeLock WriteLock(&WriteFileLock);
+		FlushFileWriter();
+		FileWriter.Reset();
+		bFileWriterChecked = false;
+		FlushResumeData();
+		if (MappedFile)
+		{
+			MappedFile->Flush(0, MappedFile->GetSize(), true);
+			MappedFile.Reset();
+		}
 		OpenFile->Flush();
 		delete OpenFile;
 		OpenFile=nullptr;
@@ -428,6 +1125,8 @@ bool UChunkStreamDownloader::MoveTempFileToFinalSave()
 	{
 		IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
 
+#if PLATFORM_WINDOWS
+		// rename replaces the existing file in one step elsewhere, Windows refuses to
 		if (FPaths::FileExists(*FileSavePath))
 		{
 			IFileManager& FileManager = IFileManager::Get();
@@ -441,6 +1140,7 @@ bool UChunkStreamDownloader::MoveTempFileToFinalSave()
 				return false;
 			}
 		}
+#endif
 		FString Path, Filename, Extension;
 		FPaths::Split(FileSavePath, Path, Filename, Extension);
 		if (!PlatformFile.DirectoryExists(*Path))
@@ -457,6 +1157,9 @@ bool UChunkStreamDownloader::MoveTempFileToFinalSave()
 			LOG_ERROR("MoveTempFileToFinalSave:: Error Moving file %s \n to %s",*TempDownloadDir, *FileSavePath);
 			return false;
 		}
+#if PLATFORM_WINDOWS
+		::SetFileAttributesW(*FPaths::ConvertRelativePathToFull(FileSavePath), FILE_ATTRIBUTE_NORMAL);
+#endif
 		return true;
 	}
 	return false;
@@ -466,35 +1169,14 @@ bool UChunkStreamDownloader::MoveTempFileToFinalSave()
 FString UChunkStreamDownloader::GetTempPathForSavePath(const FString& SavePath)
 {
 	FString AbsoluteSavePath = FPaths::ConvertRelativePathToFull(SavePath);
-	
-	FString ProjectDir = FPaths::ConvertRelativePathToFull(FPaths::ProjectDir());
-	FString SavedDir = FPaths::ConvertRelativePathToFull(FPaths::ProjectSavedDir());
-    
-	FString RelativePath;
-    
-	// check if the path is within the project directory
-	if (AbsoluteSavePath.StartsWith(ProjectDir))
-	{
-		// get the relative path from project root
-		RelativePath = AbsoluteSavePath.RightChop(ProjectDir.Len());
-        
-		//  remove any leading slashes
-		while (RelativePath.StartsWith(TEXT("/")) || RelativePath.StartsWith(TEXT("\\")))
-		{
-			RelativePath = RelativePath.RightChop(1);
-		}
-		// Path is outside project dir  use filename with hash
-		uint32 PathHash = GetTypeHash(RelativePath);
-		return FPaths::ProjectSavedDir() / TEXT("temp") / 
-			   FString::Printf(TEXT("%u_%s"), PathHash, *FPaths::GetCleanFilename(SavePath));
-	}
-	else
+	if (!FPaths::GetCleanFilename(AbsoluteSavePath).IsEmpty())
 	{
-		// Path is outside project dir - use filename with hash
-		uint32 PathHash = GetTypeHash(AbsoluteSavePath);
-		return FPaths::ProjectSavedDir() / TEXT("temp") / 
-			   FString::Printf(TEXT("%u_%s"), PathHash, *FPaths::GetCleanFilename(SavePath));
+		// next to the save path, on the same volume, so finishing is a rename rather than a copy
+		return FChunkStreamTempFiles::GetTempPathForSavePath(AbsoluteSavePath);
 	}
 	
-//	return FPaths::ProjectSavedDir() / TEXT("temp") / RelativePath;
+	// no file to sit next to, use filename with hash
+	uint32 PathHash = GetTypeHash(AbsoluteSavePath);
+	return FChunkStreamTempFiles::GetTempDirectory() / 
+		   FString::Printf(TEXT("%u_%s"), PathHash, *FPaths::GetCleanFilename(SavePath));
 }
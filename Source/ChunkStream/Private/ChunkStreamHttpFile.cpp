@@ -0,0 +1,481 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+
+#include "ChunkStreamHttpFile.h"
+#include "ChunkStreamLogs.h"
+#include "Async/Async.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/Guid.h"
+#include "Misc/Paths.h"
+
+// Times a reader asks for a block that keeps being evicted before it gets to it
+static constexpr int32 MaxBlockAttempts = 4;
+
+TFuture<TSharedPtr<FChunkStreamHttpFile>> FChunkStreamHttpFile::Open(const FString& URL, const FChunkStreamHttpFileSettings& Settings)
+{
+	TSharedRef<FStreamChunkDownloader> SizeRequest = MakeShared<FStreamChunkDownloader>(URL, FString());
+	return SizeRequest->RequestDownloadTotalSize(URL, 0.f)
+		.Next([SizeRequest, URL, Settings](const FChunkStreamResponsePtr& Response) -> TSharedPtr<FChunkStreamHttpFile>
+		{
+			if (!Response || !FStreamChunkDownloader::IsSuccessStatusCode(Response->GetResponseCode()))
+			{
+				LOG_ERROR("Failed to open '%s', HEAD request failed (status %d)", *URL, Response ? Response->GetResponseCode() : 0);
+				return nullptr;
+			}
+			const uint64 FileSize = FStreamChunkDownloader::GetFileSizeFromRequest(Response, true);
+			if (FileSize == 0)
+			{
+				LOG_ERROR("Failed to open '%s', the server didn't report its size", *URL);
+				return nullptr;
+			}
+			if (!FStreamChunkDownloader::DoesApiAcceptRanges(Response, true))
+			{
+				LOG_WARN("'%s' doesn't advertise range support, reads will fail if it ignores Range", *URL);
+			}
+			return MakeShared<FChunkStreamHttpFile>(URL, FileSize, Settings);
+		});
+}
+
+FChunkStreamHttpFile::FChunkStreamHttpFile(const FString& InURL, uint64 InFileSize, const FChunkStreamHttpFileSettings& InSettings)
+	: URL(InURL), FileSize(InFileSize), Settings(InSettings)
+{
+	Settings.BlockSize = FMath::Max<int64>(Settings.BlockSize, 4096);
+	Settings.MaxMemoryBlocks = FMath::Max(Settings.MaxMemoryBlocks, 1);
+	Settings.MaxReadaheadBlocks = FMath::Max(Settings.MaxReadaheadBlocks, 0);
+	
+	if (!Settings.DiskCacheDirectory.IsEmpty() && Settings.MaxDiskBlocks > 0)
+	{
+		IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+		PlatformFile.CreateDirectoryTree(*Settings.DiskCacheDirectory);
+		DiskCachePath = FPaths::Combine(Settings.DiskCacheDirectory, FGuid::NewGuid().ToString() + TEXT(".cscache"));
+		DiskFile = PlatformFile.OpenWrite(*DiskCachePath, false, true);
+		if (!DiskFile)
+		{
+			LOG_WARN("Failed to create block cache '%s', caching in memory only", *DiskCachePath);
+		}
+	}
+}
+
+FChunkStreamHttpFile::~FChunkStreamHttpFile()
+{
+	for (const TPair<uint32, TSharedPtr<FStreamChunkDownloader>>& Fetcher : Fetchers)
+	{
+		Fetcher.Value->Shutdown();
+	}
+	for (const TPair<int64, TSharedPtr<FBlockFetch, ESPMode::ThreadSafe>>& Pending : InFlight)
+	{
+		Pending.Value->bFailed = true;
+		Pending.Value->Done->Trigger();
+	}
+	if (DiskFile)
+	{
+		delete DiskFile;
+		DiskFile = nullptr;
+		FPlatformFileManager::Get().GetPlatformFile().DeleteFile(*DiskCachePath);
+	}
+}
+
+TUniquePtr<IFileHandle> FChunkStreamHttpFile::CreateHandle()
+{
+	return MakeUnique<FChunkStreamHttpFileHandle>(AsShared());
+}
+
+int64 FChunkStreamHttpFile::GetBlockBytes(int64 BlockIndex) const
+{
+	const int64 Start = BlockIndex * Settings.BlockSize;
+	return FMath::Min(Settings.BlockSize, static_cast<int64>(FileSize) - Start);
+}
+
+bool FChunkStreamHttpFile::ReadAt(uint8* Destination, int64 Bytes, int64 Offset)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FChunkStreamHttpFile::ReadAt)
+	if (Offset < 0 || Bytes < 0 || static_cast<uint64>(Offset + Bytes) > FileSize)
+	{
+		return false;
+	}
+	if (Bytes == 0)
+	{
+		return true;
+	}
+	const int64 FirstBlock = Offset / Settings.BlockSize;
+	const int64 LastBlock = (Offset + Bytes - 1) / Settings.BlockSize;
+	
+	// everything missing goes out at once so contiguous blocks share a request
+	RequestBlocks(FirstBlock, LastBlock);
+	
+	for (int64 Block = FirstBlock; Block <= LastBlock; Block++)
+	{
+		const FBlockData Data = WaitForBlock(Block);
+		if (!Data)
+		{
+			return false;
+		}
+		const int64 BlockStart = Block * Settings.BlockSize;
+		const int64 CopyStart = FMath::Max(Offset, BlockStart);
+		const int64 CopyEnd = FMath::Min(Offset + Bytes, BlockStart + Data->Num());
+		FMemory::Memcpy(Destination + (CopyStart - Offset), Data->GetData() + (CopyStart - BlockStart), CopyEnd - CopyStart);
+	}
+	return true;
+}
+
+void FChunkStreamHttpFile::Prefetch(int64 Offset, int64 Bytes)
+{
+	Offset = FMath::Max<int64>(Offset, 0);
+	Bytes = FMath::Min(Bytes, static_cast<int64>(FileSize) - Offset);
+	if (Bytes > 0)
+	{
+		RequestBlocks(Offset / Settings.BlockSize, (Offset + Bytes - 1) / Settings.BlockSize);
+	}
+}
+
+bool FChunkStreamHttpFile::IsCached(int64 Offset, int64 Bytes)
+{
+	if (Bytes <= 0)
+	{
+		return true;
+	}
+	FScopeLock Lock(&CacheLock);
+	for (int64 Block = Offset / Settings.BlockSize; Block <= (Offset + Bytes - 1) / Settings.BlockSize; Block++)
+	{
+		if (!MemoryBlocks.Contains(Block) && !DiskSlots.Contains(Block))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+FChunkStreamHttpFile::FBlockData FChunkStreamHttpFile::WaitForBlock(int64 BlockIndex)
+{
+	for (int32 Attempt = 0; Attempt < MaxBlockAttempts; Attempt++)
+	{
+		// no-op when it is cached or already downloading
+		RequestBlocks(BlockIndex, BlockIndex);
+		
+		TSharedPtr<FBlockFetch, ESPMode::ThreadSafe> Fetch;
+		{
+			FScopeLock Lock(&CacheLock);
+			if (FBlockData Data = FindCachedBlock(BlockIndex))
+			{
+				return Data;
+			}
+			Fetch = InFlight.FindRef(BlockIndex);
+		}
+		if (!Fetch)
+		{
+			continue;
+		}
+		if (IsInGameThread())
+		{
+			// the download completes on the game thread, waiting here would never return
+			LOG_WARN("Block %lld of '%s' isn't cached yet, uncached reads can't wait on the game thread", BlockIndex, *URL);
+			return nullptr;
+		}
+		Fetch->Done->Wait();
+		if (Fetch->bFailed)
+		{
+			return nullptr;
+		}
+	}
+	LOG_WARN("Block %lld of '%s' was evicted before it could be read, the cache is too small for the reads in flight", BlockIndex, *URL);
+	return nullptr;
+}
+
+void FChunkStreamHttpFile::RequestBlocks(int64 FirstBlock, int64 LastBlock)
+{
+	struct FRun
+	{
+		int64 First;
+		int64 Last;
+		uint32 FetchId;
+	};
+	TArray<FRun> Runs;
+	{
+		FScopeLock Lock(&CacheLock);
+		FirstBlock = FMath::Max<int64>(FirstBlock, 0);
+		LastBlock = FMath::Min(LastBlock, GetNumBlocks() - 1);
+		for (int64 Block = FirstBlock; Block <= LastBlock + 1; Block++)
+		{
+			const bool bMissing = Block <= LastBlock && !MemoryBlocks.Contains(Block) && !DiskSlots.Contains(Block) && !InFlight.Contains(Block);
+			if (bMissing)
+			{
+				if (Runs.Num() == 0 || Runs.Last().Last != Block - 1)
+				{
+					Runs.Add({ Block, Block, ++NextFetchId });
+				}
+				Runs.Last().Last = Block;
+				TSharedPtr<FBlockFetch, ESPMode::ThreadSafe> Fetch = MakeShared<FBlockFetch, ESPMode::ThreadSafe>();
+				Fetch->FetchId = Runs.Last().FetchId;
+				InFlight.Add(Block, Fetch);
+			}
+		}
+	}
+	
+	for (const FRun& Run : Runs)
+	{
+		TWeakPtr<FChunkStreamHttpFile> WeakThis = AsShared();
+		auto Start = [WeakThis, Run]()
+		{
+			if (TSharedPtr<FChunkStreamHttpFile> File = WeakThis.Pin())
+			{
+				File->StartFetch(Run.First, Run.Last);
+			}
+		};
+		// requests are started and completed on the game thread
+		if (IsInGameThread())
+		{
+			Start();
+		}
+		else
+		{
+			AsyncTask(ENamedThreads::GameThread, MoveTemp(Start));
+		}
+	}
+}
+
+void FChunkStreamHttpFile::StartFetch(int64 FirstBlock, int64 LastBlock)
+{
+	uint32 FetchId = 0;
+	{
+		FScopeLock Lock(&CacheLock);
+		if (const TSharedPtr<FBlockFetch, ESPMode::ThreadSafe>* Fetch = InFlight.Find(FirstBlock))
+		{
+			FetchId = (*Fetch)->FetchId;
+		}
+	}
+	const uint64 Start = FirstBlock * Settings.BlockSize;
+	const uint64 End = LastBlock * Settings.BlockSize + GetBlockBytes(LastBlock) - 1;
+	LOG_VERBOSE("Fetching blocks %lld-%lld of '%s'", FirstBlock, LastBlock, *URL);
+	
+	TSharedPtr<FStreamChunkDownloader> Fetcher = MakeShared<FStreamChunkDownloader>(URL, FString());
+	Fetcher->SetKnownFileInfo(FileSize, true);
+	Fetcher->SetRequestedRanges({ StreamChunkDownloader::FByteRange(Start, End) });
+	{
+		FScopeLock Lock(&CacheLock);
+		Fetchers.Add(FetchId, Fetcher);
+	}
+	// a chunk per block, so readers can go as soon as their block is in
+	Fetcher->BeginDownload(Settings.BlockSize,
+		FStreamDownloadProgressSignature(),
+		FOnSingleChunkCompleteSignature::CreateSP(this, &FChunkStreamHttpFile::OnBlockChunk),
+		FOnDownloadCompleteSignature::CreateSP(this, &FChunkStreamHttpFile::OnFetchComplete, FirstBlock, LastBlock, FetchId));
+}
+
+void FChunkStreamHttpFile::OnBlockChunk(TUniquePtr<StreamChunkDownloader::FChunkInfo>&& Chunk)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FChunkStreamHttpFile::OnBlockChunk)
+	// a chunk that got no data ends before it starts
+	if (Chunk->EndOffset + 1 <= Chunk->StartOffset)
+	{
+		return;
+	}
+	FScopeLock Lock(&CacheLock);
+	uint64 Offset = Chunk->StartOffset;
+	while (Offset <= Chunk->EndOffset)
+	{
+		const int64 Block = static_cast<int64>(Offset) / Settings.BlockSize;
+		const int64 BlockStart = Block * Settings.BlockSize;
+		const int64 BlockBytes = GetBlockBytes(Block);
+		const int64 Take = FMath::Min(static_cast<int64>(Chunk->EndOffset + 1 - Offset), BlockStart + BlockBytes - static_cast<int64>(Offset));
+		
+		FBlockData Completed;
+		if (Offset == Chunk->StartOffset && static_cast<int64>(Offset) == BlockStart && Take == BlockBytes)
+		{
+			// the chunk is exactly this block, keep its buffer
+			Completed = MakeShared<TArray64<uint8>, ESPMode::ThreadSafe>(MoveTemp(Chunk->Data));
+			Completed->SetNum(BlockBytes, EAllowShrinking::No);
+		}
+		else
+		{
+			FPartialBlock& Partial = PartialBlocks.FindOrAdd(Block);
+			if (!Partial.Data)
+			{
+				Partial.Data = MakeShared<TArray64<uint8>, ESPMode::ThreadSafe>();
+				Partial.Data->SetNumUninitialized(BlockBytes);
+			}
+			FMemory::Memcpy(Partial.Data->GetData() + (Offset - BlockStart), Chunk->Data.GetData() + (Offset - Chunk->StartOffset), Take);
+			Partial.Filled += Take;
+			if (Partial.Filled >= BlockBytes)
+			{
+				Completed = Partial.Data;
+				PartialBlocks.Remove(Block);
+			}
+		}
+		
+		if (Completed)
+		{
+			AddToMemory(Block, Completed);
+			BlocksFetched++;
+			TSharedPtr<FBlockFetch, ESPMode::ThreadSafe> Fetch;
+			if (InFlight.RemoveAndCopyValue(Block, Fetch))
+			{
+				Fetch->Done->Trigger();
+			}
+		}
+		Offset += Take;
+	}
+}
+
+void FChunkStreamHttpFile::OnFetchComplete(EChunkStreamDownloadResult Result, int64 FirstBlock, int64 LastBlock, uint32 FetchId)
+{
+	FScopeLock Lock(&CacheLock);
+	if (Result != EChunkStreamDownloadResult::Success)
+	{
+		LOG_WARN("Failed to fetch blocks %lld-%lld of '%s'", FirstBlock, LastBlock, *URL);
+	}
+	// anything this request didn't deliver has failed, later requests for the same block are left alone
+	for (int64 Block = FirstBlock; Block <= LastBlock; Block++)
+	{
+		const TSharedPtr<FBlockFetch, ESPMode::ThreadSafe>* Fetch = InFlight.Find(Block);
+		if (Fetch && (*Fetch)->FetchId == FetchId)
+		{
+			(*Fetch)->bFailed = true;
+			(*Fetch)->Done->Trigger();
+			InFlight.Remove(Block);
+			PartialBlocks.Remove(Block);
+		}
+	}
+	Fetchers.Remove(FetchId);
+}
+
+FChunkStreamHttpFile::FBlockData FChunkStreamHttpFile::FindCachedBlock(int64 BlockIndex)
+{
+	if (FCachedBlock* Cached = MemoryBlocks.Find(BlockIndex))
+	{
+		Cached->LastUse = ++UseCounter;
+		MemoryHits++;
+		return Cached->Data;
+	}
+	if (FBlockData Data = ReadFromDisk(BlockIndex))
+	{
+		DiskHits++;
+		AddToMemory(BlockIndex, Data);
+		return Data;
+	}
+	return nullptr;
+}
+
+void FChunkStreamHttpFile::AddToMemory(int64 BlockIndex, FBlockData Data)
+{
+	if (!MemoryBlocks.Contains(BlockIndex) && MemoryBlocks.Num() >= Settings.MaxMemoryBlocks)
+	{
+		int64 Oldest = INDEX_NONE;
+		uint64 OldestUse = MAX_uint64;
+		for (const TPair<int64, FCachedBlock>& Cached : MemoryBlocks)
+		{
+			if (Cached.Value.LastUse < OldestUse)
+			{
+				Oldest = Cached.Key;
+				OldestUse = Cached.Value.LastUse;
+			}
+		}
+		FCachedBlock Evicted;
+		MemoryBlocks.RemoveAndCopyValue(Oldest, Evicted);
+		if (!DiskSlots.Contains(Oldest))
+		{
+			WriteToDisk(Oldest, *Evicted.Data);
+		}
+	}
+	FCachedBlock& Cached = MemoryBlocks.FindOrAdd(BlockIndex);
+	Cached.Data = MoveTemp(Data);
+	Cached.LastUse = ++UseCounter;
+}
+
+void FChunkStreamHttpFile::WriteToDisk(int64 BlockIndex, const TArray64<uint8>& Data)
+{
+	if (!DiskFile)
+	{
+		return;
+	}
+	int32 Slot = INDEX_NONE;
+	if (SlotBlocks.Num() < Settings.MaxDiskBlocks)
+	{
+		Slot = SlotBlocks.Add(BlockIndex);
+		SlotLastUse.Add(0);
+	}
+	else
+	{
+		Slot = 0;
+		for (int32 i = 1; i < SlotLastUse.Num(); i++)
+		{
+			if (SlotLastUse[i] < SlotLastUse[Slot])
+			{
+				Slot = i;
+			}
+		}
+		DiskSlots.Remove(SlotBlocks[Slot]);
+		SlotBlocks[Slot] = BlockIndex;
+	}
+	SlotLastUse[Slot] = ++UseCounter;
+	
+	if (!DiskFile->Seek(static_cast<int64>(Slot) * Settings.BlockSize) || !DiskFile->Write(Data.GetData(), Data.Num()))
+	{
+		LOG_WARN("Failed to write block %lld to the block cache '%s'", BlockIndex, *DiskCachePath);
+		return;
+	}
+	DiskSlots.Add(BlockIndex, Slot);
+}
+
+FChunkStreamHttpFile::FBlockData FChunkStreamHttpFile::ReadFromDisk(int64 BlockIndex)
+{
+	const int32* Slot = DiskSlots.Find(BlockIndex);
+	if (!DiskFile || !Slot)
+	{
+		return nullptr;
+	}
+	FBlockData Data = MakeShared<TArray64<uint8>, ESPMode::ThreadSafe>();
+	Data->SetNumUninitialized(GetBlockBytes(BlockIndex));
+	if (!DiskFile->Seek(static_cast<int64>(*Slot) * Settings.BlockSize) || !DiskFile->Read(Data->GetData(), Data->Num()))
+	{
+		LOG_WARN("Failed to read block %lld from the block cache '%s'", BlockIndex, *DiskCachePath);
+		DiskSlots.Remove(BlockIndex);
+		return nullptr;
+	}
+	SlotLastUse[*Slot] = ++UseCounter;
+	return Data;
+}
+
+bool FChunkStreamHttpFileHandle::Seek(int64 NewPosition)
+{
+	if (NewPosition < 0 || NewPosition > Size())
+	{
+		return false;
+	}
+	Position = NewPosition;
+	return true;
+}
+
+bool FChunkStreamHttpFileHandle::SeekFromEnd(int64 NewPositionRelativeToEnd)
+{
+	return Seek(Size() + NewPositionRelativeToEnd);
+}
+
+bool FChunkStreamHttpFileHandle::Read(uint8* Destination, int64 BytesToRead)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FChunkStreamHttpFileHandle::Read)
+	if (BytesToRead < 0 || Position + BytesToRead > Size())
+	{
+		return false;
+	}
+	
+	// readahead doubles while reads follow each other and stops on a seek
+	const FChunkStreamHttpFileSettings& Settings = File->GetSettings();
+	if (Position == SequentialEnd)
+	{
+		ReadaheadBlocks = FMath::Min(FMath::Max(ReadaheadBlocks * 2, 1), Settings.MaxReadaheadBlocks);
+	}
+	else
+	{
+		ReadaheadBlocks = 0;
+	}
+	
+	// one request covers the read and the readahead behind it
+	File->Prefetch(Position, BytesToRead + ReadaheadBlocks * Settings.BlockSize);
+	if (!File->ReadAt(Destination, BytesToRead, Position))
+	{
+		return false;
+	}
+	Position += BytesToRead;
+	SequentialEnd = Position;
+	return true;
+}
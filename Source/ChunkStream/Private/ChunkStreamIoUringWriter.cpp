@@ -0,0 +1,343 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#include "ChunkStreamIoUringWriter.h"
+#include "ChunkStreamLogs.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/Paths.h"
+
+#if WITH_CHUNKSTREAM_IO_URING
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "liburing.h"
+#endif
+
+TAutoConsoleVariable<int32> CVarIoUringQueueDepth(
+	TEXT("ChunkStream.IoUringQueueDepth"),
+	32,
+	TEXT("Most writes the io_uring writer keeps in flight at once, each from its own ChunkStream.IoUringSegmentSize buffer. Read when a download opens its file. Default: 32"),
+	ECVF_Default);
+
+TAutoConsoleVariable<int32> CVarIoUringSegmentSize(
+	TEXT("ChunkStream.IoUringSegmentSize"),
+	1024,
+	TEXT("Size in KB of the writes the io_uring writer splits chunks into, and of its buffers. Read when a download opens its file. Default: 1024"),
+	ECVF_Default);
+
+// Most memory a writer's buffers take, the queue is made shallower to fit
+static constexpr uint64 IoUringMaxBufferBytes = 256ull * 1024 * 1024;
+
+FChunkStreamIoUringWriter::~FChunkStreamIoUringWriter()
+{
+#if WITH_CHUNKSTREAM_IO_URING
+	if (Ring)
+	{
+		// the owner flushes before closing, anything still in flight is waited for so the buffers aren't freed under the kernel
+		const bool bDrained = Drain();
+		if (bDrained && bFixedBuffers)
+		{
+			io_uring_unregister_buffers(Ring);
+		}
+		io_uring_queue_exit(Ring);
+		delete Ring;
+		if (bDrained)
+		{
+			FMemory::Free(Buffers);
+		}
+		else
+		{
+			LOG_ERROR("Leaking io_uring write buffers, %u writes never completed", NumInFlight);
+		}
+	}
+	if (Handle >= 0)
+	{
+		close(Handle);
+	}
+#endif
+}
+
+TUniquePtr<FChunkStreamIoUringWriter> FChunkStreamIoUringWriter::Open(const FString& Path)
+{
+#if WITH_CHUNKSTREAM_IO_URING
+	TUniquePtr<FChunkStreamIoUringWriter> Writer(new FChunkStreamIoUringWriter());
+	Writer->SegmentSize = static_cast<uint32>(FMath::Clamp(CVarIoUringSegmentSize.GetValueOnAnyThread(), 4, 64 * 1024)) * 1024;
+	Writer->QueueDepth = static_cast<uint32>(FMath::Clamp<int64>(CVarIoUringQueueDepth.GetValueOnAnyThread(), 1, FMath::Min<int64>(4096, IoUringMaxBufferBytes / Writer->SegmentSize)));
+	Writer->Ring = new io_uring();
+	const int Result = io_uring_queue_init(Writer->QueueDepth, Writer->Ring, 0);
+	if (Result < 0)
+	{
+		// containers and older kernels often don't allow it
+		LOG_WARN("io_uring isn't available (%d), writing '%s' the usual way", -Result, *Path);
+		delete Writer->Ring;
+		Writer->Ring = nullptr;
+		return nullptr;
+	}
+	Writer->Handle = open(FTCHARToUTF8(*FPaths::ConvertRelativePathToFull(Path)).Get(), O_WRONLY | O_CLOEXEC);
+	if (Writer->Handle < 0)
+	{
+		LOG_WARN("Failed to open '%s' for io_uring writes, errno %d", *Path, errno);
+		return nullptr;
+	}
+	
+	// registered once, so the kernel pins the pages here instead of on every write
+	Writer->Buffers = static_cast<uint8*>(FMemory::Malloc(static_cast<SIZE_T>(Writer->QueueDepth) * Writer->SegmentSize, 4096));
+	Writer->Slots.SetNum(Writer->QueueDepth);
+	TArray<iovec> Buffers;
+	Buffers.SetNum(Writer->QueueDepth);
+	for (uint32 Slot = 0; Slot < Writer->QueueDepth; Slot++)
+	{
+		Buffers[Slot].iov_base = Writer->GetSlotMemory(Slot);
+		Buffers[Slot].iov_len = Writer->SegmentSize;
+		Writer->FreeSlots.Add(Writer->QueueDepth - 1 - Slot);
+	}
+	const int RegisterResult = io_uring_register_buffers(Writer->Ring, Buffers.GetData(), Writer->QueueDepth);
+	Writer->bFixedBuffers = RegisterResult == 0;
+	if (!Writer->bFixedBuffers)
+	{
+		LOG_VERBOSE("io_uring buffer registration failed (%d), writing from unregistered buffers", -RegisterResult);
+	}
+	return Writer;
+#else
+	return nullptr;
+#endif
+}
+
+bool FChunkStreamIoUringWriter::Write(const uint8* Data, uint64 Num, uint64 Offset)
+{
+#if WITH_CHUNKSTREAM_IO_URING
+	TRACE_CPUPROFILER_EVENT_SCOPE(FChunkStreamIoUringWriter::Write)
+	if (bBroken)
+	{
+		return false;
+	}
+	for (uint64 Position = 0; Position < Num;)
+	{
+		// every buffer is being written from, wait for one to come back
+		while (FreeSlots.Num() == 0)
+		{
+			if (!Submit() || !Reap(true))
+			{
+				return false;
+			}
+		}
+		const uint32 Slot = FreeSlots.Pop(EAllowShrinking::No);
+		FSlot& Entry = Slots[Slot];
+		Entry.Offset = Offset + Position;
+		Entry.Num = static_cast<uint32>(FMath::Min<uint64>(SegmentSize, Num - Position));
+		Entry.Written = 0;
+		FMemory::Memcpy(GetSlotMemory(Slot), Data + Position, Entry.Num);
+		if (!Prepare(Slot))
+		{
+			return false;
+		}
+		Position += Entry.Num;
+	}
+	if (!Submit())
+	{
+		return false;
+	}
+	// collect what has finished meanwhile without waiting, the rest stays in flight for the next chunk or Flush
+	while (NumInFlight > 0 && Reap(false))
+	{
+	}
+	return Submit();
+#else
+	return false;
+#endif
+}
+
+bool FChunkStreamIoUringWriter::Flush()
+{
+#if WITH_CHUNKSTREAM_IO_URING
+	TRACE_CPUPROFILER_EVENT_SCOPE(FChunkStreamIoUringWriter::Flush)
+	while (!bBroken && (NumPrepared > 0 || NumInFlight > 0))
+	{
+		if (!Submit() || !Reap(true))
+		{
+			return false;
+		}
+	}
+	if (bBroken)
+	{
+		return false;
+	}
+	bool bSucceeded = !bFailed;
+	bFailed = false;
+	// same as the IFileHandle path flushing its writes
+	if (bSucceeded && fdatasync(Handle) != 0)
+	{
+		LOG_ERROR("Failed to sync io_uring writes, errno %d", errno);
+		bSucceeded = false;
+	}
+	return bSucceeded;
+#else
+	return false;
+#endif
+}
+
+bool FChunkStreamIoUringWriter::Prepare(uint32 Slot)
+{
+#if WITH_CHUNKSTREAM_IO_URING
+	io_uring_sqe* Sqe = io_uring_get_sqe(Ring);
+	if (!Sqe)
+	{
+		// the submission queue is as deep as there are buffers, so only prepared writes fill it
+		if (!Submit())
+		{
+			return false;
+		}
+		Sqe = io_uring_get_sqe(Ring);
+		if (!Sqe)
+		{
+			LOG_ERROR("io_uring has no free submission entry");
+			Abandon();
+			return false;
+		}
+	}
+	const FSlot& Entry = Slots[Slot];
+	uint8* Memory = GetSlotMemory(Slot) + Entry.Written;
+	const uint32 Left = Entry.Num - Entry.Written;
+	if (bFixedBuffers)
+	{
+		io_uring_prep_write_fixed(Sqe, Handle, Memory, Left, Entry.Offset + Entry.Written, static_cast<int>(Slot));
+	}
+	else
+	{
+		io_uring_prep_write(Sqe, Handle, Memory, Left, Entry.Offset + Entry.Written);
+	}
+	io_uring_sqe_set_data(Sqe, reinterpret_cast<void*>(static_cast<UPTRINT>(Slot)));
+	NumPrepared++;
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool FChunkStreamIoUringWriter::Submit()
+{
+#if WITH_CHUNKSTREAM_IO_URING
+	if (bBroken)
+	{
+		return false;
+	}
+	if (NumPrepared == 0)
+	{
+		return true;
+	}
+	const int Submitted = io_uring_submit(Ring);
+	if (Submitted < 0)
+	{
+		LOG_ERROR("io_uring submit failed (%d)", -Submitted);
+		Abandon();
+		return false;
+	}
+	const uint32 Started = FMath::Min(static_cast<uint32>(Submitted), NumPrepared);
+	NumInFlight += Started;
+	NumPrepared -= Started;
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool FChunkStreamIoUringWriter::Reap(bool bWait)
+{
+#if WITH_CHUNKSTREAM_IO_URING
+	if (bBroken || NumInFlight == 0)
+	{
+		return false;
+	}
+	io_uring_cqe* Cqe = nullptr;
+	int Result = 0;
+	do
+	{
+		Result = bWait ? io_uring_wait_cqe(Ring, &Cqe) : io_uring_peek_cqe(Ring, &Cqe);
+	}
+	while (bWait && Result == -EINTR);
+	if (!bWait && (Result == -EAGAIN || Result == -EINTR))
+	{
+		return false;
+	}
+	if (Result < 0)
+	{
+		LOG_ERROR("io_uring wait failed (%d)", -Result);
+		Abandon();
+		return false;
+	}
+	const uint32 Slot = static_cast<uint32>(reinterpret_cast<UPTRINT>(io_uring_cqe_get_data(Cqe)));
+	const int32 Written = Cqe->res;
+	io_uring_cqe_seen(Ring, Cqe);
+	NumInFlight--;
+	
+	FSlot& Entry = Slots[Slot];
+	if (Written == -EAGAIN || Written == -EINTR)
+	{
+		return Prepare(Slot);
+	}
+	if (Written <= 0)
+	{
+		LOG_ERROR("io_uring write of %u bytes at %llu failed (%d)", Entry.Num - Entry.Written, Entry.Offset + Entry.Written, -Written);
+		bFailed = true;
+		FreeSlots.Add(Slot);
+		return true;
+	}
+	Entry.Written += static_cast<uint32>(Written);
+	if (Entry.Written < Entry.Num)
+	{
+		// short write, the rest goes again
+		return Prepare(Slot);
+	}
+	FreeSlots.Add(Slot);
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool FChunkStreamIoUringWriter::Drain()
+{
+#if WITH_CHUNKSTREAM_IO_URING
+	int32 Failures = 0;
+	while (NumInFlight > 0)
+	{
+		io_uring_cqe* Cqe = nullptr;
+		const int Result = io_uring_wait_cqe(Ring, &Cqe);
+		if (Result == -EINTR)
+		{
+			continue;
+		}
+		if (Result < 0)
+		{
+			if (++Failures >= 8)
+			{
+				LOG_ERROR("Gave up waiting for %u io_uring writes (%d)", NumInFlight, -Result);
+				return false;
+			}
+			FPlatformProcess::Sleep(0.01f);
+			continue;
+		}
+		io_uring_cqe_seen(Ring, Cqe);
+		NumInFlight--;
+	}
+	return true;
+#else
+	return true;
+#endif
+}
+
+void FChunkStreamIoUringWriter::Abandon()
+{
+#if WITH_CHUNKSTREAM_IO_URING
+	bBroken = true;
+	bFailed = true;
+	// prepared writes were never handed over and go with the ring, submitted ones still read from the buffers
+	NumPrepared = 0;
+	if (Drain() && bFixedBuffers)
+	{
+		io_uring_unregister_buffers(Ring);
+		bFixedBuffers = false;
+	}
+#endif
+}
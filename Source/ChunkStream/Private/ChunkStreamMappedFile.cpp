@@ -0,0 +1,118 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#include "ChunkStreamMappedFile.h"
+#include "ChunkStreamLogs.h"
+#include "Misc/Paths.h"
+
+#define CHUNKSTREAM_MAPPED_WRITES (PLATFORM_LINUX || PLATFORM_ANDROID || PLATFORM_MAC || PLATFORM_IOS)
+
+#if CHUNKSTREAM_MAPPED_WRITES
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+FChunkStreamMappedFile::~FChunkStreamMappedFile()
+{
+#if CHUNKSTREAM_MAPPED_WRITES
+	if (Data)
+	{
+		munmap(Data, Size);
+	}
+	if (Handle >= 0)
+	{
+		close(Handle);
+	}
+#endif
+}
+
+TSharedPtr<FChunkStreamMappedFile, ESPMode::ThreadSafe> FChunkStreamMappedFile::Create(const FString& Path, uint64 Size)
+{
+#if CHUNKSTREAM_MAPPED_WRITES
+	if (Size == 0 || Size > static_cast<uint64>(TNumericLimits<off_t>::Max()) || Size > static_cast<uint64>(TNumericLimits<SIZE_T>::Max()))
+	{
+		return nullptr;
+	}
+	TSharedPtr<FChunkStreamMappedFile, ESPMode::ThreadSafe> MappedFile = MakeShareable(new FChunkStreamMappedFile());
+	const FString FullPath = FPaths::ConvertRelativePathToFull(Path);
+	MappedFile->Handle = open(FTCHARToUTF8(*FullPath).Get(), O_RDWR | O_CLOEXEC);
+	if (MappedFile->Handle < 0)
+	{
+		LOG_WARN("Failed to open '%s' for mapping, errno %d", *Path, errno);
+		return nullptr;
+	}
+	
+	// a write to a page storage can't back is a SIGBUS, not an error, so the space is claimed up front
+	struct stat Stat;
+	const uint64 CurrentSize = fstat(MappedFile->Handle, &Stat) == 0 ? static_cast<uint64>(Stat.st_size) : 0;
+	uint64 TotalDiskSpace = 0;
+	uint64 FreeDiskSpace = 0;
+	if (CurrentSize < Size && FPlatformMisc::GetDiskTotalAndFreeSpace(FPaths::GetPath(FullPath), TotalDiskSpace, FreeDiskSpace)
+		&& FreeDiskSpace < Size - CurrentSize)
+	{
+		LOG_WARN("Not enough space to map '%s', %llu bytes needed, %llu free", *Path, Size - CurrentSize, FreeDiskSpace);
+		return nullptr;
+	}
+#if PLATFORM_LINUX || PLATFORM_ANDROID
+	const int AllocateResult = posix_fallocate(MappedFile->Handle, 0, static_cast<off_t>(Size));
+	if (AllocateResult == ENOSPC)
+	{
+		LOG_WARN("Not enough space to map '%s' (%llu bytes)", *Path, Size);
+		return nullptr;
+	}
+	// filesystems without fallocate still take a plain resize
+	if (AllocateResult != 0 && CurrentSize < Size && ftruncate(MappedFile->Handle, static_cast<off_t>(Size)) != 0)
+#else
+	if (CurrentSize < Size && ftruncate(MappedFile->Handle, static_cast<off_t>(Size)) != 0)
+#endif
+	{
+		LOG_WARN("Failed to extend '%s' to %llu bytes for mapping, errno %d", *Path, Size, errno);
+		return nullptr;
+	}
+	
+	void* Mapping = mmap(nullptr, static_cast<size_t>(Size), PROT_READ | PROT_WRITE, MAP_SHARED, MappedFile->Handle, 0);
+	if (Mapping == MAP_FAILED)
+	{
+		LOG_WARN("Failed to map '%s' (%llu bytes), errno %d", *Path, Size, errno);
+		return nullptr;
+	}
+	MappedFile->Data = static_cast<uint8*>(Mapping);
+	MappedFile->Size = Size;
+	LOG("Mapped '%s' (%llu bytes) to receive into", *Path, Size);
+	return MappedFile;
+#else
+	return nullptr;
+#endif
+}
+
+bool FChunkStreamMappedFile::Flush(uint64 Offset, uint64 Num, bool bWait)
+{
+#if CHUNKSTREAM_MAPPED_WRITES
+	TRACE_CPUPROFILER_EVENT_SCOPE(FChunkStreamMappedFile::Flush)
+	if (!Data || Num == 0 || Offset >= Size)
+	{
+		return Data != nullptr;
+	}
+	Num = FMath::Min(Num, Size - Offset);
+#if PLATFORM_LINUX || PLATFORM_ANDROID
+	if (!bWait)
+	{
+		// MS_ASYNC does nothing on Linux, this actually starts the writeback
+		return sync_file_range(Handle, static_cast<off_t>(Offset), static_cast<off_t>(Num), SYNC_FILE_RANGE_WRITE) == 0;
+	}
+#endif
+	// msync wants the start on a page boundary
+	const uint64 PageSize = static_cast<uint64>(sysconf(_SC_PAGESIZE));
+	const uint64 Start = AlignDown(Offset, PageSize);
+	if (msync(Data + Start, static_cast<size_t>(Offset + Num - Start), bWait ? MS_SYNC : MS_ASYNC) != 0)
+	{
+		LOG_ERROR("Failed to flush mapped range [%llu-%llu], errno %d", Offset, Offset + Num - 1, errno);
+		return false;
+	}
+	return true;
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,145 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#include "ChunkStreamMemoryBudget.h"
+#include "ChunkStreamLogs.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/ScopeLock.h"
+
+TAutoConsoleVariable<int32> CVarMemoryBudgetMB(
+	TEXT("ChunkStream.MemoryBudgetMB"),
+#if PLATFORM_ANDROID || PLATFORM_IOS
+	256,
+#else
+	2048,
+#endif
+	TEXT("Most memory in MB all downloads together may hold in chunk buffers, in flight and waiting to be written.")
+	TEXT(" Chunks get smaller, then downloads wait, when it runs short. 0 = unlimited. Default: 256 on mobile, 2048 elsewhere"),
+	ECVF_Default);
+
+TAutoConsoleVariable<int32> CVarMemoryPressureBudgetPercent(
+	TEXT("ChunkStream.MemoryPressureBudgetPercent"),
+	25,
+	TEXT("Percent of ChunkStream.MemoryBudgetMB left to downloads after a platform memory warning. Default: 25"),
+	ECVF_Default);
+
+TAutoConsoleVariable<float> CVarMemoryPressureSeconds(
+	TEXT("ChunkStream.MemoryPressureSeconds"),
+	30.f,
+	TEXT("Seconds the budget stays lowered after a platform memory warning. Default: 30"),
+	ECVF_Default);
+
+FChunkStreamMemoryReservation& FChunkStreamMemoryReservation::operator=(FChunkStreamMemoryReservation&& Other)
+{
+	if (this != &Other)
+	{
+		Reset();
+		Bytes = Other.Bytes;
+		Other.Bytes = 0;
+	}
+	return *this;
+}
+
+void FChunkStreamMemoryReservation::Shrink(uint64 NewBytes)
+{
+	if (NewBytes < Bytes)
+	{
+		FChunkStreamMemoryBudget::Get().Release(Bytes - NewBytes);
+		Bytes = NewBytes;
+	}
+}
+
+FChunkStreamMemoryReservation FChunkStreamMemoryReservation::Split(uint64 SplitBytes)
+{
+	SplitBytes = FMath::Min(SplitBytes, Bytes);
+	Bytes -= SplitBytes;
+	return FChunkStreamMemoryReservation(SplitBytes);
+}
+
+void FChunkStreamMemoryReservation::Append(FChunkStreamMemoryReservation&& Other)
+{
+	if (this != &Other)
+	{
+		Bytes += Other.Bytes;
+		Other.Bytes = 0;
+	}
+}
+
+void FChunkStreamMemoryReservation::Reset()
+{
+	if (Bytes > 0)
+	{
+		FChunkStreamMemoryBudget::Get().Release(Bytes);
+		Bytes = 0;
+	}
+}
+
+FChunkStreamMemoryBudget& FChunkStreamMemoryBudget::Get()
+{
+	// outlives the module, chunks may still be queued when it shuts down
+	static FChunkStreamMemoryBudget Budget;
+	return Budget;
+}
+
+FChunkStreamMemoryReservation FChunkStreamMemoryBudget::TryReserve(uint64 WantedBytes, uint64 MinBytes)
+{
+	const uint64 Budget = GetBudget();
+	FScopeLock ScopeLock(&Lock);
+	const uint64 CurrentlyReserved = Reserved.load(std::memory_order_relaxed);
+	uint64 Granted = WantedBytes;
+	if (Budget > 0 && CurrentlyReserved > 0)
+	{
+		const uint64 Left = Budget > CurrentlyReserved ? Budget - CurrentlyReserved : 0;
+		if (Left < MinBytes)
+		{
+			return FChunkStreamMemoryReservation();
+		}
+		Granted = FMath::Min(WantedBytes, Left);
+	}
+	else if (Budget > 0)
+	{
+		Granted = FMath::Max(FMath::Min(WantedBytes, Budget), FMath::Min(MinBytes, WantedBytes));
+	}
+	Reserved.store(CurrentlyReserved + Granted, std::memory_order_relaxed);
+	return FChunkStreamMemoryReservation(Granted);
+}
+
+FChunkStreamMemoryReservation FChunkStreamMemoryBudget::ReserveOverBudget(uint64 Bytes)
+{
+	FScopeLock ScopeLock(&Lock);
+	Reserved.store(Reserved.load(std::memory_order_relaxed) + Bytes, std::memory_order_relaxed);
+	return FChunkStreamMemoryReservation(Bytes);
+}
+
+uint64 FChunkStreamMemoryBudget::GetBudget() const
+{
+	const uint64 Budget = static_cast<uint64>(FMath::Max(CVarMemoryBudgetMB.GetValueOnAnyThread(), 0)) * 1024 * 1024;
+	if (Budget > 0 && IsUnderMemoryPressure())
+	{
+		return Budget * FMath::Clamp(CVarMemoryPressureBudgetPercent.GetValueOnAnyThread(), 1, 100) / 100;
+	}
+	return Budget;
+}
+
+bool FChunkStreamMemoryBudget::IsUnderMemoryPressure() const
+{
+	return FPlatformTime::Seconds() < PressureEndTime.load(std::memory_order_relaxed);
+}
+
+void FChunkStreamMemoryBudget::OnMemoryPressure()
+{
+	const bool bWasUnderPressure = IsUnderMemoryPressure();
+	PressureEndTime.store(FPlatformTime::Seconds() + FMath::Max(CVarMemoryPressureSeconds.GetValueOnAnyThread(), 0.f), std::memory_order_relaxed);
+	if (!bWasUnderPressure)
+	{
+		LOG_WARN("Memory warning, download chunk buffers limited to %.1f MB (%.1f MB held)", GetBudget() / (1024.0 * 1024.0),
+			GetReserved() / (1024.0 * 1024.0));
+	}
+}
+
+void FChunkStreamMemoryBudget::Release(uint64 Bytes)
+{
+	FScopeLock ScopeLock(&Lock);
+	const uint64 CurrentlyReserved = Reserved.load(std::memory_order_relaxed);
+	ensure(CurrentlyReserved >= Bytes);
+	Reserved.store(CurrentlyReserved - FMath::Min(CurrentlyReserved, Bytes), std::memory_order_relaxed);
+}
@@ -0,0 +1,459 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+
+#include "ChunkStreamMemoryTransport.h"
+#include "StreamChunkDownloader.h"
+#include "Async/Async.h"
+
+// Longest sleep between checks for cancellation while a request waits
+static constexpr float MaxWaitStepSeconds = 0.01f;
+static const TCHAR* MultipartBoundary = TEXT("CHUNKSTREAM_MEMORY_BOUNDARY");
+
+namespace
+{
+	class FChunkStreamMemoryResponse : public IChunkStreamResponse
+	{
+	public:
+		explicit FChunkStreamMemoryResponse(int32 InResponseCode) : ResponseCode(InResponseCode) {}
+
+		virtual int32 GetResponseCode() const override { return ResponseCode; }
+		virtual FString GetHeader(const FString& HeaderName) const override { return Headers.FindRef(HeaderName); }
+
+		int32 ResponseCode;
+		// TMap keys compare case-insensitively, like header names
+		TMap<FString, FString> Headers;
+	};
+
+	// Part of a response body, Prefix then Num bytes of the file from Start
+	struct FBodySegment
+	{
+		TArray<uint8> Prefix;
+		uint64 Start = 0;
+		uint64 Num = 0;
+
+		uint64 GetSize() const { return Prefix.Num() + Num; }
+	};
+
+	TArray<uint8> ToBytes(const FString& Text)
+	{
+		const FTCHARToUTF8 Utf8(*Text);
+		return TArray<uint8>(reinterpret_cast<const uint8*>(Utf8.Get()), Utf8.Length());
+	}
+
+	/**
+	 * Parses "bytes=a-b,c-" against a file of FileSize bytes.
+	 * @return false if any range can't be satisfied
+	 */
+	bool ParseRangeHeader(const FString& Header, uint64 FileSize, TArray<StreamChunkDownloader::FByteRange>& OutRanges)
+	{
+		FString Spec = Header.TrimStartAndEnd();
+		if (!Spec.StartsWith(TEXT("bytes="), ESearchCase::IgnoreCase))
+		{
+			return false;
+		}
+		Spec.RightChopInline(6);
+		TArray<FString> Parts;
+		Spec.ParseIntoArray(Parts, TEXT(","));
+		for (const FString& Part : Parts)
+		{
+			FString First;
+			FString Last;
+			if (!Part.TrimStartAndEnd().Split(TEXT("-"), &First, &Last) || First.IsEmpty() || !First.IsNumeric())
+			{
+				return false;
+			}
+			StreamChunkDownloader::FByteRange Range;
+			Range.Start = FCString::Strtoui64(*First, nullptr, 10);
+			Range.End = Last.IsEmpty() ? FileSize - 1 : FMath::Min(FCString::Strtoui64(*Last, nullptr, 10), FileSize - 1);
+			if (Range.Start >= FileSize || Range.End < Range.Start)
+			{
+				return false;
+			}
+			OutRanges.Add(Range);
+		}
+		return OutRanges.Num() > 0;
+	}
+}
+
+// Serves one request on its own thread
+class FChunkStreamMemoryRequest : public IChunkStreamRequest
+{
+public:
+	explicit FChunkStreamMemoryRequest(const TSharedRef<FChunkStreamMemoryTransport, ESPMode::ThreadSafe>& InServer) : Server(InServer) {}
+
+	virtual void SetVerb(const FString& InVerb) override { Verb = InVerb; }
+	virtual void SetURL(const FString& InURL) override { URL = InURL; }
+	virtual void SetHeader(const FString& Name, const FString& Value) override { RequestHeaders.Add(Name, Value); }
+	virtual void SetTimeout(float Seconds) override { TimeoutSeconds = Seconds; }
+
+	virtual bool ProcessRequest() override
+	{
+		if (bStarted)
+		{
+			return false;
+		}
+		bStarted = true;
+		StartTime = FPlatformTime::Seconds();
+		TSharedRef<FChunkStreamMemoryRequest, ESPMode::ThreadSafe> This = StaticCastSharedRef<FChunkStreamMemoryRequest>(AsShared());
+		Async(EAsyncExecution::Thread, [This]() { This->Serve(); });
+		return true;
+	}
+
+	virtual void CancelRequest() override { bCanceled = true; }
+
+private:
+	// Sleeps up to Seconds, false if the request was canceled or timed out meanwhile
+	bool Wait(double Seconds)
+	{
+		const double Until = FPlatformTime::Seconds() + Seconds;
+		for (double Now = FPlatformTime::Seconds(); Now < Until; Now = FPlatformTime::Seconds())
+		{
+			if (!IsAlive())
+			{
+				return false;
+			}
+			FPlatformProcess::Sleep(FMath::Min(static_cast<float>(Until - Now), MaxWaitStepSeconds));
+		}
+		return IsAlive();
+	}
+
+	bool IsAlive() const
+	{
+		return !bCanceled && (TimeoutSeconds <= 0.f || FPlatformTime::Seconds() - StartTime < TimeoutSeconds);
+	}
+
+	void Serve()
+	{
+		FChunkStreamMemoryFileSettings Settings;
+		int32 RequestNumber = 0;
+		const bool bFound = Server->BeginRequest(URL, RequestHeaders.FindRef(TEXT("Range")), Settings, RequestNumber);
+		if (!Wait(Settings.LatencySeconds))
+		{
+			Complete(nullptr, false);
+			return;
+		}
+		
+		const uint64 FileSize = Settings.Data ? Settings.Data->Num() : Settings.FileSize;
+		if (!bFound)
+		{
+			Respond(MakeShared<FChunkStreamMemoryResponse, ESPMode::ThreadSafe>(404), Settings, {});
+			return;
+		}
+		const EChunkStreamMemoryFault Fault = Verb != TEXT("HEAD") && Settings.Faults.Num() > 0
+			? Settings.Faults[(RequestNumber - 1) % Settings.Faults.Num()] : EChunkStreamMemoryFault::None;
+		if ((Settings.FailEveryNthRequest > 0 && RequestNumber % Settings.FailEveryNthRequest == 0) || Fault == EChunkStreamMemoryFault::ServiceUnavailable)
+		{
+			Respond(MakeShared<FChunkStreamMemoryResponse, ESPMode::ThreadSafe>(Settings.FailureStatusCode), Settings, {});
+			return;
+		}
+		if (Fault == EChunkStreamMemoryFault::Delay && !Wait(Settings.FaultDelaySeconds))
+		{
+			Complete(nullptr, false);
+			return;
+		}
+		
+		TArray<StreamChunkDownloader::FByteRange> Ranges;
+		const FString* RangeHeader = Fault != EChunkStreamMemoryFault::IgnoreRange ? RequestHeaders.Find(TEXT("Range")) : nullptr;
+		if (Settings.bAcceptRanges && RangeHeader && !ParseRangeHeader(*RangeHeader, FileSize, Ranges))
+		{
+			TSharedRef<FChunkStreamMemoryResponse, ESPMode::ThreadSafe> Response = MakeShared<FChunkStreamMemoryResponse, ESPMode::ThreadSafe>(416);
+			Response->Headers.Add(TEXT("Content-Range"), FString::Printf(TEXT("bytes */%llu"), FileSize));
+			Respond(Response, Settings, {});
+			return;
+		}
+		
+		TArray<FBodySegment> Body;
+		TSharedRef<FChunkStreamMemoryResponse, ESPMode::ThreadSafe> Response = MakeShared<FChunkStreamMemoryResponse, ESPMode::ThreadSafe>(200);
+		if (Ranges.Num() == 1)
+		{
+			Response->ResponseCode = 206;
+			Response->Headers.Add(TEXT("Content-Range"), FString::Printf(TEXT("bytes %llu-%llu/%llu"), Ranges[0].Start, Ranges[0].End, FileSize));
+			Body.Add({ {}, Ranges[0].Start, Ranges[0].Num() });
+			if (Fault == EChunkStreamMemoryFault::ExtraBytes)
+			{
+				// synthetic bytes exist past the end of the file, real data doesn't
+				const uint64 ExtraBytes = Settings.Data ? FMath::Min(Settings.FaultBytes, FileSize - Ranges[0].End - 1) : Settings.FaultBytes;
+				Body.Add({ {}, Ranges[0].End + 1, ExtraBytes });
+			}
+		}
+		else if (Ranges.Num() > 1 && Settings.bMultiRange)
+		{
+			Response->ResponseCode = 206;
+			Response->Headers.Add(TEXT("Content-Type"), FString::Printf(TEXT("multipart/byteranges; boundary=%s"), MultipartBoundary));
+			for (const StreamChunkDownloader::FByteRange& Range : Ranges)
+			{
+				const FString PartHeader = FString::Printf(TEXT("\r\n--%s\r\nContent-Type: application/octet-stream\r\nContent-Range: bytes %llu-%llu/%llu\r\n\r\n"),
+					MultipartBoundary, Range.Start, Range.End, FileSize);
+				Body.Add({ ToBytes(PartHeader), Range.Start, Range.Num() });
+			}
+			Body.Add({ ToBytes(FString::Printf(TEXT("\r\n--%s--\r\n"), MultipartBoundary)), 0, 0 });
+		}
+		else
+		{
+			// no range, or a server that ignores them
+			Body.Add({ {}, 0, FileSize });
+		}
+		if (Settings.bAcceptRanges)
+		{
+			Response->Headers.Add(TEXT("Accept-Ranges"), TEXT("bytes"));
+		}
+		if (!Settings.ETag.IsEmpty())
+		{
+			Response->Headers.Add(TEXT("ETag"), Settings.ETag);
+		}
+		uint64 BodySize = 0;
+		for (const FBodySegment& Segment : Body)
+		{
+			BodySize += Segment.GetSize();
+		}
+		uint64 ContentLength = BodySize;
+		if (Fault == EChunkStreamMemoryFault::ShortContentLength)
+		{
+			ContentLength = BodySize > Settings.FaultBytes ? BodySize - Settings.FaultBytes : BodySize / 2;
+		}
+		else if (Fault == EChunkStreamMemoryFault::LongContentLength)
+		{
+			ContentLength = BodySize + Settings.FaultBytes;
+		}
+		Response->Headers.Add(TEXT("Content-Length"), FString::Printf(TEXT("%llu"), ContentLength));
+		
+		if (Verb == TEXT("HEAD"))
+		{
+			Body.Reset();
+		}
+		Respond(Response, Settings, Body, Fault, ContentLength);
+	}
+
+	// Sends the status, headers and body then completes
+	void Respond(const TSharedRef<FChunkStreamMemoryResponse, ESPMode::ThreadSafe>& Response, const FChunkStreamMemoryFileSettings& Settings,
+		const TArray<FBodySegment>& Body, EChunkStreamMemoryFault Fault = EChunkStreamMemoryFault::None, uint64 ContentLength = 0)
+	{
+		StatusCodeDelegate.ExecuteIfBound(Response->ResponseCode);
+		for (const TPair<FString, FString>& Header : Response->Headers)
+		{
+			HeaderDelegate.ExecuteIfBound(Header.Key, Header.Value);
+		}
+		
+		uint64 BodySize = 0;
+		for (const FBodySegment& Segment : Body)
+		{
+			BodySize += Segment.GetSize();
+		}
+		// body bytes sent before the connection ends, and whether the client sees that as the end of the response
+		uint64 SendLimit = Settings.DisconnectAfterBytes > 0 ? Settings.DisconnectAfterBytes : MAX_uint64;
+		bool bLimitEndsResponse = false;
+		if (Fault == EChunkStreamMemoryFault::Disconnect)
+		{
+			SendLimit = BodySize / 2;
+		}
+		else if (Fault == EChunkStreamMemoryFault::ShortContentLength)
+		{
+			// the client stops reading at Content-Length
+			SendLimit = ContentLength;
+			bLimitEndsResponse = true;
+		}
+		
+		TArray<uint8> Packet;
+		Packet.SetNumUninitialized(FMath::Max(Fault == EChunkStreamMemoryFault::Trickle ? Settings.TrickleBytes : Settings.PacketSize, 1));
+		const double BodyStartTime = FPlatformTime::Seconds();
+		uint64 Sent = 0;
+		for (const FBodySegment& Segment : Body)
+		{
+			for (uint64 SegmentOffset = 0; SegmentOffset < Segment.GetSize();)
+			{
+				uint64 Num = FMath::Min<uint64>(Packet.Num(), Segment.GetSize() - SegmentOffset);
+				if (Sent + Num > SendLimit)
+				{
+					Num = SendLimit - Sent;
+				}
+				if (Num == 0)
+				{
+					// dropped connection, or the end the short Content-Length announced
+					Complete(Response, bLimitEndsResponse);
+					return;
+				}
+				FillPacket(Segment, SegmentOffset, Settings, Packet.GetData(), Num);
+				
+				if (Fault == EChunkStreamMemoryFault::Trickle)
+				{
+					if (!Wait(Settings.TrickleIntervalSeconds))
+					{
+						Complete(Response, false);
+						return;
+					}
+				}
+				else if (Settings.BytesPerSecond > 0.0)
+				{
+					const double SendTime = BodyStartTime + static_cast<double>(Sent + Num) / Settings.BytesPerSecond;
+					if (!Wait(SendTime - FPlatformTime::Seconds()))
+					{
+						Complete(Response, false);
+						return;
+					}
+				}
+				else if (!IsAlive())
+				{
+					Complete(Response, false);
+					return;
+				}
+				
+				int64 Length = static_cast<int64>(Num);
+				if (BodyDelegate.IsBound())
+				{
+					BodyDelegate.Execute(Packet.GetData(), Length);
+					if (Length == 0)
+					{
+						// the reader refused the data
+						Complete(Response, false);
+						return;
+					}
+				}
+				Sent += Num;
+				SegmentOffset += Num;
+				ReportProgress(Sent);
+			}
+		}
+		// a longer Content-Length than the body is a connection closed early
+		Complete(Response, Fault != EChunkStreamMemoryFault::LongContentLength);
+	}
+
+	void FillPacket(const FBodySegment& Segment, uint64 SegmentOffset, const FChunkStreamMemoryFileSettings& Settings, uint8* Destination, uint64 Num) const
+	{
+		if (SegmentOffset < static_cast<uint64>(Segment.Prefix.Num()))
+		{
+			const uint64 PrefixBytes = FMath::Min<uint64>(Num, Segment.Prefix.Num() - SegmentOffset);
+			FMemory::Memcpy(Destination, Segment.Prefix.GetData() + SegmentOffset, PrefixBytes);
+			Destination += PrefixBytes;
+			SegmentOffset += PrefixBytes;
+			Num -= PrefixBytes;
+		}
+		if (Num == 0)
+		{
+			return;
+		}
+		const uint64 FileOffset = Segment.Start + SegmentOffset - Segment.Prefix.Num();
+		if (Settings.Data)
+		{
+			FMemory::Memcpy(Destination, Settings.Data->GetData() + FileOffset, Num);
+		}
+		else
+		{
+			FChunkStreamMemoryTransport::FillSynthetic(Destination, FileOffset, Num);
+		}
+	}
+
+	void ReportProgress(uint64 Received)
+	{
+		BytesReceived = Received;
+		// one update in flight at a time, it reads the latest count
+		if (!ProgressDelegate.IsBound() || bProgressQueued.exchange(true))
+		{
+			return;
+		}
+		TSharedRef<FChunkStreamMemoryRequest, ESPMode::ThreadSafe> This = StaticCastSharedRef<FChunkStreamMemoryRequest>(AsShared());
+		AsyncTask(ENamedThreads::GameThread, [This]()
+		{
+			This->bProgressQueued = false;
+			This->ProgressDelegate.ExecuteIfBound(This->BytesReceived.load());
+		});
+	}
+
+	void Complete(const FChunkStreamResponsePtr& Response, bool bSucceeded)
+	{
+		TSharedRef<FChunkStreamMemoryRequest, ESPMode::ThreadSafe> This = StaticCastSharedRef<FChunkStreamMemoryRequest>(AsShared());
+		AsyncTask(ENamedThreads::GameThread, [This, Response, bSucceeded]()
+		{
+			This->CompleteDelegate.ExecuteIfBound(Response, bSucceeded);
+		});
+	}
+
+	TSharedRef<FChunkStreamMemoryTransport, ESPMode::ThreadSafe> Server;
+	FString Verb = TEXT("GET");
+	FString URL;
+	TMap<FString, FString> RequestHeaders;
+	float TimeoutSeconds = 0.f;
+	double StartTime = 0.0;
+	bool bStarted = false;
+	std::atomic<bool> bCanceled{false};
+	std::atomic<uint64> BytesReceived{0};
+	std::atomic<bool> bProgressQueued{false};
+};
+
+void FChunkStreamMemoryTransport::AddFile(const FString& URL, const FChunkStreamMemoryFileSettings& Settings)
+{
+	FScopeLock Lock(&FilesLock);
+	Files.FindOrAdd(URL).Settings = Settings;
+}
+
+void FChunkStreamMemoryTransport::RemoveFile(const FString& URL)
+{
+	FScopeLock Lock(&FilesLock);
+	Files.Remove(URL);
+}
+
+int32 FChunkStreamMemoryTransport::GetRequestCount(const FString& URL) const
+{
+	FScopeLock Lock(&FilesLock);
+	const FServedFile* File = Files.Find(URL);
+	return File ? File->RequestCount : 0;
+}
+
+TArray<FString> FChunkStreamMemoryTransport::GetRangeHeaders(const FString& URL) const
+{
+	FScopeLock Lock(&FilesLock);
+	const FServedFile* File = Files.Find(URL);
+	return File ? File->RangeHeaders : TArray<FString>();
+}
+
+bool FChunkStreamMemoryTransport::BeginRequest(const FString& URL, const FString& RangeHeader, FChunkStreamMemoryFileSettings& OutSettings, int32& OutRequestNumber)
+{
+	FScopeLock Lock(&FilesLock);
+	FServedFile* File = Files.Find(URL);
+	if (!File)
+	{
+		return false;
+	}
+	OutSettings = File->Settings;
+	OutRequestNumber = ++File->RequestCount;
+	File->RangeHeaders.Add(RangeHeader);
+	return true;
+}
+
+static uint64 GetSyntheticWord(uint64 WordIndex)
+{
+	// splitmix64 finalizer, cheap and without visible patterns
+	uint64 X = WordIndex + 0x9E3779B97F4A7C15ull;
+	X = (X ^ (X >> 30)) * 0xBF58476D1CE4E5B9ull;
+	X = (X ^ (X >> 27)) * 0x94D049BB133111EBull;
+	return X ^ (X >> 31);
+}
+
+uint8 FChunkStreamMemoryTransport::GetSyntheticByte(uint64 Offset)
+{
+	return static_cast<uint8>(GetSyntheticWord(Offset / 8) >> ((Offset % 8) * 8));
+}
+
+void FChunkStreamMemoryTransport::FillSynthetic(uint8* Destination, uint64 Offset, uint64 Num)
+{
+	// bytes up to a word boundary, whole words, then the tail
+	while (Num > 0 && Offset % 8 != 0)
+	{
+		*Destination++ = GetSyntheticByte(Offset++);
+		Num--;
+	}
+	for (; Num >= 8; Num -= 8, Offset += 8, Destination += 8)
+	{
+		const uint64 Word = INTEL_ORDER64(GetSyntheticWord(Offset / 8));
+		FMemory::Memcpy(Destination, &Word, 8);
+	}
+	while (Num > 0)
+	{
+		*Destination++ = GetSyntheticByte(Offset++);
+		Num--;
+	}
+}
+
+FChunkStreamRequestRef FChunkStreamMemoryTransport::CreateRequest()
+{
+	return MakeShared<FChunkStreamMemoryRequest, ESPMode::ThreadSafe>(AsShared());
+}
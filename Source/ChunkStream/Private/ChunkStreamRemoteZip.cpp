@@ -0,0 +1,448 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+
+#include "ChunkStreamRemoteZip.h"
+#include "ChunkStreamDownloader.h"
+#include "ChunkStreamLogs.h"
+#include "Algo/BinarySearch.h"
+#include "Async/Async.h"
+
+// Enough of the end of the archive for the end of central directory record with a maximum length comment and the zip64 records
+static constexpr uint64 TailFetchSize = 64 * 1024 + ChunkStreamZip::EndOfCentralDirectorySize
+	+ ChunkStreamZip::Zip64EndOfCentralDirectoryLocatorSize + ChunkStreamZip::Zip64EndOfCentralDirectorySize;
+
+FChunkStreamRemoteZip::FChunkStreamRemoteZip(const FString& InURL)
+	: URL(InURL)
+{
+}
+
+FChunkStreamRemoteZip::~FChunkStreamRemoteZip()
+{
+	if (Downloader)
+	{
+		Downloader->Shutdown();
+	}
+}
+
+const ChunkStreamZip::FEntry* FChunkStreamRemoteZip::FindEntry(const FString& Name) const
+{
+	return Entries.FindByPredicate([&Name](const ChunkStreamZip::FEntry& Entry) { return Entry.Name == Name; });
+}
+
+void FChunkStreamRemoteZip::ReadCentralDirectory(const FOnRemoteZipDirectoryRead& OnComplete)
+{
+	check(IsInGameThread());
+	if (bDirectoryRead)
+	{
+		OnComplete.ExecuteIfBound(true);
+		return;
+	}
+	DirectoryReadDelegates.Add(OnComplete);
+	if (bReadingDirectory)
+	{
+		return;
+	}
+	bReadingDirectory = true;
+	
+	SizeRequest = MakeShared<FStreamChunkDownloader>(URL, FString());
+	TWeakPtr<FChunkStreamRemoteZip> WeakThis = AsShared();
+	SizeRequest->RequestDownloadTotalSize(URL, 0.f)
+		.Next([WeakThis](const FChunkStreamResponsePtr& Response)
+		{
+			AsyncTask(ENamedThreads::GameThread, [WeakThis, Response]()
+			{
+				if (TSharedPtr<FChunkStreamRemoteZip> RemoteZip = WeakThis.Pin())
+				{
+					RemoteZip->OnSizeReceived(Response);
+				}
+			});
+		});
+}
+
+void FChunkStreamRemoteZip::OnSizeReceived(const FChunkStreamResponsePtr& Response)
+{
+	SizeRequest.Reset();
+	if (!bReadingDirectory)
+	{
+		// canceled
+		return;
+	}
+	if (!Response || !FStreamChunkDownloader::IsSuccessStatusCode(Response->GetResponseCode()))
+	{
+		FinishDirectoryRead(false, FString::Printf(TEXT("HEAD request failed (status %d)"), Response ? Response->GetResponseCode() : 0));
+		return;
+	}
+	ArchiveSize = FStreamChunkDownloader::GetFileSizeFromRequest(Response, true);
+	bAcceptsRanges = FStreamChunkDownloader::DoesApiAcceptRanges(Response, true);
+	if (ArchiveSize < ChunkStreamZip::EndOfCentralDirectorySize)
+	{
+		FinishDirectoryRead(false, TEXT("Server didn't report a usable archive size"));
+		return;
+	}
+	
+	const uint64 TailSize = FMath::Min(ArchiveSize, TailFetchSize);
+	FetchRange(StreamChunkDownloader::FByteRange(ArchiveSize - TailSize, ArchiveSize - 1), [this](bool bSuccess)
+	{
+		if (bSuccess)
+		{
+			OnTailFetched();
+		}
+		else
+		{
+			FinishDirectoryRead(false, TEXT("Failed to download the end of the archive"));
+		}
+	});
+}
+
+void FChunkStreamRemoteZip::OnTailFetched()
+{
+	ChunkStreamZip::FCentralDirectoryLocation Location;
+	if (!ChunkStreamZip::FindCentralDirectory(FetchBuffer.GetData(), FetchBuffer.Num(), FetchBufferStart, Location))
+	{
+		FinishDirectoryRead(false, TEXT("No end of central directory record, not a zip archive"));
+		return;
+	}
+	if (Location.Offset + Location.Size > ArchiveSize)
+	{
+		FinishDirectoryRead(false, TEXT("Central directory is outside the archive"));
+		return;
+	}
+	
+	if (Location.Offset >= FetchBufferStart)
+	{
+		// small directory, already in the tail
+		const bool bParsed = ParseDirectory(FetchBuffer.GetData() + (Location.Offset - FetchBufferStart), Location.Size, Location);
+		FinishDirectoryRead(bParsed, TEXT("Central directory is invalid"));
+		return;
+	}
+	
+	FetchRange(StreamChunkDownloader::FByteRange(Location.Offset, Location.Offset + Location.Size - 1), [this, Location](bool bSuccess)
+	{
+		const bool bParsed = bSuccess && ParseDirectory(FetchBuffer.GetData(), FetchBuffer.Num(), Location);
+		FinishDirectoryRead(bParsed, bSuccess ? TEXT("Central directory is invalid") : TEXT("Failed to download the central directory"));
+	});
+}
+
+bool FChunkStreamRemoteZip::ParseDirectory(const uint8* Data, uint64 Num, const ChunkStreamZip::FCentralDirectoryLocation& Location)
+{
+	TArray<ChunkStreamZip::FEntry> Parsed;
+	uint64 Consumed = 0;
+	if (!ChunkStreamZip::ParseCentralDirectory(Data, Num, Parsed, Consumed)
+		|| Consumed != Num || static_cast<uint64>(Parsed.Num()) != Location.NumEntries)
+	{
+		return false;
+	}
+	// entries are looked up by name, a second one with the same name would be unreachable or overwrite the first
+	TSet<FString> Names;
+	for (const ChunkStreamZip::FEntry& Entry : Parsed)
+	{
+		bool bDuplicate = false;
+		Names.Add(Entry.Name, &bDuplicate);
+		if (bDuplicate)
+		{
+			LOG_WARN("'%s' is in the central directory of '%s' more than once", *Entry.Name, *URL);
+			return false;
+		}
+	}
+	Entries = MoveTemp(Parsed);
+	CentralDirectoryOffset = Location.Offset;
+	return true;
+}
+
+void FChunkStreamRemoteZip::FinishDirectoryRead(bool bSuccess, const FString& Error)
+{
+	FetchBuffer.Empty();
+	bReadingDirectory = false;
+	bDirectoryRead = bSuccess;
+	if (bSuccess)
+	{
+		LOG("Read central directory of '%s', %d entries in %llu bytes", *URL, Entries.Num(), ArchiveSize);
+	}
+	else
+	{
+		LOG_ERROR("Failed to read the central directory of '%s': %s", *URL, *Error);
+	}
+	
+	TArray<FOnRemoteZipDirectoryRead> Delegates = MoveTemp(DirectoryReadDelegates);
+	for (const FOnRemoteZipDirectoryRead& Delegate : Delegates)
+	{
+		Delegate.ExecuteIfBound(bSuccess);
+	}
+}
+
+void FChunkStreamRemoteZip::FetchRange(const StreamChunkDownloader::FByteRange& Range, TFunction<void(bool)>&& OnFetched)
+{
+	{
+		FScopeLock Lock(&FetchLock);
+		FetchBuffer.SetNumZeroed(Range.Num());
+		FetchBufferStart = Range.Start;
+	}
+	
+	Downloader = MakeShared<FStreamChunkDownloader>(URL, FString());
+	Downloader->SetKnownFileInfo(ArchiveSize, bAcceptsRanges);
+	Downloader->SetRequestedRanges({ Range });
+	
+	TWeakPtr<FChunkStreamRemoteZip> WeakThis = AsShared();
+	Downloader->BeginDownload(FChunkStreamDownloaderUtils::GetMaxChunkSize(),
+		FStreamDownloadProgressSignature(),
+		FOnSingleChunkCompleteSignature::CreateSPLambda(this, [this](TUniquePtr<StreamChunkDownloader::FChunkInfo>&& Chunk)
+		{
+			FScopeLock Lock(&FetchLock);
+			const uint64 Num = Chunk->EndOffset - Chunk->StartOffset + 1;
+			if (Chunk->StartOffset >= FetchBufferStart && Chunk->StartOffset - FetchBufferStart + Num <= static_cast<uint64>(FetchBuffer.Num()))
+			{
+				FMemory::Memcpy(FetchBuffer.GetData() + (Chunk->StartOffset - FetchBufferStart), Chunk->Data.GetData(), Num);
+			}
+		}),
+		FOnDownloadCompleteSignature::CreateSPLambda(this, [WeakThis, OnFetched = MoveTemp(OnFetched)](EChunkStreamDownloadResult Result) mutable
+		{
+			AsyncTask(ENamedThreads::GameThread, [WeakThis, Result, OnFetched = MoveTemp(OnFetched)]()
+			{
+				if (TSharedPtr<FChunkStreamRemoteZip> RemoteZip = WeakThis.Pin())
+				{
+					RemoteZip->Downloader.Reset();
+					OnFetched(Result == EChunkStreamDownloadResult::Success);
+				}
+			});
+		}));
+}
+
+void FChunkStreamRemoteZip::ExtractEntries(const TArray<FString>& EntryNames, const FString& TargetDirectory,
+	const FOnDownloadCompleteSignature& OnComplete)
+{
+	check(IsInGameThread());
+	if (bExtracting)
+	{
+		LOG_WARN("'%s' is already extracting entries", *URL);
+		OnComplete.ExecuteIfBound(EChunkStreamDownloadResult::ValidationFailed);
+		return;
+	}
+	bExtracting = true;
+	RequestedNames = EntryNames;
+	ExtractDirectory = TargetDirectory;
+	ExtractCompleteDelegate = OnComplete;
+	
+	if (bDirectoryRead)
+	{
+		StartExtraction();
+		return;
+	}
+	ReadCentralDirectory(FOnRemoteZipDirectoryRead::CreateSPLambda(this, [this](bool bSuccess)
+	{
+		if (!bExtracting)
+		{
+			return;
+		}
+		if (bSuccess)
+		{
+			StartExtraction();
+		}
+		else
+		{
+			bExtracting = false;
+			ExtractCompleteDelegate.ExecuteIfBound(EChunkStreamDownloadResult::InvalidResponse);
+		}
+	}));
+}
+
+void FChunkStreamRemoteZip::StartExtraction()
+{
+	TArray<ChunkStreamZip::FEntry> Selected;
+	for (const FString& Name : RequestedNames)
+	{
+		const int32 NumBefore = Selected.Num();
+		for (const ChunkStreamZip::FEntry& Entry : Entries)
+		{
+			const bool bMatches = Name.EndsWith(TEXT("/")) ? Entry.Name.StartsWith(Name) : Entry.Name == Name;
+			if (bMatches && !Selected.ContainsByPredicate([&Entry](const ChunkStreamZip::FEntry& Other) { return Other.LocalHeaderOffset == Entry.LocalHeaderOffset; }))
+			{
+				Selected.Add(Entry);
+			}
+		}
+		if (Selected.Num() == NumBefore && !Name.EndsWith(TEXT("/")))
+		{
+			LOG_ERROR("'%s' is not in the archive '%s'", *Name, *URL);
+			FinishExtraction(EChunkStreamDownloadResult::ValidationFailed);
+			return;
+		}
+	}
+	if (Selected.Num() == 0)
+	{
+		FinishExtraction(EChunkStreamDownloadResult::Success);
+		return;
+	}
+	
+	// an entry's local header, data and descriptor run up to the next entry's header or the central directory
+	TArray<uint64> Boundaries;
+	for (const ChunkStreamZip::FEntry& Entry : Entries)
+	{
+		Boundaries.Add(Entry.LocalHeaderOffset);
+	}
+	Boundaries.Add(CentralDirectoryOffset);
+	Boundaries.Sort();
+	
+	Selected.Sort([](const ChunkStreamZip::FEntry& A, const ChunkStreamZip::FEntry& B) { return A.LocalHeaderOffset < B.LocalHeaderOffset; });
+	TArray<StreamChunkDownloader::FByteRange> Ranges;
+	uint64 TotalBytes = 0;
+	for (const ChunkStreamZip::FEntry& Entry : Selected)
+	{
+		const int32 NextIndex = Algo::UpperBound(Boundaries, Entry.LocalHeaderOffset);
+		if (!Boundaries.IsValidIndex(NextIndex) || Boundaries[NextIndex] > ArchiveSize)
+		{
+			LOG_ERROR("Entry '%s' has an invalid offset in '%s'", *Entry.Name, *URL);
+			FinishExtraction(EChunkStreamDownloadResult::ValidationFailed);
+			return;
+		}
+		Ranges.Emplace(Entry.LocalHeaderOffset, Boundaries[NextIndex] - 1);
+		TotalBytes += Boundaries[NextIndex] - Entry.LocalHeaderOffset;
+	}
+	LOG("Downloading %d of %d entries from '%s', %llu of %llu bytes", Selected.Num(), Entries.Num(), *URL, TotalBytes, ArchiveSize);
+	
+	Extractor = MakeUnique<FChunkStreamZipExtractor>(ExtractDirectory);
+	Extractor->SetExpectedEntries(Selected);
+	{
+		FScopeLock Lock(&QueueLock);
+		PendingChunks.Reset();
+		bDraining = false;
+		bExtractDownloadDone = false;
+		ExtractDownloadResult = EChunkStreamDownloadResult::InProgress;
+	}
+	
+	// selected entries read back to back form a stream of local entries the extractor can consume
+	Downloader = MakeShared<FStreamChunkDownloader>(URL, FString());
+	Downloader->SetKnownFileInfo(ArchiveSize, bAcceptsRanges);
+	Downloader->SetRequestedRanges(Ranges);
+	Downloader->BeginDownload(FChunkStreamDownloaderUtils::GetMaxChunkSize(),
+		FStreamDownloadProgressSignature(),
+		FOnSingleChunkCompleteSignature::CreateSP(this, &FChunkStreamRemoteZip::OnExtractChunk),
+		FOnDownloadCompleteSignature::CreateSP(this, &FChunkStreamRemoteZip::EndExtractionDownload));
+}
+
+void FChunkStreamRemoteZip::OnExtractChunk(TUniquePtr<StreamChunkDownloader::FChunkInfo>&& Chunk)
+{
+	FScopeLock Lock(&QueueLock);
+	if (bExtractDownloadDone)
+	{
+		return;
+	}
+	PendingChunks.Add(MoveTemp(Chunk));
+	if (!bDraining)
+	{
+		bDraining = true;
+		Async(EAsyncExecution::ThreadPool, [This = AsShared()]() { This->DrainExtractChunks(); });
+	}
+}
+
+void FChunkStreamRemoteZip::EndExtractionDownload(EChunkStreamDownloadResult Result)
+{
+	FScopeLock Lock(&QueueLock);
+	if (bExtractDownloadDone)
+	{
+		return;
+	}
+	bExtractDownloadDone = true;
+	ExtractDownloadResult = Result;
+	if (!bDraining)
+	{
+		bDraining = true;
+		Async(EAsyncExecution::ThreadPool, [This = AsShared()]() { This->DrainExtractChunks(); });
+	}
+}
+
+void FChunkStreamRemoteZip::DrainExtractChunks()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FChunkStreamRemoteZip::DrainExtractChunks)
+	bool bFailed = false;
+	for (;;)
+	{
+		TUniquePtr<StreamChunkDownloader::FChunkInfo> Chunk;
+		{
+			FScopeLock Lock(&QueueLock);
+			if (PendingChunks.Num() == 0)
+			{
+				if (!bExtractDownloadDone)
+				{
+					bDraining = false;
+					return;
+				}
+				break;
+			}
+			Chunk = MoveTemp(PendingChunks[0]);
+			PendingChunks.RemoveAt(0);
+		}
+		
+		if (!bFailed && !Extractor->Process(Chunk->Data.GetData(), Chunk->EndOffset - Chunk->StartOffset + 1))
+		{
+			LOG_ERROR("Failed to extract from '%s': %s", *URL, *Extractor->GetError());
+			bFailed = true;
+			TWeakPtr<FChunkStreamRemoteZip> WeakThis = AsShared();
+			AsyncTask(ENamedThreads::GameThread, [WeakThis]()
+			{
+				TSharedPtr<FChunkStreamRemoteZip> RemoteZip = WeakThis.Pin();
+				if (RemoteZip && RemoteZip->Downloader)
+				{
+					RemoteZip->Downloader->Shutdown();
+				}
+			});
+			FScopeLock Lock(&QueueLock);
+			if (!bExtractDownloadDone)
+			{
+				bExtractDownloadDone = true;
+				ExtractDownloadResult = EChunkStreamDownloadResult::InvalidResponse;
+			}
+		}
+	}
+	
+	EChunkStreamDownloadResult Result = ExtractDownloadResult;
+	if (Result == EChunkStreamDownloadResult::Success && !Extractor->Finish())
+	{
+		LOG_ERROR("Extraction from '%s' failed validation: %s", *URL, *Extractor->GetError());
+		Result = EChunkStreamDownloadResult::ValidationFailed;
+	}
+	if (Result != EChunkStreamDownloadResult::Success)
+	{
+		Extractor->Abort();
+	}
+	
+	TWeakPtr<FChunkStreamRemoteZip> WeakThis = AsShared();
+	AsyncTask(ENamedThreads::GameThread, [WeakThis, Result]()
+	{
+		if (TSharedPtr<FChunkStreamRemoteZip> RemoteZip = WeakThis.Pin())
+		{
+			RemoteZip->FinishExtraction(Result);
+		}
+	});
+}
+
+void FChunkStreamRemoteZip::FinishExtraction(EChunkStreamDownloadResult Result)
+{
+	Downloader.Reset();
+	Extractor.Reset();
+	{
+		FScopeLock Lock(&QueueLock);
+		PendingChunks.Reset();
+		bDraining = false;
+	}
+	bExtracting = false;
+	ExtractCompleteDelegate.ExecuteIfBound(Result);
+}
+
+void FChunkStreamRemoteZip::Cancel()
+{
+	check(IsInGameThread());
+	if (Downloader)
+	{
+		Downloader->Shutdown();
+	}
+	if (bReadingDirectory)
+	{
+		SizeRequest.Reset();
+		Downloader.Reset();
+		FinishDirectoryRead(false, TEXT("Canceled"));
+	}
+	if (bExtracting && Extractor)
+	{
+		// the worker aborts the extractor and completes with UserCancelled
+		EndExtractionDownload(EChunkStreamDownloadResult::UserCancelled);
+	}
+}
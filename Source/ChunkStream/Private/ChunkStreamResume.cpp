@@ -0,0 +1,441 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#include "ChunkStreamResume.h"
+#include "ChunkStreamLogs.h"
+#include "Async/Async.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+TAutoConsoleVariable<int32> CVarTempMaxAgeHours(
+	TEXT("ChunkStream.TempMaxAgeHours"),
+	168,
+	TEXT("Partial downloads left by earlier runs are deleted at startup once they haven't been written for this many hours. Default: 168 (a week)"),
+	ECVF_Default);
+
+TAutoConsoleVariable<int32> CVarTempMaxSizeMB(
+	TEXT("ChunkStream.TempMaxSizeMB"),
+	4096,
+	TEXT("Most storage in MB partial downloads left by earlier runs may keep, the oldest are deleted at startup until they fit. Default: 4096"),
+	ECVF_Default);
+
+uint64 FChunkStreamResumeData::GetWrittenBytes() const
+{
+	uint64 Bytes = 0;
+	for (const StreamChunkDownloader::FByteRange& Range : WrittenRanges)
+	{
+		Bytes += Range.Num();
+	}
+	return Bytes;
+}
+
+bool FChunkStreamResumeData::Save(const FString& TempPath)
+{
+	UpdatedTime = FDateTime::UtcNow();
+	// a save cut short by a crash loses ranges from the end, it never claims bytes that weren't written
+	FString Text = FString::Printf(TEXT("Size=%llu\nUpdated=%lld\nETag=%s\nLastModified=%s\nURL=%s\n"),
+		TotalFileSize, UpdatedTime.GetTicks(), *ETag, *LastModified, *URL);
+	for (const StreamChunkDownloader::FByteRange& Range : WrittenRanges)
+	{
+		Text += FString::Printf(TEXT("Range=%llu-%llu\n"), Range.Start, Range.End);
+	}
+	return FFileHelper::SaveStringToFile(Text, *GetMetaPath(TempPath), FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM);
+}
+
+bool FChunkStreamResumeData::Load(const FString& TempPath, FChunkStreamResumeData& OutData)
+{
+	FString Text;
+	if (!FFileHelper::LoadFileToString(Text, *GetMetaPath(TempPath)))
+	{
+		return false;
+	}
+	OutData = FChunkStreamResumeData();
+	TArray<FString> Lines;
+	Text.ParseIntoArrayLines(Lines);
+	for (const FString& Line : Lines)
+	{
+		FString Key, Value;
+		if (!Line.Split(TEXT("="), &Key, &Value))
+		{
+			return false;
+		}
+		if (Key == TEXT("Size"))
+		{
+			OutData.TotalFileSize = FCString::Strtoui64(*Value, nullptr, 10);
+		}
+		else if (Key == TEXT("Updated"))
+		{
+			OutData.UpdatedTime = FDateTime(FCString::Atoi64(*Value));
+		}
+		else if (Key == TEXT("ETag"))
+		{
+			OutData.ETag = Value;
+		}
+		else if (Key == TEXT("LastModified"))
+		{
+			OutData.LastModified = Value;
+		}
+		else if (Key == TEXT("URL"))
+		{
+			OutData.URL = Value;
+		}
+		else if (Key == TEXT("Range"))
+		{
+			FString Start, End;
+			const bool bParsed = Value.Split(TEXT("-"), &Start, &End) && Start.IsNumeric() && End.IsNumeric();
+			const StreamChunkDownloader::FByteRange Range(FCString::Strtoui64(*Start, nullptr, 10), FCString::Strtoui64(*End, nullptr, 10));
+			if (!bParsed || Range.End < Range.Start)
+			{
+				// torn by a crash, the ranges before it still hold
+				break;
+			}
+			if (Range.End >= OutData.TotalFileSize)
+			{
+				return false;
+			}
+			StreamChunkDownloader::FByteRange::AddMerged(OutData.WrittenRanges, Range);
+		}
+	}
+	return !OutData.URL.IsEmpty() && OutData.TotalFileSize > 0 && (!OutData.ETag.IsEmpty() || !OutData.LastModified.IsEmpty());
+}
+
+bool FChunkStreamResumeData::Delete(const FString& TempPath)
+{
+	const FString MetaPath = GetMetaPath(TempPath);
+	return !IFileManager::Get().FileExists(*MetaPath) || IFileManager::Get().Delete(*MetaPath, false, true, true);
+}
+
+FChunkStreamTempFiles::~FChunkStreamTempFiles()
+{
+	WaitForSweep();
+	TArray<TFuture<void>> PendingClaims;
+	{
+		FScopeLock ScopeLock(&Lock);
+		PendingClaims = MoveTemp(Claims);
+	}
+	for (TFuture<void>& Claim : PendingClaims)
+	{
+		Claim.Wait();
+	}
+}
+
+FString FChunkStreamTempFiles::GetTempDirectory()
+{
+	return FPaths::ProjectSavedDir() / TEXT("temp");
+}
+
+FString FChunkStreamTempFiles::GetTempPathForSavePath(const FString& SavePath)
+{
+	return FPaths::GetPath(SavePath) / FString::Printf(TEXT(".%s.cstmp"), *FPaths::GetCleanFilename(SavePath));
+}
+
+bool FChunkStreamTempFiles::IsTempFileName(const FString& Filename)
+{
+	const FString CleanFilename = FPaths::GetCleanFilename(Filename);
+	return CleanFilename.Len() > 7 && CleanFilename.StartsWith(TEXT(".")) && CleanFilename.EndsWith(TEXT(".cstmp"));
+}
+
+FString FChunkStreamTempFiles::GetDirectoryListPath()
+{
+	return FPaths::ProjectSavedDir() / TEXT("ChunkStream") / TEXT("TempDirectories.txt");
+}
+
+void FChunkStreamTempFiles::SaveDirectories() const
+{
+	if (!FFileHelper::SaveStringArrayToFile(Directories.Array(), *GetDirectoryListPath()))
+	{
+		LOG_WARN("Failed to save temp directory list '%s'", *GetDirectoryListPath());
+	}
+}
+
+void FChunkStreamTempFiles::StartSweep()
+{
+	if (SweepFuture.IsValid() && !SweepFuture.IsReady())
+	{
+		return;
+	}
+	bSweepComplete = false;
+	// boot doesn't wait on the disk, downloads started meanwhile only resume from their own temp path
+	SweepFuture = Async(EAsyncExecution::ThreadPool, [this]()
+	{
+		Sweep();
+		bSweepComplete = true;
+	});
+}
+
+void FChunkStreamTempFiles::WaitForSweep()
+{
+	if (SweepFuture.IsValid())
+	{
+		SweepFuture.Wait();
+	}
+}
+
+void FChunkStreamTempFiles::Acquire(const FString& TempPath)
+{
+	const FString FullTempPath = FPaths::ConvertRelativePathToFull(TempPath);
+	const FString Directory = FPaths::GetPath(FullTempPath);
+	FScopeLock ScopeLock(&Lock);
+	InUse.Add(FullTempPath);
+	// recorded before anything is written there, so a crash can't leave a temp file no sweep looks for
+	if (!FPaths::IsSamePath(Directory, FPaths::ConvertRelativePathToFull(GetTempDirectory())) && !Directories.Contains(Directory))
+	{
+		Directories.Add(Directory);
+		SaveDirectories();
+	}
+}
+
+void FChunkStreamTempFiles::Release(const FString& TempPath)
+{
+	FScopeLock ScopeLock(&Lock);
+	InUse.Remove(FPaths::ConvertRelativePathToFull(TempPath));
+}
+
+bool FChunkStreamTempFiles::ClaimResumable(const FString& URL, const FString& TempPath, FChunkStreamResumeData& OutData)
+{
+	const FString FullTempPath = FPaths::ConvertRelativePathToFull(TempPath);
+	IFileManager& FileManager = IFileManager::Get();
+	// the metadata can't claim bytes past the end of the file
+	auto IsResumable = [&FileManager, &URL](const FString& Path, FChunkStreamResumeData& Data)
+	{
+		return FChunkStreamResumeData::Load(Path, Data) && Data.URL == URL && Data.WrittenRanges.Num() > 0
+			&& static_cast<int64>(Data.WrittenRanges.Last().End) < FileManager.FileSize(*Path);
+	};
+	FString FoundPath;
+	{
+		FScopeLock ScopeLock(&Lock);
+		// a crash left this download's own temp file
+		if (IsResumable(FullTempPath, OutData))
+		{
+			ResumableByURL.Remove(URL);
+			return true;
+		}
+		
+		const FString* Found = ResumableByURL.Find(URL);
+		if (!Found || InUse.Contains(*Found))
+		{
+			return false;
+		}
+		FoundPath = *Found;
+		ResumableByURL.Remove(URL);
+		// the move can take a while, nothing else touches the file meanwhile
+		InUse.Add(FoundPath);
+	}
+	
+	bool bClaimed = IsResumable(FoundPath, OutData);
+	if (bClaimed)
+	{
+		// left by a download saving somewhere else, it carries on under this download's temp path
+		FChunkStreamResumeData::Delete(FullTempPath);
+		bClaimed = FileManager.Move(*FullTempPath, *FoundPath, true, true) && FileManager.Move(*FChunkStreamResumeData::GetMetaPath(FullTempPath),
+			*FChunkStreamResumeData::GetMetaPath(FoundPath), true, true);
+		if (bClaimed)
+		{
+			LOG("Resuming '%s' from partial download '%s'", *URL, *FoundPath);
+		}
+		else
+		{
+			LOG_WARN("Failed to move partial download '%s' to '%s'", *FoundPath, *FullTempPath);
+			FileManager.Delete(*FoundPath, false, true, true);
+			FChunkStreamResumeData::Delete(FoundPath);
+		}
+	}
+	FScopeLock ScopeLock(&Lock);
+	InUse.Remove(FoundPath);
+	return bClaimed;
+}
+
+void FChunkStreamTempFiles::ClaimResumableAsync(const FString& URL, const FString& TempPath, TFunction<void(bool, FChunkStreamResumeData&&)>&& OnClaimed)
+{
+	FScopeLock ScopeLock(&Lock);
+	Claims.RemoveAll([](const TFuture<void>& Claim) { return Claim.IsReady(); });
+	Claims.Add(Async(EAsyncExecution::ThreadPool, [this, URL, TempPath, OnClaimed = MoveTemp(OnClaimed)]() mutable
+	{
+		TRACE_CPUPROFILER_EVENT_SCOPE(FChunkStreamTempFiles::ClaimResumable)
+		TSharedRef<FChunkStreamResumeData, ESPMode::ThreadSafe> Data = MakeShared<FChunkStreamResumeData, ESPMode::ThreadSafe>();
+		const bool bClaimed = ClaimResumable(URL, TempPath, *Data);
+		AsyncTask(ENamedThreads::GameThread, [bClaimed, Data, OnClaimed = MoveTemp(OnClaimed)]()
+		{
+			OnClaimed(bClaimed, MoveTemp(*Data));
+		});
+	}));
+}
+
+int32 FChunkStreamTempFiles::GetNumResumable() const
+{
+	FScopeLock ScopeLock(&Lock);
+	return ResumableByURL.Num();
+}
+
+void FChunkStreamTempFiles::Sweep()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FChunkStreamTempFiles::Sweep)
+	const FString TempDirectory = FPaths::ConvertRelativePathToFull(GetTempDirectory());
+	IFileManager& FileManager = IFileManager::Get();
+	TArray<FString> SweptDirectories;
+	{
+		TArray<FString> Listed;
+		FFileHelper::LoadFileToStringArray(Listed, *GetDirectoryListPath());
+		FScopeLock ScopeLock(&Lock);
+		for (const FString& Directory : Listed)
+		{
+			if (!Directory.IsEmpty())
+			{
+				Directories.Add(Directory);
+			}
+		}
+		SweptDirectories = Directories.Array();
+	}
+	
+	struct FTempFile
+	{
+		FString Path;
+		FChunkStreamResumeData Data;
+		uint64 SizeOnDisk = 0;
+		FDateTime LastWrite;
+	};
+	TArray<FString> MetaPaths;
+	TMap<FString, FFileStatData> DataFiles;
+	// everything in the temp directory is ours, next to save paths only the hidden temp files are
+	auto Collect = [&MetaPaths, &DataFiles](const TCHAR* Path, const FFileStatData& StatData, bool bOnlyTempFiles)
+	{
+		if (!StatData.bIsDirectory)
+		{
+			if (FStringView(Path).EndsWith(TEXT(".csmeta")))
+			{
+				if (!bOnlyTempFiles || IsTempFileName(FString(Path).LeftChop(FStringView(TEXT(".csmeta")).Len())))
+				{
+					MetaPaths.Add(Path);
+				}
+			}
+			else if (!bOnlyTempFiles || IsTempFileName(Path))
+			{
+				DataFiles.Add(Path, StatData);
+			}
+		}
+		return true;
+	};
+	if (FileManager.DirectoryExists(*TempDirectory))
+	{
+		FileManager.IterateDirectoryStat(*TempDirectory, [&Collect](const TCHAR* Path, const FFileStatData& StatData)
+		{
+			return Collect(Path, StatData, false);
+		});
+	}
+	for (const FString& Directory : SweptDirectories)
+	{
+		if (FileManager.DirectoryExists(*Directory))
+		{
+			FileManager.IterateDirectoryStat(*Directory, [&Collect](const TCHAR* Path, const FFileStatData& StatData)
+			{
+				return Collect(Path, StatData, true);
+			});
+		}
+	}
+	
+	const FDateTime Now = FDateTime::UtcNow();
+	const FTimespan MaxAge = FTimespan::FromHours(FMath::Max(CVarTempMaxAgeHours.GetValueOnAnyThread(), 0));
+	const uint64 MaxBytes = static_cast<uint64>(FMath::Max(CVarTempMaxSizeMB.GetValueOnAnyThread(), 0)) * 1024 * 1024;
+	int32 NumDeleted = 0;
+	uint64 BytesDeleted = 0;
+	// skipped if a download has taken it since the sweep started
+	auto DeleteTempFile = [this, &FileManager, &NumDeleted, &BytesDeleted](const FString& Path, uint64 Size)
+	{
+		FScopeLock ScopeLock(&Lock);
+		if (InUse.Contains(Path))
+		{
+			return;
+		}
+		if (FileManager.FileExists(*Path) && !FileManager.Delete(*Path, false, true, true))
+		{
+			LOG_WARN("Failed to delete stale temp file '%s'", *Path);
+			return;
+		}
+		FChunkStreamResumeData::Delete(Path);
+		NumDeleted++;
+		BytesDeleted += Size;
+	};
+	
+	for (const FString& MetaPath : MetaPaths)
+	{
+		const FString DataPath = MetaPath.LeftChop(FStringView(TEXT(".csmeta")).Len());
+		if (!DataFiles.Contains(DataPath))
+		{
+			DeleteTempFile(DataPath, 0);
+		}
+	}
+	
+	TArray<FTempFile> Resumable;
+	for (const TPair<FString, FFileStatData>& DataFile : DataFiles)
+	{
+		FTempFile TempFile;
+		TempFile.Path = DataFile.Key;
+		TempFile.SizeOnDisk = static_cast<uint64>(FMath::Max<int64>(DataFile.Value.FileSize, 0));
+		TempFile.LastWrite = DataFile.Value.ModificationTime;
+		// without metadata, or claiming bytes past the end of the file, there is nothing to trust in it
+		const bool bValid = FChunkStreamResumeData::Load(TempFile.Path, TempFile.Data) && TempFile.Data.WrittenRanges.Num() > 0
+			&& TempFile.Data.WrittenRanges.Last().End < TempFile.SizeOnDisk;
+		if (bValid)
+		{
+			TempFile.LastWrite = FMath::Max(TempFile.LastWrite, TempFile.Data.UpdatedTime);
+		}
+		if (!bValid || Now - TempFile.LastWrite > MaxAge)
+		{
+			DeleteTempFile(TempFile.Path, TempFile.SizeOnDisk);
+			continue;
+		}
+		Resumable.Add(MoveTemp(TempFile));
+	}
+	
+	// newest first, older copies of a URL and whatever doesn't fit the budget go
+	Resumable.Sort([](const FTempFile& A, const FTempFile& B) { return A.LastWrite > B.LastWrite; });
+	TMap<FString, FString> Index;
+	uint64 KeptBytes = 0;
+	for (const FTempFile& TempFile : Resumable)
+	{
+		if (Index.Contains(TempFile.Data.URL) || KeptBytes + TempFile.SizeOnDisk > MaxBytes)
+		{
+			DeleteTempFile(TempFile.Path, TempFile.SizeOnDisk);
+			continue;
+		}
+		KeptBytes += TempFile.SizeOnDisk;
+		Index.Add(TempFile.Data.URL, TempFile.Path);
+	}
+	
+	{
+		FScopeLock ScopeLock(&Lock);
+		for (const TPair<FString, FString>& Entry : Index)
+		{
+			if (!InUse.Contains(Entry.Value))
+			{
+				ResumableByURL.Add(Entry.Key, Entry.Value);
+			}
+		}
+		
+		// directories with nothing left to sweep are forgotten
+		TSet<FString> Used;
+		for (const TPair<FString, FString>& Entry : Index)
+		{
+			Used.Add(FPaths::GetPath(Entry.Value));
+		}
+		for (const FString& Path : InUse)
+		{
+			Used.Add(FPaths::GetPath(Path));
+		}
+		const int32 NumDirectories = Directories.Num();
+		for (TSet<FString>::TIterator It(Directories); It; ++It)
+		{
+			if (!Used.Contains(*It))
+			{
+				It.RemoveCurrent();
+			}
+		}
+		if (Directories.Num() != NumDirectories)
+		{
+			SaveDirectories();
+		}
+	}
+	LOG("Temp file sweep kept %d partial downloads (%.2f MB), deleted %d files (%.2f MB)", Index.Num(),
+		KeptBytes / (1024.0 * 1024.0), NumDeleted, BytesDeleted / (1024.0 * 1024.0));
+}
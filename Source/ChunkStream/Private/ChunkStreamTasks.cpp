@@ -0,0 +1,252 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#include "ChunkStreamTasks.h"
+#include "Async/Async.h"
+#include "Misc/ScopeLock.h"
+#include "UObject/StrongObjectPtr.h"
+#include <atomic>
+
+struct FChunkStreamCancellationToken::FState
+{
+	~FState()
+	{
+		// a child going away no longer needs to hear from its parent
+		if (TSharedPtr<FState, ESPMode::ThreadSafe> PinnedParent = Parent.Pin())
+		{
+			PinnedParent->RemoveCallback(ParentCallbackId);
+		}
+	}
+
+	void Cancel()
+	{
+		TMap<uint64, TFunction<void()>> ToCall;
+		{
+			FScopeLock ScopeLock(&Lock);
+			if (bCanceled.load())
+			{
+				return;
+			}
+			bCanceled.store(true);
+			ToCall = MoveTemp(Callbacks);
+		}
+		// outside the lock, a callback may add or remove callbacks of its own
+		for (TPair<uint64, TFunction<void()>>& Callback : ToCall)
+		{
+			Callback.Value();
+		}
+	}
+
+	uint64 AddCallback(TFunction<void()>&& Callback)
+	{
+		{
+			FScopeLock ScopeLock(&Lock);
+			if (!bCanceled.load())
+			{
+				const uint64 CallbackId = NextCallbackId++;
+				Callbacks.Add(CallbackId, MoveTemp(Callback));
+				return CallbackId;
+			}
+		}
+		Callback();
+		return 0;
+	}
+
+	void RemoveCallback(uint64 CallbackId)
+	{
+		FScopeLock ScopeLock(&Lock);
+		Callbacks.Remove(CallbackId);
+	}
+
+	FCriticalSection Lock;
+	std::atomic<bool> bCanceled{false};
+	TMap<uint64, TFunction<void()>> Callbacks;
+	uint64 NextCallbackId = 1;
+	TWeakPtr<FState, ESPMode::ThreadSafe> Parent;
+	uint64 ParentCallbackId = 0;
+};
+
+FChunkStreamCancellationToken::FChunkStreamCancellationToken()
+	: State(MakeShared<FState, ESPMode::ThreadSafe>())
+{
+}
+
+void FChunkStreamCancellationToken::Cancel() const
+{
+	State->Cancel();
+}
+
+bool FChunkStreamCancellationToken::IsCanceled() const
+{
+	return State->bCanceled.load();
+}
+
+FChunkStreamCancellationToken FChunkStreamCancellationToken::CreateChild() const
+{
+	FChunkStreamCancellationToken Child;
+	TWeakPtr<FState, ESPMode::ThreadSafe> WeakChild = Child.State;
+	Child.State->Parent = State;
+	Child.State->ParentCallbackId = State->AddCallback([WeakChild]()
+	{
+		if (TSharedPtr<FState, ESPMode::ThreadSafe> PinnedChild = WeakChild.Pin())
+		{
+			PinnedChild->Cancel();
+		}
+	});
+	return Child;
+}
+
+uint64 FChunkStreamCancellationToken::AddCallback(TFunction<void()> Callback) const
+{
+	return State->AddCallback(MoveTemp(Callback));
+}
+
+void FChunkStreamCancellationToken::RemoveCallback(uint64 CallbackId) const
+{
+	if (CallbackId != 0)
+	{
+		State->RemoveCallback(CallbackId);
+	}
+}
+
+namespace
+{
+	struct FDownloadTaskState
+	{
+		FDownloadTaskState() : Finished(UE_SOURCE_LOCATION) {}
+
+		// Triggered once with Result filled in, the download's task depends on it
+		UE::Tasks::FTaskEvent Finished;
+		FChunkStreamResult Result;
+		FChunkStreamCancellationToken CancellationToken;
+
+		// The rest is game thread only. Holds the downloader until it completes, nothing else keeps it from GC without a world
+		TStrongObjectPtr<UChunkStreamDownloader> Downloader;
+		uint64 CancelCallbackId = 0;
+		bool bReported = false;
+	};
+	using FDownloadTaskStateRef = TSharedRef<FDownloadTaskState, ESPMode::ThreadSafe>;
+	using FDownloadTaskStateWeak = TWeakPtr<FDownloadTaskState, ESPMode::ThreadSafe>;
+
+	// On the game thread, where the downloader's stats are written and where it has to be let go
+	void ReportResult(FDownloadTaskState& State, const FChunkStreamResultParams& ResultParams)
+	{
+		check(IsInGameThread());
+		if (State.bReported)
+		{
+			return;
+		}
+		State.bReported = true;
+		State.CancellationToken.RemoveCallback(State.CancelCallbackId);
+		State.CancelCallbackId = 0;
+		
+		State.Result.Result = ResultParams.DownloadTaskResult;
+		State.Result.HttpStatusCode = ResultParams.HttpStatusCode;
+		if (IsValid(ResultParams.Downloader))
+		{
+			State.Result.Stats = ResultParams.Downloader->GetStats();
+			State.Result.Stats.DownloadTaskResult = ResultParams.DownloadTaskResult;
+		}
+		State.Downloader.Reset();
+		// last, the task may let go of the state as soon as it's triggered
+		State.Finished.Trigger();
+	}
+
+	void StartDownload(const FDownloadTaskStateRef& State, const TArray<FString>& URLs)
+	{
+		check(IsInGameThread());
+		if (State->CancellationToken.IsCanceled())
+		{
+			FChunkStreamResultParams ResultParams;
+			ResultParams.DownloadTaskResult = EChunkStreamDownloadResult::UserCancelled;
+			ResultParams.HttpStatusCode = 0;
+			ReportResult(*State, ResultParams);
+			return;
+		}
+
+		// the callbacks hold the state weakly, the download's task holds it until the result is in
+		const FDownloadTaskStateWeak WeakState = State;
+		UChunkStreamDownloader* Downloader = UChunkStreamDownloader::DownloadFileToStorageFromMirrors(nullptr, URLs, State->Result.SavePath);
+		State->Downloader.Reset(Downloader);
+		Downloader->Native_DownloadFinished.AddLambda([WeakState](FChunkStreamResultParams ResultParams)
+		{
+			if (TSharedPtr<FDownloadTaskState, ESPMode::ThreadSafe> PinnedState = WeakState.Pin())
+			{
+				ReportResult(*PinnedState, ResultParams);
+			}
+		});
+
+		// before Activate, a download that fails straight away reports with the callback already in place to remove
+		State->CancelCallbackId = State->CancellationToken.AddCallback([WeakState]()
+		{
+			auto CancelDownloader = [WeakState]()
+			{
+				TSharedPtr<FDownloadTaskState, ESPMode::ThreadSafe> PinnedState = WeakState.Pin();
+				if (PinnedState && PinnedState->Downloader.IsValid() && !PinnedState->Downloader->IsComplete())
+				{
+					PinnedState->Downloader->CancelDownload();
+				}
+			};
+			if (IsInGameThread())
+			{
+				CancelDownloader();
+			}
+			else
+			{
+				AsyncTask(ENamedThreads::GameThread, MoveTemp(CancelDownloader));
+			}
+		});
+		if (!State->bReported)
+		{
+			// not canceled in the meantime
+			Downloader->Activate();
+		}
+	}
+}
+
+UE::Tasks::TTask<FChunkStreamResult> ChunkStreamTasks::DownloadFile(const FString& URL, const FString& SavePath,
+	const FChunkStreamCancellationToken& CancellationToken)
+{
+	return DownloadFileFromMirrors({ URL }, SavePath, CancellationToken);
+}
+
+UE::Tasks::TTask<FChunkStreamResult> ChunkStreamTasks::DownloadFileFromMirrors(const TArray<FString>& URLs, const FString& SavePath,
+	const FChunkStreamCancellationToken& CancellationToken)
+{
+	FDownloadTaskStateRef State = MakeShared<FDownloadTaskState, ESPMode::ThreadSafe>();
+	State->Result.URL = URLs.Num() > 0 ? URLs[0] : FString();
+	State->Result.SavePath = SavePath;
+	State->CancellationToken = CancellationToken;
+
+	// runs inline on the game thread as Finished is triggered, continuations of the download then go to workers
+	UE::Tasks::TTask<FChunkStreamResult> Task = UE::Tasks::Launch(UE_SOURCE_LOCATION, [State]()
+	{
+		return State->Result;
+	}, UE::Tasks::Prerequisites(State->Finished), UE::Tasks::ETaskPriority::Normal, UE::Tasks::EExtendedTaskPriority::Inline);
+
+	if (IsInGameThread())
+	{
+		StartDownload(State, URLs);
+	}
+	else
+	{
+		AsyncTask(ENamedThreads::GameThread, [State, URLs]()
+		{
+			StartDownload(State, URLs);
+		});
+	}
+	return Task;
+}
+
+UE::Tasks::TTask<TArray<FChunkStreamResult>> ChunkStreamTasks::WhenAll(const TArray<UE::Tasks::TTask<FChunkStreamResult>>& Downloads)
+{
+	return UE::Tasks::Launch(UE_SOURCE_LOCATION, [Downloads]() mutable
+	{
+		TArray<FChunkStreamResult> Results;
+		Results.Reserve(Downloads.Num());
+		for (UE::Tasks::TTask<FChunkStreamResult>& Download : Downloads)
+		{
+			Results.Add(Download.GetResult());
+		}
+		return Results;
+	}, UE::Tasks::Prerequisites(Downloads));
+}
@@ -0,0 +1,179 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#include "ChunkStreamTrace.h"
+
+#if CHUNKSTREAM_TRACE_ENABLED
+#include "ProfilingDebugging/CountersTrace.h"
+#include "ProfilingDebugging/MiscTrace.h"
+#include <atomic>
+
+UE_TRACE_CHANNEL_DEFINE(ChunkStreamChannel)
+
+UE_TRACE_EVENT_BEGIN(ChunkStream, DownloadStart)
+	UE_TRACE_EVENT_FIELD(uint64, Cycle)
+	UE_TRACE_EVENT_FIELD(uint32, DownloadId)
+	UE_TRACE_EVENT_FIELD(UE::Trace::WideString, URL)
+UE_TRACE_EVENT_END()
+
+UE_TRACE_EVENT_BEGIN(ChunkStream, ChunkEvent)
+	UE_TRACE_EVENT_FIELD(uint64, Cycle)
+	UE_TRACE_EVENT_FIELD(uint32, DownloadId)
+	UE_TRACE_EVENT_FIELD(uint8, Type)
+	UE_TRACE_EVENT_FIELD(uint64, StartOffset)
+	UE_TRACE_EVENT_FIELD(uint64, Bytes)
+	UE_TRACE_EVENT_FIELD(uint32, Attempt)
+UE_TRACE_EVENT_END()
+
+TRACE_DECLARE_INT_COUNTER(ChunkStreamBytesInFlight, TEXT("ChunkStream/BytesInFlight"));
+TRACE_DECLARE_INT_COUNTER(ChunkStreamBytesBuffered, TEXT("ChunkStream/BytesBuffered"));
+TRACE_DECLARE_INT_COUNTER(ChunkStreamPendingWrites, TEXT("ChunkStream/PendingWrites"));
+TRACE_DECLARE_INT_COUNTER(ChunkStreamActiveDownloads, TEXT("ChunkStream/ActiveDownloads"));
+TRACE_DECLARE_INT_COUNTER(ChunkStreamWaitingDownloads, TEXT("ChunkStream/WaitingDownloads"));
+TRACE_DECLARE_FLOAT_COUNTER(ChunkStreamThroughput, TEXT("ChunkStream/ThroughputMBps"));
+
+namespace
+{
+	// Throughput is averaged over windows of this length
+	constexpr double ThroughputWindowSeconds = 0.5;
+
+	std::atomic<uint32> GNextDownloadId(1);
+	std::atomic<uint64> GWindowBytes(0);
+	std::atomic<uint64> GWindowStartCycles(0);
+
+	void LogChunkEvent(uint32 DownloadId, ChunkStreamTrace::EChunkEvent Type, uint64 StartOffset, uint64 Bytes, uint32 Attempt = 0)
+	{
+		UE_TRACE_LOG(ChunkStream, ChunkEvent, ChunkStreamChannel)
+			<< ChunkEvent.Cycle(FPlatformTime::Cycles64())
+			<< ChunkEvent.DownloadId(DownloadId)
+			<< ChunkEvent.Type(static_cast<uint8>(Type))
+			<< ChunkEvent.StartOffset(StartOffset)
+			<< ChunkEvent.Bytes(Bytes)
+			<< ChunkEvent.Attempt(Attempt);
+	}
+
+	// Begin and end have to name a region the same way
+	FString GetRequestRegionName(uint32 DownloadId, uint64 StartOffset, uint32 Attempt)
+	{
+		return FString::Printf(TEXT("ChunkStream %u chunk@%llu try %u"), DownloadId, StartOffset, Attempt);
+	}
+}
+
+uint32 ChunkStreamTrace::NewDownloadId()
+{
+	return GNextDownloadId.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ChunkStreamTrace::DownloadStart(uint32 DownloadId, const FString& URL)
+{
+	UE_TRACE_LOG(ChunkStream, DownloadStart, ChunkStreamChannel)
+		<< DownloadStart.Cycle(FPlatformTime::Cycles64())
+		<< DownloadStart.DownloadId(DownloadId)
+		<< DownloadStart.URL(*URL, URL.Len());
+}
+
+void ChunkStreamTrace::RequestStart(uint32 DownloadId, uint64 StartOffset, uint64 Bytes, uint32 Attempt)
+{
+	LogChunkEvent(DownloadId, EChunkEvent::RequestStart, StartOffset, Bytes, Attempt);
+	if (UE_TRACE_CHANNELEXPR_IS_ENABLED(ChunkStreamChannel))
+	{
+		TRACE_BEGIN_REGION(*GetRequestRegionName(DownloadId, StartOffset, Attempt));
+	}
+}
+
+void ChunkStreamTrace::FirstByte(uint32 DownloadId, uint64 StartOffset)
+{
+	LogChunkEvent(DownloadId, EChunkEvent::FirstByte, StartOffset, 0);
+}
+
+void ChunkStreamTrace::LastByte(uint32 DownloadId, uint64 StartOffset, uint64 Bytes)
+{
+	LogChunkEvent(DownloadId, EChunkEvent::LastByte, StartOffset, Bytes);
+}
+
+void ChunkStreamTrace::RequestEnd(uint32 DownloadId, uint64 StartOffset, uint32 Attempt, uint64 Bytes, bool bSucceeded)
+{
+	LogChunkEvent(DownloadId, EChunkEvent::RequestEnd, StartOffset, Bytes, Attempt);
+	if (UE_TRACE_CHANNELEXPR_IS_ENABLED(ChunkStreamChannel))
+	{
+		if (!bSucceeded)
+		{
+			TRACE_BOOKMARK(TEXT("ChunkStream %u chunk@%llu try %u failed after %llu bytes"), DownloadId, StartOffset, Attempt, Bytes);
+		}
+		TRACE_END_REGION(*GetRequestRegionName(DownloadId, StartOffset, Attempt));
+	}
+}
+
+void ChunkStreamTrace::HandOff(uint32 DownloadId, uint64 StartOffset, uint64 Bytes)
+{
+	LogChunkEvent(DownloadId, EChunkEvent::HandOff, StartOffset, Bytes);
+}
+
+void ChunkStreamTrace::WriteQueued(uint64 Bytes)
+{
+	TRACE_COUNTER_ADD(ChunkStreamBytesBuffered, static_cast<int64>(Bytes));
+	TRACE_COUNTER_INCREMENT(ChunkStreamPendingWrites);
+}
+
+void ChunkStreamTrace::Retry(uint32 DownloadId, uint64 StartOffset, uint32 Attempt, float DelaySeconds)
+{
+	LogChunkEvent(DownloadId, EChunkEvent::Retry, StartOffset, 0, Attempt);
+	if (UE_TRACE_CHANNELEXPR_IS_ENABLED(ChunkStreamChannel))
+	{
+		TRACE_BOOKMARK(TEXT("ChunkStream %u chunk@%llu retry %u in %.2fs"), DownloadId, StartOffset, Attempt, DelaySeconds);
+	}
+}
+
+void ChunkStreamTrace::Stall(uint32 DownloadId, uint64 StartOffset, double SecondsWithoutData)
+{
+	LogChunkEvent(DownloadId, EChunkEvent::Stall, StartOffset, 0);
+	if (UE_TRACE_CHANNELEXPR_IS_ENABLED(ChunkStreamChannel))
+	{
+		TRACE_BOOKMARK(TEXT("ChunkStream %u chunk@%llu stalled, no data for %.2fs"), DownloadId, StartOffset, SecondsWithoutData);
+	}
+}
+
+void ChunkStreamTrace::AddBytesInFlight(int64 Delta)
+{
+	TRACE_COUNTER_ADD(ChunkStreamBytesInFlight, Delta);
+}
+
+void ChunkStreamTrace::AddBytesReceived(uint64 Num)
+{
+#if COUNTERSTRACE_ENABLED
+	const uint64 Bytes = GWindowBytes.fetch_add(Num, std::memory_order_relaxed) + Num;
+	const uint64 Now = FPlatformTime::Cycles64();
+	uint64 WindowStart = GWindowStartCycles.load(std::memory_order_relaxed);
+	const double Elapsed = FPlatformTime::ToSeconds64(Now - WindowStart);
+	// one thread closes the window, the others keep adding to the next one
+	if (Elapsed >= ThroughputWindowSeconds && GWindowStartCycles.compare_exchange_strong(WindowStart, Now))
+	{
+		GWindowBytes.fetch_sub(Bytes, std::memory_order_relaxed);
+		// the first window starts at 0 cycles, it only sets the start time
+		if (WindowStart != 0)
+		{
+			TRACE_COUNTER_SET(ChunkStreamThroughput, static_cast<double>(Bytes) / (1024.0 * 1024.0) / Elapsed);
+		}
+	}
+#endif
+}
+
+void ChunkStreamTrace::SetDownloadCounts(int32 Active, int32 Waiting)
+{
+	TRACE_COUNTER_SET(ChunkStreamActiveDownloads, Active);
+	TRACE_COUNTER_SET(ChunkStreamWaitingDownloads, Waiting);
+}
+
+ChunkStreamTrace::FScopedWrite::FScopedWrite(uint32 InDownloadId, uint64 InStartOffset, uint64 InBytes)
+	: DownloadId(InDownloadId), StartOffset(InStartOffset), Bytes(InBytes)
+{
+	LogChunkEvent(DownloadId, EChunkEvent::WriteStart, StartOffset, Bytes);
+}
+
+ChunkStreamTrace::FScopedWrite::~FScopedWrite()
+{
+	LogChunkEvent(DownloadId, EChunkEvent::WriteEnd, StartOffset, Bytes);
+	TRACE_COUNTER_SUBTRACT(ChunkStreamBytesBuffered, static_cast<int64>(Bytes));
+	TRACE_COUNTER_DECREMENT(ChunkStreamPendingWrites);
+}
+
+#endif //CHUNKSTREAM_TRACE_ENABLED
@@ -0,0 +1,158 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+
+#include "ChunkStreamTransport.h"
+#include "StreamChunkDownloader.h"
+#include "HttpModule.h"
+#include "Interfaces/IHttpResponse.h"
+
+namespace
+{
+	class FChunkStreamHttpResponse : public IChunkStreamResponse
+	{
+	public:
+		explicit FChunkStreamHttpResponse(const FHttpResponsePtr& InResponse) : Response(InResponse) {}
+
+		virtual int32 GetResponseCode() const override { return Response->GetResponseCode(); }
+		virtual FString GetHeader(const FString& HeaderName) const override { return Response->GetHeader(HeaderName); }
+
+	private:
+		FHttpResponsePtr Response;
+	};
+
+	// Request through UE's HTTP module
+	class FChunkStreamHttpRequest : public IChunkStreamRequest
+	{
+	public:
+		FChunkStreamHttpRequest() : Request(FHttpModule::Get().CreateRequest()) {}
+
+		virtual void SetVerb(const FString& Verb) override { Request->SetVerb(Verb); }
+		virtual void SetURL(const FString& URL) override { Request->SetURL(URL); }
+		virtual void SetHeader(const FString& Name, const FString& Value) override { Request->SetHeader(Name, Value); }
+		virtual void SetTimeout(float Seconds) override
+		{
+#ifndef OLD_HTTP
+			Request->SetTimeout(Seconds);
+#endif
+		}
+
+		virtual bool ProcessRequest() override
+		{
+			TWeakPtr<IChunkStreamRequest, ESPMode::ThreadSafe> WeakThis = AsShared();
+			Request->OnStatusCodeReceived()
+				.BindLambda([WeakThis](FHttpRequestPtr, int32 StatusCode)
+				{
+					if (TSharedPtr<IChunkStreamRequest, ESPMode::ThreadSafe> This = WeakThis.Pin())
+					{
+						This->OnStatusCode().ExecuteIfBound(StatusCode);
+					}
+				});
+			Request->OnHeaderReceived()
+				.BindLambda([WeakThis](FHttpRequestPtr, const FString& Name, const FString& Value)
+				{
+					if (TSharedPtr<IChunkStreamRequest, ESPMode::ThreadSafe> This = WeakThis.Pin())
+					{
+						This->OnHeader().ExecuteIfBound(Name, Value);
+					}
+				});
+#ifdef OLD_HTTP
+			Request->OnRequestProgress()
+#else
+			Request->OnRequestProgress64()
+#endif
+				.BindLambda([WeakThis](FHttpRequestPtr, BytesType BytesSent, BytesType BytesReceived)
+				{
+					if (TSharedPtr<IChunkStreamRequest, ESPMode::ThreadSafe> This = WeakThis.Pin())
+					{
+						This->OnProgress().ExecuteIfBound(BytesReceived);
+					}
+				});
+			if (BodyDelegate.IsBound())
+			{
+				// without it the response body is kept in the response instead
+				Request->SetResponseBodyReceiveStreamDelegateV2(FHttpRequestStreamDelegateV2::CreateLambda([WeakThis](void* Data, int64& InOutLength)
+				{
+					if (TSharedPtr<IChunkStreamRequest, ESPMode::ThreadSafe> This = WeakThis.Pin())
+					{
+						This->OnBody().ExecuteIfBound(Data, InOutLength);
+					}
+				}));
+			}
+			Request->OnProcessRequestComplete()
+				.BindLambda([WeakThis](FHttpRequestPtr, FHttpResponsePtr Response, bool bSuccess)
+				{
+					if (TSharedPtr<IChunkStreamRequest, ESPMode::ThreadSafe> This = WeakThis.Pin())
+					{
+						StaticCastSharedPtr<FChunkStreamHttpRequest>(This)->OnRequestComplete(Response, bSuccess);
+					}
+				});
+			
+			KeepAlive = AsShared();
+			if (!Request->ProcessRequest())
+			{
+				KeepAlive.Reset();
+				return false;
+			}
+			return true;
+		}
+
+		virtual void CancelRequest() override { Request->CancelRequest(); }
+
+	private:
+		void OnRequestComplete(const FHttpResponsePtr& Response, bool bSuccess)
+		{
+			// released once the owner has seen the result
+			TSharedPtr<IChunkStreamRequest, ESPMode::ThreadSafe> Self = MoveTemp(KeepAlive);
+			FChunkStreamResponsePtr Wrapped;
+			if (Response)
+			{
+				Wrapped = MakeShared<FChunkStreamHttpResponse, ESPMode::ThreadSafe>(Response);
+			}
+			CompleteDelegate.ExecuteIfBound(Wrapped, bSuccess);
+		}
+
+		FHttpRequestType Request;
+		// The request in flight holds itself like UE's HTTP manager holds its requests
+		TSharedPtr<IChunkStreamRequest, ESPMode::ThreadSafe> KeepAlive;
+	};
+
+	FCriticalSection& GetSchemeLock()
+	{
+		static FCriticalSection Lock;
+		return Lock;
+	}
+
+	TMap<FString, TSharedPtr<IChunkStreamTransport, ESPMode::ThreadSafe>>& GetSchemes()
+	{
+		static TMap<FString, TSharedPtr<IChunkStreamTransport, ESPMode::ThreadSafe>> Schemes;
+		return Schemes;
+	}
+}
+
+void ChunkStreamTransport::RegisterScheme(const FString& Scheme, const TSharedPtr<IChunkStreamTransport, ESPMode::ThreadSafe>& Transport)
+{
+	FScopeLock Lock(&GetSchemeLock());
+	if (Transport)
+	{
+		GetSchemes().Add(Scheme, Transport);
+	}
+	else
+	{
+		GetSchemes().Remove(Scheme);
+	}
+}
+
+FChunkStreamRequestRef ChunkStreamTransport::CreateRequest(const FString& URL)
+{
+	TSharedPtr<IChunkStreamTransport, ESPMode::ThreadSafe> Transport;
+	const int32 SchemeEnd = URL.Find(TEXT("://"));
+	if (SchemeEnd != INDEX_NONE)
+	{
+		FScopeLock Lock(&GetSchemeLock());
+		Transport = GetSchemes().FindRef(URL.Left(SchemeEnd));
+	}
+	
+	FChunkStreamRequestRef Request = Transport ? Transport->CreateRequest() : MakeShared<FChunkStreamHttpRequest, ESPMode::ThreadSafe>();
+	Request->SetURL(URL);
+	return Request;
+}
@@ -0,0 +1,140 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#include "ChunkStreamUncachedWriter.h"
+#include "ChunkStreamLogs.h"
+#include "Misc/Paths.h"
+
+#define CHUNKSTREAM_UNCACHED_WRITES (PLATFORM_LINUX || PLATFORM_ANDROID)
+
+#if CHUNKSTREAM_UNCACHED_WRITES
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+FChunkStreamUncachedWriter::~FChunkStreamUncachedWriter()
+{
+#if CHUNKSTREAM_UNCACHED_WRITES
+	if (DirectHandle >= 0)
+	{
+		close(DirectHandle);
+	}
+	if (BufferedHandle >= 0)
+	{
+		close(BufferedHandle);
+	}
+#endif
+	if (BounceBuffer)
+	{
+		FMemory::Free(BounceBuffer);
+	}
+}
+
+TUniquePtr<FChunkStreamUncachedWriter> FChunkStreamUncachedWriter::Open(const FString& Path)
+{
+#if CHUNKSTREAM_UNCACHED_WRITES
+	TUniquePtr<FChunkStreamUncachedWriter> Writer(new FChunkStreamUncachedWriter());
+	const FTCHARToUTF8 FilePath(*FPaths::ConvertRelativePathToFull(Path));
+	Writer->BufferedHandle = open(FilePath.Get(), O_WRONLY | O_CLOEXEC);
+	if (Writer->BufferedHandle < 0)
+	{
+		LOG_WARN("Failed to open '%s' for uncached writes, errno %d", *Path, errno);
+		return nullptr;
+	}
+#if defined(O_DIRECT)
+	// tmpfs and some FUSE filesystems refuse O_DIRECT, they still get the fadvise fallback
+	Writer->DirectHandle = open(FilePath.Get(), O_WRONLY | O_CLOEXEC | O_DIRECT);
+	if (Writer->DirectHandle >= 0)
+	{
+		Writer->BounceBuffer = static_cast<uint8*>(FMemory::Malloc(BounceBufferSize, Alignment));
+	}
+#endif
+	return Writer;
+#else
+	return nullptr;
+#endif
+}
+
+bool FChunkStreamUncachedWriter::Write(const uint8* Data, uint64 Num, uint64 Offset)
+{
+#if CHUNKSTREAM_UNCACHED_WRITES
+	TRACE_CPUPROFILER_EVENT_SCOPE(FChunkStreamUncachedWriter::Write)
+	if (Num == 0)
+	{
+		return true;
+	}
+	const uint64 End = Offset + Num;
+	const uint64 AlignedStart = Align(Offset, Alignment);
+	const uint64 AlignedEnd = AlignDown(End, Alignment);
+	if (!IsDirect() || AlignedStart >= AlignedEnd)
+	{
+		if (!WriteAll(BufferedHandle, Data, Num, Offset))
+		{
+			return false;
+		}
+	}
+	else
+	{
+		// chunks are sized in whole blocks, so usually only the end of the file is partial
+		if (AlignedStart > Offset && !WriteAll(BufferedHandle, Data, AlignedStart - Offset, Offset))
+		{
+			return false;
+		}
+		for (uint64 Position = AlignedStart; Position < AlignedEnd;)
+		{
+			const uint64 BlockBytes = FMath::Min(BounceBufferSize, AlignedEnd - Position);
+			FMemory::Memcpy(BounceBuffer, Data + (Position - Offset), BlockBytes);
+			if (!WriteAll(DirectHandle, BounceBuffer, BlockBytes, Position))
+			{
+				return false;
+			}
+			Position += BlockBytes;
+		}
+		if (End > AlignedEnd && !WriteAll(BufferedHandle, Data + (AlignedEnd - Offset), End - AlignedEnd, AlignedEnd))
+		{
+			return false;
+		}
+	}
+	
+	// dirty pages can't be dropped, so they go to storage first, same as the cached path flushing every chunk
+	if (fdatasync(BufferedHandle) != 0)
+	{
+		LOG_ERROR("Failed to sync uncached write [%llu-%llu], errno %d", Offset, End - 1, errno);
+		return false;
+	}
+	posix_fadvise(BufferedHandle, static_cast<off_t>(Offset), static_cast<off_t>(Num), POSIX_FADV_DONTNEED);
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool FChunkStreamUncachedWriter::WriteAll(int32 Handle, const uint8* Data, uint64 Num, uint64 Offset)
+{
+#if CHUNKSTREAM_UNCACHED_WRITES
+	while (Num > 0)
+	{
+		const ssize_t Written = pwrite(Handle, Data, Num, static_cast<off_t>(Offset));
+		if (Written < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (Written <= 0)
+		{
+			LOG_ERROR("Failed uncached write of %llu bytes at %llu, errno %d", Num, Offset, errno);
+			return false;
+		}
+		// a short O_DIRECT write can leave the rest unaligned, finish it through the cache
+		if (Handle == DirectHandle && static_cast<uint64>(Written) < Num && Written % Alignment != 0)
+		{
+			Handle = BufferedHandle;
+		}
+		Data += Written;
+		Num -= Written;
+		Offset += Written;
+	}
+	return true;
+#else
+	return false;
+#endif
+}
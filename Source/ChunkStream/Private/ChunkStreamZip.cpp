@@ -0,0 +1,897 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+
+#include "ChunkStreamZip.h"
+#include "ChunkStreamLogs.h"
+#include "Async/Async.h"
+#include "HAL/PlatformFileManager.h"
+#include "GenericPlatform/GenericPlatformFile.h"
+#include "Misc/Paths.h"
+
+THIRD_PARTY_INCLUDES_START
+#include "zlib.h"
+THIRD_PARTY_INCLUDES_END
+
+// Deflated entries up to this size are buffered and extracted on workers, larger ones are inflated inline
+static constexpr uint64 MaxParallelEntryBytes = 16 * 1024 * 1024;
+// Size of the scratch buffer inflated data goes through before it is written
+static constexpr int64 InflateBufferSize = 1024 * 1024;
+// zip64 extended information extra field
+static constexpr uint16 Zip64ExtraId = 0x0001;
+
+namespace
+{
+	uint32 UpdateCrc(uint32 Crc, const uint8* Data, uint64 Num)
+	{
+		// zlib counts in uInt
+		while (Num > 0)
+		{
+			const uInt Slice = static_cast<uInt>(FMath::Min<uint64>(Num, MAX_uint32 >> 1));
+			Crc = crc32(Crc, Data, Slice);
+			Data += Slice;
+			Num -= Slice;
+		}
+		return Crc;
+	}
+
+	FString ReadEntryName(const uint8* Data, uint16 Num)
+	{
+		// names are UTF-8 or CP437, which only differ outside ASCII
+		const FUTF8ToTCHAR Converted(reinterpret_cast<const ANSICHAR*>(Data), Num);
+		return FString(Converted.Length(), Converted.Get());
+	}
+
+	// Applies a zip64 extra field, only the fields that overflowed in the header are present, in this order
+	void ApplyZip64Extra(const uint8* Extra, uint16 Num, ChunkStreamZip::FEntry& Entry, bool bLocalHeader)
+	{
+		using namespace ChunkStreamZip;
+		uint16 Offset = 0;
+		while (Offset + 4 <= Num)
+		{
+			const uint16 Id = ReadU16(Extra + Offset);
+			const uint16 Size = ReadU16(Extra + Offset + 2);
+			const uint8* Field = Extra + Offset + 4;
+			if (Offset + 4 + Size > Num)
+			{
+				break;
+			}
+			if (Id == Zip64ExtraId)
+			{
+				Entry.bZip64 = true;
+				uint16 Read = 0;
+				// the local header always carries both sizes
+				if ((bLocalHeader || Entry.UncompressedSize == MAX_uint32) && Read + 8 <= Size)
+				{
+					Entry.UncompressedSize = ReadU64(Field + Read);
+					Read += 8;
+				}
+				if ((bLocalHeader || Entry.CompressedSize == MAX_uint32) && Read + 8 <= Size)
+				{
+					Entry.CompressedSize = ReadU64(Field + Read);
+					Read += 8;
+				}
+				if (!bLocalHeader && Entry.LocalHeaderOffset == MAX_uint32 && Read + 8 <= Size)
+				{
+					Entry.LocalHeaderOffset = ReadU64(Field + Read);
+				}
+			}
+			Offset += 4 + Size;
+		}
+	}
+}
+
+bool ChunkStreamZip::ParseLocalFileHeader(const uint8* Data, uint64 Num, FEntry& OutEntry)
+{
+	if (Num < LocalFileHeaderSize || ReadU32(Data) != LocalFileHeaderSignature)
+	{
+		return false;
+	}
+	const uint16 NameLength = ReadU16(Data + 26);
+	const uint16 ExtraLength = ReadU16(Data + 28);
+	if (Num < LocalFileHeaderSize + NameLength + ExtraLength)
+	{
+		return false;
+	}
+	
+	OutEntry = FEntry();
+	OutEntry.Flags = ReadU16(Data + 6);
+	OutEntry.Method = ReadU16(Data + 8);
+	OutEntry.Crc32 = ReadU32(Data + 14);
+	OutEntry.CompressedSize = ReadU32(Data + 18);
+	OutEntry.UncompressedSize = ReadU32(Data + 22);
+	OutEntry.Name = ReadEntryName(Data + LocalFileHeaderSize, NameLength);
+	ApplyZip64Extra(Data + LocalFileHeaderSize + NameLength, ExtraLength, OutEntry, true);
+	return true;
+}
+
+bool ChunkStreamZip::ParseCentralDirectory(const uint8* Data, uint64 Num, TArray<FEntry>& OutEntries, uint64& OutConsumed)
+{
+	uint64 Offset = 0;
+	while (Offset + 4 <= Num && ReadU32(Data + Offset) == CentralDirectorySignature)
+	{
+		const uint8* Header = Data + Offset;
+		if (Offset + CentralDirectoryHeaderSize > Num)
+		{
+			return false;
+		}
+		const uint16 NameLength = ReadU16(Header + 28);
+		const uint16 ExtraLength = ReadU16(Header + 30);
+		const uint16 CommentLength = ReadU16(Header + 32);
+		const uint64 RecordSize = CentralDirectoryHeaderSize + NameLength + ExtraLength + CommentLength;
+		if (Offset + RecordSize > Num)
+		{
+			return false;
+		}
+		
+		FEntry& Entry = OutEntries.AddDefaulted_GetRef();
+		Entry.Flags = ReadU16(Header + 8);
+		Entry.Method = ReadU16(Header + 10);
+		Entry.Crc32 = ReadU32(Header + 16);
+		Entry.CompressedSize = ReadU32(Header + 20);
+		Entry.UncompressedSize = ReadU32(Header + 24);
+		Entry.LocalHeaderOffset = ReadU32(Header + 42);
+		Entry.Name = ReadEntryName(Header + CentralDirectoryHeaderSize, NameLength);
+		ApplyZip64Extra(Header + CentralDirectoryHeaderSize + NameLength, ExtraLength, Entry, false);
+		
+		Offset += RecordSize;
+	}
+	OutConsumed = Offset;
+	return true;
+}
+
+bool ChunkStreamZip::FindCentralDirectory(const uint8* Tail, uint64 Num, uint64 TailOffset, FCentralDirectoryLocation& OutLocation)
+{
+	if (Num < EndOfCentralDirectorySize)
+	{
+		return false;
+	}
+	
+	// the record is followed by a comment of up to 64KB, search back for a signature whose comment ends the archive
+	const uint8* Record = nullptr;
+	const uint64 SearchStart = Num - EndOfCentralDirectorySize;
+	const uint64 SearchEnd = SearchStart > MAX_uint16 ? SearchStart - MAX_uint16 : 0;
+	for (uint64 Pos = SearchStart + 1; Pos-- > SearchEnd;)
+	{
+		if (ReadU32(Tail + Pos) == EndOfCentralDirectorySignature
+			&& Pos + EndOfCentralDirectorySize + ReadU16(Tail + Pos + 20) == Num)
+		{
+			Record = Tail + Pos;
+			break;
+		}
+	}
+	if (!Record)
+	{
+		return false;
+	}
+	
+	OutLocation.NumEntries = ReadU16(Record + 10);
+	OutLocation.Size = ReadU32(Record + 12);
+	OutLocation.Offset = ReadU32(Record + 16);
+	if (OutLocation.NumEntries != MAX_uint16 && OutLocation.Size != MAX_uint32 && OutLocation.Offset != MAX_uint32)
+	{
+		return true;
+	}
+	
+	// values overflowed, the zip64 locator sits just before the record and points at the zip64 record
+	const uint64 RecordPos = Record - Tail;
+	if (RecordPos < Zip64EndOfCentralDirectoryLocatorSize)
+	{
+		return false;
+	}
+	const uint8* Locator = Record - Zip64EndOfCentralDirectoryLocatorSize;
+	if (ReadU32(Locator) != Zip64EndOfCentralDirectoryLocatorSignature)
+	{
+		return false;
+	}
+	const uint64 Zip64RecordOffset = ReadU64(Locator + 8);
+	if (Zip64RecordOffset < TailOffset || Zip64RecordOffset - TailOffset + Zip64EndOfCentralDirectorySize > Num)
+	{
+		return false;
+	}
+	const uint8* Zip64Record = Tail + (Zip64RecordOffset - TailOffset);
+	if (ReadU32(Zip64Record) != Zip64EndOfCentralDirectorySignature)
+	{
+		return false;
+	}
+	OutLocation.NumEntries = ReadU64(Zip64Record + 32);
+	OutLocation.Size = ReadU64(Zip64Record + 40);
+	OutLocation.Offset = ReadU64(Zip64Record + 48);
+	return true;
+}
+
+bool ChunkStreamZip::MakeSafeOutputPath(const FString& TargetDirectory, const FString& EntryName, FString& OutPath)
+{
+	const FString Relative = EntryName.Replace(TEXT("\\"), TEXT("/"));
+	if (Relative.StartsWith(TEXT("/")) || Relative.Contains(TEXT(":")))
+	{
+		return false;
+	}
+	
+	TArray<FString> Parts;
+	Relative.ParseIntoArray(Parts, TEXT("/"), true);
+	Parts.RemoveAll([](const FString& Part) { return Part == TEXT("."); });
+	for (const FString& Part : Parts)
+	{
+		if (Part == TEXT(".."))
+		{
+			return false;
+		}
+	}
+	if (Parts.Num() == 0)
+	{
+		return false;
+	}
+	
+	OutPath = FPaths::Combine(TargetDirectory, FString::Join(Parts, TEXT("/")));
+	FPaths::NormalizeFilename(OutPath);
+	return true;
+}
+
+FString ChunkStreamZip::ExtractEntryFromMemory(const FEntry& Entry, const uint8* Data, uint64 Num, const FString& OutPath)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(ChunkStreamZip::ExtractEntryFromMemory)
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*FPaths::GetPath(OutPath));
+	TUniquePtr<IFileHandle> File(PlatformFile.OpenWrite(*OutPath));
+	if (!File)
+	{
+		return FString::Printf(TEXT("Failed to open '%s' for writing"), *OutPath);
+	}
+	
+	uint32 Crc = 0;
+	uint64 Written = 0;
+	if (Entry.Method == MethodStored)
+	{
+		Crc = UpdateCrc(Crc, Data, Num);
+		Written = Num;
+		if (!File->Write(Data, Num))
+		{
+			return FString::Printf(TEXT("Failed to write '%s'"), *OutPath);
+		}
+	}
+	else
+	{
+		z_stream Stream;
+		FMemory::Memzero(Stream);
+		if (inflateInit2(&Stream, -MAX_WBITS) != Z_OK)
+		{
+			return TEXT("Failed to initialise zlib");
+		}
+		TArray<uint8> Buffer;
+		Buffer.SetNumUninitialized(static_cast<int32>(FMath::Min<uint64>(InflateBufferSize, FMath::Max<uint64>(Entry.UncompressedSize, 1))));
+		Stream.next_in = const_cast<Bytef*>(Data);
+		Stream.avail_in = static_cast<uInt>(Num);
+		int Ret = Z_OK;
+		while (Ret == Z_OK)
+		{
+			Stream.next_out = Buffer.GetData();
+			Stream.avail_out = static_cast<uInt>(Buffer.Num());
+			Ret = inflate(&Stream, Z_NO_FLUSH);
+			const uint64 Produced = Buffer.Num() - Stream.avail_out;
+			Crc = UpdateCrc(Crc, Buffer.GetData(), Produced);
+			Written += Produced;
+			if (Produced > 0 && !File->Write(Buffer.GetData(), Produced))
+			{
+				inflateEnd(&Stream);
+				return FString::Printf(TEXT("Failed to write '%s'"), *OutPath);
+			}
+			if (Ret == Z_BUF_ERROR && Produced > 0)
+			{
+				Ret = Z_OK;
+			}
+		}
+		inflateEnd(&Stream);
+		if (Ret != Z_STREAM_END)
+		{
+			return FString::Printf(TEXT("'%s' failed to inflate, zlib error %d"), *Entry.Name, Ret);
+		}
+	}
+	
+	if (Written != Entry.UncompressedSize)
+	{
+		return FString::Printf(TEXT("'%s' extracted to %llu bytes, expected %llu"), *Entry.Name, Written, Entry.UncompressedSize);
+	}
+	if (Crc != Entry.Crc32)
+	{
+		return FString::Printf(TEXT("'%s' failed its crc check"), *Entry.Name);
+	}
+	return FString();
+}
+
+struct FChunkStreamZipExtractor::FInflater
+{
+	z_stream Stream;
+	bool bInitialized = false;
+	TArray<uint8> Buffer;
+
+	FInflater()
+	{
+		FMemory::Memzero(Stream);
+		bInitialized = inflateInit2(&Stream, -MAX_WBITS) == Z_OK;
+		Buffer.SetNumUninitialized(InflateBufferSize);
+	}
+	~FInflater()
+	{
+		if (bInitialized)
+		{
+			inflateEnd(&Stream);
+		}
+	}
+};
+
+FChunkStreamZipExtractor::FChunkStreamZipExtractor(const FString& InTargetDirectory)
+	: TargetDirectory(InTargetDirectory)
+{
+	FPaths::NormalizeDirectoryName(TargetDirectory);
+	MaxTasks = FMath::Max(2, FPlatformMisc::NumberOfCoresIncludingHyperthreads() / 2);
+}
+
+FChunkStreamZipExtractor::~FChunkStreamZipExtractor()
+{
+	for (TFuture<FString>& Task : Tasks)
+	{
+		Task.Wait();
+	}
+	CloseEntryFile();
+}
+
+void FChunkStreamZipExtractor::SetExpectedEntries(const TArray<ChunkStreamZip::FEntry>& InEntries)
+{
+	ExpectedEntries = InEntries;
+	bHasExpectedEntries = true;
+}
+
+bool FChunkStreamZipExtractor::Process(const uint8* Data, uint64 Num)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FChunkStreamZipExtractor::Process)
+	using namespace ChunkStreamZip;
+	while (Num > 0)
+	{
+		switch (State)
+		{
+		case EState::Signature:
+			if (!Gather(Data, Num, 4))
+			{
+				return true;
+			}
+			if (!OnSignature())
+			{
+				return false;
+			}
+			break;
+		case EState::LocalHeader:
+			if (!Gather(Data, Num, LocalHeaderNeeded))
+			{
+				return true;
+			}
+			if (LocalHeaderNeeded == LocalFileHeaderSize)
+			{
+				// fixed part is in, now the name and extra field lengths are known
+				LocalHeaderNeeded += ReadU16(HeaderBuffer.GetData() + 26) + ReadU16(HeaderBuffer.GetData() + 28);
+				if (LocalHeaderNeeded > LocalFileHeaderSize)
+				{
+					break;
+				}
+			}
+			if (!OnLocalHeader())
+			{
+				return false;
+			}
+			break;
+		case EState::EntryData:
+		{
+			uint64 Consumed = 0;
+			if (!ProcessEntryData(Data, Num, Consumed))
+			{
+				return false;
+			}
+			Data += Consumed;
+			Num -= Consumed;
+			StreamOffset += Consumed;
+			break;
+		}
+		case EState::DataDescriptor:
+			if (!Gather(Data, Num, DescriptorNeeded))
+			{
+				return true;
+			}
+			if (DescriptorNeeded == 4)
+			{
+				// the signature is optional, without it these 4 bytes were the crc
+				const bool bHasSignature = ReadU32(HeaderBuffer.GetData()) == DataDescriptorSignature;
+				DescriptorNeeded = (bHasSignature ? 8 : 4) + (Entry.bZip64 ? 16 : 8);
+				break;
+			}
+			if (!OnDataDescriptor())
+			{
+				return false;
+			}
+			break;
+		case EState::CentralDirectory:
+			CentralDirectoryBytes.Append(Data, Num);
+			StreamOffset += Num;
+			Num = 0;
+			break;
+		case EState::Failed:
+			return false;
+		}
+	}
+	return CollectFinishedTasks(false);
+}
+
+bool FChunkStreamZipExtractor::Gather(const uint8*& Data, uint64& Num, uint64 Needed)
+{
+	const uint64 Have = HeaderBuffer.Num();
+	if (Have < Needed)
+	{
+		const uint64 Take = FMath::Min(Needed - Have, Num);
+		HeaderBuffer.Append(Data, static_cast<int32>(Take));
+		Data += Take;
+		Num -= Take;
+		StreamOffset += Take;
+	}
+	return static_cast<uint64>(HeaderBuffer.Num()) >= Needed;
+}
+
+bool FChunkStreamZipExtractor::OnSignature()
+{
+	using namespace ChunkStreamZip;
+	const uint32 Signature = ReadU32(HeaderBuffer.GetData());
+	if (Signature == LocalFileHeaderSignature)
+	{
+		// keep the signature, the header is parsed as a whole
+		LocalHeaderNeeded = LocalFileHeaderSize;
+		State = EState::LocalHeader;
+		return true;
+	}
+	if (Signature == CentralDirectorySignature || Signature == EndOfCentralDirectorySignature)
+	{
+		// all entries are done, the rest is the directory validated in Finish
+		CentralDirectoryOffset = StreamOffset - HeaderBuffer.Num();
+		CentralDirectoryBytes.Append(HeaderBuffer.GetData(), HeaderBuffer.Num());
+		HeaderBuffer.Reset();
+		State = EState::CentralDirectory;
+		return true;
+	}
+	return Fail(FString::Printf(TEXT("Unexpected record 0x%08x at offset %llu, not a zip archive or unsupported layout"), Signature, StreamOffset - 4));
+}
+
+bool FChunkStreamZipExtractor::OnLocalHeader()
+{
+	using namespace ChunkStreamZip;
+	if (!ParseLocalFileHeader(HeaderBuffer.GetData(), HeaderBuffer.Num(), Entry))
+	{
+		return Fail(TEXT("Invalid local file header"));
+	}
+	HeaderBuffer.Reset();
+	EntryConsumed = 0;
+	EntryCrc = 0;
+	EntryWritten = 0;
+	EntryBuffer.Reset();
+	bBufferEntry = false;
+	
+	if (Entry.Flags & FlagEncrypted)
+	{
+		return Fail(FString::Printf(TEXT("'%s' is encrypted, which isn't supported"), *Entry.Name));
+	}
+	if (Entry.Method != MethodStored && Entry.Method != MethodDeflate)
+	{
+		return Fail(FString::Printf(TEXT("'%s' uses unsupported compression method %d"), *Entry.Name, Entry.Method));
+	}
+	const bool bSizesFollow = (Entry.Flags & FlagDataDescriptor) != 0;
+	if (bSizesFollow && Entry.Method == MethodStored)
+	{
+		// nothing marks where stored data ends when the size isn't in the header
+		return Fail(FString::Printf(TEXT("'%s' is stored with a data descriptor, it can't be extracted while streaming"), *Entry.Name));
+	}
+	if (!MakeSafeOutputPath(TargetDirectory, Entry.Name, EntryOutputPath))
+	{
+		return Fail(FString::Printf(TEXT("'%s' would extract outside of the target directory"), *Entry.Name));
+	}
+	bool bDuplicate = false;
+	EntryOutputPaths.Add(EntryOutputPath, &bDuplicate);
+	if (bDuplicate)
+	{
+		return Fail(FString::Printf(TEXT("'%s' is in the archive more than once"), *Entry.Name));
+	}
+	
+	State = EState::EntryData;
+	if (Entry.IsDirectory())
+	{
+		FPlatformFileManager::Get().GetPlatformFile().CreateDirectoryTree(*EntryOutputPath);
+		if (bSizesFollow)
+		{
+			// an empty deflate stream, inflated to nowhere
+			return BeginInlineEntry();
+		}
+		// directories carry no data
+		return Entry.CompressedSize == 0 ? FinishEntry(0, 0) : Fail(FString::Printf(TEXT("Directory '%s' has data"), *Entry.Name));
+	}
+	
+	if (!bSizesFollow && Entry.CompressedSize <= MaxParallelEntryBytes)
+	{
+		bBufferEntry = true;
+		EntryBuffer.Reserve(Entry.CompressedSize);
+		if (Entry.CompressedSize == 0)
+		{
+			return DispatchBufferedEntry();
+		}
+		return true;
+	}
+	return BeginInlineEntry();
+}
+
+bool FChunkStreamZipExtractor::BeginInlineEntry()
+{
+	if (!Entry.IsDirectory())
+	{
+		IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+		PlatformFile.CreateDirectoryTree(*FPaths::GetPath(EntryOutputPath));
+		EntryFile = PlatformFile.OpenWrite(*EntryOutputPath);
+		if (!EntryFile)
+		{
+			return Fail(FString::Printf(TEXT("Failed to open '%s' for writing"), *EntryOutputPath));
+		}
+		CreatedFiles.Add(EntryOutputPath);
+	}
+	if (Entry.Method == ChunkStreamZip::MethodDeflate)
+	{
+		if (!Inflater)
+		{
+			Inflater = MakeUnique<FInflater>();
+		}
+		else if (Inflater->bInitialized)
+		{
+			inflateReset(&Inflater->Stream);
+		}
+		if (!Inflater->bInitialized)
+		{
+			return Fail(TEXT("Failed to initialise zlib"));
+		}
+	}
+	return true;
+}
+
+bool FChunkStreamZipExtractor::ProcessEntryData(const uint8* Data, uint64 Num, uint64& OutConsumed)
+{
+	using namespace ChunkStreamZip;
+	const bool bSizesFollow = (Entry.Flags & FlagDataDescriptor) != 0;
+	const uint64 Available = bSizesFollow ? Num : FMath::Min(Num, Entry.CompressedSize - EntryConsumed);
+	OutConsumed = Available;
+	
+	if (bBufferEntry)
+	{
+		EntryBuffer.Append(Data, static_cast<int64>(Available));
+		EntryConsumed += Available;
+		if (EntryConsumed == Entry.CompressedSize)
+		{
+			return DispatchBufferedEntry();
+		}
+		return true;
+	}
+	
+	if (Entry.Method == MethodStored)
+	{
+		EntryCrc = UpdateCrc(EntryCrc, Data, Available);
+		if (!EntryFile->Write(Data, Available))
+		{
+			return Fail(FString::Printf(TEXT("Failed to write '%s'"), *EntryOutputPath));
+		}
+		EntryConsumed += Available;
+		EntryWritten += Available;
+		if (EntryConsumed == Entry.CompressedSize)
+		{
+			return FinishEntry(EntryCrc, EntryWritten);
+		}
+		return true;
+	}
+	
+	z_stream& Stream = Inflater->Stream;
+	// a full buffer may have left zlib holding output
+	bool bBufferFilled = false;
+	// inflates into the buffer and writes out what came of it, false if the write failed
+	auto InflateStep = [this, &Stream, &bBufferFilled](int& OutRet, uint64& OutProduced)
+	{
+		Stream.next_out = Inflater->Buffer.GetData();
+		Stream.avail_out = static_cast<uInt>(Inflater->Buffer.Num());
+		OutRet = inflate(&Stream, Z_NO_FLUSH);
+		OutProduced = Inflater->Buffer.Num() - Stream.avail_out;
+		bBufferFilled = Stream.avail_out == 0;
+		if (OutProduced > 0)
+		{
+			EntryCrc = UpdateCrc(EntryCrc, Inflater->Buffer.GetData(), OutProduced);
+			EntryWritten += OutProduced;
+			if (EntryFile && !EntryFile->Write(Inflater->Buffer.GetData(), OutProduced))
+			{
+				return Fail(FString::Printf(TEXT("Failed to write '%s'"), *EntryOutputPath));
+			}
+		}
+		return true;
+	};
+	
+	uint64 Remaining = Available;
+	bool bStreamEnded = false;
+	while (Remaining > 0 && !bStreamEnded)
+	{
+		const uInt Slice = static_cast<uInt>(FMath::Min<uint64>(Remaining, MAX_uint32 >> 1));
+		Stream.next_in = const_cast<Bytef*>(Data);
+		Stream.avail_in = Slice;
+		while (Stream.avail_in > 0)
+		{
+			int Ret = Z_OK;
+			uint64 Produced = 0;
+			if (!InflateStep(Ret, Produced))
+			{
+				return false;
+			}
+			if (Ret == Z_STREAM_END)
+			{
+				bStreamEnded = true;
+				break;
+			}
+			if (Ret != Z_OK && !(Ret == Z_BUF_ERROR && Produced > 0))
+			{
+				return Fail(FString::Printf(TEXT("'%s' failed to inflate, zlib error %d"), *Entry.Name, Ret));
+			}
+		}
+		const uint64 Used = Slice - Stream.avail_in;
+		Data += Used;
+		Remaining -= Used;
+	}
+	// the input can run out as the buffer fills with zlib still holding output, the end of the stream may be in it
+	while (!bStreamEnded && bBufferFilled)
+	{
+		int Ret = Z_OK;
+		uint64 Produced = 0;
+		if (!InflateStep(Ret, Produced))
+		{
+			return false;
+		}
+		if (Ret == Z_STREAM_END)
+		{
+			bStreamEnded = true;
+		}
+		else if (Ret != Z_OK && Ret != Z_BUF_ERROR)
+		{
+			return Fail(FString::Printf(TEXT("'%s' failed to inflate, zlib error %d"), *Entry.Name, Ret));
+		}
+		else if (Produced == 0)
+		{
+			break;
+		}
+	}
+	// bytes after the end of the deflate stream belong to the descriptor or the next entry
+	OutConsumed = Available - Remaining;
+	EntryConsumed += OutConsumed;
+	
+	if (!bStreamEnded)
+	{
+		if (!bSizesFollow && EntryConsumed == Entry.CompressedSize)
+		{
+			return Fail(FString::Printf(TEXT("'%s' ended before its deflate stream did"), *Entry.Name));
+		}
+		return true;
+	}
+	if (bSizesFollow)
+	{
+		DescriptorNeeded = 4;
+		State = EState::DataDescriptor;
+		return true;
+	}
+	if (EntryConsumed != Entry.CompressedSize)
+	{
+		return Fail(FString::Printf(TEXT("'%s' deflate stream is shorter than its compressed size"), *Entry.Name));
+	}
+	return FinishEntry(EntryCrc, EntryWritten);
+}
+
+bool FChunkStreamZipExtractor::OnDataDescriptor()
+{
+	using namespace ChunkStreamZip;
+	const uint8* Descriptor = HeaderBuffer.GetData();
+	if (ReadU32(Descriptor) == DataDescriptorSignature && HeaderBuffer.Num() > (Entry.bZip64 ? 20 : 12))
+	{
+		Descriptor += 4;
+	}
+	Entry.Crc32 = ReadU32(Descriptor);
+	if (Entry.bZip64)
+	{
+		Entry.CompressedSize = ReadU64(Descriptor + 4);
+		Entry.UncompressedSize = ReadU64(Descriptor + 12);
+	}
+	else
+	{
+		Entry.CompressedSize = ReadU32(Descriptor + 4);
+		Entry.UncompressedSize = ReadU32(Descriptor + 8);
+	}
+	HeaderBuffer.Reset();
+	
+	if (Entry.CompressedSize != EntryConsumed)
+	{
+		return Fail(FString::Printf(TEXT("'%s' data descriptor size doesn't match its data"), *Entry.Name));
+	}
+	return FinishEntry(EntryCrc, EntryWritten);
+}
+
+bool FChunkStreamZipExtractor::FinishEntry(uint32 ActualCrc, uint64 ActualSize)
+{
+	CloseEntryFile();
+	if (ActualSize != Entry.UncompressedSize)
+	{
+		return Fail(FString::Printf(TEXT("'%s' extracted to %llu bytes, expected %llu"), *Entry.Name, ActualSize, Entry.UncompressedSize));
+	}
+	if (ActualCrc != Entry.Crc32)
+	{
+		return Fail(FString::Printf(TEXT("'%s' failed its crc check"), *Entry.Name));
+	}
+	LOG_VERBOSE("Extracted '%s' (%llu bytes)", *Entry.Name, ActualSize);
+	Extracted.Add(Entry);
+	State = EState::Signature;
+	return true;
+}
+
+bool FChunkStreamZipExtractor::DispatchBufferedEntry()
+{
+	// entries are independent files, so any number can be extracted at once, bounded to limit buffered memory
+	while (Tasks.Num() >= MaxTasks)
+	{
+		Tasks[0].Wait();
+		if (!CollectFinishedTasks(false))
+		{
+			return false;
+		}
+	}
+	
+	CreatedFiles.Add(EntryOutputPath);
+	Extracted.Add(Entry);
+	Tasks.Add(Async(EAsyncExecution::ThreadPool, [EntryInfo = Entry, Data = MoveTemp(EntryBuffer), Path = EntryOutputPath]()
+	{
+		return ChunkStreamZip::ExtractEntryFromMemory(EntryInfo, Data.GetData(), Data.Num(), Path);
+	}));
+	EntryBuffer.Reset();
+	bBufferEntry = false;
+	State = EState::Signature;
+	return true;
+}
+
+bool FChunkStreamZipExtractor::CollectFinishedTasks(bool bWaitAll)
+{
+	for (int32 i = Tasks.Num() - 1; i >= 0; i--)
+	{
+		if (!bWaitAll && !Tasks[i].IsReady())
+		{
+			continue;
+		}
+		const FString TaskError = Tasks[i].Get();
+		Tasks.RemoveAtSwap(i);
+		if (!TaskError.IsEmpty())
+		{
+			return Fail(TaskError);
+		}
+	}
+	return true;
+}
+
+void FChunkStreamZipExtractor::CloseEntryFile()
+{
+	if (EntryFile)
+	{
+		EntryFile->Flush();
+		delete EntryFile;
+		EntryFile = nullptr;
+	}
+}
+
+bool FChunkStreamZipExtractor::Fail(const FString& InError)
+{
+	Error = InError;
+	State = EState::Failed;
+	return false;
+}
+
+bool FChunkStreamZipExtractor::Finish()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FChunkStreamZipExtractor::Finish)
+	using namespace ChunkStreamZip;
+	if (State == EState::Failed || !CollectFinishedTasks(true))
+	{
+		return false;
+	}
+	if (bHasExpectedEntries)
+	{
+		if (State != EState::Signature || HeaderBuffer.Num() > 0)
+		{
+			return Fail(TEXT("Entry data ended early, the download is truncated"));
+		}
+		if (!ValidateExtracted(ExpectedEntries))
+		{
+			return false;
+		}
+		LOG("Extracted %d entries to '%s'", Extracted.Num(), *TargetDirectory);
+		return true;
+	}
+	if (State != EState::CentralDirectory)
+	{
+		return Fail(TEXT("Archive ended before its central directory, the download is truncated"));
+	}
+	
+	TArray<FEntry> Directory;
+	uint64 DirectorySize = 0;
+	FCentralDirectoryLocation Location;
+	if (!ParseCentralDirectory(CentralDirectoryBytes.GetData(), CentralDirectoryBytes.Num(), Directory, DirectorySize)
+		|| !FindCentralDirectory(CentralDirectoryBytes.GetData(), CentralDirectoryBytes.Num(), CentralDirectoryOffset, Location))
+	{
+		return Fail(TEXT("Central directory is invalid or truncated"));
+	}
+	if (Location.Offset != CentralDirectoryOffset || Location.Size != DirectorySize || Location.NumEntries != static_cast<uint64>(Directory.Num()))
+	{
+		return Fail(TEXT("End of central directory record doesn't match the central directory"));
+	}
+	if (!ValidateExtracted(Directory))
+	{
+		return false;
+	}
+	
+	LOG("Extracted %d entries to '%s'", Extracted.Num(), *TargetDirectory);
+	return true;
+}
+
+bool FChunkStreamZipExtractor::ValidateExtracted(const TArray<ChunkStreamZip::FEntry>& Directory)
+{
+	using namespace ChunkStreamZip;
+	if (Directory.Num() != Extracted.Num())
+	{
+		return Fail(FString::Printf(TEXT("Central directory lists %d entries but %d were in the stream"), Directory.Num(), Extracted.Num()));
+	}
+	
+	TMap<FString, const FEntry*> ExtractedByName;
+	for (const FEntry& Local : Extracted)
+	{
+		if (ExtractedByName.Contains(Local.Name))
+		{
+			return Fail(FString::Printf(TEXT("'%s' is in the stream more than once"), *Local.Name));
+		}
+		ExtractedByName.Add(Local.Name, &Local);
+	}
+	TSet<FString> ListedNames;
+	for (const FEntry& Listed : Directory)
+	{
+		bool bDuplicate = false;
+		ListedNames.Add(Listed.Name, &bDuplicate);
+		if (bDuplicate)
+		{
+			return Fail(FString::Printf(TEXT("'%s' is in the central directory more than once"), *Listed.Name));
+		}
+		
+		const FEntry* const* Local = ExtractedByName.Find(Listed.Name);
+		if (!Local)
+		{
+			return Fail(FString::Printf(TEXT("'%s' is in the central directory but wasn't in the stream"), *Listed.Name));
+		}
+		if ((*Local)->Crc32 != Listed.Crc32 || (*Local)->UncompressedSize != Listed.UncompressedSize
+			|| (*Local)->CompressedSize != Listed.CompressedSize || (*Local)->Method != Listed.Method)
+		{
+			return Fail(FString::Printf(TEXT("'%s' doesn't match its central directory entry"), *Listed.Name));
+		}
+	}
+	return true;
+}
+
+void FChunkStreamZipExtractor::Abort()
+{
+	for (TFuture<FString>& Task : Tasks)
+	{
+		Task.Wait();
+	}
+	Tasks.Empty();
+	CloseEntryFile();
+	State = EState::Failed;
+	
+	// partial contents are no more useful than a partial archive
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	for (const FString& File : CreatedFiles)
+	{
+		PlatformFile.DeleteFile(*File);
+	}
+	CreatedFiles.Empty();
+}
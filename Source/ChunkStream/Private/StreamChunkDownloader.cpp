@@ -2,10 +2,333 @@
 
 
 #include "StreamChunkDownloader.h"
+#include "ChunkStreamConnectionPool.h"
 #include "ChunkStreamLogs.h"
-#include "HttpModule.h"
-#include "Interfaces/IHttpResponse.h"
+#include "Async/Async.h"
 #include "Containers/Ticker.h"
+#include "HAL/IConsoleManager.h"
+#include "ChunkStreamStats.h"
+#include "ChunkStreamBenchmark.h"
+#include "ChunkStreamTrace.h"
+
+// Length of the windows GetCurrentBytesPerSecond measures over
+static constexpr double RateWindowSeconds = 1.0;
+
+TAutoConsoleVariable<float> CVarStallCheckInterval(
+	TEXT("ChunkStream.StallCheckInterval"),
+	0.25f,
+	TEXT("Seconds between stall checks of a download. Range: 0.05-5. Default: 0.25"),
+	ECVF_Default);
+
+TAutoConsoleVariable<float> CVarStallTimeoutMin(
+	TEXT("ChunkStream.StallTimeoutMin"),
+	1.5f,
+	TEXT("Lower bound in seconds for the adaptive stall threshold. Fast links are treated as stalled after this long without data. Default: 1.5"),
+	ECVF_Default);
+
+TAutoConsoleVariable<float> CVarStallTimeoutMax(
+	TEXT("ChunkStream.StallTimeoutMax"),
+	14.0f,
+	TEXT("Upper bound in seconds for the adaptive stall threshold, also used until enough packets have been seen to estimate it. Default: 14"),
+	ECVF_Default);
+
+TAutoConsoleVariable<float> CVarStallGapMultiplier(
+	TEXT("ChunkStream.StallGapMultiplier"),
+	3.0f,
+	TEXT("Stall threshold = multiplier * (smoothed packet gap + 4 * gap deviation), or the same over time to first byte before data arrives. Default: 3"),
+	ECVF_Default);
+
+// Samples needed before the packet gap / first byte estimates replace StallTimeoutMax
+static constexpr int32 MinPacketGapSamples = 8;
+static constexpr int32 MinFirstByteSamples = 2;
+
+TAutoConsoleVariable<int32> CVarHedgeEnabled(
+	TEXT("ChunkStream.HedgeEnabled"),
+	1,
+	TEXT("Race a duplicate ranged request for the rest of a chunk that is downloading far slower than recent chunks. 0 = off, 1 = on"),
+	ECVF_Default);
+
+TAutoConsoleVariable<float> CVarHedgeThroughputRatio(
+	TEXT("ChunkStream.HedgeThroughputRatio"),
+	0.3f,
+	TEXT("A chunk is hedged when its throughput falls below this fraction of the median throughput of recent chunks. Default: 0.3"),
+	ECVF_Default);
+
+TAutoConsoleVariable<float> CVarHedgeMinElapsedSeconds(
+	TEXT("ChunkStream.HedgeMinElapsedSeconds"),
+	2.0f,
+	TEXT("Minimum seconds a chunk request must have run before it can be hedged, so connection setup isn't mistaken for slowness. Default: 2"),
+	ECVF_Default);
+
+// Samples needed before the median throughput is trusted for hedging
+static constexpr int32 MinThroughputSamplesForHedge = 3;
+static constexpr int32 MaxThroughputSamples = 16;
+// Tails smaller than this finish sooner than a new request could connect
+static constexpr uint64 MinHedgeBytes = 256 * 1024;
+// Chunks that jump ahead for a reader start on this boundary, so the gaps left behind are never a single byte
+static constexpr uint64 PriorityAlignment = 4096;
+// Smallest chunk worth starting when the memory budget runs short, below it the chunk loop waits instead
+static constexpr uint64 MinBudgetChunkSize = 1024 * 1024;
+// How often a download waiting on the memory budget checks again
+static constexpr float MemoryWaitInterval = 0.1f;
+
+TAutoConsoleVariable<int32> CVarMaxRangesPerRequest(
+	TEXT("ChunkStream.MaxRangesPerRequest"),
+	32,
+	TEXT("Requested ranges smaller than a chunk are fetched up to this many per request (Range: bytes=a-b,c-d,...). 1 = one range per request. Default: 32"),
+	ECVF_Default);
+
+// Longest header line accepted in a multipart/byteranges body
+static constexpr int32 MaxMultipartLineLength = 4096;
+
+bool StreamChunkDownloader::FMultipartRangeParser::Reset(const FString& ContentType, const FString& ContentRange)
+{
+	LineBuffer.Reset();
+	Delimiter.Reset();
+	bPartHasRange = false;
+	BodyOffset = 0;
+	State = EState::Error;
+	if (ContentType.StartsWith(TEXT("multipart/byteranges"), ESearchCase::IgnoreCase))
+	{
+		const int32 BoundaryStart = ContentType.Find(TEXT("boundary="), ESearchCase::IgnoreCase);
+		if (BoundaryStart == INDEX_NONE)
+		{
+			return false;
+		}
+		FString Boundary = ContentType.Mid(BoundaryStart + 9);
+		int32 BoundaryEnd;
+		if (Boundary.FindChar(TEXT(';'), BoundaryEnd))
+		{
+			Boundary.LeftInline(BoundaryEnd);
+		}
+		Boundary = Boundary.TrimStartAndEnd().TrimQuotes();
+		if (Boundary.IsEmpty())
+		{
+			return false;
+		}
+		Delimiter = TEXT("--") + Boundary;
+		State = EState::Boundary;
+		return true;
+	}
+	// a single part response is just the bytes of its Content-Range
+	if (ParseContentRange(ContentRange, PartRange))
+	{
+		bPartHasRange = true;
+		BodyOffset = PartRange.Start;
+		State = EState::Body;
+		return true;
+	}
+	return false;
+}
+
+void StreamChunkDownloader::FMirrorState::RecordSuccess(uint64 Bytes, double Seconds)
+{
+	ConsecutiveFailures = 0;
+	CooldownUntil = 0.0;
+	if (Bytes > 0 && Seconds > 0.0)
+	{
+		const double Sample = static_cast<double>(Bytes) / Seconds;
+		// smoothed so one unlucky chunk doesn't starve a mirror
+		Throughput = Throughput > 0.0 ? Throughput * 0.7 + Sample * 0.3 : Sample;
+	}
+}
+
+void StreamChunkDownloader::FMirrorState::RecordFailure(float BackoffBaseSeconds, float BackoffMultiplier)
+{
+	ConsecutiveFailures++;
+	CooldownUntil = FPlatformTime::Seconds() + BackoffBaseSeconds * FMath::Pow(BackoffMultiplier, static_cast<float>(ConsecutiveFailures));
+}
+
+void StreamChunkDownloader::FRangeHelperSet::Register(const TSharedRef<FStreamChunkDownloader>& Downloader) const
+{
+	if (Pool)
+	{
+		Pool->Register(Downloader);
+	}
+}
+
+bool StreamChunkDownloader::FRangeHelperSet::CanOpenExtraConnection() const
+{
+	return !Pool || Pool->CanOpenExtraConnection();
+}
+
+StreamChunkDownloader::FRangeHelper* StreamChunkDownloader::FRangeHelperSet::Find(uint32 HelperSerial) const
+{
+	const TUniquePtr<FRangeHelper>* Found = Helpers.FindByPredicate([HelperSerial](const TUniquePtr<FRangeHelper>& Helper) { return Helper->Serial == HelperSerial; });
+	return Found ? Found->Get() : nullptr;
+}
+
+TUniquePtr<StreamChunkDownloader::FRangeHelper> StreamChunkDownloader::FRangeHelperSet::Remove(uint32 HelperSerial)
+{
+	const int32 Index = Helpers.IndexOfByPredicate([HelperSerial](const TUniquePtr<FRangeHelper>& Helper) { return Helper->Serial == HelperSerial; });
+	if (Index == INDEX_NONE)
+	{
+		return nullptr;
+	}
+	TUniquePtr<FRangeHelper> Helper = MoveTemp(Helpers[Index]);
+	Helpers.RemoveAt(Index);
+	return Helper;
+}
+
+TArray<TUniquePtr<StreamChunkDownloader::FRangeHelper>> StreamChunkDownloader::FRangeHelperSet::RemoveAll()
+{
+	TArray<TUniquePtr<FRangeHelper>> Removed = MoveTemp(Helpers);
+	Helpers.Reset();
+	return Removed;
+}
+
+void StreamChunkDownloader::FRangeHelperSet::AddClaimedRanges(TArray<FByteRange>& Ranges) const
+{
+	for (const TUniquePtr<FRangeHelper>& Helper : Helpers)
+	{
+		FByteRange::AddMerged(Ranges, FByteRange(Helper->Chunk->StartOffset, Helper->Chunk->EndOffset));
+	}
+}
+
+uint64 StreamChunkDownloader::FRangeHelperSet::GetNextStart(uint64 Offset) const
+{
+	uint64 NextStart = MAX_uint64;
+	for (const TUniquePtr<FRangeHelper>& Helper : Helpers)
+	{
+		if (Helper->Chunk->StartOffset > Offset)
+		{
+			NextStart = FMath::Min(NextStart, Helper->Chunk->StartOffset);
+		}
+	}
+	return NextStart;
+}
+
+void StreamChunkDownloader::FRangeHelperSet::CountRequestsPerMirror(TArrayView<int32> RequestsPerMirror) const
+{
+	for (const TUniquePtr<FRangeHelper>& Helper : Helpers)
+	{
+		if (RequestsPerMirror.IsValidIndex(Helper->MirrorIndex))
+		{
+			RequestsPerMirror[Helper->MirrorIndex]++;
+		}
+	}
+}
+
+bool StreamChunkDownloader::FMultipartRangeParser::Feed(const uint8* Data, uint64 Num, FOnRangeData OnRangeData)
+{
+	uint64 Pos = 0;
+	while (Pos < Num)
+	{
+		switch (State)
+		{
+		case EState::Body:
+			{
+				const uint64 Take = FMath::Min(Num - Pos, PartRange.End + 1 - BodyOffset);
+				OnRangeData(BodyOffset, Data + Pos, Take);
+				BodyOffset += Take;
+				Pos += Take;
+				if (BodyOffset > PartRange.End)
+				{
+					State = Delimiter.IsEmpty() ? EState::Done : EState::Boundary;
+				}
+				break;
+			}
+		case EState::Boundary:
+		case EState::Headers:
+			{
+				// header lines are short, byte at a time keeps lines split across packets simple
+				const uint8 Byte = Data[Pos++];
+				if (Byte != '\n')
+				{
+					if (LineBuffer.Num() >= MaxMultipartLineLength)
+					{
+						State = EState::Error;
+						return false;
+					}
+					LineBuffer.Add(Byte);
+					break;
+				}
+				if (LineBuffer.Num() > 0 && LineBuffer.Last() == '\r')
+				{
+					LineBuffer.Pop(EAllowShrinking::No);
+				}
+				const FString Line(FAnsiStringView(reinterpret_cast<const ANSICHAR*>(LineBuffer.GetData()), LineBuffer.Num()));
+				LineBuffer.Reset();
+				if (!ProcessLine(Line))
+				{
+					State = EState::Error;
+					return false;
+				}
+				break;
+			}
+		case EState::Done:
+			// anything after the final boundary is an epilogue
+			return true;
+		case EState::Error:
+			return false;
+		}
+	}
+	return State != EState::Error;
+}
+
+bool StreamChunkDownloader::FMultipartRangeParser::ProcessLine(const FString& Line)
+{
+	if (State == EState::Boundary)
+	{
+		// the line break ending a body and any preamble come before the boundary, boundaries may have trailing whitespace
+		const FString Trimmed = Line.TrimEnd();
+		if (Trimmed.Equals(Delimiter + TEXT("--"), ESearchCase::CaseSensitive))
+		{
+			State = EState::Done;
+		}
+		else if (Trimmed.Equals(Delimiter, ESearchCase::CaseSensitive))
+		{
+			bPartHasRange = false;
+			State = EState::Headers;
+		}
+		return true;
+	}
+	if (Line.IsEmpty())
+	{
+		// end of the part headers, its bytes follow
+		if (!bPartHasRange)
+		{
+			return false;
+		}
+		BodyOffset = PartRange.Start;
+		State = EState::Body;
+		return true;
+	}
+	static constexpr int32 ContentRangeNameLength = 14;
+	if (Line.StartsWith(TEXT("Content-Range:"), ESearchCase::IgnoreCase))
+	{
+		bPartHasRange = ParseContentRange(Line.Mid(ContentRangeNameLength), PartRange);
+		return bPartHasRange;
+	}
+	// Content-Type of the part and anything else
+	return true;
+}
+
+bool StreamChunkDownloader::FMultipartRangeParser::ParseContentRange(const FString& Value, FByteRange& OutRange)
+{
+	FString Range = Value.TrimStartAndEnd();
+	if (!Range.StartsWith(TEXT("bytes "), ESearchCase::IgnoreCase))
+	{
+		return false;
+	}
+	Range.RightChopInline(6);
+	FString Span;
+	FString Total;
+	if (!Range.Split(TEXT("/"), &Span, &Total))
+	{
+		Span = Range;
+	}
+	FString First;
+	FString Last;
+	if (!Span.TrimStartAndEnd().Split(TEXT("-"), &First, &Last) || First.IsEmpty() || Last.IsEmpty()
+		|| !First.IsNumeric() || !Last.IsNumeric())
+	{
+		return false;
+	}
+	OutRange.Start = FCString::Strtoui64(*First, nullptr, 10);
+	OutRange.End = FCString::Strtoui64(*Last, nullptr, 10);
+	return OutRange.Start <= OutRange.End;
+}
 
 FStreamChunkDownloader::~FStreamChunkDownloader()
 {
@@ -13,6 +336,80 @@ FStreamChunkDownloader::~FStreamChunkDownloader()
 
 }
 
+void FStreamChunkDownloader::AddMirrorURL(const FString& InMirrorURL)
+{
+	if (bHasStarted)
+	{
+		LOG_WARN("Mirrors must be added before the download starts, ignoring '%s'", *InMirrorURL);
+		return;
+	}
+	if (InMirrorURL.IsEmpty() || Mirrors.ContainsByPredicate([&InMirrorURL](const StreamChunkDownloader::FMirrorState& Mirror) { return Mirror.URL == InMirrorURL; }))
+	{
+		return;
+	}
+	Mirrors.Emplace(InMirrorURL);
+}
+
+void FStreamChunkDownloader::SetRequestedRanges(const TArray<StreamChunkDownloader::FByteRange>& InRanges)
+{
+	if (bHasStarted)
+	{
+		LOG_WARN("Requested ranges must be set before the download starts");
+		return;
+	}
+	RequestedRanges.Reset();
+	RequestedBytesTotal = 0;
+	for (const StreamChunkDownloader::FByteRange& Range : InRanges)
+	{
+		if (Range.End < Range.Start)
+		{
+			LOG_WARN("Ignoring invalid range {%llu-%llu}", Range.Start, Range.End);
+			continue;
+		}
+		// ranges that continue the previous one are fetched as one
+		if (RequestedRanges.Num() > 0 && RequestedRanges.Last().End + 1 == Range.Start)
+		{
+			RequestedRanges.Last().End = Range.End;
+		}
+		else
+		{
+			RequestedRanges.Add(Range);
+		}
+		RequestedBytesTotal += Range.Num();
+	}
+	RequestedRangeIndex = 0;
+	RequestedRangeCursor = RequestedRanges.Num() > 0 ? RequestedRanges[0].Start : 0;
+	RequestedBytesCompleted = 0;
+}
+
+void FStreamChunkDownloader::SetKnownFileInfo(uint64 InTotalFileSize, bool bInAcceptsRanges)
+{
+	if (bHasStarted)
+	{
+		LOG_WARN("File info must be set before the download starts");
+		return;
+	}
+	TotalFileSize = InTotalFileSize;
+	bUnknownTotalSize = TotalFileSize == 0;
+	bApiAcceptsRanges = bInAcceptsRanges;
+	bHasKnownFileInfo = true;
+}
+
+void FStreamChunkDownloader::SetResumeData(const TArray<StreamChunkDownloader::FByteRange>& InRanges, uint64 InTotalFileSize,
+	const FString& InETag, const FString& InLastModified, const FOnResumeCheckedSignature& OnChecked)
+{
+	if (bHasStarted)
+	{
+		LOG_WARN("Resume data must be set before the download starts");
+		return;
+	}
+	ResumeRanges = InRanges;
+	ResumeFileSize = InTotalFileSize;
+	ResumeETag = InETag;
+	ResumeLastModified = InLastModified;
+	OnResumeCheckedDelegate = OnChecked;
+}
+
 bool FStreamChunkDownloader::BeginDownload(uint64 InMaxChunkSize, const FStreamDownloadProgressSignature& OnProgress,
 	const FOnSingleChunkCompleteSignature& OnSingleChunkComplete, const FOnDownloadCompleteSignature& OnDownloadComplete )
 {
@@ -20,25 +417,58 @@ bool FStreamChunkDownloader::BeginDownload(uint64 InMaxChunkSize, const FStreamD
 	OnSingleChunkCompleteDelegate = OnSingleChunkComplete;
 	OnDownloadCompleteDelegate = OnDownloadComplete;
 	MaxChunkSize = InMaxChunkSize;
+	if (TraceId == 0)
+	{
+		TraceId = ChunkStreamTrace::NewDownloadId();
+		ChunkStreamTrace::DownloadStart(TraceId, URL);
+	}
 	
+	if (bHasKnownFileInfo)
+	{
+		bHasStarted=true;
+		// no HEAD response to validate, chunk responses are checked as they arrive
+		ChunkDownloadResponseCode.store(200);
+		StartChunkDownloads();
+		return true;
+	}
 
-	auto pWeakThis = GetWeakThis();
+	RequestTotalSizeFromMirror(0);
+	bHasStarted=true;
+	return true;
+}
 
+void FStreamChunkDownloader::RequestTotalSizeFromMirror(int32 MirrorIndex)
+{
+	check(Mirrors.IsValidIndex(MirrorIndex));
+	ActiveMirrorIndex = MirrorIndex;
 	
-	RequestDownloadTotalSize(URL, 0.f)
-		.Next([pWeakThis](const FHttpResponsePtr& Response)
+	auto pWeakThis = GetWeakThis();
+	RequestDownloadTotalSize(Mirrors[MirrorIndex].URL, 0.f)
+		.Next([pWeakThis, MirrorIndex](const FChunkStreamResponsePtr& Response)
 		{
 			if (pWeakThis.IsValid())
 			{
-				if (Response)
+				auto Downloader = pWeakThis.Pin();
+				if (Downloader->IsCanceled())
+				{
+					return;
+				}
+				const bool bValidResponse = Response && IsSuccessStatusCode(Response->GetResponseCode());
+				if (!bValidResponse && Downloader->Mirrors.IsValidIndex(MirrorIndex + 1))
+				{
+					LOG_WARN("HEAD request to mirror '%s' failed (status %d), trying next mirror",
+						*Downloader->Mirrors[MirrorIndex].URL, Response ? Response->GetResponseCode() : 0);
+					Downloader->Mirrors[MirrorIndex].ConsecutiveFailures++;
+					Downloader->RequestTotalSizeFromMirror(MirrorIndex + 1);
+				}
+				else if (Response)
 				{
-					auto Downloader = pWeakThis.Pin();
 					Downloader->OnTotalSizeReceived(Response);
 				}
 				else
 				{
 					LOG_ERROR("RequestDownloadTotalSize::Next:: Invalid response.");
-					pWeakThis.Pin()->InternalCancelDownload(EChunkStreamDownloadResult::InvalidResponse, 
+					Downloader->InternalCancelDownload(EChunkStreamDownloadResult::InvalidResponse, 
 						TEXT("Failed to receive valid response from initial HEAD request"));
 				}
 				
@@ -48,19 +478,18 @@ bool FStreamChunkDownloader::BeginDownload(uint64 InMaxChunkSize, const FStreamD
 				LOG_ERROR("RequestDownloadTotalSize::Next:: Invalid downloader, halting.");
 			}
 		});
-	bHasStarted=true;
-	return true;
 }
 
-TFuture<const FHttpResponsePtr&> FStreamChunkDownloader::RequestDownloadTotalSize(const FString& InURL, float Timeout)
+TFuture<const FChunkStreamResponsePtr&> FStreamChunkDownloader::RequestDownloadTotalSize(const FString& InURL, float Timeout)
 {
-	FHttpRequestType NewRequest = MakeHttpRequest(InURL,TEXT("HEAD"),Timeout,TEXT(""));
+	FChunkStreamRequestRef NewRequest = MakeHttpRequest(InURL,TEXT("HEAD"),Timeout,TEXT(""));
+	ApplyCommonHeaders(NewRequest);
 
-	auto Promise = MakeShared<TPromise<const FHttpResponsePtr&>>();
+	auto Promise = MakeShared<TPromise<const FChunkStreamResponsePtr&>>();
 	
 	auto pWeakThis = GetWeakThis();
-	NewRequest->OnProcessRequestComplete().BindLambda([pWeakThis = MoveTemp(pWeakThis), Promise]
-		(FHttpRequestPtr Request, FHttpResponsePtr Response, bool bSuccess)
+	NewRequest->OnComplete().BindLambda([pWeakThis = MoveTemp(pWeakThis), Promise]
+		(FChunkStreamResponsePtr Response, bool bSuccess)
 		{
 			if (pWeakThis.IsValid())
 			{
@@ -77,13 +506,13 @@ TFuture<const FHttpResponsePtr&> FStreamChunkDownloader::RequestDownloadTotalSiz
 		
 		LOG_ERROR("Failed to get content size from URL '%s'",*InURL);
 		// return error
-		return MakeFulfilledPromise<const FHttpResponsePtr&>(nullptr).GetFuture();
+		return MakeFulfilledPromise<const FChunkStreamResponsePtr&>(nullptr).GetFuture();
 	}
 	
 	return Promise->GetFuture();
 }
 
-uint64 FStreamChunkDownloader::GetFileSizeFromRequest( FHttpResponsePtr Response,
+uint64 FStreamChunkDownloader::GetFileSizeFromRequest( FChunkStreamResponsePtr Response,
 	bool bSuccess) 
 {
 	if (!bSuccess || !Response.IsValid())
@@ -117,7 +546,7 @@ uint64 FStreamChunkDownloader::GetFileSizeFromRequest( FHttpResponsePtr Response
 	return 0;
 }
 
-bool FStreamChunkDownloader::DoesApiAcceptRanges( FHttpResponsePtr Response, bool bSuccess)
+bool FStreamChunkDownloader::DoesApiAcceptRanges( FChunkStreamResponsePtr Response, bool bSuccess)
 {
 	bool Result = false;
 	if (!bSuccess || !Response.IsValid())
@@ -135,7 +564,7 @@ bool FStreamChunkDownloader::DoesApiAcceptRanges( FHttpResponsePtr Response, boo
 	return Result;
 }
 
-bool FStreamChunkDownloader::DoesResponseHaveEncoding(const FHttpResponsePtr& Response)
+bool FStreamChunkDownloader::DoesResponseHaveEncoding(const FChunkStreamResponsePtr& Response)
 {
 	if (!Response)
 		return false;
@@ -146,8 +575,11 @@ bool FStreamChunkDownloader::DoesResponseHaveEncoding(const FHttpResponsePtr& Re
 	return false;
 }
 
-void FStreamChunkDownloader::OnTotalSizeReceived(const FHttpResponsePtr& Response)
+void FStreamChunkDownloader::OnTotalSizeReceived(const FChunkStreamResponsePtr& Response)
 {
+	ResponseEncodingType = DoesResponseHaveEncoding(Response) ? Response->GetHeader(TEXT("Content-Encoding")) : FString();
+	ETag = Response->GetHeader(TEXT("ETag"));
+	LastModified = Response->GetHeader(TEXT("Last-Modified"));
 	TotalFileSize = GetFileSizeFromRequest( Response, true);
 	bApiAcceptsRanges = DoesApiAcceptRanges( Response, true);
 	bUnknownTotalSize = TotalFileSize == 0;
@@ -160,6 +592,11 @@ void FStreamChunkDownloader::OnTotalSizeReceived(const FHttpResponsePtr& Respons
 			FString::Printf(TEXT("Status code %d during initial request"), StatusCode));
 		return;
 	}
+	StartChunkDownloads();
+}
+
+void FStreamChunkDownloader::StartChunkDownloads()
+{
 	if (bUnknownTotalSize)
 	{
 		bShouldUseRanges = false;
@@ -177,14 +614,36 @@ void FStreamChunkDownloader::OnTotalSizeReceived(const FHttpResponsePtr& Respons
 	{
 		LOG("File Size received...");
 	}
-	if (TotalFileSize < MaxChunkSize)
+	if (HasRequestedRanges())
+	{
+		if (!bUnknownTotalSize && RequestedRanges.ContainsByPredicate([this](const StreamChunkDownloader::FByteRange& Range) { return Range.End >= TotalFileSize; }))
+		{
+			InternalCancelDownload(EChunkStreamDownloadResult::ValidationFailed,
+				FString::Printf(TEXT("Requested range is past the end of the %llu byte file"), TotalFileSize));
+			return;
+		}
+		if (!bApiAcceptsRanges)
+		{
+			LOG_WARN("Server doesn't advertise Accept-Ranges, requesting ranges anyway");
+		}
+		bShouldUseRanges = true;
+	}
+	else if (TotalFileSize < MaxChunkSize)
 	{
 		bShouldUseRanges=false;
 	}
+	LastChunkEndOffset = 0;
+	ApplyResumeData();
+	if (!bUnknownTotalSize && !HasRequestedRanges() && GetSequentialOffset() >= TotalFileSize)
+	{
+		LOG("'%s' was already fully downloaded", *URL);
+		OnAllChunksDownloaded();
+		return;
+	}
+	MapOutputFile();
 	// Init chunk params
 	InitNewChunk();
 	CurrentChunkOffset.store(0);
-	LastChunkEndOffset = 0;
 	
 	auto pWeakThis = GetWeakThis();
 	// setup stall detection
@@ -194,73 +653,362 @@ void FStreamChunkDownloader::OnTotalSizeReceived(const FHttpResponsePtr& Respons
 		if (pWeakThis.IsValid() && !pWeakThis.Pin()->IsCanceled())
 		{
 			pWeakThis.Pin()->CheckForStall();
+			pWeakThis.Pin()->CheckForSlowChunk();
 			return true;
 		}
 		return false; // dont repeat tick
 		
-	}), 5.0f);
+	}), FMath::Clamp(CVarStallCheckInterval.GetValueOnAnyThread(), 0.05f, 5.0f));
 	
+	// idle connections of the pool may take ranges of this download from here on
+	RangeHelpers.Register(AsShared());
 	
 	ProcessNextChunk();
 }
 
-void FStreamChunkDownloader::OnFailedToGetTotalFileSize()
-{
-	
-}
-
-bool FStreamChunkDownloader::CancelDownload()
+void FStreamChunkDownloader::ApplyResumeData()
 {
-
-	InternalCancelDownload(EChunkStreamDownloadResult::UserCancelled, FString());
-	bCanceled = true;
-	return true;
+	if (ResumeRanges.Num() == 0)
+	{
+		return;
+	}
+	// a validator has to match, the size alone can't tell a changed file apart
+	const bool bSameValidator = (!ETag.IsEmpty() && ETag == ResumeETag) || (!LastModified.IsEmpty() && LastModified == ResumeLastModified);
+	const bool bAccepted = bSameValidator && bApiAcceptsRanges && !bUnknownTotalSize && !HasRequestedRanges()
+		&& ResponseEncodingType.IsEmpty() && TotalFileSize == ResumeFileSize;
+	if (bAccepted)
+	{
+		// the rest has to be asked for by range, however small the file is
+		bShouldUseRanges = true;
+		for (const StreamChunkDownloader::FByteRange& Range : ResumeRanges)
+		{
+			if (Range.End < TotalFileSize)
+			{
+				AddDownloadedAheadRange(Range.Start, Range.End);
+			}
+		}
+		// carry on in file order from the start
+		AheadCursor = MAX_uint64;
+		SkipDownloadedAhead();
+		LOG("Resuming '%s' with %llu of %llu bytes from an earlier download", *URL, GetSequentialOffset() + DownloadedAheadBytes, TotalFileSize);
+	}
+	else
+	{
+		LOG("Can't resume '%s', the server's file has changed or it doesn't accept ranges. Downloading from the start", *URL);
+	}
+	ResumeRanges.Empty();
+	OnResumeCheckedDelegate.ExecuteIfBound(bAccepted);
 }
 
-void FStreamChunkDownloader::Shutdown()
+void FStreamChunkDownloader::OnFailedToGetTotalFileSize()
 {
-	InternalCancelDownload(EChunkStreamDownloadResult::UserCancelled, FString(),true);
+	
 }
 
-void FStreamChunkDownloader::InternalCancelDownload(EChunkStreamDownloadResult Reason, const FString& ErrorMessage, bool bFromShutdown)
+void FStreamChunkDownloader::SelectMirrorForNextChunk()
 {
-	TRACE_CPUPROFILER_EVENT_SCOPE(FStreamChunkDownloader::InternalCancelDownload)
-	if (bCanceled)
+	if (Mirrors.Num() <= 1)
 	{
-		// Already canceled, don't duplicate the notification
 		return;
 	}
-	if (CurrentHttpRequest.IsValid())
+	const double Now = FPlatformTime::Seconds();
+	
+	if (!bApiAcceptsRanges || !bShouldUseRanges)
 	{
-		CurrentHttpRequest.Pin()->CancelRequest();
-		CurrentHttpRequest.Reset();
+		// single stream, only move away from a mirror that is cooling down after a failure
+		if (Mirrors[ActiveMirrorIndex].CooldownUntil > Now)
+		{
+			const int32 Failover = FindFailoverMirror();
+			if (Failover != INDEX_NONE)
+			{
+				ActiveMirrorIndex = Failover;
+			}
+		}
+		return;
 	}
-	if (CurrentDownloadFuture.IsValid())
+	
+	double BestThroughput = 0.0;
+	for (const StreamChunkDownloader::FMirrorState& Mirror : Mirrors)
 	{
-		CurrentDownloadFuture.Reset();
+		BestThroughput = FMath::Max(BestThroughput, Mirror.Throughput);
 	}
 	
-	FTSTicker::GetCoreTicker().RemoveTicker(StallTickHandle);
-	bCanceled = true;
-	if (!bFromShutdown)
+	// Smooth weighted round robin, each mirror gets a share of chunks proportional to its throughput.
+	// Ties go to the higher ranked mirror.
+	double TotalWeight = 0.0;
+	int32 Selected = INDEX_NONE;
+	for (int32 i = 0; i < Mirrors.Num(); i++)
 	{
-		switch (Reason)
+		StreamChunkDownloader::FMirrorState& Mirror = Mirrors[i];
+		if (Mirror.CooldownUntil > Now)
 		{
-		case EChunkStreamDownloadResult::InvalidStatusCode:
-			LOG_ERROR("Download canceled due to invalid status code. %s", *ErrorMessage);
-			break;
-		case EChunkStreamDownloadResult::ValidationFailed:
-			LOG_ERROR("Download canceled due to validation failure. %s", *ErrorMessage);
-			break;
-		case EChunkStreamDownloadResult::NetworkError:
-			LOG_ERROR("Download canceled due to network error. %s", *ErrorMessage);
-			break;
-		case EChunkStreamDownloadResult::InvalidResponse:
-			LOG_ERROR("Download canceled due to invalid response. %s", *ErrorMessage);
-			break;
-		case EChunkStreamDownloadResult::UserCancelled:
-			LOG("Download canceled by user.");
-			break;
+			continue;
+		}
+		// unmeasured mirrors are given the best known rate so they get sampled
+		const double Weight = Mirror.Throughput > 0.0 ? Mirror.Throughput : FMath::Max(BestThroughput, 1.0);
+		Mirror.StripeCredit += Weight;
+		TotalWeight += Weight;
+		if (Selected == INDEX_NONE || Mirror.StripeCredit > Mirrors[Selected].StripeCredit)
+		{
+			Selected = i;
+		}
+	}
+	
+	if (Selected == INDEX_NONE)
+	{
+		// everything is cooling down, take whichever recovers first
+		Selected = 0;
+		for (int32 i = 1; i < Mirrors.Num(); i++)
+		{
+			if (Mirrors[i].CooldownUntil < Mirrors[Selected].CooldownUntil)
+			{
+				Selected = i;
+			}
+		}
+	}
+	else
+	{
+		Mirrors[Selected].StripeCredit -= TotalWeight;
+	}
+	
+	if (Selected != ActiveMirrorIndex)
+	{
+		LOG_VERBOSE("Next chunk striped to mirror '%s' (%.2f MB/s)", *Mirrors[Selected].URL, Mirrors[Selected].Throughput / (1024.0 * 1024.0));
+	}
+	ActiveMirrorIndex = Selected;
+}
+
+int32 FStreamChunkDownloader::FindRangeHelperMirror() const
+{
+	TArray<int32, TInlineAllocator<8>> RequestsPerMirror;
+	RequestsPerMirror.SetNumZeroed(Mirrors.Num());
+	if (bChunkRequestInFlight && RequestsPerMirror.IsValidIndex(ActiveMirrorIndex))
+	{
+		RequestsPerMirror[ActiveMirrorIndex]++;
+	}
+	if (HedgeHttpRequest.IsValid() && RequestsPerMirror.IsValidIndex(HedgeMirrorIndex))
+	{
+		RequestsPerMirror[HedgeMirrorIndex]++;
+	}
+	RangeHelpers.CountRequestsPerMirror(RequestsPerMirror);
+	
+	// the mirrors are ranked, on a tie the faster one then the earlier one
+	const double Now = FPlatformTime::Seconds();
+	int32 Best = INDEX_NONE;
+	for (int32 Index = 0; Index < Mirrors.Num(); Index++)
+	{
+		if (Mirrors[Index].CooldownUntil > Now)
+		{
+			continue;
+		}
+		if (Best == INDEX_NONE || RequestsPerMirror[Index] < RequestsPerMirror[Best]
+			|| (RequestsPerMirror[Index] == RequestsPerMirror[Best] && Mirrors[Index].Throughput > Mirrors[Best].Throughput))
+		{
+			Best = Index;
+		}
+	}
+	return Best != INDEX_NONE ? Best : ActiveMirrorIndex;
+}
+
+int32 FStreamChunkDownloader::FindFailoverMirror() const
+{
+	if (Mirrors.Num() <= 1)
+	{
+		return INDEX_NONE;
+	}
+	const double Now = FPlatformTime::Seconds();
+	int32 EarliestRecovery = INDEX_NONE;
+	
+	// walk down the ranked list from the current mirror, wrapping around
+	for (int32 Step = 1; Step < Mirrors.Num(); Step++)
+	{
+		const int32 Index = (ActiveMirrorIndex + Step) % Mirrors.Num();
+		if (Mirrors[Index].CooldownUntil <= Now)
+		{
+			return Index;
+		}
+		if (EarliestRecovery == INDEX_NONE || Mirrors[Index].CooldownUntil < Mirrors[EarliestRecovery].CooldownUntil)
+		{
+			EarliestRecovery = Index;
+		}
+	}
+	return EarliestRecovery;
+}
+
+void FStreamChunkDownloader::OnMirrorChunkSucceeded(uint64 BytesReceived, double Seconds)
+{
+	if (!Mirrors.IsValidIndex(ActiveMirrorIndex))
+	{
+		return;
+	}
+	Mirrors[ActiveMirrorIndex].RecordSuccess(BytesReceived, Seconds);
+	
+	// for spotting slow chunks to hedge
+	if (BytesReceived > 0 && Seconds > 0.0)
+	{
+		const double Sample = static_cast<double>(BytesReceived) / Seconds;
+		if (RecentChunkThroughputs.Num() >= MaxThroughputSamples)
+		{
+			RecentChunkThroughputs.RemoveAt(0, 1, EAllowShrinking::No);
+		}
+		RecentChunkThroughputs.Add(Sample);
+	}
+}
+
+void FStreamChunkDownloader::OnMirrorChunkFailed()
+{
+	if (!Mirrors.IsValidIndex(ActiveMirrorIndex))
+	{
+		return;
+	}
+	StreamChunkDownloader::FMirrorState& Mirror = Mirrors[ActiveMirrorIndex];
+	Mirror.RecordFailure(RetryBackoffBaseSeconds, RetryBackoffMultiplier);
+	
+	const int32 Failover = FindFailoverMirror();
+	if (Failover != INDEX_NONE && Failover != ActiveMirrorIndex)
+	{
+		LOG_WARN("Failing over from '%s' to mirror '%s'", *Mirror.URL, *Mirrors[Failover].URL);
+		ActiveMirrorIndex = Failover;
+	}
+}
+
+bool FStreamChunkDownloader::CancelDownload()
+{
+
+	InternalCancelDownload(EChunkStreamDownloadResult::UserCancelled, FString());
+	bCanceled = true;
+	return true;
+}
+
+void FStreamChunkDownloader::Shutdown()
+{
+	InternalCancelDownload(EChunkStreamDownloadResult::UserCancelled, FString(),true);
+}
+
+bool FStreamChunkDownloader::Pause()
+{
+	if (!bHasStarted || bCanceled || bPaused)
+	{
+		return false;
+	}
+	LOG("Pausing download of '%s'", *URL);
+	bPaused = true;
+	if (bRetryPending)
+	{
+		// the retry starts again from Resume
+		FTSTicker::GetCoreTicker().RemoveTicker(RetryHandle);
+		bRetryPending = false;
+		bPausedMidLoop = true;
+	}
+	if (bWaitingForMemory)
+	{
+		// same for a chunk waiting on the memory budget, the paused download holds none of it
+		FTSTicker::GetCoreTicker().RemoveTicker(MemoryWaitHandle);
+		bWaitingForMemory = false;
+		bPausedMidLoop = true;
+	}
+	if (bWaitingForRangeHelpers)
+	{
+		// and for one waiting on range helpers, they are dropped below and their ranges fetched after Resume
+		bWaitingForRangeHelpers = false;
+		bPausedMidLoop = true;
+	}
+	{
+		FScopeLock Lock(&ChunkDataLock);
+		CancelHedge();
+		CancelRangeHelpers();
+		NextChunkMemory.Reset();
+	}
+	// its completion hands off whatever arrived and stops the chunk loop
+	if (TSharedPtr<IChunkStreamRequest, ESPMode::ThreadSafe> Request = CurrentHttpRequest.Pin())
+	{
+		Request->CancelRequest();
+	}
+	return true;
+}
+
+bool FStreamChunkDownloader::Resume()
+{
+	if (!bPaused || bCanceled)
+	{
+		return false;
+	}
+	LOG("Resuming download of '%s'", *URL);
+	bPaused = false;
+	if (!bPausedMidLoop)
+	{
+		// paused before the chunk loop stopped, eg waiting on the HEAD request, it carries on by itself
+		return true;
+	}
+	bPausedMidLoop = false;
+	CurrentRetryCount = 0;
+	
+	if (!HasRequestedRanges() && GetSequentialOffset() > 0)
+	{
+		if (bApiAcceptsRanges)
+		{
+			// small files are normally fetched in one request without Range
+			bShouldUseRanges = true;
+		}
+		else
+		{
+			LOG_WARN("'%s' doesn't accept ranges, downloading it from the start again", *URL);
+			LastChunkEndOffset = 0;
+		}
+	}
+	StartNextChunkOrFinish();
+	return true;
+}
+
+void FStreamChunkDownloader::InternalCancelDownload(EChunkStreamDownloadResult Reason, const FString& ErrorMessage, bool bFromShutdown)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FStreamChunkDownloader::InternalCancelDownload)
+	if (bCanceled)
+	{
+		// Already canceled, don't duplicate the notification
+		return;
+	}
+	if (CurrentHttpRequest.IsValid())
+	{
+		CurrentHttpRequest.Pin()->CancelRequest();
+		CurrentHttpRequest.Reset();
+	}
+	if (CurrentDownloadFuture.IsValid())
+	{
+		CurrentDownloadFuture.Reset();
+	}
+	
+	FTSTicker::GetCoreTicker().RemoveTicker(StallTickHandle);
+	FTSTicker::GetCoreTicker().RemoveTicker(MemoryWaitHandle);
+	bWaitingForMemory = false;
+	bCanceled = true;
+	{
+		FScopeLock Lock(&ChunkDataLock);
+		CancelHedge();
+		CancelRangeHelpers();
+		bWaitingForRangeHelpers = false;
+		MappedFile.Reset();
+		NextChunkMemory.Reset();
+	}
+	if (!bFromShutdown)
+	{
+		switch (Reason)
+		{
+		case EChunkStreamDownloadResult::InvalidStatusCode:
+			LOG_ERROR("Download canceled due to invalid status code. %s", *ErrorMessage);
+			break;
+		case EChunkStreamDownloadResult::ValidationFailed:
+			LOG_ERROR("Download canceled due to validation failure. %s", *ErrorMessage);
+			break;
+		case EChunkStreamDownloadResult::NetworkError:
+			LOG_ERROR("Download canceled due to network error. %s", *ErrorMessage);
+			break;
+		case EChunkStreamDownloadResult::InvalidResponse:
+			LOG_ERROR("Download canceled due to invalid response. %s", *ErrorMessage);
+			break;
+		case EChunkStreamDownloadResult::UserCancelled:
+			LOG("Download canceled by user.");
+			break;
 		case EChunkStreamDownloadResult::InsufficientDiskSpace:
 			LOG_ERROR("Download canceled due to insufficient disk space. %s", *ErrorMessage);
 			break;
@@ -289,33 +1037,69 @@ TFuture<bool> FStreamChunkDownloader::DownloadChunk()
 
 	if (!IsValidChunkRange())
 	{
-		LOG_ERROR("Invalid chunk range to download \n\r Range {%llu-%llu} \n\r URL '%s", ActiveChunk->StartOffset, ActiveChunk->EndOffset, *URL);
+		LOG_ERROR("Invalid chunk range to download \n\r Range {%llu-%llu} \n\r URL '%s", ActiveChunk->StartOffset, ActiveChunk->EndOffset, *GetActiveURL());
 		return MakeFulfilledPromise<bool>(false).GetFuture() ;
 	}
 
-	auto NewRequest = MakeHttpRequest( URL,TEXT("GET"), TimeoutInSeconds, ContentType);
+	auto NewRequest = MakeHttpRequest( GetActiveURL(),TEXT("GET"), TimeoutInSeconds, ContentType);
+	ApplyCommonHeaders(NewRequest);
 	
-	if (bApiAcceptsRanges && bShouldUseRanges)
+	if ((bApiAcceptsRanges && bShouldUseRanges) || HasRequestedRanges())
 	{
-		NewRequest->SetHeader(TEXT("Range"),
-		FString::Printf(TEXT("bytes=%llu-%llu"), ActiveChunk->StartOffset, ActiveChunk->EndOffset));
-	
+		NewRequest->SetHeader(TEXT("Range"), GetRangeHeader());
 	}
 	
 	auto pWeakThis = GetWeakThis();
+	bServerIgnoredRange = false;
+	// a 200 body starts at byte 0, which is only right for a chunk that does too
+	const bool bNeedsRange = HasRequestedRanges() || ActiveChunk->StartOffset > 0;
+	if (MultiRangeParts.Num() > 0)
+	{
+		FScopeLock Lock(&ChunkDataLock);
+		for (StreamChunkDownloader::FMultiRangePart& Part : MultiRangeParts)
+		{
+			Part.Received = 0;
+		}
+		bMultiRangeParserReady = false;
+		ResponseContentType.Reset();
+		ResponseContentRange.Reset();
+		// the body can't be parsed without these
+		NewRequest->OnHeader()
+			.BindLambda([pWeakThis](const FString& HeaderName, const FString& HeaderValue)
+			{
+				if (TSharedPtr<FStreamChunkDownloader> Downloader = pWeakThis.Pin())
+				{
+					FScopeLock Lock(&Downloader->ChunkDataLock);
+					if (HeaderName.Equals(TEXT("Content-Type"), ESearchCase::IgnoreCase))
+					{
+						Downloader->ResponseContentType = HeaderValue;
+					}
+					else if (HeaderName.Equals(TEXT("Content-Range"), ESearchCase::IgnoreCase))
+					{
+						Downloader->ResponseContentRange = HeaderValue;
+					}
+				}
+			});
+	}
 
-	NewRequest->OnStatusCodeReceived()
-		.BindLambda([pWeakThis](FHttpRequestPtr Request, int32 StatusCode)
+	NewRequest->OnStatusCode()
+		.BindLambda([pWeakThis, bNeedsRange](int32 StatusCode)
 		{
 			if (pWeakThis.IsValid())
 			{
-				pWeakThis.Pin()->ChunkDownloadResponseCode.store(StatusCode);
-				pWeakThis.Pin()->ValidateStatusCode();
+				auto Downloader = pWeakThis.Pin();
+				Downloader->ChunkDownloadResponseCode.store(StatusCode);
+				Downloader->ValidateStatusCode();
+				if (StatusCode == 200 && bNeedsRange)
+				{
+					// whole file instead of the range, the body would land at the wrong offsets
+					Downloader->bServerIgnoredRange = true;
+				}
 			}
 		});
 	// on progressed event
-	GetHttpProgressDelegate(NewRequest)
-		.BindLambda([pWeakThis](FHttpRequestPtr Request, BytesType BytesSent, BytesType BytesReceived)
+	NewRequest->OnProgress()
+		.BindLambda([pWeakThis](uint64 BytesReceived)
 		{
 			if (pWeakThis.IsValid())
 			{
@@ -325,14 +1109,14 @@ TFuture<bool> FStreamChunkDownloader::DownloadChunk()
 
 	auto Promise = MakeShared<TPromise<bool>>();
 	// on request complete event
-	NewRequest->OnProcessRequestComplete()
-		.BindLambda([pWeakThis,Promise](FHttpRequestPtr Request, FHttpResponsePtr Response, bool bSuccess)
+	NewRequest->OnComplete()
+		.BindLambda([pWeakThis,Promise](FChunkStreamResponsePtr Response, bool bSuccess)
 		{
 			if (pWeakThis.IsValid())
 			{
-				pWeakThis.Pin()->ChunkDownloadRequestComplete(Request, Response, bSuccess);
+				const bool bChunkComplete = pWeakThis.Pin()->ChunkDownloadRequestComplete(Response, bSuccess);
 
-				Promise->SetValue(bSuccess);
+				Promise->SetValue(bChunkComplete);
 			}
 			else
 			{
@@ -340,24 +1124,128 @@ TFuture<bool> FStreamChunkDownloader::DownloadChunk()
 			}
 		});
 	// delegate that http will stream the data to instead of caching in response
-	FHttpRequestStreamDelegateV2 StreamDelegate = FHttpRequestStreamDelegateV2::CreateSP(this,&FStreamChunkDownloader::OnChunkStream);
-	NewRequest->SetResponseBodyReceiveStreamDelegateV2(StreamDelegate);
+	NewRequest->OnBody().BindSP(this, &FStreamChunkDownloader::OnChunkStream);
 	CurrentHttpRequest = NewRequest;
+	ChunkRequestStartTime = FPlatformTime::Seconds();
+	LastDataReceivedTime = ChunkRequestStartTime;
+	bReceivedFirstByte = false;
+	bChunkRequestInFlight = true;
+	
+	TraceRequestOffset = ActiveChunk->StartOffset;
+	TraceRequestAttempt = CurrentRetryCount + 1;
+	TraceBytesInFlight = static_cast<int64>(CalculateRange());
+	bTraceFirstByte = false;
+	ChunkStreamTrace::RequestStart(TraceId, TraceRequestOffset, CalculateRange(), TraceRequestAttempt);
+	ChunkStreamTrace::AddBytesInFlight(TraceBytesInFlight);
 	// start request
 	if (!NewRequest->ProcessRequest())
 	{
-		LOG_ERROR("Failed to start chunk download \n\r Range {%llu-%llu} \n\r URL '%s", ActiveChunk->StartOffset, ActiveChunk->EndOffset, *URL);
+		LOG_ERROR("Failed to start chunk download \n\r Range {%llu-%llu} \n\r URL '%s", ActiveChunk->StartOffset, ActiveChunk->EndOffset, *GetActiveURL());
 		CurrentHttpRequest.Reset();
+		bChunkRequestInFlight = false;
+		ChunkStreamTrace::AddBytesInFlight(-TraceBytesInFlight);
+		TraceBytesInFlight = 0;
+		ChunkStreamTrace::RequestEnd(TraceId, TraceRequestOffset, TraceRequestAttempt, 0, false);
 		return MakeFulfilledPromise<bool>(false).GetFuture() ;
 	}
 	
 	return Promise->GetFuture();
 }
 
+void FStreamChunkDownloader::StartActiveChunkRequest()
+{
+	auto pWeakThis = GetWeakThis();
+	(CurrentDownloadFuture = DownloadChunk())
+		.Next([pWeakThis](bool bRequestSucceeded)
+		{
+			if (pWeakThis.IsValid())
+			{
+				pWeakThis.Pin()->OnChunkRequestFinished(bRequestSucceeded);
+			}
+		});
+}
+
+void FStreamChunkDownloader::OnChunkRequestFinished(bool bRequestSucceeded)
+{
+	bChunkRequestInFlight = false;
+	if (IsCanceled())
+	{
+		return;
+	}
+	if (bPaused)
+	{
+		// anything that arrived was handed off, Resume carries on after it
+		bPausedMidLoop = true;
+		return;
+	}
+
+	const int32 StatusCode = ChunkDownloadResponseCode.load();
+	if (bServerIgnoredRange && MultiRangeParts.Num() > 0)
+	{
+		// whole file or an unreadable body, the same ranges are asked for again one at a time
+		LOG_WARN("'%s' doesn't support multiple ranges in one request, fetching them one at a time", *GetActiveURL());
+		bServerIgnoredRange = false;
+		bMultiRangeUnsupported = true;
+		MultiRangeParts.Reset();
+		ActiveChunk.Reset();
+		StartNextChunkOrFinish();
+		return;
+	}
+	if (bServerIgnoredRange)
+	{
+		bServerIgnoredRange = false;
+		// caches in front of a server sometimes drop the Range header, one that always does runs out of retries
+		if (CurrentRetryCount < GetMaxRetryAttempts())
+		{
+			LOG_WARN("'%s' answered a ranged request with the whole file. Attempting retry %d/%d", *GetActiveURL(),
+				CurrentRetryCount + 1, GetMaxRetryAttempts());
+			OnMirrorChunkFailed();
+			RetryChunkDownload();
+			return;
+		}
+		InternalCancelDownload(EChunkStreamDownloadResult::InvalidResponse,
+			FString::Printf(TEXT("'%s' answered a ranged request with the whole file"), *GetActiveURL()));
+		return;
+	}
+	if (bRequestSucceeded && IsSuccessStatusCode(StatusCode))
+	{
+		// Reset retry counter on success
+		CurrentRetryCount = 0;
+		OnMirrorChunkSucceeded(LastChunkBytesReceived, FPlatformTime::Seconds() - ChunkRequestStartTime);
+		ProcessNextChunk();
+		return;
+	}
+
+	// A definite rejection from the only source will not get better by retrying
+	if (bRequestSucceeded && !IsRetryableStatusCode(StatusCode) && Mirrors.Num() <= 1)
+	{
+		ValidateStatusCode();
+		InternalCancelDownload(EChunkStreamDownloadResult::InvalidStatusCode, 
+			FString::Printf(TEXT("Status code %d during chunk download"), StatusCode));
+		return;
+	}
+
+	OnMirrorChunkFailed();
+	
+	// Try to retry if we haven't exceeded max retries
+	if (CurrentRetryCount < GetMaxRetryAttempts())
+	{
+		LOG_WARN("Chunk download failed (status %d). Attempting retry %d/%d on '%s'", StatusCode,
+			CurrentRetryCount + 1, GetMaxRetryAttempts(), *GetActiveURL());
+		RetryChunkDownload();
+	}
+	else
+	{
+		LOG_ERROR("Chunk download failed after %d retries", GetMaxRetryAttempts());
+		InternalCancelDownload(EChunkStreamDownloadResult::NetworkError, 
+			FString::Printf(TEXT("Chunk download failed after %d retries"), GetMaxRetryAttempts()));
+	}
+}
+
 bool FStreamChunkDownloader::ValidateStatusCode()
 {
 	int32 StatusCode = ChunkDownloadResponseCode.load();
-	if (StatusCode == 200 || StatusCode == 206 || StatusCode == 201)
+	if (IsSuccessStatusCode(StatusCode))
 	{
 		LOG_VERBOSE("Status Code is good %d",StatusCode);
 		return true;
@@ -390,37 +1278,69 @@ bool FStreamChunkDownloader::ValidateStatusCode()
 	return false;
 }
 
-void FStreamChunkDownloader::OnChunkDownloadProgress(const BytesType& BytesReceived)
+void FStreamChunkDownloader::OnChunkDownloadProgress(uint64 BytesReceived)
 {
-	const double Progress = TotalFileSize <= 0 ? 0.0f : static_cast<double>(BytesReceived + ActiveChunk->StartOffset) /  static_cast<double>(TotalFileSize);
+	double Progress = TotalFileSize <= 0 ? 0.0f : static_cast<double>(BytesReceived + GetSequentialOffset() + DownloadedAheadBytes) /  static_cast<double>(TotalFileSize);
+	if (HasRequestedRanges())
+	{
+		// a multipart body also carries part headers, only the range bytes count
+		const uint64 RangeBytesReceived = MultiRangeParts.Num() > 0 ? CurrentChunkOffset.load() : BytesReceived;
+		Progress = RequestedBytesTotal == 0 ? 0.0 : static_cast<double>(RequestedBytesCompleted + RangeBytesReceived) / static_cast<double>(RequestedBytesTotal);
+	}
 	if (OnProgressDelegate.IsBound())
 	{
 		OnProgressDelegate.Execute(BytesReceived,static_cast<float>(Progress));
 	}
 }
 
-void FStreamChunkDownloader::ChunkDownloadRequestComplete(FHttpRequestPtr Request, FHttpResponsePtr Response,
-	bool bSuccess)
+bool FStreamChunkDownloader::ChunkDownloadRequestComplete(FChunkStreamResponsePtr Response, bool bSuccess)
 {
 	FScopeLock Lock(&ChunkDataLock);
+	ChunkStreamTrace::AddBytesInFlight(-TraceBytesInFlight);
+	TraceBytesInFlight = 0;
+	ChunkStreamTrace::RequestEnd(TraceId, TraceRequestOffset, TraceRequestAttempt, CurrentChunkOffset.load(), bSuccess);
 	if (bCanceled)
 	{
 		// drop data if canceled
 		ActiveChunk.Reset();
-		return;
+		MultiRangeParts.Reset();
+		return false;
 	}
 	
-	if (bSuccess && CurrentChunkOffset.load() > 0)
+	// the primary was canceled because the hedge already filled the chunk
+	const bool bCompletedByHedge = bHedgeWon;
+	bHedgeWon = false;
+	// the loser of the race is no longer needed
+	CancelHedge();
+	
+	LastChunkBytesReceived = bCompletedByHedge ? PrimaryBytesAtHedgeWin : CurrentChunkOffset.load();
+	if (bPaused && !bSuccess && !bCompletedByHedge)
+	{
+		// canceled by Pause, keep what arrived rather than downloading it again
+		if (CurrentChunkOffset.load() > 0 && IsSuccessStatusCode(ChunkDownloadResponseCode.load()))
+		{
+			HandOffActiveChunk();
+		}
+		// the chunk was cut short, not the file
+		bLastChunkCompletedEarly = false;
+		bLastChunkHadData = true;
+		CurrentChunkOffset.store(0);
+		return true;
+	}
+	if ((bSuccess || bCompletedByHedge) && CurrentChunkOffset.load() > 0 && IsSuccessStatusCode(ChunkDownloadResponseCode.load()))
 	{
 		LOG("Chunk range complete... handing off...");
 		
 		bLastChunkHadData = true;
 		HandOffActiveChunk();
+		return true;
 	}
 	else
 	{
-		// No data received in this chunk
+		// No usable data received in this chunk, an error body is never handed off
 		bLastChunkHadData = false;
+		CurrentChunkOffset.store(0);
+		return false;
 	}
 }
 
@@ -440,11 +1360,20 @@ void FStreamChunkDownloader::ProcessNextChunk()
 		LOG("Download canceled. halting chunk download.");
 		return;
 	}
-	
+	StartNextChunkOrFinish();
+}
+
+void FStreamChunkDownloader::StartNextChunkOrFinish()
+{
 	// Determine if more chunks are needed
 	bool bShouldContinue = false;
 	
-	if (bUnknownTotalSize)
+	if (HasRequestedRanges())
+	{
+		// a chunk that ended early is continued from where it stopped
+		bShouldContinue = AdvanceRequestedRange();
+	}
+	else if (bUnknownTotalSize)
 	{
 		// When total size is unknown, continue downloading as long as we are receiving data
 		// If LastChunkEndOffset is 0, we haven't started yet, so continue
@@ -466,46 +1395,47 @@ void FStreamChunkDownloader::ProcessNextChunk()
 	}
 	else
 	{
+		// parts fetched early for a reader aren't downloaded again
+		SkipDownloadedAhead();
 		// When total size is known, check if we have downloaded everything
-		// Also stop if a chunk completed early (file ended before expected)
-		bShouldContinue = (LastChunkEndOffset + 1 < TotalFileSize) && !bLastChunkCompletedEarly;
+		bShouldContinue = LastChunkEndOffset + 1 < TotalFileSize;
+		if (bShouldContinue && bLastChunkCompletedEarly)
+		{
+			// the response ended short of the file, eg a wrong Content-Length, the rest can only be asked for with a range
+			if (!bApiAcceptsRanges)
+			{
+				InternalCancelDownload(EChunkStreamDownloadResult::InvalidResponse,
+					FString::Printf(TEXT("'%s' ended after %llu of %llu bytes and doesn't accept ranges"), *GetActiveURL(), LastChunkEndOffset + 1, TotalFileSize));
+				return;
+			}
+			LOG_WARN("Response from '%s' ended after %llu of %llu bytes, requesting the rest", *GetActiveURL(), LastChunkEndOffset + 1, TotalFileSize);
+			bShouldUseRanges = true;
+		}
 	}
 	
-	if (bShouldContinue)
+	if (bShouldContinue && bPaused)
+	{
+		bPausedMidLoop = true;
+	}
+	else if (bShouldContinue)
 	{
+		if (!ReserveChunkMemory())
+		{
+			WaitForChunkMemory();
+			return;
+		}
+		ApplyPriorityOffset();
+		if (!SkipRangeHelperRanges())
+		{
+			// picked up again as each helper completes
+			LOG_VERBOSE("Waiting on %d range helpers to finish '%s'", RangeHelpers.Num(), *URL);
+			bWaitingForRangeHelpers = true;
+			NextChunkMemory.Reset();
+			return;
+		}
 		InitNewChunk();
-		
-		auto pWeakThis = GetWeakThis();
-		(CurrentDownloadFuture = DownloadChunk())
-			.Next([pWeakThis](bool LastChunkSucceded)
-			{
-				if (pWeakThis.IsValid() )
-				{
-					if (LastChunkSucceded)
-					{
-						// Reset retry counter on success
-						pWeakThis.Pin()->CurrentRetryCount = 0;
-						pWeakThis.Pin()->ProcessNextChunk();
-					}
-					else if ( !pWeakThis.Pin()->IsCanceled())
-					{
-						// Try to retry if we haven't exceeded max retries
-						auto Downloader = pWeakThis.Pin();
-						if (Downloader->CurrentRetryCount < Downloader->MaxRetryCount)
-						{
-							LOG_WARN("Chunk download failed. Attempting retry %d/%d", 
-								Downloader->CurrentRetryCount + 1, Downloader->MaxRetryCount);
-							Downloader->RetryChunkDownload();
-						}
-						else
-						{
-							LOG_ERROR("Chunk download failed after %d retries", Downloader->MaxRetryCount);
-							Downloader->InternalCancelDownload(EChunkStreamDownloadResult::NetworkError, 
-								FString::Printf(TEXT("Chunk download failed after %d retries"), Downloader->MaxRetryCount));
-						}
-					}
-				}
-			});
+		SelectMirrorForNextChunk();
+		StartActiveChunkRequest();
 	}
 	else
 	{
@@ -514,14 +1444,166 @@ void FStreamChunkDownloader::ProcessNextChunk()
 	}
 }
 
+bool FStreamChunkDownloader::AdvanceRequestedRange()
+{
+	while (RequestedRanges.IsValidIndex(RequestedRangeIndex) && RequestedRangeCursor > RequestedRanges[RequestedRangeIndex].End)
+	{
+		RequestedRangeIndex++;
+		if (RequestedRanges.IsValidIndex(RequestedRangeIndex))
+		{
+			RequestedRangeCursor = RequestedRanges[RequestedRangeIndex].Start;
+		}
+	}
+	return RequestedRanges.IsValidIndex(RequestedRangeIndex);
+}
+
+void FStreamChunkDownloader::PrioritizeOffset(uint64 Offset)
+{
+	LOG_VERBOSE("Prioritizing offset %llu of '%s'", Offset, *URL);
+	PendingPriorityOffset.store(Offset);
+}
+
+void FStreamChunkDownloader::ApplyPriorityOffset()
+{
+	const uint64 Offset = PendingPriorityOffset.exchange(MAX_uint64) / PriorityAlignment * PriorityAlignment;
+	if (Offset >= TotalFileSize || HasRequestedRanges() || bUnknownTotalSize || !bShouldUseRanges || !bApiAcceptsRanges)
+	{
+		return;
+	}
+	const uint64 SequentialOffset = GetSequentialOffset();
+	if (Offset < SequentialOffset || StreamChunkDownloader::FByteRange::FindContaining(DownloadedAheadRanges, Offset) != INDEX_NONE)
+	{
+		// already downloaded
+		return;
+	}
+	if (Offset < SequentialOffset + MaxChunkSize)
+	{
+		// the next chunk in order covers it
+		AheadCursor = MAX_uint64;
+	}
+	else if (AheadCursor == MAX_uint64 || Offset < AheadCursor || Offset >= AheadCursor + MaxChunkSize)
+	{
+		LOG("Jumping ahead to offset %llu for a reader", Offset);
+		AheadCursor = Offset;
+	}
+}
+
+void FStreamChunkDownloader::SkipDownloadedAhead()
+{
+	while (DownloadedAheadRanges.Num() > 0 && DownloadedAheadRanges[0].Start <= GetSequentialOffset())
+	{
+		LastChunkEndOffset = FMath::Max(LastChunkEndOffset, DownloadedAheadRanges[0].End);
+		DownloadedAheadBytes -= DownloadedAheadRanges[0].Num();
+		DownloadedAheadRanges.RemoveAt(0);
+	}
+	if (AheadCursor != MAX_uint64 && AheadCursor <= GetSequentialOffset())
+	{
+		AheadCursor = MAX_uint64;
+	}
+}
+
+void FStreamChunkDownloader::AddDownloadedAheadRange(uint64 Start, uint64 End, bool bMoveAheadCursor)
+{
+	// the range can overlap bytes already here, only what the merge newly covers counts
+	auto CoveredBytes = [this]()
+	{
+		uint64 Bytes = 0;
+		for (const StreamChunkDownloader::FByteRange& Range : DownloadedAheadRanges)
+		{
+			Bytes += Range.Num();
+		}
+		return Bytes;
+	};
+	const uint64 CoveredBefore = CoveredBytes();
+	const int32 Index = StreamChunkDownloader::FByteRange::AddMerged(DownloadedAheadRanges, StreamChunkDownloader::FByteRange(Start, End));
+	DownloadedAheadBytes += CoveredBytes() - CoveredBefore;
+	if (!bMoveAheadCursor)
+	{
+		return;
+	}
+	// carry on after everything already here, back to sequential order at the end of the file
+	AheadCursor = DownloadedAheadRanges[Index].End + 1;
+	if (AheadCursor >= TotalFileSize)
+	{
+		AheadCursor = MAX_uint64;
+	}
+}
+
+uint64 FStreamChunkDownloader::GetNextDownloadedAheadStart(uint64 Offset) const
+{
+	uint64 NextStart = MAX_uint64;
+	for (const StreamChunkDownloader::FByteRange& Range : DownloadedAheadRanges)
+	{
+		if (Range.Start > Offset)
+		{
+			NextStart = Range.Start;
+			break;
+		}
+	}
+	return FMath::Min(NextStart, RangeHelpers.GetNextStart(Offset));
+}
+
+double FStreamChunkDownloader::GetCurrentBytesPerSecond() const
+{
+	// a window that closed a while ago means data has stopped
+	if (FPlatformTime::Seconds() - LastWindowEndTime.load(std::memory_order_relaxed) > RateWindowSeconds * 2.0)
+	{
+		return 0.0;
+	}
+	return LastWindowBytesPerSecond.load(std::memory_order_relaxed);
+}
+
+uint64 FStreamChunkDownloader::CopyReceivedBytes(uint8* Destination, uint64 Offset, uint64 MaxBytes)
+{
+	FScopeLock Lock(&ChunkDataLock);
+	if (!ActiveChunk || MultiRangeParts.Num() > 0 || !IsSuccessStatusCode(ChunkDownloadResponseCode.load()))
+	{
+		return 0;
+	}
+	const uint64 ReceivedEnd = ActiveChunk->StartOffset + CurrentChunkOffset.load();
+	if (Offset < ActiveChunk->StartOffset || Offset >= ReceivedEnd)
+	{
+		return 0;
+	}
+	const uint64 Num = FMath::Min(MaxBytes, ReceivedEnd - Offset);
+	FMemory::Memcpy(Destination, GetActiveChunkData() + (Offset - ActiveChunk->StartOffset), Num);
+	return Num;
+}
+
+void FStreamChunkDownloader::MapOutputFile()
+{
+	if (MappedOutputPath.IsEmpty() || bUnknownTotalSize || TotalFileSize == 0 || HasRequestedRanges() || !ResponseEncodingType.IsEmpty())
+	{
+		return;
+	}
+	MappedFile = FChunkStreamMappedFile::Create(MappedOutputPath, TotalFileSize);
+	if (!MappedFile)
+	{
+		LOG_WARN("Can't map '%s', receiving '%s' into chunk buffers", *MappedOutputPath, *URL);
+	}
+}
+
+uint8* FStreamChunkDownloader::GetActiveChunkData() const
+{
+	return ActiveChunk->MappedFile ? ActiveChunk->MappedFile->GetData() + ActiveChunk->StartOffset : ActiveChunk->Data.GetData();
+}
+
 void FStreamChunkDownloader::OnAllChunksDownloaded()
 {
 	FTSTicker::GetCoreTicker().RemoveTicker(StallTickHandle);
+	bChunkLoopFinished = true;
+	// handed off chunks keep it until written
+	MappedFile.Reset();
 	OnDownloadCompleteDelegate.ExecuteIfBound(EChunkStreamDownloadResult::Success);
 }
 
 void FStreamChunkDownloader::HandOffActiveChunk()
 {
+	if (MultiRangeParts.Num() > 0)
+	{
+		HandOffMultiRangeParts();
+		return;
+	}
 	LLM_SCOPE_BYNAME("ChunkStream/HandOffActiveChunk");
 	TRACE_CPUPROFILER_EVENT_SCOPE(FStreamChunkDownloader::HandOffActiveChunk)
 	TUniquePtr<StreamChunkDownloader::FChunkInfo> ChunkToProcess = MoveTemp(ActiveChunk);
@@ -536,8 +1618,23 @@ void FStreamChunkDownloader::HandOffActiveChunk()
 		bLastChunkCompletedEarly=true;
 	}
 	
-	LastChunkEndOffset = ChunkToProcess->EndOffset;
+	if (bActiveChunkIsAhead)
+	{
+		// the sequential position stays put, an ahead chunk that ended early is continued by the next one
+		bLastChunkCompletedEarly = false;
+		AddDownloadedAheadRange(ChunkToProcess->StartOffset, ChunkToProcess->EndOffset);
+	}
+	else
+	{
+		LastChunkEndOffset = ChunkToProcess->EndOffset;
+	}
+	if (HasRequestedRanges())
+	{
+		RequestedRangeCursor = ChunkToProcess->EndOffset + 1;
+		RequestedBytesCompleted += ChunkToProcess->EndOffset - ChunkToProcess->StartOffset + 1;
+	}
 
+	ChunkStreamTrace::HandOff(TraceId, ChunkToProcess->StartOffset, ChunkToProcess->EndOffset - ChunkToProcess->StartOffset + 1);
 	OnSingleChunkCompleteDelegate.Execute(MoveTemp(ChunkToProcess));
 }
 
@@ -548,22 +1645,77 @@ void FStreamChunkDownloader::InitNewChunk()
 	// make fresh chunk
 	ActiveChunk = MakeUnique<StreamChunkDownloader::FChunkInfo>();
 	bLastChunkCompletedEarly = false;
+	CancelHedge();
+	bHedgedThisChunk = false;
+	
+	// what the budget gave the chunk loop, data already arriving (a stream running on into the next chunk) can't wait for it
+	FChunkStreamMemoryReservation Memory = MoveTemp(NextChunkMemory);
+	if (!Memory.IsValid() && !MappedFile)
+	{
+		Memory = FChunkStreamMemoryBudget::Get().ReserveOverBudget(MaxChunkSize + BufferPadding);
+	}
+	uint64 ChunkLimit = MaxChunkSize;
+	if (Memory.IsValid() && !bUnknownTotalSize && Memory.Num() < MaxChunkSize + BufferPadding)
+	{
+		// the budget is short, a smaller chunk rather than a longer wait
+		ChunkLimit = FMath::Max<uint64>(AlignDown(Memory.Num() - FMath::Min(Memory.Num(), BufferPadding), 4096), 4096);
+	}
+	
+	if (HasRequestedRanges())
+	{
+		if (RequestedRanges.IsValidIndex(RequestedRangeIndex))
+		{
+			BuildMultiRangeBatch(ChunkLimit);
+			ActiveChunk->StartOffset = RequestedRangeCursor;
+			ActiveChunk->TotalFileSize = TotalFileSize;
+			if (MultiRangeParts.Num() > 0)
+			{
+				// the parts hold the data
+				for (StreamChunkDownloader::FMultiRangePart& Part : MultiRangeParts)
+				{
+					Part.Chunk->Memory = Memory.Split(Part.Chunk->Data.Num());
+				}
+				ActiveChunk->EndOffset = MultiRangeParts.Last().Chunk->EndOffset;
+				CurrentChunkOffset.store(0);
+				return;
+			}
+			ActiveChunk->EndOffset = FMath::Min(RequestedRangeCursor + ChunkLimit - 1, RequestedRanges[RequestedRangeIndex].End);
+			Memory.Shrink(CalculateRange() + BufferPadding);
+			ActiveChunk->Memory = MoveTemp(Memory);
+			ActiveChunk->Data.Reserve(CalculateRange() + BufferPadding);
+			ActiveChunk->Data.SetNumUninitialized(CalculateRange(), EAllowShrinking::No);
+			CurrentChunkOffset.store(0);
+		}
+		return;
+	}
 	uint64 EndSize = !bUnknownTotalSize? TotalFileSize : MaxChunkSize;
+	bActiveChunkIsAhead = AheadCursor != MAX_uint64;
 	
 	// Check if more chunks needed
-	if (LastChunkEndOffset + 1 < EndSize)
+	if (bActiveChunkIsAhead || LastChunkEndOffset + 1 < EndSize)
 	{
 		// Update chunk range for next download
-		ActiveChunk->StartOffset = LastChunkEndOffset == 0? 0 : LastChunkEndOffset + 1;
+		ActiveChunk->StartOffset = bActiveChunkIsAhead ? AheadCursor : GetSequentialOffset();
+		// stop short of anything already downloaded ahead
 		if (!bUnknownTotalSize)
-			ActiveChunk->EndOffset = FMath::Min(ActiveChunk->StartOffset + MaxChunkSize, TotalFileSize) - 1;
+			ActiveChunk->EndOffset = FMath::Min3(ActiveChunk->StartOffset + ChunkLimit, TotalFileSize, GetNextDownloadedAheadStart(ActiveChunk->StartOffset)) - 1;
 		else
 			ActiveChunk->EndOffset = ActiveChunk->StartOffset + MaxChunkSize;
 		
 		ensure(ActiveChunk->EndOffset > ActiveChunk->StartOffset);
 		ActiveChunk->TotalFileSize=TotalFileSize;
-		ActiveChunk->Data.Reserve(CalculateRange() + BufferPadding);
-		ActiveChunk->Data.SetNumUninitialized(CalculateRange(),EAllowShrinking::No);
+		if (MappedFile)
+		{
+			// received straight into the file, no buffer
+			ActiveChunk->MappedFile = MappedFile;
+		}
+		else
+		{
+			Memory.Shrink(CalculateRange() + BufferPadding);
+			ActiveChunk->Memory = MoveTemp(Memory);
+			ActiveChunk->Data.Reserve(CalculateRange() + BufferPadding);
+			ActiveChunk->Data.SetNumUninitialized(CalculateRange(),EAllowShrinking::No);
+		}
 		CurrentChunkOffset.store(0);
 	}
 }
@@ -571,28 +1723,112 @@ void FStreamChunkDownloader::InitNewChunk()
 void FStreamChunkDownloader::OnChunkStream(void* DataPtr, int64& InOutLength)
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE(FStreamChunkDownloader::OnChunkStream)
+	ChunkStreamBenchmark::FScopedCpuTimer CpuTimer(ChunkStreamBenchmark::ECpuCounter::HttpThread);
 	FScopeLock Lock(&ChunkDataLock);
 	if (!ActiveChunk)
 	{
 		LOG_ERROR("Data still streaming but no active chunk!")
 		return;
 	}
+	
+	AddReceivedBytes(InOutLength);
+	if (!bTraceFirstByte)
+	{
+		bTraceFirstByte = true;
+		ChunkStreamTrace::FirstByte(TraceId, TraceRequestOffset);
+	}
+	if (TraceBytesInFlight > 0)
+	{
+		const int64 Arrived = FMath::Min(TraceBytesInFlight, InOutLength);
+		TraceBytesInFlight -= Arrived;
+		ChunkStreamTrace::AddBytesInFlight(-Arrived);
+		if (TraceBytesInFlight == 0)
+		{
+			ChunkStreamTrace::LastByte(TraceId, TraceRequestOffset, CalculateRange());
+		}
+	}
+	if (MultiRangeParts.Num() > 0)
+	{
+		OnMultiRangeStream(DataPtr, InOutLength);
+		return;
+	}
 	const uint64 ExpectedChunkBytes = (ActiveChunk->EndOffset - ActiveChunk->StartOffset) + 1;
     uint64 CurrentChunkOffsetVal = CurrentChunkOffset.load();
-	check( static_cast<int64>(CurrentChunkOffsetVal) <= ActiveChunk->Data.Num());
+	check(ActiveChunk->MappedFile || static_cast<int64>(CurrentChunkOffsetVal) <= ActiveChunk->Data.Num());
 	
-	LastDataReceivedTime = FPlatformTime::Seconds();
+	const double Now = FPlatformTime::Seconds();
+	RecordPacketTiming(Now);
+	LastDataReceivedTime = Now;
+	if (!IsSuccessStatusCode(ChunkDownloadResponseCode.load()))
+	{
+		// error page from the server, not file content
+		return;
+	}
+	if (bHedgeWon)
+	{
+		// chunk already filled by the hedge, this request is being canceled
+		return;
+	}
+	if (bServerIgnoredRange)
+	{
+		// consuming nothing fails the request, no point downloading the whole file
+		InOutLength = 0;
+		return;
+	}
+	if ((HasRequestedRanges() || ChunkDownloadResponseCode.load() == 206) && CurrentChunkOffsetVal + static_cast<uint64>(InOutLength) > ExpectedChunkBytes)
+	{
+		// bytes past the requested range aren't part of it
+		const uint64 InRange = ExpectedChunkBytes - CurrentChunkOffsetVal;
+		FMemory::Memcpy(GetActiveChunkData() + CurrentChunkOffsetVal, DataPtr, InRange);
+		CurrentChunkOffset.store(CurrentChunkOffsetVal + InRange);
+		LOG_WARN("Server sent more than the requested range, dropped %llu bytes", static_cast<uint64>(InOutLength) - InRange);
+		return;
+	}
 	// within current range
 	if (CurrentChunkOffsetVal + static_cast<uint64>(InOutLength) <= ExpectedChunkBytes )
 	{
-		FMemory::Memcpy(ActiveChunk->Data.GetData() + CurrentChunkOffsetVal, DataPtr, static_cast<uint64>(InOutLength));
+		FMemory::Memcpy(GetActiveChunkData() + CurrentChunkOffsetVal, DataPtr, static_cast<uint64>(InOutLength));
 		CurrentChunkOffset.store(CurrentChunkOffsetVal +  static_cast<uint64>(InOutLength));
 	}
+	else if (ActiveChunk->MappedFile)
+	{
+		// a stream without ranges crossing into the next chunk, which is already there in the mapping
+		const uint8* Source = static_cast<const uint8*>(DataPtr);
+		uint64 Remaining = static_cast<uint64>(InOutLength);
+		while (Remaining > 0 && ActiveChunk)
+		{
+			const uint64 Offset = CurrentChunkOffset.load();
+			const uint64 Num = FMath::Min(Remaining, ActiveChunk->EndOffset - ActiveChunk->StartOffset + 1 - Offset);
+			FMemory::Memcpy(GetActiveChunkData() + Offset, Source, Num);
+			CurrentChunkOffset.store(Offset + Num);
+			Source += Num;
+			Remaining -= Num;
+			if (Remaining == 0)
+			{
+				break;
+			}
+			if (ActiveChunk->EndOffset + 1 >= TotalFileSize)
+			{
+				LOG_WARN("Server sent more than the %llu byte file, dropped %llu bytes", TotalFileSize, Remaining);
+				break;
+			}
+			HandOffActiveChunk();
+			InitNewChunk();
+			TraceBytesInFlight = ActiveChunk ? static_cast<int64>(CalculateRange()) : 0;
+			ChunkStreamTrace::AddBytesInFlight(TraceBytesInFlight);
+		}
+	}
 	else
 	{
 		// incoming data goes beyond the initialized array size, add more to the end which should still be within the safe reserved region
 		
 		int64 Difference = (static_cast<int64>(CurrentChunkOffsetVal) + InOutLength) - ActiveChunk->Data.Num();
+		// the data is already here, it can't wait for the budget
+		const uint64 GrownBytes = static_cast<uint64>(ActiveChunk->Data.Num() + Difference) + BufferPadding;
+		if (GrownBytes > ActiveChunk->Memory.Num())
+		{
+			ActiveChunk->Memory.Append(FChunkStreamMemoryBudget::Get().ReserveOverBudget(GrownBytes - ActiveChunk->Memory.Num()));
+		}
 		ActiveChunk->Data.AddZeroed(Difference);
 		ActiveChunk->EndOffset+=Difference;
 		
@@ -608,104 +1844,899 @@ void FStreamChunkDownloader::OnChunkStream(void* DataPtr, int64& InOutLength)
 		
 		HandOffActiveChunk();
 		InitNewChunk();
+		// a stream without ranges fills one chunk after another
+		TraceBytesInFlight = ActiveChunk ? static_cast<int64>(CalculateRange()) : 0;
+		ChunkStreamTrace::AddBytesInFlight(TraceBytesInFlight);
 	}
 	
 }
 
-void FStreamChunkDownloader::CheckForStall()
+void FStreamChunkDownloader::BuildMultiRangeBatch(uint64 MaxBatchBytes)
 {
-	double CurrentTime = FPlatformTime::Seconds();
-	if ( CurrentTime - LastDataReceivedTime >= StallDetectionTimeout)
+	MultiRangeParts.Reset();
+	const int32 MaxRanges = CVarMaxRangesPerRequest.GetValueOnAnyThread();
+	if (MaxRanges < 2 || bMultiRangeUnsupported)
+	{
+		return;
+	}
+	uint64 BatchBytes = 0;
+	for (int32 Index = RequestedRangeIndex; Index < RequestedRanges.Num() && MultiRangeParts.Num() < MaxRanges; Index++)
 	{
-		// Try to retry if we haven't exceeded max retries
-		if (CurrentRetryCount < MaxRetryCount)
+		const uint64 Start = Index == RequestedRangeIndex ? RequestedRangeCursor : RequestedRanges[Index].Start;
+		const uint64 Num = RequestedRanges[Index].End - Start + 1;
+		// ranges that don't fit in what's left of a chunk are fetched on their own, in chunks if needed
+		if (BatchBytes + Num > MaxBatchBytes)
 		{
-		
-			LOG_WARN("Stream download stalled. Attempting retry %d/%d",CurrentRetryCount +1, MaxRetryCount);
-			
-			// Cancel current request
-			if (auto Request = CurrentHttpRequest.Pin())
+			break;
+		}
+		BatchBytes += Num;
+		StreamChunkDownloader::FMultiRangePart& Part = MultiRangeParts.AddDefaulted_GetRef();
+		Part.Chunk = MakeUnique<StreamChunkDownloader::FChunkInfo>();
+		Part.Chunk->StartOffset = Start;
+		Part.Chunk->EndOffset = RequestedRanges[Index].End;
+		Part.Chunk->TotalFileSize = TotalFileSize;
+		Part.Chunk->Data.SetNumUninitialized(Num);
+	}
+	if (MultiRangeParts.Num() < 2)
+	{
+		MultiRangeParts.Reset();
+	}
+}
+
+FString FStreamChunkDownloader::GetRangeHeader() const
+{
+	if (MultiRangeParts.Num() == 0)
+	{
+		return FString::Printf(TEXT("bytes=%llu-%llu"), ActiveChunk->StartOffset, ActiveChunk->EndOffset);
+	}
+	FString Header = TEXT("bytes=");
+	for (int32 i = 0; i < MultiRangeParts.Num(); i++)
+	{
+		if (i > 0)
+		{
+			Header += TEXT(",");
+		}
+		Header += FString::Printf(TEXT("%llu-%llu"), MultiRangeParts[i].Chunk->StartOffset, MultiRangeParts[i].Chunk->EndOffset);
+	}
+	return Header;
+}
+
+void FStreamChunkDownloader::OnMultiRangeStream(void* DataPtr, int64& InOutLength)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FStreamChunkDownloader::OnMultiRangeStream)
+	const double Now = FPlatformTime::Seconds();
+	RecordPacketTiming(Now);
+	LastDataReceivedTime = Now;
+	if (!IsSuccessStatusCode(ChunkDownloadResponseCode.load()))
+	{
+		return;
+	}
+	if (bServerIgnoredRange)
+	{
+		// the ranges are fetched again one at a time, no point downloading the whole file
+		InOutLength = 0;
+		return;
+	}
+	if (!bMultiRangeParserReady)
+	{
+		bMultiRangeParserReady = true;
+		if (!MultiRangeParser.Reset(ResponseContentType, ResponseContentRange))
+		{
+			LOG_WARN("Multi-range response from '%s' has no byte ranges (Content-Type '%s')", *GetActiveURL(), *ResponseContentType);
+			bServerIgnoredRange = true;
+			InOutLength = 0;
+			return;
+		}
+	}
+	
+	const bool bParsed = MultiRangeParser.Feed(static_cast<const uint8*>(DataPtr), static_cast<uint64>(InOutLength),
+		[this](uint64 Offset, const uint8* Data, uint64 Num)
+		{
+			// servers may merge ranges, so a part can cover several of ours
+			const uint64 End = Offset + Num;
+			for (StreamChunkDownloader::FMultiRangePart& Part : MultiRangeParts)
 			{
-				Request->CancelRequest();
+				const uint64 PartStart = Part.Chunk->StartOffset;
+				const uint64 CopyStart = FMath::Max(Offset, PartStart);
+				const uint64 CopyEnd = FMath::Min(End, Part.Chunk->EndOffset + 1);
+				// only bytes that continue what the part has, so it is always filled from its start
+				if (CopyStart >= CopyEnd || CopyStart - PartStart > Part.Received)
+				{
+					continue;
+				}
+				FMemory::Memcpy(Part.Chunk->Data.GetData() + (CopyStart - PartStart), Data + (CopyStart - Offset), CopyEnd - CopyStart);
+				Part.Received = FMath::Max(Part.Received, CopyEnd - PartStart);
+				CurrentChunkOffset.fetch_add(CopyEnd - CopyStart);
 			}
-			
-			RetryChunkDownload();
+		});
+	if (!bParsed)
+	{
+		LOG_WARN("Malformed multipart/byteranges response from '%s'", *GetActiveURL());
+		bServerIgnoredRange = true;
+		InOutLength = 0;
+	}
+}
+
+void FStreamChunkDownloader::HandOffMultiRangeParts()
+{
+	TArray<StreamChunkDownloader::FMultiRangePart> Parts = MoveTemp(MultiRangeParts);
+	MultiRangeParts.Reset();
+	ActiveChunk.Reset();
+	if (Parts[0].Received == 0)
+	{
+		// asking again would get the same answer
+		LOG_WARN("'%s' left the first range out of a multi-range response, fetching ranges one at a time", *GetActiveURL());
+		bMultiRangeUnsupported = true;
+	}
+	for (StreamChunkDownloader::FMultiRangePart& Part : Parts)
+	{
+		if (Part.Received == 0)
+		{
+			break;
 		}
-		else
+		const bool bComplete = Part.Received == static_cast<uint64>(Part.Chunk->Data.Num());
+		ActiveChunk = MoveTemp(Part.Chunk);
+		CurrentChunkOffset.store(Part.Received);
+		HandOffActiveChunk();
+		// the requested range cursor only moves forward, anything after a short part is fetched again
+		if (!bComplete)
 		{
-			LOG_ERROR("Stream download timed out after %d retries", MaxRetryCount);
-			InternalCancelDownload(EChunkStreamDownloadResult::NetworkError,
-				FString::Printf(TEXT("Stream download timed out after %d retries"), MaxRetryCount));
+			break;
 		}
 	}
+	CurrentChunkOffset.store(0);
 }
 
-float FStreamChunkDownloader::CalculateRetryDelay() const
+void FStreamChunkDownloader::CheckForStall()
 {
-	// Exponential backoff: delay = base * multiplier^retryCount
-	return RetryBackoffBaseSeconds * FMath::Pow(RetryBackoffMultiplier, static_cast<float>(CurrentRetryCount));
+	UpdateStallThreshold();
+	CheckForStalledRangeHelpers();
+	if (!bChunkRequestInFlight || bPaused)
+	{
+		// waiting on a retry delay or paused, nothing to stall
+		return;
+	}
+	double CurrentTime = FPlatformTime::Seconds();
+	if (HedgeChunk && CurrentTime - HedgeLastDataReceivedTime < StallDetectionTimeout)
+	{
+		// the hedge is still receiving the rest of this chunk, let the race finish
+		return;
+	}
+	if ( CurrentTime - LastDataReceivedTime >= StallDetectionTimeout)
+	{
+		LOG_WARN("Stream download stalled on '%s', no data for %.2fs (threshold %.2fs). Canceling request so it can be retried",
+			*GetActiveURL(), CurrentTime - LastDataReceivedTime, StallDetectionTimeout);
+		INC_DWORD_STAT(STAT_ChunkStreamStallsDetected);
+		NumStalls.fetch_add(1, std::memory_order_relaxed);
+		ChunkStreamTrace::Stall(TraceId, TraceRequestOffset, CurrentTime - LastDataReceivedTime);
+		
+		// Cancel current request, its completion goes through the normal retry/failover path
+		if (auto Request = CurrentHttpRequest.Pin())
+		{
+			Request->CancelRequest();
+		}
+	}
 }
 
-void FStreamChunkDownloader::RetryChunkDownload()
+void FStreamChunkDownloader::CheckForStalledRangeHelpers()
 {
-	CurrentRetryCount++;
-	
-	// Calculate delay using exponential backoff
-	float DelaySeconds = CalculateRetryDelay();
-	
-	LOG("Retrying chunk download after %.2f seconds (attempt %d/%d)", DelaySeconds, CurrentRetryCount, MaxRetryCount);
+	if (bPaused)
+	{
+		return;
+	}
+	TArray<TSharedPtr<IChunkStreamRequest, ESPMode::ThreadSafe>, TInlineAllocator<4>> ToCancel;
+	{
+		FScopeLock Lock(&ChunkDataLock);
+		const double CurrentTime = FPlatformTime::Seconds();
+		for (const TUniquePtr<StreamChunkDownloader::FRangeHelper>& Helper : RangeHelpers.GetHelpers())
+		{
+			// the threshold follows the chunk loop's packet gaps, waiting for the first byte gets the longest one
+			const bool bReceivedData = Helper->LastDataReceivedTime > 0.0;
+			const double Silent = CurrentTime - (bReceivedData ? Helper->LastDataReceivedTime : Helper->StartTime);
+			const float Threshold = bReceivedData ? StallDetectionTimeout : FMath::Max(StallDetectionTimeout, CVarStallTimeoutMax.GetValueOnAnyThread());
+			if (Silent < Threshold)
+			{
+				continue;
+			}
+			TSharedPtr<IChunkStreamRequest, ESPMode::ThreadSafe> Request = Helper->Request.Pin();
+			if (Request)
+			{
+				LOG_WARN("Range helper %u for '%s' stalled, no data for %.2fs. Canceling it, its range goes back to the chunk loop", Helper->Serial,
+					Mirrors.IsValidIndex(Helper->MirrorIndex) ? *Mirrors[Helper->MirrorIndex].URL : *URL, Silent);
+				INC_DWORD_STAT(STAT_ChunkStreamStallsDetected);
+				NumStalls.fetch_add(1, std::memory_order_relaxed);
+				// canceled once, its completion removes it
+				Helper->Request.Reset();
+				ToCancel.Add(MoveTemp(Request));
+			}
+		}
+	}
+	// its completion fails it and the chunk loop takes the range back
+	for (const TSharedPtr<IChunkStreamRequest, ESPMode::ThreadSafe>& Request : ToCancel)
+	{
+		Request->CancelRequest();
+	}
+}
+
+void FStreamChunkDownloader::UpdateStallThreshold()
+{
+	const float MinTimeout = FMath::Max(0.1f, CVarStallTimeoutMin.GetValueOnAnyThread());
+	const float MaxTimeout = FMath::Max(MinTimeout, CVarStallTimeoutMax.GetValueOnAnyThread());
+	const double Multiplier = FMath::Max(1.0f, CVarStallGapMultiplier.GetValueOnAnyThread());
 	
-	// Reset chunk state for retry
-	CurrentChunkOffset.store(0);
+	double Threshold = MaxTimeout;
+	{
+		FScopeLock Lock(&ChunkDataLock);
+		if (!bReceivedFirstByte)
+		{
+			// waiting for a response, judge against how long responses usually take
+			if (FirstByteSamples >= MinFirstByteSamples)
+			{
+				Threshold = Multiplier * (SmoothedFirstByteTime + 4.0 * FirstByteTimeDeviation);
+			}
+		}
+		else if (PacketGapSamples >= MinPacketGapSamples)
+		{
+			Threshold = Multiplier * (SmoothedPacketGap + 4.0 * PacketGapDeviation);
+		}
+		PacketGapAtLastCheck = static_cast<float>(SmoothedPacketGap);
+	}
 	
-	// Use a timer to delay the retry
-	auto pWeakThis = GetWeakThis();
-	RetryHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([pWeakThis](float DeltaTime) -> bool
+	StallDetectionTimeout = FMath::Clamp(static_cast<float>(Threshold), MinTimeout, MaxTimeout);
+}
+
+void FStreamChunkDownloader::RecordPacketTiming(double Now)
+{
+	// Smoothing as TCP does for round trip times (RFC 6298), deviation reacts faster than the mean
+	auto AddSample = [](double Sample, double& Smoothed, double& Deviation, int32& Samples)
 	{
-		if (pWeakThis.IsValid() && !pWeakThis.Pin()->IsCanceled())
+		if (Samples == 0)
 		{
-			auto Downloader = pWeakThis.Pin();
-			FTSTicker::GetCoreTicker().RemoveTicker(Downloader->RetryHandle);
-			// Start the download again
-			(Downloader->CurrentDownloadFuture = Downloader->DownloadChunk())
-				.Next([pWeakThis](bool bSuccess)
-				{
-					if (pWeakThis.IsValid())
-					{
-						if (!pWeakThis.Pin()->ActiveChunk.IsValid())
-						{
-							pWeakThis.Pin()->InitNewChunk();
-						}
-						if (bSuccess)
-						{
-							
-							pWeakThis.Pin()->CurrentRetryCount = 0;
-							pWeakThis.Pin()->ProcessNextChunk();
-						}
-						else
-						{
-							// Retry or fail will be handled in ProcessNextChunk
-							pWeakThis.Pin()->ProcessNextChunk();
-						}
-					}
-				});
+			Smoothed = Sample;
+			Deviation = Sample * 0.5;
 		}
-		return false; // Don't repeat the ticker
+		else
+		{
+			Deviation = Deviation * 0.75 + FMath::Abs(Sample - Smoothed) * 0.25;
+			Smoothed = Smoothed * 0.875 + Sample * 0.125;
+		}
+		Samples++;
+	};
+	
+	if (!bReceivedFirstByte)
+	{
+		bReceivedFirstByte = true;
+		AddSample(Now - ChunkRequestStartTime, SmoothedFirstByteTime, FirstByteTimeDeviation, FirstByteSamples);
+	}
+	else
+	{
+		AddSample(Now - LastDataReceivedTime, SmoothedPacketGap, PacketGapDeviation, PacketGapSamples);
+	}
+}
+
+void FStreamChunkDownloader::CheckForSlowChunk()
+{
+	if (!CVarHedgeEnabled.GetValueOnAnyThread() || !bChunkRequestInFlight || bPaused || bHedgedThisChunk
+		|| !bApiAcceptsRanges || !bShouldUseRanges || bUnknownTotalSize || MultiRangeParts.Num() > 0)
+	{
+		return;
+	}
+	
+	const double MedianThroughput = GetMedianChunkThroughput();
+	if (MedianThroughput <= 0.0)
+	{
+		return;
+	}
+	
+	const double Elapsed = FPlatformTime::Seconds() - ChunkRequestStartTime;
+	if (Elapsed < CVarHedgeMinElapsedSeconds.GetValueOnAnyThread())
+	{
+		return;
+	}
+	
+	uint64 Received = 0;
+	uint64 Remaining = 0;
+	{
+		FScopeLock Lock(&ChunkDataLock);
+		if (!ActiveChunk)
+		{
+			return;
+		}
+		Received = CurrentChunkOffset.load();
+		const uint64 Expected = CalculateRange();
+		Remaining = Received < Expected ? Expected - Received : 0;
+	}
+	if (Remaining < MinHedgeBytes)
+	{
+		return;
+	}
+	
+	const double ChunkThroughput = static_cast<double>(Received) / Elapsed;
+	if (ChunkThroughput < MedianThroughput * CVarHedgeThroughputRatio.GetValueOnAnyThread()
+		&& RangeHelpers.CanOpenExtraConnection())
+	{
+		// refused for now without memory for the copy, a later check tries again
+		if (StartHedgeRequest())
+		{
+			LOG_WARN("Chunk is downloading at %.2f KB/s against a median of %.2f KB/s, hedging the remaining %llu bytes",
+				ChunkThroughput / 1024.0, MedianThroughput / 1024.0, Remaining);
+		}
+	}
+}
+
+bool FStreamChunkDownloader::StartHedgeRequest()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FStreamChunkDownloader::StartHedgeRequest)
+	FScopeLock Lock(&ChunkDataLock);
+	if (!ActiveChunk || bCanceled)
+	{
+		return false;
+	}
+	const uint64 HedgeBytes = ActiveChunk->EndOffset - (ActiveChunk->StartOffset + CurrentChunkOffset.load()) + 1;
+	FChunkStreamMemoryReservation HedgeMemory = FChunkStreamMemoryBudget::Get().TryReserve(HedgeBytes, HedgeBytes);
+	if (!HedgeMemory.IsValid())
+	{
+		// a second copy of the chunk isn't worth waiting for memory, the next check may find some
+		return false;
+	}
+	HedgeSerial++;
+	const uint32 Serial = HedgeSerial;
+	
+	HedgeStartInChunk = CurrentChunkOffset.load();
+	HedgeChunkOffset = 0;
+	HedgeChunk = MakeUnique<StreamChunkDownloader::FChunkInfo>();
+	HedgeChunk->StartOffset = ActiveChunk->StartOffset + HedgeStartInChunk;
+	HedgeChunk->EndOffset = ActiveChunk->EndOffset;
+	HedgeChunk->TotalFileSize = TotalFileSize;
+	HedgeChunk->Memory = MoveTemp(HedgeMemory);
+	HedgeChunk->Data.SetNumUninitialized(HedgeChunk->EndOffset - HedgeChunk->StartOffset + 1);
+	
+	// prefer another mirror, a slow host is likely to stay slow
+	HedgeMirrorIndex = FindFailoverMirror();
+	if (HedgeMirrorIndex == INDEX_NONE)
+	{
+		HedgeMirrorIndex = ActiveMirrorIndex;
+	}
+	HedgeResponseCode.store(0);
+	HedgeStartTime = FPlatformTime::Seconds();
+	HedgeLastDataReceivedTime = HedgeStartTime;
+	
+	auto NewRequest = MakeHttpRequest(Mirrors[HedgeMirrorIndex].URL, TEXT("GET"), TimeoutInSeconds, ContentType);
+	ApplyCommonHeaders(NewRequest);
+	NewRequest->SetHeader(TEXT("Range"),
+		FString::Printf(TEXT("bytes=%llu-%llu"), HedgeChunk->StartOffset, HedgeChunk->EndOffset));
+	
+	auto pWeakThis = GetWeakThis();
+	NewRequest->OnStatusCode()
+		.BindLambda([pWeakThis](int32 StatusCode)
+		{
+			if (pWeakThis.IsValid())
+			{
+				pWeakThis.Pin()->HedgeResponseCode.store(StatusCode);
+			}
+		});
+	NewRequest->OnComplete()
+		.BindLambda([pWeakThis, Serial](FChunkStreamResponsePtr Response, bool bSuccess)
+		{
+			if (pWeakThis.IsValid())
+			{
+				pWeakThis.Pin()->OnHedgeRequestComplete(bSuccess, Serial);
+			}
+		});
+	NewRequest->OnBody().BindSP(this, &FStreamChunkDownloader::OnHedgeStream, Serial);
+	
+	HedgeHttpRequest = NewRequest;
+	bHedgedThisChunk = true;
+	if (!NewRequest->ProcessRequest())
+	{
+		LOG_WARN("Failed to start hedge request to '%s'", *Mirrors[HedgeMirrorIndex].URL);
+		HedgeHttpRequest.Reset();
+		HedgeChunk.Reset();
+		return false;
+	}
+	return true;
+}
+
+void FStreamChunkDownloader::OnHedgeStream(void* DataPtr, int64& InOutLength, uint32 Serial)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FStreamChunkDownloader::OnHedgeStream)
+	FScopeLock Lock(&ChunkDataLock);
+	// only a 206 is the range we asked for, a 200 would be the whole file from offset 0
+	if (Serial != HedgeSerial || !HedgeChunk || HedgeResponseCode.load() != 206)
+	{
+		return;
+	}
+	HedgeLastDataReceivedTime = FPlatformTime::Seconds();
+	
+	const uint64 Space = static_cast<uint64>(HedgeChunk->Data.Num()) - HedgeChunkOffset;
+	const uint64 ToCopy = FMath::Min(Space, static_cast<uint64>(InOutLength));
+	if (ToCopy > 0)
+	{
+		FMemory::Memcpy(HedgeChunk->Data.GetData() + HedgeChunkOffset, DataPtr, ToCopy);
+		HedgeChunkOffset += ToCopy;
+	}
+}
+
+void FStreamChunkDownloader::OnHedgeRequestComplete(bool bSuccess, uint32 Serial)
+{
+	TSharedPtr<IChunkStreamRequest, ESPMode::ThreadSafe> PrimaryToCancel;
+	{
+		FScopeLock Lock(&ChunkDataLock);
+		if (Serial != HedgeSerial || !HedgeChunk || bCanceled)
+		{
+			// the primary already finished or the download moved on
+			return;
+		}
+		HedgeHttpRequest.Reset();
+		
+		const uint64 HedgeBytes = static_cast<uint64>(HedgeChunk->Data.Num());
+		if (bSuccess && HedgeResponseCode.load() == 206 && HedgeChunkOffset == HedgeBytes
+			&& ActiveChunk && bChunkRequestInFlight && CurrentChunkOffset.load() < CalculateRange())
+		{
+			LOG("Hedged request to '%s' finished first, canceling the slow request", *Mirrors[HedgeMirrorIndex].URL);
+			
+			// the primary has everything before the hedge start, the hedge has the rest
+			FMemory::Memcpy(GetActiveChunkData() + HedgeStartInChunk, HedgeChunk->Data.GetData(), HedgeBytes);
+			PrimaryBytesAtHedgeWin = CurrentChunkOffset.load();
+			CurrentChunkOffset.store(HedgeStartInChunk + HedgeBytes);
+			bHedgeWon = true;
+			
+			// the mirror that won gets credit for its speed
+			const double HedgeSeconds = FPlatformTime::Seconds() - HedgeStartTime;
+			if (Mirrors.IsValidIndex(HedgeMirrorIndex))
+			{
+				Mirrors[HedgeMirrorIndex].RecordSuccess(HedgeBytes, HedgeSeconds);
+			}
+			HedgeChunk.Reset();
+			PrimaryToCancel = CurrentHttpRequest.Pin();
+		}
+		else
+		{
+			LOG_VERBOSE("Hedge request to '%s' did not complete the chunk (status %d), keeping the original request",
+				*Mirrors[HedgeMirrorIndex].URL, HedgeResponseCode.load());
+			HedgeChunk.Reset();
+		}
+	}
+	
+	// completion of the canceled primary hands off the chunk the hedge filled
+	if (PrimaryToCancel)
+	{
+		PrimaryToCancel->CancelRequest();
+	}
+}
+
+void FStreamChunkDownloader::CancelHedge()
+{
+	HedgeSerial++;
+	HedgeChunk.Reset();
+	HedgeChunkOffset = 0;
+	if (TSharedPtr<IChunkStreamRequest, ESPMode::ThreadSafe> Request = HedgeHttpRequest.Pin())
+	{
+		HedgeHttpRequest.Reset();
+		if (IsInGameThread())
+		{
+			Request->CancelRequest();
+		}
+		else
+		{
+			// a stream overflowing into the next chunk lands here on the http thread, inside its own callback,
+			// the serial bump above already makes the hedge's late callbacks no-ops
+			AsyncTask(ENamedThreads::GameThread, [Request]()
+			{
+				Request->CancelRequest();
+			});
+		}
+	}
+}
+
+int32 FStreamChunkDownloader::GetNumConnections() const
+{
+	return (bChunkRequestInFlight ? 1 : 0) + GetNumExtraConnections();
+}
+
+int32 FStreamChunkDownloader::GetNumExtraConnections() const
+{
+	// a hedge can be dropped from the http thread when a stream runs into the next chunk
+	FScopeLock Lock(&ChunkDataLock);
+	return (HedgeHttpRequest.IsValid() ? 1 : 0) + RangeHelpers.Num();
+}
+
+bool FStreamChunkDownloader::CanUseRangeHelpers() const
+{
+	return RangeHelpers.IsEnabled() && bHasStarted && !bCanceled && !bPaused && !bChunkLoopFinished && bApiAcceptsRanges && bShouldUseRanges
+		&& !bUnknownTotalSize && !HasRequestedRanges() && TotalFileSize > 0 && MaxChunkSize > 0;
+}
+
+TArray<StreamChunkDownloader::FByteRange> FStreamChunkDownloader::GetUnclaimedRanges() const
+{
+	FScopeLock Lock(&ChunkDataLock);
+	TArray<StreamChunkDownloader::FByteRange> Claimed = DownloadedAheadRanges;
+	if (ActiveChunk)
+	{
+		StreamChunkDownloader::FByteRange::AddMerged(Claimed, StreamChunkDownloader::FByteRange(ActiveChunk->StartOffset, ActiveChunk->EndOffset));
+	}
+	RangeHelpers.AddClaimedRanges(Claimed);
+	TArray<StreamChunkDownloader::FByteRange> Unclaimed;
+	uint64 Cursor = GetSequentialOffset();
+	for (const StreamChunkDownloader::FByteRange& Range : Claimed)
+	{
+		if (Range.Start > Cursor)
+		{
+			Unclaimed.Emplace(Cursor, FMath::Min(Range.Start, TotalFileSize) - 1);
+		}
+		Cursor = FMath::Max(Cursor, Range.End + 1);
+		if (Cursor >= TotalFileSize)
+		{
+			break;
+		}
+	}
+	if (Cursor < TotalFileSize)
+	{
+		Unclaimed.Emplace(Cursor, TotalFileSize - 1);
+	}
+	return Unclaimed;
+}
+
+uint64 FStreamChunkDownloader::GetStealableBytes() const
+{
+	if (!CanUseRangeHelpers())
+	{
+		return 0;
+	}
+	uint64 Largest = 0;
+	for (const StreamChunkDownloader::FByteRange& Range : GetUnclaimedRanges())
+	{
+		Largest = FMath::Max(Largest, Range.Num());
+	}
+	return Largest;
+}
+
+bool FStreamChunkDownloader::StartRangeHelper(uint64 MinBytes)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FStreamChunkDownloader::StartRangeHelper)
+	if (!CanUseRangeHelpers())
+	{
+		return false;
+	}
+	// held until the helper is added, so the range it takes can't be claimed meanwhile
+	FScopeLock Lock(&ChunkDataLock);
+	const TArray<StreamChunkDownloader::FByteRange> Unclaimed = GetUnclaimedRanges();
+	const StreamChunkDownloader::FByteRange* Largest = nullptr;
+	for (const StreamChunkDownloader::FByteRange& Range : Unclaimed)
+	{
+		if (!Largest || Range.Num() > Largest->Num())
+		{
+			Largest = &Range;
+		}
+	}
+	// the end of the largest range, halving it each time so the last bytes of the file are spread over every connection
+	const uint64 Bytes = FMath::Min<uint64>(MaxChunkSize, Largest ? AlignDown(Largest->Num() / 2, 4096) : 0);
+	if (Bytes < FMath::Max<uint64>(MinBytes, 1))
+	{
+		return false;
+	}
+	FChunkStreamMemoryReservation Memory;
+	if (!MappedFile)
+	{
+		Memory = FChunkStreamMemoryBudget::Get().TryReserve(Bytes, Bytes);
+		if (!Memory.IsValid())
+		{
+			return false;
+		}
+	}
+	
+	TUniquePtr<StreamChunkDownloader::FRangeHelper> Helper = MakeUnique<StreamChunkDownloader::FRangeHelper>();
+	Helper->Serial = RangeHelpers.NextSerial();
+	Helper->Chunk = MakeUnique<StreamChunkDownloader::FChunkInfo>();
+	Helper->Chunk->StartOffset = Largest->End + 1 - Bytes;
+	Helper->Chunk->EndOffset = Largest->End;
+	Helper->Chunk->TotalFileSize = TotalFileSize;
+	if (MappedFile)
+	{
+		Helper->Chunk->MappedFile = MappedFile;
+	}
+	else
+	{
+		Helper->Chunk->Memory = MoveTemp(Memory);
+		Helper->Chunk->Data.SetNumUninitialized(Bytes);
+	}
+	const uint32 Serial = Helper->Serial;
+	Helper->MirrorIndex = FindRangeHelperMirror();
+	Helper->StartTime = FPlatformTime::Seconds();
+	const FString HelperURL = Mirrors.IsValidIndex(Helper->MirrorIndex) ? Mirrors[Helper->MirrorIndex].URL : URL;
+	LOG_VERBOSE("Range helper %u takes bytes %llu-%llu of '%s'", Serial, Helper->Chunk->StartOffset, Helper->Chunk->EndOffset, *HelperURL);
+	
+	auto NewRequest = MakeHttpRequest(HelperURL, TEXT("GET"), TimeoutInSeconds, ContentType);
+	ApplyCommonHeaders(NewRequest);
+	NewRequest->SetHeader(TEXT("Range"), FString::Printf(TEXT("bytes=%llu-%llu"), Helper->Chunk->StartOffset, Helper->Chunk->EndOffset));
+	
+	auto pWeakThis = GetWeakThis();
+	NewRequest->OnStatusCode()
+		.BindLambda([pWeakThis, Serial](int32 StatusCode)
+		{
+			if (TSharedPtr<FStreamChunkDownloader> Downloader = pWeakThis.Pin())
+			{
+				FScopeLock Lock(&Downloader->ChunkDataLock);
+				if (StreamChunkDownloader::FRangeHelper* RangeHelper = Downloader->RangeHelpers.Find(Serial))
+				{
+					RangeHelper->ResponseCode = StatusCode;
+				}
+			}
+		});
+	NewRequest->OnComplete()
+		.BindLambda([pWeakThis, Serial](FChunkStreamResponsePtr Response, bool bSuccess)
+		{
+			if (pWeakThis.IsValid())
+			{
+				pWeakThis.Pin()->OnRangeHelperComplete(bSuccess, Serial);
+			}
+		});
+	NewRequest->OnBody().BindSP(this, &FStreamChunkDownloader::OnRangeHelperStream, Serial);
+	Helper->Request = NewRequest;
+	RangeHelpers.Add(MoveTemp(Helper));
+	Lock.Unlock();
+	if (!NewRequest->ProcessRequest())
+	{
+		LOG_WARN("Failed to start a range helper request for '%s'", *HelperURL);
+		FScopeLock RemoveLock(&ChunkDataLock);
+		RangeHelpers.Remove(Serial);
+		return false;
+	}
+	return true;
+}
+
+bool FStreamChunkDownloader::SkipRangeHelperRanges()
+{
+	if (RangeHelpers.Num() == 0 || HasRequestedRanges() || bUnknownTotalSize)
+	{
+		return true;
+	}
+	const TArray<StreamChunkDownloader::FByteRange> Unclaimed = GetUnclaimedRanges();
+	if (Unclaimed.Num() == 0)
+	{
+		return false;
+	}
+	// keep a reader's jump ahead if it isn't on a helper's range, otherwise the first byte nobody has
+	const uint64 Start = AheadCursor != MAX_uint64 ? AheadCursor : GetSequentialOffset();
+	const StreamChunkDownloader::FByteRange* Next = Unclaimed.FindByPredicate([Start](const StreamChunkDownloader::FByteRange& Range) { return Range.End >= Start; });
+	const uint64 NextStart = Next ? FMath::Max(Next->Start, Start) : Unclaimed[0].Start;
+	AheadCursor = NextStart == GetSequentialOffset() ? MAX_uint64 : NextStart;
+	return true;
+}
+
+void FStreamChunkDownloader::OnRangeHelperStream(void* DataPtr, int64& InOutLength, uint32 Serial)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FStreamChunkDownloader::OnRangeHelperStream)
+	FScopeLock Lock(&ChunkDataLock);
+	StreamChunkDownloader::FRangeHelper* Found = RangeHelpers.Find(Serial);
+	// only a 206 is the range we asked for, a 200 would be the whole file from offset 0
+	if (!Found || Found->ResponseCode != 206)
+	{
+		return;
+	}
+	StreamChunkDownloader::FRangeHelper& Helper = *Found;
+	Helper.LastDataReceivedTime = FPlatformTime::Seconds();
+	AddReceivedBytes(InOutLength);
+	
+	const uint64 Space = Helper.Chunk->EndOffset - Helper.Chunk->StartOffset + 1 - Helper.Received;
+	const uint64 ToCopy = FMath::Min(Space, static_cast<uint64>(InOutLength));
+	if (ToCopy > 0)
+	{
+		uint8* Destination = Helper.Chunk->MappedFile ? Helper.Chunk->MappedFile->GetData() + Helper.Chunk->StartOffset : Helper.Chunk->Data.GetData();
+		FMemory::Memcpy(Destination + Helper.Received, DataPtr, ToCopy);
+		Helper.Received += ToCopy;
+	}
+}
+
+void FStreamChunkDownloader::OnRangeHelperComplete(bool bSuccess, uint32 Serial)
+{
+	TUniquePtr<StreamChunkDownloader::FChunkInfo> Chunk;
+	{
+		FScopeLock Lock(&ChunkDataLock);
+		if (bCanceled)
+		{
+			return;
+		}
+		TUniquePtr<StreamChunkDownloader::FRangeHelper> Helper = RangeHelpers.Remove(Serial);
+		if (!Helper)
+		{
+			// dropped by a pause or cancel
+			return;
+		}
+		const uint64 Bytes = Helper->Chunk->EndOffset - Helper->Chunk->StartOffset + 1;
+		StreamChunkDownloader::FMirrorState* Mirror = Mirrors.IsValidIndex(Helper->MirrorIndex) ? &Mirrors[Helper->MirrorIndex] : nullptr;
+		if (bSuccess && Helper->ResponseCode == 206 && Helper->Received == Bytes)
+		{
+			AddDownloadedAheadRange(Helper->Chunk->StartOffset, Helper->Chunk->EndOffset, false);
+			Chunk = MoveTemp(Helper->Chunk);
+			
+			// the mirror that served it gets credit for its speed, as for a chunk of the loop
+			if (Mirror)
+			{
+				Mirror->RecordSuccess(Bytes, FPlatformTime::Seconds() - Helper->StartTime);
+			}
+		}
+		else
+		{
+			// the chunk loop fetches it instead, and helpers leave the mirror alone for a while
+			LOG_VERBOSE("Range helper %u for '%s' failed (status %d, %llu of %llu bytes)", Serial, Mirror ? *Mirror->URL : *URL,
+				Helper->ResponseCode, Helper->Received, Bytes);
+			if (Mirror)
+			{
+				Mirror->RecordFailure(RetryBackoffBaseSeconds, RetryBackoffMultiplier);
+			}
+		}
+	}
+	if (Chunk)
+	{
+		ChunkStreamTrace::HandOff(TraceId, Chunk->StartOffset, Chunk->EndOffset - Chunk->StartOffset + 1);
+		OnSingleChunkCompleteDelegate.Execute(MoveTemp(Chunk));
+		OnChunkDownloadProgress(0);
+	}
+	if (bWaitingForRangeHelpers && !bPaused)
+	{
+		bWaitingForRangeHelpers = false;
+		StartNextChunkOrFinish();
+	}
+}
+
+void FStreamChunkDownloader::CancelRangeHelpers()
+{
+	const TArray<TUniquePtr<StreamChunkDownloader::FRangeHelper>> Helpers = RangeHelpers.RemoveAll();
+	for (const TUniquePtr<StreamChunkDownloader::FRangeHelper>& Helper : Helpers)
+	{
+		if (TSharedPtr<IChunkStreamRequest, ESPMode::ThreadSafe> Request = Helper->Request.Pin())
+		{
+			Request->CancelRequest();
+		}
+	}
+}
+
+void FStreamChunkDownloader::AddReceivedBytes(int64 Num)
+{
+	ChunkStreamTrace::AddBytesReceived(Num);
+	BytesReceived.fetch_add(Num, std::memory_order_relaxed);
+	const double RateNow = FPlatformTime::Seconds();
+	if (RateWindowStartTime == 0.0 || RateNow - RateWindowStartTime >= RateWindowSeconds * 2.0)
+	{
+		// first data, or the first after a gap that a window shouldn't average over
+		RateWindowStartTime = RateNow;
+		RateWindowBytes = 0;
+	}
+	RateWindowBytes += Num;
+	if (RateNow - RateWindowStartTime >= RateWindowSeconds)
+	{
+		LastWindowBytesPerSecond.store(RateWindowBytes / (RateNow - RateWindowStartTime), std::memory_order_relaxed);
+		LastWindowEndTime.store(RateNow, std::memory_order_relaxed);
+		RateWindowStartTime = RateNow;
+		RateWindowBytes = 0;
+	}
+}
+
+double FStreamChunkDownloader::GetMedianChunkThroughput() const
+{
+	if (RecentChunkThroughputs.Num() < MinThroughputSamplesForHedge)
+	{
+		return 0.0;
+	}
+	TArray<double> Sorted = RecentChunkThroughputs;
+	Sorted.Sort();
+	return Sorted[Sorted.Num() / 2];
+}
+
+float FStreamChunkDownloader::CalculateRetryDelay() const
+{
+	// Exponential backoff: delay = base * multiplier^failures, counted per mirror so failing over to a healthy mirror is quick
+	const int32 Failures = Mirrors.IsValidIndex(ActiveMirrorIndex) ? Mirrors[ActiveMirrorIndex].ConsecutiveFailures : CurrentRetryCount;
+	return RetryBackoffBaseSeconds * FMath::Pow(RetryBackoffMultiplier, static_cast<float>(Failures));
+}
+
+void FStreamChunkDownloader::RetryChunkDownload()
+{
+	CurrentRetryCount++;
+	NumRetries.fetch_add(1, std::memory_order_relaxed);
+	
+	// Calculate delay using exponential backoff
+	float DelaySeconds = CalculateRetryDelay();
+	
+	LOG("Retrying chunk download from '%s' after %.2f seconds (attempt %d/%d)", *GetActiveURL(), DelaySeconds, CurrentRetryCount, GetMaxRetryAttempts());
+	ChunkStreamTrace::Retry(TraceId, TraceRequestOffset, CurrentRetryCount, DelaySeconds);
+	
+	// Reset chunk state for retry
+	CurrentChunkOffset.store(0);
+	bRetryPending = true;
+	
+	if (!HasRequestedRanges() && !bShouldUseRanges && ActiveChunk && ActiveChunk->StartOffset > 0)
+	{
+		// the failed request streamed the file without Range and got part way, a new one would start from byte 0
+		if (bApiAcceptsRanges && !bUnknownTotalSize)
+		{
+			bShouldUseRanges = true;
+		}
+		else
+		{
+			LOG_WARN("'%s' doesn't accept ranges, downloading it from the start again", *GetActiveURL());
+			LastChunkEndOffset = 0;
+			ActiveChunk.Reset();
+		}
+	}
+	
+	// Use a timer to delay the retry
+	auto pWeakThis = GetWeakThis();
+	RetryHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([pWeakThis](float DeltaTime) -> bool
+	{
+		if (pWeakThis.IsValid() && !pWeakThis.Pin()->IsCanceled())
+		{
+			auto Downloader = pWeakThis.Pin();
+			FTSTicker::GetCoreTicker().RemoveTicker(Downloader->RetryHandle);
+			Downloader->bRetryPending = false;
+			if (!Downloader->ActiveChunk.IsValid())
+			{
+				Downloader->InitNewChunk();
+			}
+			// Start the download again
+			Downloader->StartActiveChunkRequest();
+		}
+		return false; // Don't repeat the ticker
 	}), DelaySeconds);
 }
 
-FHttpRequestType FStreamChunkDownloader::MakeHttpRequest(const FString& URL, const FString& Verb, float Timeout,
+bool FStreamChunkDownloader::ReserveChunkMemory()
+{
+	if (NextChunkMemory.IsValid() || MappedFile)
+	{
+		return true;
+	}
+	// a download of unknown size tells its end by a chunk coming up short, so its chunks keep their size
+	const uint64 MinChunkBytes = bUnknownTotalSize ? MaxChunkSize : FMath::Min<uint64>(MaxChunkSize, MinBudgetChunkSize);
+	NextChunkMemory = FChunkStreamMemoryBudget::Get().TryReserve(MaxChunkSize + BufferPadding, MinChunkBytes + BufferPadding);
+	return NextChunkMemory.IsValid();
+}
+
+void FStreamChunkDownloader::WaitForChunkMemory()
+{
+	if (bWaitingForMemory)
+	{
+		return;
+	}
+	bWaitingForMemory = true;
+	LOG("Waiting for chunk memory for '%s', %.1f of %.1f MB budget held", *URL,
+		FChunkStreamMemoryBudget::Get().GetReserved() / (1024.0 * 1024.0), FChunkStreamMemoryBudget::Get().GetBudget() / (1024.0 * 1024.0));
+	auto pWeakThis = GetWeakThis();
+	MemoryWaitHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([pWeakThis](float DeltaTime) -> bool
+	{
+		TSharedPtr<FStreamChunkDownloader> Downloader = pWeakThis.Pin();
+		if (!Downloader.IsValid() || Downloader->IsCanceled())
+		{
+			return false;
+		}
+		if (!Downloader->ReserveChunkMemory())
+		{
+			return true;
+		}
+		Downloader->bWaitingForMemory = false;
+		Downloader->StartNextChunkOrFinish();
+		return false;
+	}), MemoryWaitInterval);
+}
+
+void FStreamChunkDownloader::ApplyCommonHeaders(const FChunkStreamRequestRef& Request) const
+{
+	if (bRequestIdentityEncoding)
+	{
+		Request->SetHeader(TEXT("Accept-Encoding"), TEXT("identity"));
+	}
+}
+
+FChunkStreamRequestRef FStreamChunkDownloader::MakeHttpRequest(const FString& URL, const FString& Verb, float Timeout,
                                                          const FString& ContentType)
 {
-	FHttpRequestType Request = FHttpModule::Get().CreateRequest();
+	FChunkStreamRequestRef Request = ChunkStreamTransport::CreateRequest(URL);
 	
 	Request->SetVerb(Verb);
-	Request->SetURL(URL);
 	if (!ContentType.IsEmpty())
 		Request->SetHeader("Content-Type", ContentType);
-#ifndef OLD_HTTP
 	Request->SetTimeout(Timeout);
-#endif
 
 	return Request;
 }
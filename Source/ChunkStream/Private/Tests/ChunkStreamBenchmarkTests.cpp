@@ -0,0 +1,67 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#if WITH_AUTOMATION_TESTS
+#include "ChunkStreamBenchmark.h"
+#include "HAL/FileManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamBenchmarkSweepTest, "ChunkStream.Benchmark.Sweep",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool ChunkStreamBenchmarkSweepTest::RunTest(const FString& Parameters)
+{
+	// a small sweep, the full one is "ChunkStream.Benchmark" in the console
+	FChunkStreamBenchmarkSettings Settings;
+	TestTrue(TEXT("Arguments parse"), Settings.ParseArguments(TEXT("Sizes=1K,3M ChunkSizes=1 Concurrency=1,2 Ranges=1,0 Timeout=60")));
+	TestFalse(TEXT("Bad arguments are rejected"), FChunkStreamBenchmarkSettings().ParseArguments(TEXT("Sizes=lots")));
+	Settings.OutputDirectory = FPaths::ProjectIntermediateDir() / TEXT("ChunkStreamBenchmarkTest");
+	
+	TSharedRef<FChunkStreamBenchmark> Benchmark = MakeShared<FChunkStreamBenchmark>(Settings);
+	TSharedRef<bool> bDone = MakeShared<bool>(false);
+	Benchmark->Start(FOnChunkStreamBenchmarkComplete::CreateLambda([bDone](const TArray<FChunkStreamBenchmarkResult>&)
+	{
+		*bDone = true;
+	}));
+	
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, Benchmark, bDone, Settings, StartTime = FPlatformTime::Seconds()]()
+	{
+		if (!*bDone)
+		{
+			if (FPlatformTime::Seconds() - StartTime < 300.0)
+			{
+				return false;
+			}
+			AddError(TEXT("Benchmark sweep timed out"));
+			Benchmark->Stop();
+			return true;
+		}
+		
+		const TArray<FChunkStreamBenchmarkResult>& Results = Benchmark->GetResults();
+		TestEqual(TEXT("Every combination ran"), Results.Num(), 8);
+		for (const FChunkStreamBenchmarkResult& Result : Results)
+		{
+			TestTrue(FString::Printf(TEXT("%llu bytes, %d at once, ranges %d succeeded"), Result.Case.FileSize, Result.Case.Concurrency, Result.Case.bAcceptRanges),
+				Result.bSucceeded);
+			TestTrue(TEXT("Throughput measured"), Result.MegabytesPerSecond > 0.0);
+			TestTrue(TEXT("First byte before the end"), Result.MeanTimeToFirstByteMs <= Result.Seconds * 1000.0 + 1.0);
+		}
+		
+		FString CSV;
+		TestTrue(TEXT("CSV saved"), FFileHelper::LoadFileToString(CSV, *Benchmark->GetCSVPath()));
+		TArray<FString> Lines;
+		CSV.ParseIntoArrayLines(Lines);
+		TestEqual(TEXT("CSV has a header and a row per case"), Lines.Num(), Results.Num() + 1);
+		FString JSON;
+		TestTrue(TEXT("JSON saved"), FFileHelper::LoadFileToString(JSON, *Benchmark->GetJSONPath()));
+		TestTrue(TEXT("JSON has the results"), JSON.Contains(TEXT("\"results\"")) && JSON.Contains(TEXT("\"mb_per_second\"")));
+		
+		IFileManager::Get().DeleteDirectory(*Settings.OutputDirectory, false, true);
+		return true;
+	}));
+	return true;
+}
+
+#endif //WITH_AUTOMATION_TESTS
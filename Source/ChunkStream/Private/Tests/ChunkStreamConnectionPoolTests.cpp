@@ -0,0 +1,217 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#if WITH_AUTOMATION_TESTS
+#include "ChunkStreamDownloader.h"
+#include "ChunkStreamMemoryTransport.h"
+#include "ChunkStreamTestHelpers.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UObject/StrongObjectPtr.h"
+
+
+namespace ChunkStreamConnectionPoolTests
+{
+	struct FPoolDownload
+	{
+		TStrongObjectPtr<UChunkStreamDownloader> Downloader;
+		FString URL;
+		FString SavePath;
+		bool bDone = false;
+		EChunkStreamDownloadResult Result = EChunkStreamDownloadResult::InProgress;
+	};
+	
+	// The pool's console variables for a test, put back by Restore
+	struct FPoolSettings
+	{
+		int32 OldMaxConnections = 0;
+		int32 OldMaxChunkSize = 0;
+		int32 OldHedgeEnabled = 0;
+		int32 OldMinStealSize = 0;
+		
+		FPoolSettings(int32 MaxConnections, int32 MaxChunkSizeMB)
+		{
+			OldMaxConnections = Find(TEXT("ChunkStream.MaxConnections"))->GetInt();
+			OldMaxChunkSize = Find(TEXT("ChunkStream.MaxChunkSize"))->GetInt();
+			OldHedgeEnabled = Find(TEXT("ChunkStream.HedgeEnabled"))->GetInt();
+			OldMinStealSize = Find(TEXT("ChunkStream.MinStealSizeKB"))->GetInt();
+			Find(TEXT("ChunkStream.MaxConnections"))->Set(MaxConnections);
+			Find(TEXT("ChunkStream.MaxChunkSize"))->Set(MaxChunkSizeMB);
+			// a hedge would request bytes a second time
+			Find(TEXT("ChunkStream.HedgeEnabled"))->Set(0);
+			Find(TEXT("ChunkStream.MinStealSizeKB"))->Set(1024);
+		}
+		
+		void Restore() const
+		{
+			Find(TEXT("ChunkStream.MaxConnections"))->Set(OldMaxConnections);
+			Find(TEXT("ChunkStream.MaxChunkSize"))->Set(OldMaxChunkSize);
+			Find(TEXT("ChunkStream.HedgeEnabled"))->Set(OldHedgeEnabled);
+			Find(TEXT("ChunkStream.MinStealSizeKB"))->Set(OldMinStealSize);
+		}
+		
+		static IConsoleVariable* Find(const TCHAR* Name) { return IConsoleManager::Get().FindConsoleVariable(Name); }
+	};
+	
+	TSharedRef<FPoolDownload> StartDownload(FChunkStreamMemoryTransport& Server, const FString& URL, uint64 FileSize, double BytesPerSecond)
+	{
+		FChunkStreamMemoryFileSettings Settings;
+		Settings.FileSize = FileSize;
+		Settings.BytesPerSecond = BytesPerSecond;
+		Server.AddFile(URL, Settings);
+		
+		TSharedRef<FPoolDownload> Download = MakeShared<FPoolDownload>();
+		Download->URL = URL;
+		Download->SavePath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("ChunkStreamTests"), FPaths::GetCleanFilename(URL));
+		Download->Downloader.Reset(UChunkStreamDownloader::DownloadFileToStorage(nullptr, URL, Download->SavePath));
+		TWeakPtr<FPoolDownload> WeakDownload = Download;
+		Download->Downloader->Native_DownloadFinished.AddLambda([WeakDownload](FChunkStreamResultParams Params)
+		{
+			if (TSharedPtr<FPoolDownload> PinnedDownload = WeakDownload.Pin())
+			{
+				PinnedDownload->Result = Params.DownloadTaskResult;
+				PinnedDownload->bDone = true;
+			}
+		});
+		Download->Downloader->Activate();
+		return Download;
+	}
+	
+	void CheckDownload(FAutomationTestBase& Test, const FPoolDownload& Download, uint64 FileSize)
+	{
+		if (!Download.bDone)
+		{
+			Test.AddError(FString::Printf(TEXT("Download of '%s' timed out"), *Download.URL));
+		}
+		else
+		{
+			Test.TestTrue(TEXT("Download succeeded"), Download.Result == EChunkStreamDownloadResult::Success);
+			const TArray64<uint8> Expected = ChunkStreamTests::MakeSynthetic(FileSize);
+			TArray64<uint8> Written;
+			Test.TestTrue(TEXT("Read back"), FFileHelper::LoadFileToArray(Written, *Download.SavePath));
+			Test.TestTrue(TEXT("File bytes"), Written == Expected);
+		}
+		IFileManager::Get().Delete(*Download.SavePath);
+	}
+	
+	// "bytes=a-b" as a and b
+	bool ParseRange(const FString& Header, uint64& OutStart, uint64& OutEnd)
+	{
+		FString Range;
+		FString Start;
+		FString End;
+		if (!Header.Split(TEXT("="), nullptr, &Range) || !Range.Split(TEXT("-"), &Start, &End))
+		{
+			return false;
+		}
+		OutStart = FCString::Strtoui64(*Start, nullptr, 10);
+		OutEnd = FCString::Strtoui64(*End, nullptr, 10);
+		return true;
+	}
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamConnectionPoolStealingTest, "ChunkStream.ConnectionPool.Stealing",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamConnectionPoolStealingTest::RunTest(const FString& Parameters)
+{
+	using namespace ChunkStreamConnectionPoolTests;
+	
+	// 1 MB chunks of 8 MB at 512 KB/s a request, the three connections the download isn't using take 1 MB ranges off the end
+	const FPoolSettings Settings(4, 1);
+	ChunkStreamTests::FMemoryServerRef Server = ChunkStreamTests::RegisterMemoryServer(TEXT("chunkstream-pool"));
+	const uint64 FileSize = 8 * 1024 * 1024 + 333;
+	TSharedRef<FPoolDownload> Download = StartDownload(*Server, TEXT("chunkstream-pool://files/pool_stealing.bin"), FileSize, 512.0 * 1024.0);
+	
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, Server, Download, Settings, FileSize, StartTime = FPlatformTime::Seconds()]()
+	{
+		if (!Download->bDone && FPlatformTime::Seconds() - StartTime < 60.0)
+		{
+			return false;
+		}
+		CheckDownload(*this, *Download, FileSize);
+		
+		TArray<TPair<uint64, uint64>> Ranges;
+		for (const FString& Header : Server->GetRangeHeaders(Download->URL))
+		{
+			uint64 Start = 0;
+			uint64 End = 0;
+			if (ParseRange(Header, Start, End))
+			{
+				Ranges.Emplace(Start, End);
+			}
+		}
+		// while the first chunk downloads the largest range left is the rest of the file, each helper takes its last MB
+		const uint64 MB = 1024 * 1024;
+		for (uint64 Helper = 1; Helper <= 3; Helper++)
+		{
+			const TPair<uint64, uint64> Stolen(FileSize - Helper * MB, FileSize - (Helper - 1) * MB - 1);
+			TestEqual(FString::Printf(TEXT("Range helper %llu took bytes %llu-%llu"), Helper, Stolen.Key, Stolen.Value),
+				Ranges.FilterByPredicate([&Stolen](const TPair<uint64, uint64>& Range) { return Range == Stolen; }).Num(), 1);
+		}
+		// the chunk loop's requests start on chunk boundaries, the helpers' a MB back from the end of what was left
+		const TArray<TPair<uint64, uint64>> HelperRanges = Ranges.FilterByPredicate([MB](const TPair<uint64, uint64>& Range) { return Range.Key % MB != 0; });
+		TestTrue(FString::Printf(TEXT("Range helper requests, %d"), HelperRanges.Num()), HelperRanges.Num() >= 3);
+		for (const TPair<uint64, uint64>& Range : HelperRanges)
+		{
+			TestEqual(TEXT("Range helpers take a MB, ChunkStream.MinStealSizeKB and no more than a chunk"), Range.Value - Range.Key + 1, MB);
+		}
+		// the chunk loop skipped what the helpers had, no byte was requested twice
+		uint64 RequestedBytes = 0;
+		for (const TPair<uint64, uint64>& Range : Ranges)
+		{
+			RequestedBytes += Range.Value - Range.Key + 1;
+		}
+		TestEqual(TEXT("Bytes requested"), RequestedBytes, FileSize);
+		
+		Settings.Restore();
+		ChunkStreamTests::UnregisterMemoryServer(TEXT("chunkstream-pool"));
+		return true;
+	}));
+	
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamConnectionPoolAdmissionTest, "ChunkStream.ConnectionPool.Admission",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamConnectionPoolAdmissionTest::RunTest(const FString& Parameters)
+{
+	using namespace ChunkStreamConnectionPoolTests;
+	
+	// one connection for two downloads, the second starts once the first is done with it
+	const FPoolSettings Settings(1, 1);
+	ChunkStreamTests::FMemoryServerRef Server = ChunkStreamTests::RegisterMemoryServer(TEXT("chunkstream-admission"));
+	const uint64 FileSize = 2 * 1024 * 1024 + 77;
+	TSharedRef<FPoolDownload> First = StartDownload(*Server, TEXT("chunkstream-admission://files/pool_first.bin"), FileSize, 2.0 * 1024.0 * 1024.0);
+	TSharedRef<FPoolDownload> Second = StartDownload(*Server, TEXT("chunkstream-admission://files/pool_second.bin"), FileSize, 2.0 * 1024.0 * 1024.0);
+	TSharedRef<bool> bOverlapped = MakeShared<bool>(false);
+	
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, Server, First, Second, bOverlapped, Settings, FileSize,
+		StartTime = FPlatformTime::Seconds()]()
+	{
+		if (!First->bDone && Server->GetRequestCount(Second->URL) > 0)
+		{
+			*bOverlapped = true;
+		}
+		if (!(First->bDone && Second->bDone) && FPlatformTime::Seconds() - StartTime < 60.0)
+		{
+			return false;
+		}
+		CheckDownload(*this, *First, FileSize);
+		CheckDownload(*this, *Second, FileSize);
+		TestFalse(TEXT("The second download waited for the only connection"), *bOverlapped);
+		
+		Settings.Restore();
+		ChunkStreamTests::UnregisterMemoryServer(TEXT("chunkstream-admission"));
+		return true;
+	}));
+	
+	return true;
+}
+
+#endif //WITH_AUTOMATION_TESTS
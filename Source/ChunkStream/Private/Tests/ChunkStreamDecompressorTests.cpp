@@ -0,0 +1,80 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#if WITH_AUTOMATION_TESTS
+#include "ChunkStreamDecompressor.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/Compression.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamDecompressGzipTest, "ChunkStream.Decompress.Gzip",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamDecompressGzipTest::RunTest(const FString& Parameters)
+{
+	// compressible but not trivial source data
+	TArray<uint8> Source;
+	Source.SetNumUninitialized(3 * 1024 * 1024);
+	for (int32 i = 0; i < Source.Num(); i++)
+	{
+		Source[i] = static_cast<uint8>((i * 7) ^ (i >> 11));
+	}
+	
+	int32 CompressedSize = FCompression::CompressMemoryBound(NAME_Gzip, Source.Num());
+	TArray<uint8> Compressed;
+	Compressed.SetNumUninitialized(CompressedSize);
+	if (!TestTrue(TEXT("Compressed source"), FCompression::CompressMemory(NAME_Gzip, Compressed.GetData(), CompressedSize, Source.GetData(), Source.Num())))
+	{
+		return false;
+	}
+	Compressed.SetNum(CompressedSize);
+	TestTrue(TEXT("Detected gzip"), FChunkStreamDecompressor::DetectFormat(Compressed.GetData(), Compressed.Num()) == EChunkStreamDecompression::Gzip);
+	
+	const FString OutPath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("ChunkStreamTests"), TEXT("gzip_out.bin"));
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*FPaths::GetPath(OutPath));
+	IFileHandle* Handle = PlatformFile.OpenWrite(*OutPath);
+	if (!TestNotNull(TEXT("Opened output"), Handle))
+	{
+		return false;
+	}
+	
+	{
+		// feed in uneven slices like network chunks, including one smaller than the detection header
+		FChunkStreamDecompressor Decompressor(EChunkStreamDecompression::Auto, Handle);
+		const int32 Slices[] = { 1, 2, 4093, 65536 };
+		int32 Offset = 0;
+		int32 SliceIndex = 0;
+		bool bProcessed = true;
+		while (Offset < Compressed.Num() && bProcessed)
+		{
+			const int32 Num = FMath::Min(Slices[SliceIndex++ % UE_ARRAY_COUNT(Slices)], Compressed.Num() - Offset);
+			bProcessed = Decompressor.Process(Compressed.GetData() + Offset, Num);
+			Offset += Num;
+		}
+		TestTrue(TEXT("Processed all slices"), bProcessed);
+		TestTrue(TEXT("Finished cleanly"), Decompressor.Finish());
+		TestEqual(TEXT("Decoded size"), Decompressor.GetBytesWritten(), static_cast<uint64>(Source.Num()));
+	}
+	delete Handle;
+	
+	TArray<uint8> Decoded;
+	FFileHelper::LoadFileToArray(Decoded, *OutPath);
+	TestTrue(TEXT("Decoded bytes match source"), Decoded == Source);
+	PlatformFile.DeleteFile(*OutPath);
+	
+	// a truncated stream must not finish
+	{
+		IFileHandle* TruncatedHandle = PlatformFile.OpenWrite(*OutPath);
+		FChunkStreamDecompressor Decompressor(EChunkStreamDecompression::Gzip, TruncatedHandle);
+		Decompressor.Process(Compressed.GetData(), Compressed.Num() / 2);
+		TestFalse(TEXT("Truncated stream fails"), Decompressor.Finish());
+		delete TruncatedHandle;
+		PlatformFile.DeleteFile(*OutPath);
+	}
+	return true;
+}
+
+#endif //WITH_AUTOMATION_TESTS
@@ -0,0 +1,74 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#if WITH_AUTOMATION_TESTS
+#include "ChunkStreamDelta.h"
+#include "Misc/AutomationTest.h"
+#include "Serialization/MemoryWriter.h"
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamDeltaTest, "ChunkStream.Delta.ReusableBlocks",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamDeltaTest::RunTest(const FString& Parameters)
+{
+	const int32 BlockSize = 1024;
+	const int32 FileSize = 64 * BlockSize + 100;
+	TArray<uint8> NewData;
+	NewData.SetNumUninitialized(FileSize);
+	FRandomStream Random(1234);
+	for (int32 i = 0; i < FileSize; i++)
+	{
+		NewData[i] = static_cast<uint8>(Random.RandHelper(256));
+	}
+	
+	// rolling a window along gives the same sum as computing it from scratch
+	ChunkStreamDelta::FRollingChecksum Rolled;
+	Rolled.Init(NewData.GetData(), BlockSize);
+	for (int32 i = 0; i < 10; i++)
+	{
+		Rolled.Roll(NewData[i], NewData[i + BlockSize], BlockSize);
+	}
+	ChunkStreamDelta::FRollingChecksum Direct;
+	Direct.Init(NewData.GetData() + 10, BlockSize);
+	TestEqual(TEXT("Rolled checksum"), Rolled.Get(), Direct.Get());
+	
+	FChunkStreamBlockIndex Index;
+	FChunkStreamBlockIndex::Build(NewData.GetData(), NewData.Num(), BlockSize, Index);
+	TestEqual(TEXT("Blocks"), Index.GetNumBlocks(), 65);
+	
+	// the old version has some bytes inserted near the start, so the rest of its blocks are shifted, and a block changed
+	TArray<uint8> OldData = NewData;
+	OldData.Insert(NewData.GetData(), 37, 500);
+	OldData[37 + 20 * BlockSize + 5] ^= 0xff;
+	
+	TArray<int64> OldOffsets;
+	ChunkStreamDelta::FindReusableBlocks(Index, OldData.GetData(), OldData.Num(), OldOffsets);
+	int32 Found = 0;
+	for (int32 Block = 0; Block < Index.GetNumBlocks(); Block++)
+	{
+		if (OldOffsets[Block] >= 0)
+		{
+			Found++;
+			TestTrue(TEXT("Matched bytes are the same"),
+				FMemory::Memcmp(OldData.GetData() + OldOffsets[Block], NewData.GetData() + Index.GetBlockStart(Block), Index.GetBlockBytes(Block)) == 0);
+		}
+	}
+	// the block spanning the insert, the changed block and the short last block have to be downloaded
+	TestEqual(TEXT("Reusable blocks"), Found, 62);
+	
+	TArray<uint8> Saved;
+	FMemoryWriter Writer(Saved);
+	TestTrue(TEXT("Saved index"), Index.Serialize(Writer));
+	FChunkStreamBlockIndex Loaded;
+	if (TestTrue(TEXT("Loaded index"), Loaded.LoadFromMemory(Saved)))
+	{
+		TestEqual(TEXT("Loaded blocks"), Loaded.GetNumBlocks(), Index.GetNumBlocks());
+		TestTrue(TEXT("Loaded file hash"), Loaded.FileHash == Index.FileHash);
+	}
+	Saved[0] ^= 0xff;
+	TestFalse(TEXT("Rejects a corrupt index"), Loaded.LoadFromMemory(Saved));
+	
+	return true;
+}
+
+#endif //WITH_AUTOMATION_TESTS
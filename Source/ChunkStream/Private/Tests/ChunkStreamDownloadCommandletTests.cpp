@@ -0,0 +1,45 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#if WITH_AUTOMATION_TESTS
+#include "ChunkStreamDownloadCommandlet.h"
+#include "Misc/AutomationTest.h"
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamDownloadManifestTest, "ChunkStream.Commandlet.Manifest",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamDownloadManifestTest::RunTest(const FString& Parameters)
+{
+	const FString Output = TEXT("/out");
+	TArray<FChunkStreamManifestEntry> Entries;
+	FString Error;
+	
+	const FString Manifest = TEXT("# warm the CDN\n")
+		TEXT("\n")
+		TEXT("https://cdn.example.com/paks/base.pak https://mirror.example.com/paks/base.pak Paks/base.pak\n")
+		TEXT("  https://cdn.example.com:8443/movies/intro.mp4?token=abc  \r\n")
+		TEXT("https://cdn.example.com/a.bin /abs/a.bin\n");
+	TestTrue(TEXT("Parsed"), UChunkStreamDownloadCommandlet::ParseManifest(Manifest, Output, Entries, Error));
+	if (TestEqual(TEXT("Files"), Entries.Num(), 3))
+	{
+		TestEqual(TEXT("Mirrors kept in order"), Entries[0].URLs,
+			TArray<FString>{ TEXT("https://cdn.example.com/paks/base.pak"), TEXT("https://mirror.example.com/paks/base.pak") });
+		TestEqual(TEXT("Relative save path"), Entries[0].SavePath, FString(TEXT("/out/Paks/base.pak")));
+		TestEqual(TEXT("Line number"), Entries[0].Line, 3);
+		TestEqual(TEXT("Mirrored path"), Entries[1].SavePath, FString(TEXT("/out/cdn.example.com_8443/movies/intro.mp4")));
+		TestEqual(TEXT("Absolute save path"), Entries[2].SavePath, FString(TEXT("/abs/a.bin")));
+	}
+	
+	TestFalse(TEXT("No URL"), UChunkStreamDownloadCommandlet::ParseManifest(TEXT("Paks/base.pak\n"), Output, Entries, Error));
+	TestFalse(TEXT("Two save paths"), UChunkStreamDownloadCommandlet::ParseManifest(TEXT("https://a.com/x a b\n"), Output, Entries, Error));
+	TestFalse(TEXT("Same save path twice"), UChunkStreamDownloadCommandlet::ParseManifest(
+		TEXT("https://a.com/x.bin\nhttps://b.com/y.bin ../out/a.com/x.bin\n"), TEXT("/out"), Entries, Error));
+	TestFalse(TEXT("Empty"), UChunkStreamDownloadCommandlet::ParseManifest(TEXT("# nothing\n"), Output, Entries, Error));
+	
+	TestEqual(TEXT("Directory URL"), UChunkStreamDownloadCommandlet::GetMirrorPathForURL(TEXT("https://a.com/dir/"), Output), FString());
+	TestEqual(TEXT("Host only"), UChunkStreamDownloadCommandlet::GetMirrorPathForURL(TEXT("https://a.com"), Output), FString());
+	TestEqual(TEXT("Escapes the output"), UChunkStreamDownloadCommandlet::GetMirrorPathForURL(TEXT("https://a.com/../x"), Output), FString());
+	return true;
+}
+
+#endif //WITH_AUTOMATION_TESTS
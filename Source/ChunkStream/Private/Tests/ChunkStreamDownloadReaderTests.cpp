@@ -0,0 +1,98 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#if WITH_AUTOMATION_TESTS
+#include "ChunkStreamDownloadReader.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/Paths.h"
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamDownloadReaderTest, "ChunkStream.DownloadReader.WrittenRanges",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamDownloadReaderTest::RunTest(const FString& Parameters)
+{
+	using StreamChunkDownloader::FByteRange;
+	
+	// merging keeps the list sorted and joins touching ranges
+	TArray<FByteRange> Ranges;
+	FByteRange::AddMerged(Ranges, FByteRange(100, 199));
+	FByteRange::AddMerged(Ranges, FByteRange(0, 49));
+	FByteRange::AddMerged(Ranges, FByteRange(300, 399));
+	TestEqual(TEXT("Separate ranges"), Ranges.Num(), 3);
+	FByteRange::AddMerged(Ranges, FByteRange(50, 99));
+	TestEqual(TEXT("Touching ranges merged"), Ranges.Num(), 2);
+	FByteRange::AddMerged(Ranges, FByteRange(150, 349));
+	if (TestEqual(TEXT("Overlapping ranges merged"), Ranges.Num(), 1))
+	{
+		TestEqual(TEXT("Merged end"), Ranges[0].End, static_cast<uint64>(399));
+	}
+	TestEqual(TEXT("Found range"), FByteRange::FindContaining(Ranges, 250), 0);
+	TestEqual(TEXT("Past the end"), FByteRange::FindContaining(Ranges, 400), static_cast<int32>(INDEX_NONE));
+	
+	// the file a download writes into, second half first as if a reader had moved it ahead
+	const int32 FileSize = 64 * 1024;
+	TArray<uint8> Source;
+	Source.SetNumUninitialized(FileSize);
+	for (int32 i = 0; i < FileSize; i++)
+	{
+		Source[i] = static_cast<uint8>(i * 13 + (i >> 8));
+	}
+	const FString FilePath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("ChunkStreamTests"), TEXT("reader.bin"));
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*FPaths::GetPath(FilePath));
+	IFileHandle* Writer = PlatformFile.OpenWrite(*FilePath, false, true);
+	if (!TestNotNull(TEXT("Opened file"), Writer))
+	{
+		return false;
+	}
+	
+	TSharedRef<FChunkStreamDownloadReadState> State = MakeShared<FChunkStreamDownloadReadState>(nullptr);
+	State->SetFilePath(FilePath);
+	FChunkStreamDownloadReader Reader(State);
+	
+	const int32 Half = FileSize / 2;
+	TFuture<bool> FirstHalf = Reader.WhenAvailable(0, Half);
+	Writer->Seek(Half);
+	Writer->Write(Source.GetData() + Half, FileSize - Half);
+	Writer->Flush();
+	State->OnRangeWritten(Half, FileSize - 1, FileSize);
+	
+	TestFalse(TEXT("First half not written"), Reader.IsAvailable(0, 1));
+	TestFalse(TEXT("Wait not resolved early"), FirstHalf.IsReady());
+	
+	TArray<uint8> Read;
+	Read.SetNumZeroed(1024);
+	TestTrue(TEXT("Written bytes read straight away"), Reader.ReadAt(Read.GetData(), Read.Num(), FileSize - Read.Num()));
+	TestTrue(TEXT("Read matches"), FMemory::Memcmp(Read.GetData(), Source.GetData() + FileSize - Read.Num(), Read.Num()) == 0);
+	// this is the game thread, missing bytes fail rather than wait
+	TestFalse(TEXT("Missing bytes don't block the game thread"), Reader.ReadAt(Read.GetData(), Read.Num(), 0));
+	
+	Writer->Seek(0);
+	Writer->Write(Source.GetData(), Half);
+	Writer->Flush();
+	State->OnRangeWritten(0, Half - 1, FileSize);
+	TestTrue(TEXT("Wait resolved once written"), FirstHalf.IsReady() && FirstHalf.Get());
+	
+	TArray<uint8> Whole;
+	Whole.SetNumZeroed(FileSize);
+	TestTrue(TEXT("Seek"), Reader.Seek(0));
+	TestTrue(TEXT("Whole file read"), Reader.Read(Whole.GetData(), Whole.Num()));
+	TestTrue(TEXT("Whole file matches"), FMemory::Memcmp(Whole.GetData(), Source.GetData(), FileSize) == 0);
+	TestEqual(TEXT("Size"), Reader.Size(), static_cast<int64>(FileSize));
+	
+	// past the end is never satisfied
+	TFuture<bool> PastEnd = State->WhenWritten(FileSize, 1);
+	delete Writer;
+	State->Finish(true, FilePath);
+	TestTrue(TEXT("Wait past the end fails when finished"), PastEnd.IsReady() && !PastEnd.Get());
+	TestTrue(TEXT("Reads after finishing"), Reader.ReadAt(Read.GetData(), Read.Num(), 0));
+	
+	State->ReleaseFile([&PlatformFile, &FilePath]()
+	{
+		PlatformFile.DeleteFile(*FilePath);
+	});
+	return true;
+}
+
+#endif //WITH_AUTOMATION_TESTS
@@ -0,0 +1,304 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#if WITH_AUTOMATION_TESTS
+#include "ChunkStreamDownloader.h"
+#include "ChunkStreamMemoryTransport.h"
+#include "ChunkStreamTestHelpers.h"
+#include "StreamChunkDownloader.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformMemory.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+#include "UObject/StrongObjectPtr.h"
+
+#if PLATFORM_WINDOWS
+#include "Windows/WindowsHWrapper.h"
+#elif PLATFORM_UNIX || PLATFORM_ANDROID
+#include <dirent.h>
+#endif
+
+namespace ChunkStreamFaultTests
+{
+	// Handles the process has open, -1 where the platform can't tell
+	int32 GetOpenHandleCount()
+	{
+#if PLATFORM_WINDOWS
+		DWORD Count = 0;
+		return ::GetProcessHandleCount(::GetCurrentProcess(), &Count) ? static_cast<int32>(Count) : -1;
+#elif PLATFORM_UNIX || PLATFORM_ANDROID
+		DIR* Directory = opendir("/proc/self/fd");
+		if (!Directory)
+		{
+			return -1;
+		}
+		int32 Count = 0;
+		while (readdir(Directory))
+		{
+			Count++;
+		}
+		closedir(Directory);
+		// ".", ".." and the directory itself
+		return Count - 3;
+#else
+		return -1;
+#endif
+	}
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamEachFaultTest, "ChunkStream.Faults.EachFault",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamEachFaultTest::RunTest(const FString& Parameters)
+{
+	struct FFaultDownload
+	{
+		EChunkStreamMemoryFault Fault = EChunkStreamMemoryFault::None;
+		TSharedPtr<FStreamChunkDownloader> Downloader;
+		TArray64<uint8> Data;
+		bool bChunkOutOfBounds = false;
+		bool bDone = false;
+		EChunkStreamDownloadResult Result = EChunkStreamDownloadResult::InProgress;
+	};
+	
+	ChunkStreamTests::FMemoryServerRef Server = ChunkStreamTests::RegisterMemoryServer(TEXT("chunkstream-fault"));
+	
+	const TArray<EChunkStreamMemoryFault> Faults = { EChunkStreamMemoryFault::Disconnect, EChunkStreamMemoryFault::Trickle,
+		EChunkStreamMemoryFault::ShortContentLength, EChunkStreamMemoryFault::LongContentLength, EChunkStreamMemoryFault::IgnoreRange,
+		EChunkStreamMemoryFault::ExtraBytes, EChunkStreamMemoryFault::ServiceUnavailable };
+	TArray<TSharedRef<FFaultDownload>> Downloads;
+	for (int32 i = 0; i < Faults.Num(); i++)
+	{
+		// the HEAD and the first chunk go through, the second chunk hits the fault, twice for a 503 burst
+		FChunkStreamMemoryFileSettings Settings;
+		Settings.FileSize = 3 * 1024 * 1024 + 777;
+		Settings.Faults = { EChunkStreamMemoryFault::None, EChunkStreamMemoryFault::None, Faults[i] };
+		if (Faults[i] == EChunkStreamMemoryFault::ServiceUnavailable)
+		{
+			Settings.Faults.Add(EChunkStreamMemoryFault::ServiceUnavailable);
+		}
+		Settings.Faults.Append({ EChunkStreamMemoryFault::None, EChunkStreamMemoryFault::None, EChunkStreamMemoryFault::None, EChunkStreamMemoryFault::None });
+		const FString URL = FString::Printf(TEXT("chunkstream-fault://files/%d.bin"), i);
+		Server->AddFile(URL, Settings);
+		
+		TSharedRef<FFaultDownload> Download = MakeShared<FFaultDownload>();
+		Download->Fault = Faults[i];
+		Download->Data.SetNumZeroed(Settings.FileSize);
+		Download->Downloader = MakeShared<FStreamChunkDownloader>(URL, FString());
+		Download->Downloader->BeginDownload(1024 * 1024, FStreamDownloadProgressSignature(),
+			FOnSingleChunkCompleteSignature::CreateLambda([Download](TUniquePtr<StreamChunkDownloader::FChunkInfo>&& Chunk)
+			{
+				if (Chunk->EndOffset >= static_cast<uint64>(Download->Data.Num()))
+				{
+					Download->bChunkOutOfBounds = true;
+					return;
+				}
+				FMemory::Memcpy(Download->Data.GetData() + Chunk->StartOffset, Chunk->Data.GetData(), Chunk->EndOffset - Chunk->StartOffset + 1);
+			}),
+			FOnDownloadCompleteSignature::CreateLambda([Download](EChunkStreamDownloadResult InResult)
+			{
+				Download->Result = InResult;
+				Download->bDone = true;
+			}));
+		Downloads.Add(Download);
+	}
+	
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, Downloads, StartTime = FPlatformTime::Seconds()]()
+	{
+		const bool bAllDone = !Downloads.ContainsByPredicate([](const TSharedRef<FFaultDownload>& Download) { return !Download->bDone; });
+		if (!bAllDone && FPlatformTime::Seconds() - StartTime < 120.0)
+		{
+			return false;
+		}
+		const UEnum* ResultEnum = StaticEnum<EChunkStreamDownloadResult>();
+		for (const TSharedRef<FFaultDownload>& Download : Downloads)
+		{
+			const FString Name = FString::Printf(TEXT("Fault %d"), static_cast<int32>(Download->Fault));
+			TestTrue(Name + TEXT(" finished"), Download->bDone);
+			TestTrue(Name + TEXT(" succeeded, got ") + (ResultEnum ? ResultEnum->GetNameStringByValue(static_cast<int64>(Download->Result)) : FString()),
+				Download->Result == EChunkStreamDownloadResult::Success);
+			TestFalse(Name + TEXT(" chunks stayed inside the file"), Download->bChunkOutOfBounds);
+			TestTrue(Name + TEXT(" bytes"), ChunkStreamTests::MatchesSynthetic(Download->Data));
+			Download->Downloader->Shutdown();
+		}
+		ChunkStreamTests::UnregisterMemoryServer(TEXT("chunkstream-fault"));
+		return true;
+	}));
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamFaultSoakTest, "ChunkStream.Faults.Soak",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::StressFilter)
+
+/**
+ * Downloads files to storage through a server that keeps misbehaving, for -ChunkStreamSoakMinutes=N (default 2, run it for hours
+ * before a release). Every file must match byte for byte, and memory and open handles must not grow.
+ */
+bool ChunkStreamFaultSoakTest::RunTest(const FString& Parameters)
+{
+	using namespace ChunkStreamFaultTests;
+	
+	struct FSoakDownload
+	{
+		TStrongObjectPtr<UChunkStreamDownloader> Downloader;
+		FString URL;
+		FString SavePath;
+		uint64 FileSize = 0;
+		bool bDone = false;
+		EChunkStreamDownloadResult Result = EChunkStreamDownloadResult::InProgress;
+	};
+	struct FSoakState
+	{
+		TSharedPtr<FChunkStreamMemoryTransport, ESPMode::ThreadSafe> Server;
+		TArray<TSharedRef<FSoakDownload>> Running;
+		FRandomStream Random;
+		double EndTime = 0.0;
+		double RoundStartTime = 0.0;
+		int32 Rounds = 0;
+		int32 FilesVerified = 0;
+		// taken once warmed up, allocator pools and the task graph have grown by then
+		uint64 BaselineUsedPhysical = 0;
+		int32 BaselineHandles = -1;
+		int32 PeakHandles = -1;
+		TMap<FString, int32> SavedCVars;
+	};
+	
+	float Minutes = 2.f;
+	FParse::Value(FCommandLine::Get(), TEXT("ChunkStreamSoakMinutes="), Minutes);
+	
+	TSharedRef<FSoakState> State = MakeShared<FSoakState>();
+	State->Server = ChunkStreamTests::RegisterMemoryServer(TEXT("chunkstream-soak"));
+	State->Random.Initialize(0x5EED);
+	State->EndTime = FPlatformTime::Seconds() + Minutes * 60.0;
+	for (const TPair<const TCHAR*, int32>& CVarValue : { TPair<const TCHAR*, int32>(TEXT("ChunkStream.MaxChunkSize"), 1), TPair<const TCHAR*, int32>(TEXT("ChunkStream.MaxConcurrentDownloads"), 3) })
+	{
+		if (IConsoleVariable* CVar = IConsoleManager::Get().FindConsoleVariable(CVarValue.Key))
+		{
+			State->SavedCVars.Add(CVarValue.Key, CVar->GetInt());
+			CVar->Set(CVarValue.Value, ECVF_SetByCode);
+		}
+	}
+	
+	// never more than two failures in a row, a chunk gets four attempts
+	const TArray<EChunkStreamMemoryFault> Schedule = { EChunkStreamMemoryFault::None, EChunkStreamMemoryFault::Disconnect, EChunkStreamMemoryFault::None,
+		EChunkStreamMemoryFault::ExtraBytes, EChunkStreamMemoryFault::ShortContentLength, EChunkStreamMemoryFault::None, EChunkStreamMemoryFault::Trickle,
+		EChunkStreamMemoryFault::None, EChunkStreamMemoryFault::IgnoreRange, EChunkStreamMemoryFault::None, EChunkStreamMemoryFault::LongContentLength,
+		EChunkStreamMemoryFault::None, EChunkStreamMemoryFault::ServiceUnavailable, EChunkStreamMemoryFault::ServiceUnavailable, EChunkStreamMemoryFault::None,
+		EChunkStreamMemoryFault::None };
+	const FString Directory = FPaths::ProjectIntermediateDir() / TEXT("ChunkStreamSoak");
+	IFileManager::Get().MakeDirectory(*Directory, true);
+	
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, State, Schedule, Directory]()
+	{
+		const bool bRoundDone = !State->Running.ContainsByPredicate([](const TSharedRef<FSoakDownload>& Download) { return !Download->bDone; });
+		if (!bRoundDone)
+		{
+			if (FPlatformTime::Seconds() - State->RoundStartTime < 300.0)
+			{
+				return false;
+			}
+			AddError(TEXT("Soak round timed out"));
+		}
+		
+		for (const TSharedRef<FSoakDownload>& Download : State->Running)
+		{
+			if (!Download->bDone)
+			{
+				Download->Downloader->CancelDownload();
+				continue;
+			}
+			TArray64<uint8> Data;
+			const bool bLoaded = FFileHelper::LoadFileToArray(Data, *Download->SavePath);
+			if (Download->Result != EChunkStreamDownloadResult::Success || !bLoaded || Data.Num() != static_cast<int64>(Download->FileSize) || !ChunkStreamTests::MatchesSynthetic(Data))
+			{
+				AddError(FString::Printf(TEXT("Round %d: %llu byte file from '%s' is wrong (result %d, %lld bytes on disk)"), State->Rounds, Download->FileSize,
+					*Download->URL, static_cast<int32>(Download->Result), bLoaded ? Data.Num() : -1));
+			}
+			else
+			{
+				State->FilesVerified++;
+			}
+			IFileManager::Get().Delete(*Download->SavePath, false, true, true);
+			State->Server->RemoveFile(Download->URL);
+		}
+		State->Running.Reset();
+		
+		const int32 Handles = GetOpenHandleCount();
+		if (State->Rounds == 5)
+		{
+			State->BaselineUsedPhysical = FPlatformMemory::GetStats().UsedPhysical;
+			State->BaselineHandles = Handles;
+		}
+		State->PeakHandles = FMath::Max(State->PeakHandles, Handles);
+		
+		const bool bFinished = HasAnyErrors() || (FPlatformTime::Seconds() >= State->EndTime && State->Rounds > 5);
+		if (bFinished)
+		{
+			const uint64 UsedPhysical = FPlatformMemory::GetStats().UsedPhysical;
+			constexpr int64 AllowedGrowth = 64 * 1024 * 1024;
+			TestTrue(FString::Printf(TEXT("Memory grew by %lld bytes over %d rounds"), static_cast<int64>(UsedPhysical) - static_cast<int64>(State->BaselineUsedPhysical), State->Rounds),
+				static_cast<int64>(UsedPhysical) - static_cast<int64>(State->BaselineUsedPhysical) < AllowedGrowth);
+			if (State->BaselineHandles >= 0)
+			{
+				// a couple of handles of slack for the engine's own files
+				TestTrue(FString::Printf(TEXT("Open handles %d against %d after warm up"), Handles, State->BaselineHandles), Handles <= State->BaselineHandles + 2);
+			}
+			AddInfo(FString::Printf(TEXT("%d files verified over %d rounds, peak %d open handles"), State->FilesVerified, State->Rounds, State->PeakHandles));
+			
+			for (const TPair<FString, int32>& Saved : State->SavedCVars)
+			{
+				if (IConsoleVariable* CVar = IConsoleManager::Get().FindConsoleVariable(*Saved.Key))
+				{
+					CVar->Set(Saved.Value, ECVF_SetByCode);
+				}
+			}
+			ChunkStreamTests::UnregisterMemoryServer(TEXT("chunkstream-soak"));
+			IFileManager::Get().DeleteDirectory(*Directory, false, true);
+			return true;
+		}
+		
+		// a small file, a one chunk file and files of several chunks ending mid chunk, each with the schedule at a different point
+		const uint64 Sizes[] = { 1000, 64 * 1024 + 3, 1024 * 1024, 3 * 1024 * 1024 + 4097, 9 * 1024 * 1024 + 1 };
+		for (int32 i = 0; i < 3; i++)
+		{
+			FChunkStreamMemoryFileSettings Settings;
+			Settings.FileSize = Sizes[State->Random.RandHelper(static_cast<int32>(UE_ARRAY_COUNT(Sizes)))];
+			Settings.PacketSize = 16 * 1024 + State->Random.RandHelper(48 * 1024);
+			const int32 Rotation = State->Random.RandHelper(Schedule.Num());
+			for (int32 Fault = 0; Fault < Schedule.Num(); Fault++)
+			{
+				Settings.Faults.Add(Schedule[(Fault + Rotation) % Schedule.Num()]);
+			}
+			
+			TSharedRef<FSoakDownload> Download = MakeShared<FSoakDownload>();
+			Download->FileSize = Settings.FileSize;
+			Download->URL = FString::Printf(TEXT("chunkstream-soak://files/%d-%d.bin"), State->Rounds, i);
+			Download->SavePath = Directory / FString::Printf(TEXT("%d.bin"), i);
+			State->Server->AddFile(Download->URL, Settings);
+			
+			Download->Downloader.Reset(UChunkStreamDownloader::DownloadFileToStorage(nullptr, Download->URL, Download->SavePath));
+			TWeakPtr<FSoakDownload> WeakDownload = Download;
+			Download->Downloader->Native_DownloadFinished.AddLambda([WeakDownload](FChunkStreamResultParams Params)
+			{
+				if (TSharedPtr<FSoakDownload> PinnedDownload = WeakDownload.Pin())
+				{
+					PinnedDownload->Result = Params.DownloadTaskResult;
+					PinnedDownload->bDone = true;
+				}
+			});
+			Download->Downloader->Activate();
+			State->Running.Add(Download);
+		}
+		State->Rounds++;
+		State->RoundStartTime = FPlatformTime::Seconds();
+		return false;
+	}));
+	return true;
+}
+
+#endif //WITH_AUTOMATION_TESTS
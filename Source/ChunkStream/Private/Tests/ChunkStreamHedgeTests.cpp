@@ -0,0 +1,163 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#if WITH_AUTOMATION_TESTS
+#include "ChunkStreamMemoryTransport.h"
+#include "ChunkStreamTestHelpers.h"
+#include "StreamChunkDownloader.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/AutomationTest.h"
+
+namespace ChunkStreamHedgeTests
+{
+	static constexpr uint64 ChunkSize = 1024 * 1024;
+	static constexpr uint64 FileSize = 6 * ChunkSize + 555;
+	
+	struct FHedgeDownload
+	{
+		TSharedPtr<FStreamChunkDownloader> Downloader;
+		TSharedPtr<FChunkStreamMemoryTransport, ESPMode::ThreadSafe> Server;
+		FString URL;
+		TArray64<uint8> Data;
+		bool bDone = false;
+		EChunkStreamDownloadResult Result = EChunkStreamDownloadResult::InProgress;
+		float OldMinElapsed = 0.f;
+		int32 OldEnabled = 0;
+	};
+	
+	/**
+	 * Downloads a file whose fourth chunk (request 5, after the HEAD and three quick chunks for the median) is answered with SlowFault,
+	 * and the hedge for it (request 6) with HedgeFault.
+	 */
+	TSharedRef<FHedgeDownload> StartDownload(const FString& Scheme, EChunkStreamMemoryFault SlowFault, EChunkStreamMemoryFault HedgeFault,
+		int32 TrickleBytes)
+	{
+		TSharedRef<FHedgeDownload> Download = MakeShared<FHedgeDownload>();
+		IConsoleVariable* MinElapsed = IConsoleManager::Get().FindConsoleVariable(TEXT("ChunkStream.HedgeMinElapsedSeconds"));
+		IConsoleVariable* Enabled = IConsoleManager::Get().FindConsoleVariable(TEXT("ChunkStream.HedgeEnabled"));
+		Download->OldMinElapsed = MinElapsed->GetFloat();
+		Download->OldEnabled = Enabled->GetInt();
+		MinElapsed->Set(0.5f);
+		Enabled->Set(1);
+		
+		Download->Server = ChunkStreamTests::RegisterMemoryServer(Scheme);
+		FChunkStreamMemoryFileSettings Settings;
+		Settings.FileSize = FileSize;
+		Settings.Faults.Init(EChunkStreamMemoryFault::None, 16);
+		Settings.Faults[4] = SlowFault;
+		Settings.Faults[5] = HedgeFault;
+		Settings.TrickleBytes = TrickleBytes;
+		Settings.TrickleIntervalSeconds = 0.25f;
+		Settings.FaultDelaySeconds = 30.f;
+		Download->URL = Scheme + TEXT("://files/hedged.bin");
+		Download->Server->AddFile(Download->URL, Settings);
+		
+		Download->Data.SetNumZeroed(FileSize);
+		Download->Downloader = MakeShared<FStreamChunkDownloader>(Download->URL, FString());
+		// the hedge is the only extra request
+		Download->Downloader->SetAllowRangeHelpers(false);
+		TWeakPtr<FHedgeDownload> WeakDownload = Download;
+		Download->Downloader->BeginDownload(ChunkSize, FStreamDownloadProgressSignature(),
+			FOnSingleChunkCompleteSignature::CreateLambda([WeakDownload](TUniquePtr<StreamChunkDownloader::FChunkInfo>&& Chunk)
+			{
+				TSharedPtr<FHedgeDownload> Pinned = WeakDownload.Pin();
+				if (Pinned && Chunk->EndOffset < static_cast<uint64>(Pinned->Data.Num()))
+				{
+					FMemory::Memcpy(Pinned->Data.GetData() + Chunk->StartOffset, Chunk->Data.GetData(), Chunk->EndOffset - Chunk->StartOffset + 1);
+				}
+			}),
+			FOnDownloadCompleteSignature::CreateLambda([WeakDownload](EChunkStreamDownloadResult InResult)
+			{
+				if (TSharedPtr<FHedgeDownload> Pinned = WeakDownload.Pin())
+				{
+					Pinned->Result = InResult;
+					Pinned->bDone = true;
+				}
+			}));
+		return Download;
+	}
+	
+	// Checks the download and puts back what StartDownload changed
+	void Finish(FAutomationTestBase& Test, const FString& Scheme, const TSharedRef<FHedgeDownload>& Download)
+	{
+		Test.TestTrue(TEXT("Download finished"), Download->bDone);
+		Test.TestTrue(TEXT("Download succeeded"), Download->Result == EChunkStreamDownloadResult::Success);
+		const TArray64<uint8> Expected = ChunkStreamTests::MakeSynthetic(FileSize);
+		Test.TestTrue(TEXT("File bytes"), Download->Data == Expected);
+		
+		// the slow chunk's request and the hedge both end where the fourth chunk does
+		const FString SlowChunkEnd = FString::Printf(TEXT("-%llu"), 4 * ChunkSize - 1);
+		const TArray<FString> RangeHeaders = Download->Server->GetRangeHeaders(Download->URL);
+		const int32 RequestsForTail = RangeHeaders.FilterByPredicate([&SlowChunkEnd](const FString& Range) { return Range.EndsWith(SlowChunkEnd); }).Num();
+		Test.TestEqual(TEXT("The slow chunk was hedged once"), RequestsForTail, 2);
+		
+		Download->Downloader->Shutdown();
+		ChunkStreamTests::UnregisterMemoryServer(Scheme);
+		IConsoleManager::Get().FindConsoleVariable(TEXT("ChunkStream.HedgeMinElapsedSeconds"))->Set(Download->OldMinElapsed);
+		IConsoleManager::Get().FindConsoleVariable(TEXT("ChunkStream.HedgeEnabled"))->Set(Download->OldEnabled);
+	}
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamHedgeWinsTest, "ChunkStream.Hedge.HedgeWins",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamHedgeWinsTest::RunTest(const FString& Parameters)
+{
+	using namespace ChunkStreamHedgeTests;
+	// 16 KB/s would take a minute for the chunk, the hedge brings the rest at once
+	TSharedRef<FHedgeDownload> Download = StartDownload(TEXT("chunkstream-hedgewin"), EChunkStreamMemoryFault::Trickle, EChunkStreamMemoryFault::None, 4096);
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, Download, StartTime = FPlatformTime::Seconds()]()
+	{
+		if (!Download->bDone && FPlatformTime::Seconds() - StartTime < 50.0)
+		{
+			return false;
+		}
+		Finish(*this, TEXT("chunkstream-hedgewin"), Download);
+		return true;
+	}));
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamHedgePrimaryWinsTest, "ChunkStream.Hedge.PrimaryWins",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamHedgePrimaryWinsTest::RunTest(const FString& Parameters)
+{
+	using namespace ChunkStreamHedgeTests;
+	// slow enough to be hedged, 256 KB/s finishes the chunk in 4 seconds while the hedge waits 30 for its response
+	TSharedRef<FHedgeDownload> Download = StartDownload(TEXT("chunkstream-hedgelose"), EChunkStreamMemoryFault::Trickle, EChunkStreamMemoryFault::Delay, 64 * 1024);
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, Download, StartTime = FPlatformTime::Seconds()]()
+	{
+		if (!Download->bDone && FPlatformTime::Seconds() - StartTime < 50.0)
+		{
+			return false;
+		}
+		Finish(*this, TEXT("chunkstream-hedgelose"), Download);
+		return true;
+	}));
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamHedgeFailsTest, "ChunkStream.Hedge.HedgeFails",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamHedgeFailsTest::RunTest(const FString& Parameters)
+{
+	using namespace ChunkStreamHedgeTests;
+	// the hedge drops half way through its body, what it got must not reach the chunk
+	TSharedRef<FHedgeDownload> Download = StartDownload(TEXT("chunkstream-hedgefail"), EChunkStreamMemoryFault::Trickle, EChunkStreamMemoryFault::Disconnect, 64 * 1024);
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, Download, StartTime = FPlatformTime::Seconds()]()
+	{
+		if (!Download->bDone && FPlatformTime::Seconds() - StartTime < 50.0)
+		{
+			return false;
+		}
+		Finish(*this, TEXT("chunkstream-hedgefail"), Download);
+		return true;
+	}));
+	return true;
+}
+
+#endif //WITH_AUTOMATION_TESTS
@@ -0,0 +1,184 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#if WITH_AUTOMATION_TESTS
+#include "ChunkStreamHttpFile.h"
+#include "ChunkStreamMemoryTransport.h"
+#include "ChunkStreamTestHelpers.h"
+#include "Async/Async.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/Paths.h"
+
+namespace ChunkStreamHttpFileTests
+{
+	static constexpr int64 BlockSize = 64 * 1024;
+	
+	struct FHttpFileTest
+	{
+		TSharedPtr<FChunkStreamMemoryTransport, ESPMode::ThreadSafe> Server;
+		TSharedPtr<FChunkStreamHttpFile> File;
+		FString Scheme;
+		FString URL;
+		// Checks the worker found false
+		TArray<FString> Failures;
+		TFuture<void> Reads;
+	};
+	
+	TSharedRef<FHttpFileTest> OpenFile(const FString& Scheme, uint64 FileSize, const FChunkStreamHttpFileSettings& Settings)
+	{
+		TSharedRef<FHttpFileTest> Test = MakeShared<FHttpFileTest>();
+		Test->Scheme = Scheme;
+		Test->URL = Scheme + TEXT("://files/random.bin");
+		Test->Server = ChunkStreamTests::RegisterMemoryServer(Scheme);
+		FChunkStreamMemoryFileSettings ServedFile;
+		ServedFile.FileSize = FileSize;
+		Test->Server->AddFile(Test->URL, ServedFile);
+		Test->File = MakeShared<FChunkStreamHttpFile>(Test->URL, FileSize, Settings);
+		return Test;
+	}
+	
+	// Reads Bytes at Offset and compares them with the server's bytes
+	bool ReadMatches(FChunkStreamHttpFile& File, int64 Offset, int64 Bytes)
+	{
+		TArray64<uint8> Read;
+		Read.SetNumUninitialized(Bytes);
+		return File.ReadAt(Read.GetData(), Bytes, Offset) && ChunkStreamTests::MatchesSynthetic(Read, Offset);
+	}
+	
+	/**
+	 * Runs Reads on a worker, uncached reads can't wait on the game thread, and reports the checks that failed once it returns.
+	 * Reads adds the name of each failed check to the array it is given.
+	 */
+	void RunReads(FAutomationTestBase& AutomationTest, const TSharedRef<FHttpFileTest>& Test, TFunction<void(FChunkStreamHttpFile&, TArray<FString>&)>&& Reads)
+	{
+		FChunkStreamHttpFile* File = Test->File.Get();
+		TArray<FString>* Failures = &Test->Failures;
+		Test->Reads = Async(EAsyncExecution::Thread, [File, Failures, Reads = MoveTemp(Reads)]()
+		{
+			Reads(*File, *Failures);
+		});
+		ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([&AutomationTest, Test, StartTime = FPlatformTime::Seconds()]()
+		{
+			if (!Test->Reads.IsReady() && FPlatformTime::Seconds() - StartTime < 30.0)
+			{
+				return false;
+			}
+			AutomationTest.TestTrue(TEXT("Reads finished"), Test->Reads.IsReady());
+			Test->Reads.Wait();
+			for (const FString& Failure : Test->Failures)
+			{
+				AutomationTest.AddError(Failure);
+			}
+			// deletes the disk tier
+			Test->File.Reset();
+			ChunkStreamTests::UnregisterMemoryServer(Test->Scheme);
+			return true;
+		}));
+	}
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamHttpFileBlockCacheTest, "ChunkStream.HttpFile.BlockCache",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamHttpFileBlockCacheTest::RunTest(const FString& Parameters)
+{
+	using namespace ChunkStreamHttpFileTests;
+	
+	const uint64 FileSize = 8 * BlockSize + 1234;
+	FChunkStreamHttpFileSettings Settings;
+	Settings.BlockSize = BlockSize;
+	Settings.MaxMemoryBlocks = 2;
+	Settings.DiskCacheDirectory = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("ChunkStreamTests"), TEXT("HttpFileCache"));
+	Settings.MaxDiskBlocks = 16;
+	Settings.MaxReadaheadBlocks = 0;
+	TSharedRef<FHttpFileTest> Test = OpenFile(TEXT("chunkstream-httpfile"), FileSize, Settings);
+	FChunkStreamMemoryTransport* Server = Test->Server.Get();
+	const FString URL = Test->URL;
+	
+	RunReads(*this, Test, [Server, URL, FileSize](FChunkStreamHttpFile& File, TArray<FString>& Failures)
+	{
+		auto Check = [&Failures](const TCHAR* What, bool bPassed)
+		{
+			if (!bPassed)
+			{
+				Failures.Add(What);
+			}
+		};
+		
+		Check(TEXT("Read across a block boundary"), ReadMatches(File, BlockSize - 100, 300));
+		Check(TEXT("Both blocks came in one request"), Server->GetRequestCount(URL) == 1 && File.GetBlocksFetched() == 2);
+		
+		// two more blocks push the first two out of memory into the disk tier
+		Check(TEXT("Read of later blocks"), ReadMatches(File, 2 * BlockSize, 2 * BlockSize));
+		Check(TEXT("Evicted blocks kept on disk"), File.IsCached(0, 2 * BlockSize));
+		
+		const uint64 FetchedBefore = File.GetBlocksFetched();
+		const int32 RequestsBefore = Server->GetRequestCount(URL);
+		Check(TEXT("Evicted blocks read back"), ReadMatches(File, 10, BlockSize));
+		Check(TEXT("Evicted blocks came from disk"), File.GetDiskHits() >= 2);
+		Check(TEXT("Evicted blocks not downloaded again"), File.GetBlocksFetched() == FetchedBefore && Server->GetRequestCount(URL) == RequestsBefore);
+		
+		Check(TEXT("Read into the short last block"), ReadMatches(File, FileSize - 1234 - 10, 1244));
+		uint8 Past[16];
+		Check(TEXT("Read past the end fails"), !File.ReadAt(Past, sizeof(Past), FileSize - 5));
+		
+		// a handle's sequential reads straddle blocks
+		TUniquePtr<IFileHandle> Handle = File.CreateHandle();
+		Check(TEXT("Handle seek"), Handle->Seek(5 * BlockSize - 7));
+		TArray<uint8> Read;
+		Read.SetNumUninitialized(5000);
+		for (int32 i = 0; i < 3; i++)
+		{
+			const int64 Offset = Handle->Tell();
+			Check(TEXT("Sequential handle read"), Handle->Read(Read.GetData(), Read.Num()) && ChunkStreamTests::MatchesSynthetic(Read.GetData(), Read.Num(), Offset));
+		}
+	});
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamHttpFileEvictedBeforeReadTest, "ChunkStream.HttpFile.EvictedBeforeRead",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamHttpFileEvictedBeforeReadTest::RunTest(const FString& Parameters)
+{
+	using namespace ChunkStreamHttpFileTests;
+	
+	// one block of memory and no disk tier, fetching a block drops the one before it
+	FChunkStreamHttpFileSettings Settings;
+	Settings.BlockSize = BlockSize;
+	Settings.MaxMemoryBlocks = 1;
+	Settings.MaxReadaheadBlocks = 0;
+	TSharedRef<FHttpFileTest> Test = OpenFile(TEXT("chunkstream-httpfile-evict"), 4 * BlockSize, Settings);
+	
+	// block 1 is cached when the read below starts, so only block 0 is requested, and block 0 arriving evicts block 1
+	Test->File->Prefetch(BlockSize, 1);
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, Test, StartTime = FPlatformTime::Seconds()]()
+	{
+		if (!Test->File->IsCached(BlockSize, 1) && FPlatformTime::Seconds() - StartTime < 10.0)
+		{
+			return false;
+		}
+		TestTrue(TEXT("Block 1 prefetched"), Test->File->IsCached(BlockSize, 1));
+		
+		FChunkStreamMemoryTransport* Server = Test->Server.Get();
+		const FString URL = Test->URL;
+		RunReads(*this, Test, [Server, URL](FChunkStreamHttpFile& File, TArray<FString>& Failures)
+		{
+			if (!ReadMatches(File, BlockSize - 100, 200))
+			{
+				Failures.Add(TEXT("Read whose block was evicted before it got to it"));
+			}
+			// block 1 is fetched again by the reader waiting for it
+			if (File.GetBlocksFetched() != 3 || Server->GetRequestCount(URL) != 3)
+			{
+				Failures.Add(FString::Printf(TEXT("Expected block 1 to be fetched twice, %llu blocks in %d requests"), File.GetBlocksFetched(), Server->GetRequestCount(URL)));
+			}
+		});
+		return true;
+	}));
+	return true;
+}
+
+#endif //WITH_AUTOMATION_TESTS
@@ -0,0 +1,150 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#if WITH_AUTOMATION_TESTS
+#include "ChunkStreamDownloader.h"
+#include "ChunkStreamIoUringWriter.h"
+#include "ChunkStreamMemoryTransport.h"
+#include "ChunkStreamTestHelpers.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UObject/StrongObjectPtr.h"
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamIoUringWriterTest, "ChunkStream.IoUringWriter",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamIoUringWriterTest::RunTest(const FString& Parameters)
+{
+	const FString Path = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("ChunkStreamTests"), TEXT("io_uring.bin"));
+	FFileHelper::SaveArrayToFile(TArray<uint8>(), *Path);
+	
+	// a shallow queue of small writes, so segments wait for a free slot
+	IConsoleVariable* QueueDepth = IConsoleManager::Get().FindConsoleVariable(TEXT("ChunkStream.IoUringQueueDepth"));
+	IConsoleVariable* SegmentSize = IConsoleManager::Get().FindConsoleVariable(TEXT("ChunkStream.IoUringSegmentSize"));
+	const int32 OldQueueDepth = QueueDepth->GetInt();
+	const int32 OldSegmentSize = SegmentSize->GetInt();
+	QueueDepth->Set(4);
+	SegmentSize->Set(64);
+	TUniquePtr<FChunkStreamIoUringWriter> Writer = FChunkStreamIoUringWriter::Open(Path);
+	if (!Writer)
+	{
+		AddInfo(TEXT("io_uring isn't available in this build or on this kernel"));
+	}
+	else
+	{
+		const uint64 FileSize = 5 * 1024 * 1024 + 321;
+		const TArray64<uint8> Expected = ChunkStreamTests::MakeSynthetic(FileSize);
+		// the second half first, like chunks finishing out of order
+		const uint64 Half = FileSize / 2;
+		TestTrue(TEXT("Write second half"), Writer->Write(Expected.GetData() + Half, FileSize - Half, Half));
+		TestTrue(TEXT("Write first half"), Writer->Write(Expected.GetData(), Half, 0));
+		TestTrue(TEXT("Empty write"), Writer->Write(Expected.GetData(), 0, 0));
+		TestTrue(TEXT("Flush"), Writer->Flush());
+		TestTrue(TEXT("Flush with nothing queued"), Writer->Flush());
+		// queued without a flush, closing waits for them before the buffers go
+		TestTrue(TEXT("Rewrite without flushing"), Writer->Write(Expected.GetData(), FileSize, 0));
+		Writer.Reset();
+		
+		TArray64<uint8> Written;
+		TestTrue(TEXT("Read back"), FFileHelper::LoadFileToArray(Written, *Path));
+		TestEqual(TEXT("File size"), static_cast<uint64>(Written.Num()), FileSize);
+		TestTrue(TEXT("File bytes"), Written == Expected);
+	}
+	QueueDepth->Set(OldQueueDepth);
+	SegmentSize->Set(OldSegmentSize);
+	IFileManager::Get().Delete(*Path);
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamIoUringDownloadTest, "ChunkStream.IoUringWriter.Download",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamIoUringDownloadTest::RunTest(const FString& Parameters)
+{
+	struct FIoUringDownload
+	{
+		TStrongObjectPtr<UChunkStreamDownloader> Downloader;
+		bool bDone = false;
+		EChunkStreamDownloadResult Result = EChunkStreamDownloadResult::InProgress;
+	};
+	
+	// 1 MB chunks through a shallow queue, so writes are still in flight when the next chunk comes
+	IConsoleVariable* IoUringWrites = IConsoleManager::Get().FindConsoleVariable(TEXT("ChunkStream.IoUringWrites"));
+	IConsoleVariable* QueueDepth = IConsoleManager::Get().FindConsoleVariable(TEXT("ChunkStream.IoUringQueueDepth"));
+	IConsoleVariable* MaxChunkSize = IConsoleManager::Get().FindConsoleVariable(TEXT("ChunkStream.MaxChunkSize"));
+	const bool bOldIoUringWrites = IoUringWrites->GetBool();
+	const int32 OldQueueDepth = QueueDepth->GetInt();
+	const int32 OldMaxChunkSize = MaxChunkSize->GetInt();
+	IoUringWrites->Set(true);
+	QueueDepth->Set(4);
+	MaxChunkSize->Set(1);
+	
+	const FString SavePath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("ChunkStreamTests"), TEXT("io_uring_download.bin"));
+	const uint64 FileSize = 6 * 1024 * 1024 + 777;
+	
+	// where io_uring isn't there the download falls back to the file's IFileHandle, and has to be just as right
+	{
+		const FString ProbePath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("ChunkStreamTests"), TEXT("io_uring_probe.bin"));
+		FFileHelper::SaveArrayToFile(TArray<uint8>(), *ProbePath);
+		const TUniquePtr<IChunkStreamFileWriter> Writer = FChunkStreamDownloaderUtils::CreateFileWriter(ProbePath, FileSize);
+		if (!FChunkStreamIoUringWriter::Open(ProbePath))
+		{
+			TestNull(TEXT("No writer without io_uring"), Writer.Get());
+			AddInfo(TEXT("io_uring isn't available, testing the IFileHandle fallback"));
+		}
+		IFileManager::Get().Delete(*ProbePath);
+	}
+	
+	ChunkStreamTests::FMemoryServerRef Server = ChunkStreamTests::RegisterMemoryServer(TEXT("chunkstream-iouring"));
+	const FString URL = TEXT("chunkstream-iouring://files/file.bin");
+	FChunkStreamMemoryFileSettings Settings;
+	Settings.FileSize = FileSize;
+	Server->AddFile(URL, Settings);
+	
+	TSharedRef<FIoUringDownload> Download = MakeShared<FIoUringDownload>();
+	Download->Downloader.Reset(UChunkStreamDownloader::DownloadFileToStorage(nullptr, URL, SavePath));
+	TWeakPtr<FIoUringDownload> WeakDownload = Download;
+	Download->Downloader->Native_DownloadFinished.AddLambda([WeakDownload](FChunkStreamResultParams Params)
+	{
+		if (TSharedPtr<FIoUringDownload> PinnedDownload = WeakDownload.Pin())
+		{
+			PinnedDownload->Result = Params.DownloadTaskResult;
+			PinnedDownload->bDone = true;
+		}
+	});
+	Download->Downloader->Activate();
+	
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, Download, SavePath, FileSize, IoUringWrites, QueueDepth, MaxChunkSize,
+		bOldIoUringWrites, OldQueueDepth, OldMaxChunkSize, StartTime = FPlatformTime::Seconds()]()
+	{
+		if (!Download->bDone && FPlatformTime::Seconds() - StartTime < 60.0)
+		{
+			return false;
+		}
+		if (!Download->bDone)
+		{
+			AddError(TEXT("Download from the memory transport timed out"));
+		}
+		else
+		{
+			TestTrue(TEXT("Download succeeded"), Download->Result == EChunkStreamDownloadResult::Success);
+			TArray64<uint8> Written;
+			TestTrue(TEXT("Read back"), FFileHelper::LoadFileToArray(Written, *SavePath));
+			TestEqual(TEXT("File size"), static_cast<uint64>(Written.Num()), FileSize);
+			TestTrue(TEXT("File bytes"), ChunkStreamTests::MatchesSynthetic(Written));
+		}
+		IFileManager::Get().Delete(*SavePath);
+		IoUringWrites->Set(bOldIoUringWrites);
+		QueueDepth->Set(OldQueueDepth);
+		MaxChunkSize->Set(OldMaxChunkSize);
+		ChunkStreamTests::UnregisterMemoryServer(TEXT("chunkstream-iouring"));
+		return true;
+	}));
+	return true;
+}
+
+#endif //WITH_AUTOMATION_TESTS
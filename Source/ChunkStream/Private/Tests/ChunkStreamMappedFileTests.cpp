@@ -0,0 +1,102 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#if WITH_AUTOMATION_TESTS
+#include "ChunkStreamDownloader.h"
+#include "ChunkStreamMemoryTransport.h"
+#include "ChunkStreamTestHelpers.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UObject/StrongObjectPtr.h"
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamMappedWritesTest, "ChunkStream.MappedWrites",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamMappedWritesTest::RunTest(const FString& Parameters)
+{
+	struct FMappedDownload
+	{
+		TStrongObjectPtr<UChunkStreamDownloader> Downloader;
+		FString SavePath;
+		FChunkStreamDownloadStats FinalStats;
+		bool bDone = false;
+		EChunkStreamDownloadResult Result = EChunkStreamDownloadResult::InProgress;
+	};
+	
+	// 1 MB chunks, so a file is several chunks received into the one mapping
+	IConsoleVariable* MappedWrites = IConsoleManager::Get().FindConsoleVariable(TEXT("ChunkStream.MappedWrites"));
+	IConsoleVariable* MaxChunkSize = IConsoleManager::Get().FindConsoleVariable(TEXT("ChunkStream.MaxChunkSize"));
+	const bool bOldMappedWrites = MappedWrites->GetBool();
+	const int32 OldMaxChunkSize = MaxChunkSize->GetInt();
+	MappedWrites->Set(true);
+	MaxChunkSize->Set(1);
+	
+	ChunkStreamTests::FMemoryServerRef Server = ChunkStreamTests::RegisterMemoryServer(TEXT("chunkstream-mapped"));
+	const uint64 FileSize = 3 * 1024 * 1024 + 4321;
+	
+	// chunks requested by range, and one response streaming the whole file across chunk boundaries
+	TArray<TSharedRef<FMappedDownload>> Downloads;
+	for (int32 i = 0; i < 2; i++)
+	{
+		const FString URL = FString::Printf(TEXT("chunkstream-mapped://files/%d.bin"), i);
+		FChunkStreamMemoryFileSettings Settings;
+		Settings.FileSize = FileSize;
+		Settings.bAcceptRanges = i == 0;
+		Server->AddFile(URL, Settings);
+		
+		TSharedRef<FMappedDownload> Download = MakeShared<FMappedDownload>();
+		Download->SavePath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("ChunkStreamTests"), FString::Printf(TEXT("mapped_%d.bin"), i));
+		Download->Downloader.Reset(UChunkStreamDownloader::DownloadFileToStorage(nullptr, URL, Download->SavePath));
+		TWeakPtr<FMappedDownload> WeakDownload = Download;
+		Download->Downloader->Native_DownloadFinished.AddLambda([WeakDownload](FChunkStreamResultParams Params)
+		{
+			if (TSharedPtr<FMappedDownload> PinnedDownload = WeakDownload.Pin())
+			{
+				PinnedDownload->FinalStats = Params.Downloader->GetStats();
+				PinnedDownload->Result = Params.DownloadTaskResult;
+				PinnedDownload->bDone = true;
+			}
+		});
+		Download->Downloader->Activate();
+		Downloads.Add(Download);
+	}
+	
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, Downloads, FileSize, MappedWrites, MaxChunkSize, bOldMappedWrites, OldMaxChunkSize,
+		StartTime = FPlatformTime::Seconds()]()
+	{
+		const bool bAllDone = !Downloads.ContainsByPredicate([](const TSharedRef<FMappedDownload>& Download) { return !Download->bDone; });
+		if (!bAllDone && FPlatformTime::Seconds() - StartTime < 60.0)
+		{
+			return false;
+		}
+		if (!bAllDone)
+		{
+			AddError(TEXT("Mapped downloads from the memory transport timed out"));
+		}
+		
+		const TArray64<uint8> Expected = ChunkStreamTests::MakeSynthetic(FileSize);
+		for (const TSharedRef<FMappedDownload>& Download : Downloads)
+		{
+			if (Download->bDone)
+			{
+				TestTrue(TEXT("Download succeeded"), Download->Result == EChunkStreamDownloadResult::Success);
+				TestEqual(TEXT("Written the file"), Download->FinalStats.BytesWritten, static_cast<int64>(FileSize));
+				TArray64<uint8> Written;
+				TestTrue(TEXT("Read back"), FFileHelper::LoadFileToArray(Written, *Download->SavePath));
+				TestTrue(TEXT("File bytes"), Written == Expected);
+			}
+			IFileManager::Get().Delete(*Download->SavePath);
+		}
+		MappedWrites->Set(bOldMappedWrites);
+		MaxChunkSize->Set(OldMaxChunkSize);
+		ChunkStreamTests::UnregisterMemoryServer(TEXT("chunkstream-mapped"));
+		return true;
+	}));
+	
+	return true;
+}
+
+#endif //WITH_AUTOMATION_TESTS
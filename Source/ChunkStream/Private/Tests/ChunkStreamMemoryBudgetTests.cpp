@@ -0,0 +1,159 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#if WITH_AUTOMATION_TESTS
+#include "ChunkStreamDownloader.h"
+#include "ChunkStreamMemoryBudget.h"
+#include "ChunkStreamMemoryTransport.h"
+#include "ChunkStreamTestHelpers.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UObject/StrongObjectPtr.h"
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamMemoryBudgetAccountingTest, "ChunkStream.MemoryBudget.Accounting",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamMemoryBudgetAccountingTest::RunTest(const FString& Parameters)
+{
+	FChunkStreamMemoryBudget& Budget = FChunkStreamMemoryBudget::Get();
+	if (Budget.GetReserved() != 0)
+	{
+		AddWarning(TEXT("Downloads are holding chunk memory, skipped"));
+		return true;
+	}
+	IConsoleVariable* BudgetMB = IConsoleManager::Get().FindConsoleVariable(TEXT("ChunkStream.MemoryBudgetMB"));
+	const int32 OldBudgetMB = BudgetMB->GetInt();
+	BudgetMB->Set(1);
+	constexpr uint64 KB = 1024;
+	
+	{
+		FChunkStreamMemoryReservation First = Budget.TryReserve(768 * KB, 256 * KB);
+		TestEqual(TEXT("Whole request granted"), First.Num(), 768 * KB);
+		FChunkStreamMemoryReservation Second = Budget.TryReserve(768 * KB, 128 * KB);
+		TestEqual(TEXT("Granted what is left"), Second.Num(), 256 * KB);
+		TestFalse(TEXT("Nothing left"), Budget.TryReserve(1, 1).IsValid());
+		
+		FChunkStreamMemoryReservation Part = First.Split(512 * KB);
+		TestEqual(TEXT("Split off"), Part.Num(), 512 * KB);
+		TestEqual(TEXT("Split keeps the rest"), First.Num(), 256 * KB);
+		TestEqual(TEXT("Splitting holds the same bytes"), Budget.GetReserved(), 1024 * KB);
+		
+		Part.Shrink(128 * KB);
+		TestEqual(TEXT("Shrink gives bytes back"), Budget.GetReserved(), 640 * KB);
+		TestFalse(TEXT("Above the minimum"), Budget.TryReserve(512 * KB, 512 * KB).IsValid());
+		
+		FChunkStreamMemoryReservation Over = Budget.ReserveOverBudget(2048 * KB);
+		TestEqual(TEXT("Over budget is always granted"), Over.Num(), 2048 * KB);
+		
+		FChunkStreamMemoryReservation Moved = MoveTemp(Over);
+		TestFalse(TEXT("Moved from"), Over.IsValid());
+		Moved.Reset();
+		TestEqual(TEXT("Reset gives bytes back"), Budget.GetReserved(), 640 * KB);
+	}
+	TestEqual(TEXT("Everything given back"), Budget.GetReserved(), static_cast<uint64>(0));
+	
+	// with nothing held even a request bigger than the budget gets its minimum, so a download can't wait forever
+	{
+		FChunkStreamMemoryReservation Big = Budget.TryReserve(4096 * KB, 2048 * KB);
+		TestEqual(TEXT("Minimum granted when nothing is held"), Big.Num(), 2048 * KB);
+	}
+	
+	BudgetMB->Set(OldBudgetMB);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamMemoryBudgetDownloadTest, "ChunkStream.MemoryBudget.Download",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamMemoryBudgetDownloadTest::RunTest(const FString& Parameters)
+{
+	struct FBudgetDownload
+	{
+		TStrongObjectPtr<UChunkStreamDownloader> Downloader;
+		FString SavePath;
+		bool bDone = false;
+		EChunkStreamDownloadResult Result = EChunkStreamDownloadResult::InProgress;
+	};
+	
+	// 1 MB chunks against a 2 MB budget, the downloads take turns and shrink their chunks to fit
+	IConsoleVariable* BudgetMB = IConsoleManager::Get().FindConsoleVariable(TEXT("ChunkStream.MemoryBudgetMB"));
+	IConsoleVariable* MaxChunkSize = IConsoleManager::Get().FindConsoleVariable(TEXT("ChunkStream.MaxChunkSize"));
+	IConsoleVariable* MaxDownloads = IConsoleManager::Get().FindConsoleVariable(TEXT("ChunkStream.MaxConcurrentDownloads"));
+	const int32 OldBudgetMB = BudgetMB->GetInt();
+	const int32 OldMaxChunkSize = MaxChunkSize->GetInt();
+	const int32 OldMaxDownloads = MaxDownloads->GetInt();
+	BudgetMB->Set(2);
+	MaxChunkSize->Set(1);
+	MaxDownloads->Set(4);
+	
+	ChunkStreamTests::FMemoryServerRef Server = ChunkStreamTests::RegisterMemoryServer(TEXT("chunkstream-budget"));
+	const uint64 FileSize = 3 * 1024 * 1024 + 777;
+	
+	TArray<TSharedRef<FBudgetDownload>> Downloads;
+	for (int32 i = 0; i < 4; i++)
+	{
+		const FString URL = FString::Printf(TEXT("chunkstream-budget://files/%d.bin"), i);
+		FChunkStreamMemoryFileSettings Settings;
+		Settings.FileSize = FileSize;
+		Server->AddFile(URL, Settings);
+		
+		TSharedRef<FBudgetDownload> Download = MakeShared<FBudgetDownload>();
+		Download->SavePath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("ChunkStreamTests"), FString::Printf(TEXT("budget_%d.bin"), i));
+		Download->Downloader.Reset(UChunkStreamDownloader::DownloadFileToStorage(nullptr, URL, Download->SavePath));
+		TWeakPtr<FBudgetDownload> WeakDownload = Download;
+		Download->Downloader->Native_DownloadFinished.AddLambda([WeakDownload](FChunkStreamResultParams Params)
+		{
+			if (TSharedPtr<FBudgetDownload> PinnedDownload = WeakDownload.Pin())
+			{
+				PinnedDownload->Result = Params.DownloadTaskResult;
+				PinnedDownload->bDone = true;
+			}
+		});
+		Download->Downloader->Activate();
+		Downloads.Add(Download);
+	}
+	
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, Downloads, FileSize, BudgetMB, MaxChunkSize, MaxDownloads, OldBudgetMB, OldMaxChunkSize,
+		OldMaxDownloads, MaxHeld = static_cast<uint64>(0), StartTime = FPlatformTime::Seconds()]() mutable
+	{
+		MaxHeld = FMath::Max(MaxHeld, FChunkStreamMemoryBudget::Get().GetReserved());
+		const bool bAllDone = !Downloads.ContainsByPredicate([](const TSharedRef<FBudgetDownload>& Download) { return !Download->bDone; });
+		if (!bAllDone && FPlatformTime::Seconds() - StartTime < 60.0)
+		{
+			return false;
+		}
+		if (!bAllDone)
+		{
+			AddError(TEXT("Downloads under a small memory budget timed out"));
+		}
+		
+		// a chunk that is already streaming may go over, never by more than one chunk
+		TestTrue(TEXT("Held memory stayed near the budget"), MaxHeld <= 4 * 1024 * 1024);
+		TestEqual(TEXT("Finished downloads hold no memory"), FChunkStreamMemoryBudget::Get().GetReserved(), static_cast<uint64>(0));
+		
+		const TArray64<uint8> Expected = ChunkStreamTests::MakeSynthetic(FileSize);
+		for (const TSharedRef<FBudgetDownload>& Download : Downloads)
+		{
+			if (Download->bDone)
+			{
+				TestTrue(TEXT("Download succeeded"), Download->Result == EChunkStreamDownloadResult::Success);
+				TArray64<uint8> Written;
+				TestTrue(TEXT("Read back"), FFileHelper::LoadFileToArray(Written, *Download->SavePath));
+				TestTrue(TEXT("File bytes"), Written == Expected);
+			}
+			IFileManager::Get().Delete(*Download->SavePath);
+		}
+		BudgetMB->Set(OldBudgetMB);
+		MaxChunkSize->Set(OldMaxChunkSize);
+		MaxDownloads->Set(OldMaxDownloads);
+		ChunkStreamTests::UnregisterMemoryServer(TEXT("chunkstream-budget"));
+		return true;
+	}));
+	
+	return true;
+}
+
+#endif //WITH_AUTOMATION_TESTS
@@ -0,0 +1,156 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#if WITH_AUTOMATION_TESTS
+#include "ChunkStreamMemoryTransport.h"
+#include "ChunkStreamTestHelpers.h"
+#include "StreamChunkDownloader.h"
+#include "Misc/AutomationTest.h"
+
+namespace ChunkStreamMirrorTests
+{
+	struct FMirrorDownload
+	{
+		TSharedPtr<FStreamChunkDownloader> Downloader;
+		TArray64<uint8> Data;
+		bool bDone = false;
+		EChunkStreamDownloadResult Result = EChunkStreamDownloadResult::InProgress;
+	};
+	
+	// Downloads URLs, a ranked mirror list, in 1 MB chunks into memory
+	TSharedRef<FMirrorDownload> StartDownload(const TArray<FString>& URLs, uint64 FileSize)
+	{
+		TSharedRef<FMirrorDownload> Download = MakeShared<FMirrorDownload>();
+		Download->Data.SetNumZeroed(FileSize);
+		Download->Downloader = MakeShared<FStreamChunkDownloader>(URLs, FString());
+		// only the chunk loop's requests, so the counts per mirror are its choices
+		Download->Downloader->SetAllowRangeHelpers(false);
+		Download->Downloader->BeginDownload(1024 * 1024, FStreamDownloadProgressSignature(),
+			FOnSingleChunkCompleteSignature::CreateLambda([Download](TUniquePtr<StreamChunkDownloader::FChunkInfo>&& Chunk)
+			{
+				if (Chunk->EndOffset < static_cast<uint64>(Download->Data.Num()))
+				{
+					FMemory::Memcpy(Download->Data.GetData() + Chunk->StartOffset, Chunk->Data.GetData(), Chunk->EndOffset - Chunk->StartOffset + 1);
+				}
+			}),
+			FOnDownloadCompleteSignature::CreateLambda([Download](EChunkStreamDownloadResult InResult)
+			{
+				Download->Result = InResult;
+				Download->bDone = true;
+			}));
+		return Download;
+	}
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamMirrorFailoverTest, "ChunkStream.Mirrors.Failover",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamMirrorFailoverTest::RunTest(const FString& Parameters)
+{
+	using namespace ChunkStreamMirrorTests;
+	
+	ChunkStreamTests::FMemoryServerRef Server = ChunkStreamTests::RegisterMemoryServer(TEXT("chunkstream-mirror"));
+	const uint64 FileSize = 4 * 1024 * 1024 + 99;
+	
+	// the primary answers the HEAD and the first chunk, then only 503s
+	FChunkStreamMemoryFileSettings PrimarySettings;
+	PrimarySettings.FileSize = FileSize;
+	PrimarySettings.Faults.Init(EChunkStreamMemoryFault::ServiceUnavailable, 64);
+	PrimarySettings.Faults[0] = EChunkStreamMemoryFault::None;
+	PrimarySettings.Faults[1] = EChunkStreamMemoryFault::None;
+	const FString PrimaryURL = TEXT("chunkstream-mirror://primary/failover.bin");
+	Server->AddFile(PrimaryURL, PrimarySettings);
+	
+	FChunkStreamMemoryFileSettings MirrorSettings;
+	MirrorSettings.FileSize = FileSize;
+	const FString MirrorURL = TEXT("chunkstream-mirror://mirror/failover.bin");
+	Server->AddFile(MirrorURL, MirrorSettings);
+	
+	// a primary that fails from the start, the HEAD request moves on to the mirror too
+	FChunkStreamMemoryFileSettings DeadSettings = MirrorSettings;
+	DeadSettings.FailEveryNthRequest = 1;
+	const FString DeadURL = TEXT("chunkstream-mirror://dead/failover.bin");
+	Server->AddFile(DeadURL, DeadSettings);
+	const FString DeadMirrorURL = TEXT("chunkstream-mirror://mirror/failover2.bin");
+	Server->AddFile(DeadMirrorURL, MirrorSettings);
+	
+	TSharedRef<FMirrorDownload> MidDownload = StartDownload({ PrimaryURL, MirrorURL }, FileSize);
+	TSharedRef<FMirrorDownload> DeadDownload = StartDownload({ DeadURL, DeadMirrorURL }, FileSize);
+	
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, Server, MidDownload, DeadDownload, PrimaryURL, MirrorURL, DeadURL, DeadMirrorURL,
+		StartTime = FPlatformTime::Seconds()]()
+	{
+		if ((!MidDownload->bDone || !DeadDownload->bDone) && FPlatformTime::Seconds() - StartTime < 60.0)
+		{
+			return false;
+		}
+		TestTrue(TEXT("Failing over mid download succeeded"), MidDownload->bDone && MidDownload->Result == EChunkStreamDownloadResult::Success);
+		TestTrue(TEXT("Failing over mid download bytes"), ChunkStreamTests::MatchesSynthetic(MidDownload->Data));
+		TestTrue(TEXT("The primary was asked for more after it started failing"), Server->GetRequestCount(PrimaryURL) > 2);
+		TestTrue(TEXT("The mirror served the chunks the primary failed"), Server->GetRequestCount(MirrorURL) > 0);
+		
+		TestTrue(TEXT("Dead primary download succeeded"), DeadDownload->bDone && DeadDownload->Result == EChunkStreamDownloadResult::Success);
+		TestTrue(TEXT("Dead primary download bytes"), ChunkStreamTests::MatchesSynthetic(DeadDownload->Data));
+		TestTrue(TEXT("The HEAD request went to the mirror"), Server->GetRequestCount(DeadMirrorURL) > 1);
+		const TArray<StreamChunkDownloader::FMirrorState>& Mirrors = DeadDownload->Downloader->GetMirrors();
+		TestTrue(TEXT("The dead primary is marked as failing"), Mirrors.Num() == 2 && Mirrors[0].ConsecutiveFailures > 0);
+		
+		MidDownload->Downloader->Shutdown();
+		DeadDownload->Downloader->Shutdown();
+		ChunkStreamTests::UnregisterMemoryServer(TEXT("chunkstream-mirror"));
+		return true;
+	}));
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamMirrorStripingTest, "ChunkStream.Mirrors.WeightedStriping",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamMirrorStripingTest::RunTest(const FString& Parameters)
+{
+	using namespace ChunkStreamMirrorTests;
+	
+	ChunkStreamTests::FMemoryServerRef Server = ChunkStreamTests::RegisterMemoryServer(TEXT("chunkstream-stripe"));
+	const uint64 FileSize = 12 * 1024 * 1024;
+	
+	// one mirror four times faster than the other, it should get most of the chunks once both are measured
+	FChunkStreamMemoryFileSettings FastSettings;
+	FastSettings.FileSize = FileSize;
+	FastSettings.BytesPerSecond = 8.0 * 1024 * 1024;
+	const FString FastURL = TEXT("chunkstream-stripe://fast/striped.bin");
+	Server->AddFile(FastURL, FastSettings);
+	
+	FChunkStreamMemoryFileSettings SlowSettings = FastSettings;
+	SlowSettings.BytesPerSecond = 2.0 * 1024 * 1024;
+	const FString SlowURL = TEXT("chunkstream-stripe://slow/striped.bin");
+	Server->AddFile(SlowURL, SlowSettings);
+	
+	// ranked slow first, striping goes by measured speed rather than rank
+	TSharedRef<FMirrorDownload> Download = StartDownload({ SlowURL, FastURL }, FileSize);
+	
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, Server, Download, FastURL, SlowURL, StartTime = FPlatformTime::Seconds()]()
+	{
+		if (!Download->bDone && FPlatformTime::Seconds() - StartTime < 60.0)
+		{
+			return false;
+		}
+		TestTrue(TEXT("Striped download succeeded"), Download->bDone && Download->Result == EChunkStreamDownloadResult::Success);
+		TestTrue(TEXT("Striped download bytes"), ChunkStreamTests::MatchesSynthetic(Download->Data));
+		
+		// the slow mirror also answered the HEAD request
+		const int32 SlowChunks = Server->GetRequestCount(SlowURL) - 1;
+		const int32 FastChunks = Server->GetRequestCount(FastURL);
+		TestTrue(TEXT("Both mirrors were sampled"), SlowChunks > 0 && FastChunks > 0);
+		TestTrue(FString::Printf(TEXT("The fast mirror served more chunks (%d) than the slow one (%d)"), FastChunks, SlowChunks), FastChunks > SlowChunks);
+		const TArray<StreamChunkDownloader::FMirrorState>& Mirrors = Download->Downloader->GetMirrors();
+		TestTrue(TEXT("The fast mirror measured faster"), Mirrors.Num() == 2 && Mirrors[1].Throughput > Mirrors[0].Throughput);
+		
+		Download->Downloader->Shutdown();
+		ChunkStreamTests::UnregisterMemoryServer(TEXT("chunkstream-stripe"));
+		return true;
+	}));
+	return true;
+}
+
+#endif //WITH_AUTOMATION_TESTS
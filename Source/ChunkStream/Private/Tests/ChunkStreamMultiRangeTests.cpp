@@ -0,0 +1,76 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#if WITH_AUTOMATION_TESTS
+#include "StreamChunkDownloader.h"
+#include "Misc/AutomationTest.h"
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamMultiRangeTest, "ChunkStream.MultiRange.Parser",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamMultiRangeTest::RunTest(const FString& Parameters)
+{
+	using StreamChunkDownloader::FByteRange;
+	using StreamChunkDownloader::FMultipartRangeParser;
+	
+	FByteRange Range;
+	TestTrue(TEXT("Content-Range with total"), FMultipartRangeParser::ParseContentRange(TEXT("bytes 100-199/1000"), Range) && Range.Start == 100 && Range.End == 199);
+	TestTrue(TEXT("Content-Range without total"), FMultipartRangeParser::ParseContentRange(TEXT("bytes 5-9/*"), Range) && Range.End == 9);
+	TestFalse(TEXT("Unsatisfied range"), FMultipartRangeParser::ParseContentRange(TEXT("bytes */1000"), Range));
+	
+	// two parts with a preamble and epilogue
+	const FString Body = TEXT("preamble\r\n--XYZ\r\nContent-Type: application/octet-stream\r\nContent-Range: bytes 10-14/100\r\n\r\nHELLO")
+		TEXT("\r\n--XYZ\r\nContent-Range: bytes 50-52/100\r\n\r\nabc\r\n--XYZ--\r\nepilogue");
+	const FTCHARToUTF8 BodyUtf8(*Body);
+	const uint8* BodyData = reinterpret_cast<const uint8*>(BodyUtf8.Get());
+	
+	// fed a byte at a time as well as in one go, packets split lines and bodies anywhere
+	for (const int32 Step : { BodyUtf8.Length(), 1, 7 })
+	{
+		FMultipartRangeParser Parser;
+		if (!TestTrue(TEXT("Multipart content type"), Parser.Reset(TEXT("multipart/byteranges; boundary=\"XYZ\""), FString())))
+		{
+			return false;
+		}
+		TMap<uint64, uint8> Received;
+		for (int32 Pos = 0; Pos < BodyUtf8.Length(); Pos += Step)
+		{
+			const bool bParsed = Parser.Feed(BodyData + Pos, FMath::Min(Step, BodyUtf8.Length() - Pos),
+				[&Received](uint64 Offset, const uint8* Data, uint64 Num)
+				{
+					for (uint64 i = 0; i < Num; i++)
+					{
+						Received.Add(Offset + i, Data[i]);
+					}
+				});
+			if (!TestTrue(TEXT("Body parsed"), bParsed))
+			{
+				return false;
+			}
+		}
+		TestTrue(TEXT("Final boundary"), Parser.IsComplete());
+		TestEqual(TEXT("Range bytes"), Received.Num(), 8);
+		TestTrue(TEXT("First part"), Received.FindRef(10) == 'H' && Received.FindRef(14) == 'O');
+		TestTrue(TEXT("Second part"), Received.FindRef(50) == 'a' && Received.FindRef(52) == 'c');
+	}
+	
+	// a single range answer carries its range in the header
+	FMultipartRangeParser Single;
+	TestTrue(TEXT("Single range response"), Single.Reset(TEXT("application/octet-stream"), TEXT("bytes 20-22/100")));
+	uint64 FirstOffset = 0;
+	Single.Feed(reinterpret_cast<const uint8*>("xyz"), 3, [&FirstOffset](uint64 Offset, const uint8* Data, uint64 Num) { FirstOffset = Offset; });
+	TestEqual(TEXT("Single range offset"), FirstOffset, static_cast<uint64>(20));
+	TestTrue(TEXT("Single range complete"), Single.IsComplete());
+	TestFalse(TEXT("Plain response rejected"), Single.Reset(TEXT("application/octet-stream"), FString()));
+	
+	// part without a Content-Range
+	FMultipartRangeParser Broken;
+	Broken.Reset(TEXT("multipart/byteranges; boundary=XYZ"), FString());
+	const char* BrokenBody = "--XYZ\r\n\r\nabc";
+	TestFalse(TEXT("Part without a range"), Broken.Feed(reinterpret_cast<const uint8*>(BrokenBody), FCStringAnsi::Strlen(BrokenBody),
+		[](uint64, const uint8*, uint64) {}));
+	
+	return true;
+}
+
+#endif //WITH_AUTOMATION_TESTS
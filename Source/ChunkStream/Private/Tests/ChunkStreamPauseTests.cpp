@@ -0,0 +1,225 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#if WITH_AUTOMATION_TESTS
+#include "ChunkStreamDownloader.h"
+#include "ChunkStreamMemoryTransport.h"
+#include "ChunkStreamTestHelpers.h"
+#include "HAL/FileManager.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/Compression.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UObject/StrongObjectPtr.h"
+
+namespace ChunkStreamPauseTests
+{
+	struct FPausedDownload
+	{
+		TStrongObjectPtr<UChunkStreamDownloader> Downloader;
+		FString URL;
+		FString SavePath;
+		// What the saved file must hold
+		TArray64<uint8> Expected;
+		uint64 PauseAfterBytes = 0;
+		int32 RequestsAtPause = 0;
+		double PausedAt = 0.0;
+		bool bPaused = false;
+		bool bResumed = false;
+		bool bDone = false;
+		EChunkStreamDownloadResult Result = EChunkStreamDownloadResult::InProgress;
+	};
+	
+	TSharedRef<FPausedDownload> StartDownload(const FString& URL, EChunkStreamDecompression Decompression, TArray64<uint8>&& Expected, uint64 PauseAfterBytes)
+	{
+		TSharedRef<FPausedDownload> Download = MakeShared<FPausedDownload>();
+		Download->URL = URL;
+		Download->SavePath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("ChunkStreamTests"), FPaths::GetCleanFilename(URL));
+		Download->Expected = MoveTemp(Expected);
+		Download->PauseAfterBytes = PauseAfterBytes;
+		IFileManager::Get().Delete(*Download->SavePath);
+		
+		Download->Downloader.Reset(UChunkStreamDownloader::DownloadFileToStorage(nullptr, URL, Download->SavePath));
+		Download->Downloader->SetDecompression(Decompression);
+		TWeakPtr<FPausedDownload> WeakDownload = Download;
+		Download->Downloader->Native_DownloadFinished.AddLambda([WeakDownload](FChunkStreamResultParams Params)
+		{
+			if (TSharedPtr<FPausedDownload> Pinned = WeakDownload.Pin())
+			{
+				Pinned->Result = Params.DownloadTaskResult;
+				Pinned->bDone = true;
+			}
+		});
+		Download->Downloader->Activate();
+		return Download;
+	}
+	
+	// Pauses once PauseAfterBytes have arrived and resumes a second later, true once the download has ended
+	bool TickDownload(FAutomationTestBase& Test, FChunkStreamMemoryTransport& Server, FPausedDownload& Download)
+	{
+		if (Download.bDone)
+		{
+			return true;
+		}
+		const double Now = FPlatformTime::Seconds();
+		if (!Download.bPaused)
+		{
+			if (Download.Downloader->GetStats().BytesDownloaded >= Download.PauseAfterBytes)
+			{
+				Test.TestTrue(FString::Printf(TEXT("Paused '%s'"), *Download.URL), Download.Downloader->Pause());
+				Download.bPaused = true;
+				Download.PausedAt = Now;
+				Download.RequestsAtPause = Server.GetRequestCount(Download.URL);
+			}
+		}
+		else if (!Download.bResumed && Now - Download.PausedAt > 1.0)
+		{
+			Test.TestEqual(FString::Printf(TEXT("No requests while '%s' was paused"), *Download.URL), Server.GetRequestCount(Download.URL), Download.RequestsAtPause);
+			Test.TestTrue(FString::Printf(TEXT("Resumed '%s'"), *Download.URL), Download.Downloader->Resume());
+			Download.bResumed = true;
+		}
+		return false;
+	}
+	
+	void CheckDownload(FAutomationTestBase& Test, FPausedDownload& Download)
+	{
+		Test.TestTrue(FString::Printf(TEXT("'%s' was paused and resumed"), *Download.URL), Download.bPaused && Download.bResumed);
+		Test.TestTrue(FString::Printf(TEXT("'%s' succeeded"), *Download.URL), Download.bDone && Download.Result == EChunkStreamDownloadResult::Success);
+		TArray64<uint8> Saved;
+		FFileHelper::LoadFileToArray(Saved, *Download.SavePath);
+		Test.TestTrue(FString::Printf(TEXT("'%s' saved byte for byte"), *Download.URL), Saved == Download.Expected);
+		IFileManager::Get().Delete(*Download.SavePath);
+	}
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamPauseMidRequestTest, "ChunkStream.Pause.MidRequest",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamPauseMidRequestTest::RunTest(const FString& Parameters)
+{
+	using namespace ChunkStreamPauseTests;
+	
+	// one request for the whole file at 1 MB/s, paused a quarter of the way through it
+	ChunkStreamTests::FMemoryServerRef Server = ChunkStreamTests::RegisterMemoryServer(TEXT("chunkstream-pause"));
+	FChunkStreamMemoryFileSettings Settings;
+	Settings.FileSize = 4 * 1024 * 1024 + 77;
+	Settings.BytesPerSecond = 1024 * 1024;
+	Settings.PacketSize = 16 * 1024;
+	const FString URL = TEXT("chunkstream-pause://files/paused.bin");
+	Server->AddFile(URL, Settings);
+	TSharedRef<FPausedDownload> Download = StartDownload(URL, EChunkStreamDecompression::None, ChunkStreamTests::MakeSynthetic(Settings.FileSize), 1024 * 1024);
+	
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, Server, Download, StartTime = FPlatformTime::Seconds()]()
+	{
+		if (!TickDownload(*this, *Server, *Download) && FPlatformTime::Seconds() - StartTime < 60.0)
+		{
+			return false;
+		}
+		CheckDownload(*this, *Download);
+		
+		// the request after Resume asks for the rest, from the first byte the paused request didn't hand off
+		const TArray<FString> RangeHeaders = Server->GetRangeHeaders(Download->URL);
+		FString ResumedFrom;
+		const bool bRanged = RangeHeaders.Num() > 0 && RangeHeaders.Last().Split(TEXT("="), nullptr, &ResumedFrom);
+		TestTrue(TEXT("Resumed with a ranged request"), bRanged);
+		TestTrue(TEXT("Resumed past the start"), bRanged && FCString::Strtoui64(*ResumedFrom, nullptr, 10) >= Download->PauseAfterBytes);
+		
+		ChunkStreamTests::UnregisterMemoryServer(TEXT("chunkstream-pause"));
+		return true;
+	}));
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamPauseWithoutRangesTest, "ChunkStream.Pause.ServerIgnoresRanges",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamPauseWithoutRangesTest::RunTest(const FString& Parameters)
+{
+	using namespace ChunkStreamPauseTests;
+	
+	// a server without range support can only send the whole file again, written over what is already there
+	ChunkStreamTests::FMemoryServerRef Server = ChunkStreamTests::RegisterMemoryServer(TEXT("chunkstream-pausenoranges"));
+	FChunkStreamMemoryFileSettings Settings;
+	Settings.FileSize = 3 * 1024 * 1024 + 5;
+	Settings.BytesPerSecond = 1024 * 1024;
+	Settings.PacketSize = 16 * 1024;
+	Settings.bAcceptRanges = false;
+	const FString URL = TEXT("chunkstream-pausenoranges://files/restarted.bin");
+	Server->AddFile(URL, Settings);
+	TSharedRef<FPausedDownload> Download = StartDownload(URL, EChunkStreamDecompression::None, ChunkStreamTests::MakeSynthetic(Settings.FileSize), 1024 * 1024);
+	
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, Server, Download, StartTime = FPlatformTime::Seconds()]()
+	{
+		if (!TickDownload(*this, *Server, *Download) && FPlatformTime::Seconds() - StartTime < 60.0)
+		{
+			return false;
+		}
+		CheckDownload(*this, *Download);
+		const TArray<FString> RangeHeaders = Server->GetRangeHeaders(Download->URL);
+		TestTrue(TEXT("Restarted without a range"), RangeHeaders.Num() > 0 && RangeHeaders.Last().IsEmpty());
+		ChunkStreamTests::UnregisterMemoryServer(TEXT("chunkstream-pausenoranges"));
+		return true;
+	}));
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamPauseSequentialProcessorTest, "ChunkStream.Pause.SequentialProcessor",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamPauseSequentialProcessorTest::RunTest(const FString& Parameters)
+{
+	using namespace ChunkStreamPauseTests;
+	
+	// random bytes barely compress, so the gzip stream is about as long as the file
+	TArray<uint8> Source;
+	Source.SetNumUninitialized(3 * 1024 * 1024);
+	FRandomStream Random(1234);
+	for (uint8& Byte : Source)
+	{
+		Byte = static_cast<uint8>(Random.RandHelper(256));
+	}
+	int32 CompressedSize = FCompression::CompressMemoryBound(NAME_Gzip, Source.Num());
+	TArray<uint8> Compressed;
+	Compressed.SetNumUninitialized(CompressedSize);
+	if (!TestTrue(TEXT("Compressed source"), FCompression::CompressMemory(NAME_Gzip, Compressed.GetData(), CompressedSize, Source.GetData(), Source.Num())))
+	{
+		return false;
+	}
+	Compressed.SetNum(CompressedSize);
+	
+	// the decoder must see every byte once, whether the rest comes as a range or the stream starts over
+	ChunkStreamTests::FMemoryServerRef Server = ChunkStreamTests::RegisterMemoryServer(TEXT("chunkstream-pausegzip"));
+	FChunkStreamMemoryFileSettings Settings;
+	Settings.Data = MakeShared<TArray64<uint8>, ESPMode::ThreadSafe>(Compressed.GetData(), Compressed.Num());
+	Settings.BytesPerSecond = 1024 * 1024;
+	Settings.PacketSize = 16 * 1024;
+	const FString RangedURL = TEXT("chunkstream-pausegzip://files/ranged.bin.gz");
+	Server->AddFile(RangedURL, Settings);
+	Settings.bAcceptRanges = false;
+	const FString RestartedURL = TEXT("chunkstream-pausegzip://files/restarted.bin.gz");
+	Server->AddFile(RestartedURL, Settings);
+	
+	const TArray64<uint8> Expected(Source.GetData(), Source.Num());
+	TSharedRef<FPausedDownload> Ranged = StartDownload(RangedURL, EChunkStreamDecompression::Gzip, CopyTemp(Expected), 1024 * 1024);
+	TSharedRef<FPausedDownload> Restarted = StartDownload(RestartedURL, EChunkStreamDecompression::Gzip, CopyTemp(Expected), 1024 * 1024);
+	
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, Server, Ranged, Restarted, StartTime = FPlatformTime::Seconds()]()
+	{
+		const bool bRangedDone = TickDownload(*this, *Server, *Ranged);
+		const bool bRestartedDone = TickDownload(*this, *Server, *Restarted);
+		if (!(bRangedDone && bRestartedDone) && FPlatformTime::Seconds() - StartTime < 60.0)
+		{
+			return false;
+		}
+		CheckDownload(*this, *Ranged);
+		CheckDownload(*this, *Restarted);
+		ChunkStreamTests::UnregisterMemoryServer(TEXT("chunkstream-pausegzip"));
+		return true;
+	}));
+	return true;
+}
+
+#endif //WITH_AUTOMATION_TESTS
@@ -0,0 +1,184 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#if WITH_AUTOMATION_TESTS
+#include "ChunkStream.h"
+#include "ChunkStreamDownloader.h"
+#include "ChunkStreamMemoryTransport.h"
+#include "ChunkStreamTestHelpers.h"
+#include "ChunkStreamResume.h"
+#include "HAL/FileManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UObject/StrongObjectPtr.h"
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamResumeMetadataTest, "ChunkStream.Resume.Metadata",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamResumeMetadataTest::RunTest(const FString& Parameters)
+{
+	using StreamChunkDownloader::FByteRange;
+	const FString TempPath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("ChunkStreamTests"), TEXT("resume_meta.bin"));
+	
+	FChunkStreamResumeData Data;
+	Data.URL = TEXT("https://example.com/file.bin?a=1&b=2");
+	Data.TotalFileSize = 10000;
+	Data.ETag = TEXT("\"abc\"");
+	Data.WrittenRanges = { FByteRange(0, 999), FByteRange(5000, 5999) };
+	TestTrue(TEXT("Saved"), Data.Save(TempPath));
+	
+	FChunkStreamResumeData Loaded;
+	TestTrue(TEXT("Loaded"), FChunkStreamResumeData::Load(TempPath, Loaded));
+	TestEqual(TEXT("URL"), Loaded.URL, Data.URL);
+	TestEqual(TEXT("Size"), Loaded.TotalFileSize, Data.TotalFileSize);
+	TestEqual(TEXT("ETag"), Loaded.ETag, Data.ETag);
+	TestEqual(TEXT("Ranges"), Loaded.WrittenRanges.Num(), 2);
+	TestEqual(TEXT("Written bytes"), Loaded.GetWrittenBytes(), static_cast<uint64>(2000));
+	
+	// a save cut short by a crash keeps the ranges before the torn line
+	FString Text;
+	FFileHelper::LoadFileToString(Text, *FChunkStreamResumeData::GetMetaPath(TempPath));
+	FFileHelper::SaveStringToFile(Text.LeftChop(6), *FChunkStreamResumeData::GetMetaPath(TempPath));
+	TestTrue(TEXT("Torn metadata loaded"), FChunkStreamResumeData::Load(TempPath, Loaded));
+	TestEqual(TEXT("Torn metadata ranges"), Loaded.WrittenRanges.Num(), 1);
+	
+	// nothing to tell a changed file apart with
+	Data.ETag.Empty();
+	Data.Save(TempPath);
+	TestFalse(TEXT("Metadata without validators"), FChunkStreamResumeData::Load(TempPath, Loaded));
+	
+	FChunkStreamResumeData::Delete(TempPath);
+	TestFalse(TEXT("Deleted"), IFileManager::Get().FileExists(*FChunkStreamResumeData::GetMetaPath(TempPath)));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamResumeTempFileTest, "ChunkStream.Resume.TempFile",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamResumeTempFileTest::RunTest(const FString& Parameters)
+{
+	using StreamChunkDownloader::FByteRange;
+	
+	struct FResumeDownload
+	{
+		TStrongObjectPtr<UChunkStreamDownloader> Downloader;
+		FString SavePath;
+		FChunkStreamDownloadStats FinalStats;
+		bool bDone = false;
+		EChunkStreamDownloadResult Result = EChunkStreamDownloadResult::InProgress;
+	};
+	
+	ChunkStreamTests::FMemoryServerRef Server = ChunkStreamTests::RegisterMemoryServer(TEXT("chunkstream-resume"));
+	const uint64 FileSize = 3 * 1024 * 1024 + 99;
+	const TArray<FByteRange> LeftRanges = { FByteRange(0, 1024 * 1024 - 1), FByteRange(2 * 1024 * 1024, 2 * 1024 * 1024 + 4095) };
+	
+	// partial downloads as a crashed run leaves them, under temp paths of another save location
+	// the first server still has the same file, the second has changed so what was left has to be thrown away
+	const TArray<FString> ServerETags = { TEXT("\"v1\""), TEXT("\"v2\"") };
+	TArray<TSharedRef<FResumeDownload>> Downloads;
+	for (int32 i = 0; i < ServerETags.Num(); i++)
+	{
+		const FString URL = FString::Printf(TEXT("chunkstream-resume://files/%d.bin"), i);
+		FChunkStreamMemoryFileSettings Settings;
+		Settings.FileSize = FileSize;
+		Settings.ETag = ServerETags[i];
+		Server->AddFile(URL, Settings);
+		
+		TArray64<uint8> Partial;
+		Partial.SetNumZeroed(LeftRanges.Last().End + 1);
+		for (const FByteRange& Range : LeftRanges)
+		{
+			// the changed file is filled with bytes that can't pass for it
+			if (i == 0)
+			{
+				FChunkStreamMemoryTransport::FillSynthetic(Partial.GetData() + Range.Start, Range.Start, Range.Num());
+			}
+			else
+			{
+				FMemory::Memset(Partial.GetData() + Range.Start, 0xAB, Range.Num());
+			}
+		}
+		const FString LeftPath = FChunkStreamTempFiles::GetTempDirectory() / FString::Printf(TEXT("left_%d.bin"), i);
+		FFileHelper::SaveArrayToFile(Partial, *LeftPath);
+		FChunkStreamResumeData Left;
+		Left.URL = URL;
+		Left.TotalFileSize = FileSize;
+		Left.ETag = TEXT("\"v1\"");
+		Left.WrittenRanges = LeftRanges;
+		Left.Save(LeftPath);
+		
+		TSharedRef<FResumeDownload> Download = MakeShared<FResumeDownload>();
+		Download->SavePath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("ChunkStreamTests"), FString::Printf(TEXT("resume_%d.bin"), i));
+		Download->Downloader.Reset(UChunkStreamDownloader::DownloadFileToStorage(nullptr, URL, Download->SavePath));
+		Downloads.Add(Download);
+	}
+	
+	// the startup sweep indexes them for the next download of their URL
+	FChunkStreamTempFiles& TempFiles = FModuleManager::Get().GetModuleChecked<FChunkStreamModule>(TEXT("ChunkStream")).GetTempFiles();
+	TempFiles.StartSweep();
+	TempFiles.WaitForSweep();
+	TestTrue(TEXT("Sweep kept the partial downloads"), TempFiles.GetNumResumable() >= Downloads.Num());
+	
+	for (const TSharedRef<FResumeDownload>& Download : Downloads)
+	{
+		TWeakPtr<FResumeDownload> WeakDownload = Download;
+		Download->Downloader->Native_DownloadFinished.AddLambda([WeakDownload](FChunkStreamResultParams Params)
+		{
+			if (TSharedPtr<FResumeDownload> PinnedDownload = WeakDownload.Pin())
+			{
+				PinnedDownload->FinalStats = Params.Downloader->GetStats();
+				PinnedDownload->Result = Params.DownloadTaskResult;
+				PinnedDownload->bDone = true;
+			}
+		});
+		Download->Downloader->Activate();
+	}
+	
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, Downloads, FileSize, LeftRanges, StartTime = FPlatformTime::Seconds()]()
+	{
+		const bool bAllDone = !Downloads.ContainsByPredicate([](const TSharedRef<FResumeDownload>& Download) { return !Download->bDone; });
+		if (!bAllDone && FPlatformTime::Seconds() - StartTime < 60.0)
+		{
+			return false;
+		}
+		TestTrue(TEXT("Downloads finished"), bAllDone);
+		uint64 LeftBytes = 0;
+		for (const FByteRange& Range : LeftRanges)
+		{
+			LeftBytes += Range.Num();
+		}
+		for (int32 i = 0; i < Downloads.Num() && bAllDone; i++)
+		{
+			const TSharedRef<FResumeDownload>& Download = Downloads[i];
+			TestTrue(FString::Printf(TEXT("Download %d succeeded"), i), Download->Result == EChunkStreamDownloadResult::Success);
+			
+			TArray64<uint8> Saved;
+			FFileHelper::LoadFileToArray(Saved, *Download->SavePath);
+			const TArray64<uint8> Expected = ChunkStreamTests::MakeSynthetic(FileSize);
+			TestTrue(FString::Printf(TEXT("Download %d bytes"), i), Saved == Expected);
+			
+			if (i == 0)
+			{
+				TestEqual(TEXT("Only the missing bytes were downloaded"), static_cast<uint64>(Download->FinalStats.BytesDownloaded), FileSize - LeftBytes);
+			}
+			else
+			{
+				TestTrue(TEXT("Changed file was downloaded again"), static_cast<uint64>(Download->FinalStats.BytesDownloaded) >= FileSize);
+			}
+			IFileManager::Get().Delete(*Download->SavePath);
+		}
+		for (int32 i = 0; i < Downloads.Num(); i++)
+		{
+			const FString LeftPath = FChunkStreamTempFiles::GetTempDirectory() / FString::Printf(TEXT("left_%d.bin"), i);
+			IFileManager::Get().Delete(*LeftPath);
+			FChunkStreamResumeData::Delete(LeftPath);
+		}
+		ChunkStreamTests::UnregisterMemoryServer(TEXT("chunkstream-resume"));
+		return true;
+	}));
+	
+	return true;
+}
+
+#endif //WITH_AUTOMATION_TESTS
@@ -0,0 +1,98 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#if WITH_AUTOMATION_TESTS
+#include "ChunkStreamDownloader.h"
+#include "ChunkStreamMemoryTransport.h"
+#include "ChunkStreamTestHelpers.h"
+#include "StreamChunkDownloader.h"
+#include "Misc/AutomationTest.h"
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamAdaptiveStallTest, "ChunkStream.Stall.AdaptiveThreshold",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamAdaptiveStallTest::RunTest(const FString& Parameters)
+{
+	struct FStallDownload
+	{
+		TSharedPtr<FStreamChunkDownloader> Downloader;
+		TArray64<uint8> Data;
+		bool bDone = false;
+		EChunkStreamDownloadResult Result = EChunkStreamDownloadResult::InProgress;
+	};
+	auto StartDownload = [](const FString& URL, uint64 FileSize)
+	{
+		TSharedRef<FStallDownload> Download = MakeShared<FStallDownload>();
+		Download->Data.SetNumZeroed(FileSize);
+		Download->Downloader = MakeShared<FStreamChunkDownloader>(URL, FString());
+		Download->Downloader->SetAllowRangeHelpers(false);
+		Download->Downloader->BeginDownload(1024 * 1024, FStreamDownloadProgressSignature(),
+			FOnSingleChunkCompleteSignature::CreateLambda([Download](TUniquePtr<StreamChunkDownloader::FChunkInfo>&& Chunk)
+			{
+				if (Chunk->EndOffset < static_cast<uint64>(Download->Data.Num()))
+				{
+					FMemory::Memcpy(Download->Data.GetData() + Chunk->StartOffset, Chunk->Data.GetData(), Chunk->EndOffset - Chunk->StartOffset + 1);
+				}
+			}),
+			FOnDownloadCompleteSignature::CreateLambda([Download](EChunkStreamDownloadResult InResult)
+			{
+				Download->Result = InResult;
+				Download->bDone = true;
+			}));
+		return Download;
+	};
+	
+	ChunkStreamTests::FMemoryServerRef Server = ChunkStreamTests::RegisterMemoryServer(TEXT("chunkstream-stall"));
+	
+	// a packet every 32 ms, then a 3 second gap in the fourth chunk. Far under the 14 second default, so only a learned threshold catches it
+	FChunkStreamMemoryFileSettings FastSettings;
+	FastSettings.FileSize = 5 * 1024 * 1024 + 11;
+	FastSettings.BytesPerSecond = 2.0 * 1024 * 1024;
+	FastSettings.Faults.Init(EChunkStreamMemoryFault::None, 16);
+	FastSettings.Faults[4] = EChunkStreamMemoryFault::Trickle;
+	FastSettings.TrickleBytes = 64 * 1024;
+	FastSettings.TrickleIntervalSeconds = 3.f;
+	const FString FastURL = TEXT("chunkstream-stall://files/fast.bin");
+	Server->AddFile(FastURL, FastSettings);
+	
+	// a slow but steady link, a packet every 0.4 seconds must not be taken for a stall once the threshold has adapted
+	FChunkStreamMemoryFileSettings SteadySettings;
+	SteadySettings.FileSize = 384 * 1024;
+	SteadySettings.PacketSize = 16 * 1024;
+	SteadySettings.BytesPerSecond = 40.0 * 1024;
+	const FString SteadyURL = TEXT("chunkstream-stall://files/steady.bin");
+	Server->AddFile(SteadyURL, SteadySettings);
+	
+	TSharedRef<FStallDownload> Fast = StartDownload(FastURL, FastSettings.FileSize);
+	TSharedRef<FStallDownload> Steady = StartDownload(SteadyURL, SteadySettings.FileSize);
+	
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, Fast, Steady, StartTime = FPlatformTime::Seconds()]()
+	{
+		if ((!Fast->bDone || !Steady->bDone) && FPlatformTime::Seconds() - StartTime < 60.0)
+		{
+			return false;
+		}
+		for (const TSharedRef<FStallDownload>& Download : { Fast, Steady })
+		{
+			const FString Name = Download == Fast ? TEXT("Fast link") : TEXT("Steady link");
+			TestTrue(Name + TEXT(" succeeded"), Download->bDone && Download->Result == EChunkStreamDownloadResult::Success);
+			TestTrue(Name + TEXT(" bytes"), ChunkStreamTests::MatchesSynthetic(Download->Data));
+		}
+		
+		TestTrue(TEXT("The gap on the fast link was detected as a stall"), Fast->Downloader->GetNumStalls() >= 1);
+		TestTrue(FString::Printf(TEXT("The fast link's threshold came down from the default, %.2fs"), Fast->Downloader->GetStallThreshold()),
+			Fast->Downloader->GetStallThreshold() < 3.f);
+		TestEqual(TEXT("The steady link never stalled"), Steady->Downloader->GetNumStalls(), 0);
+		TestTrue(FString::Printf(TEXT("The steady link's threshold is above its packet gap, %.2fs against %.2fs"),
+			Steady->Downloader->GetStallThreshold(), Steady->Downloader->GetPacketGap()),
+			Steady->Downloader->GetStallThreshold() > Steady->Downloader->GetPacketGap());
+		
+		Fast->Downloader->Shutdown();
+		Steady->Downloader->Shutdown();
+		ChunkStreamTests::UnregisterMemoryServer(TEXT("chunkstream-stall"));
+		return true;
+	}));
+	return true;
+}
+
+#endif //WITH_AUTOMATION_TESTS
@@ -0,0 +1,88 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#if WITH_AUTOMATION_TESTS
+#include "ChunkStreamDownloader.h"
+#include "ChunkStreamMemoryTransport.h"
+#include "ChunkStreamTestHelpers.h"
+#include "HAL/FileManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/Paths.h"
+#include "UObject/StrongObjectPtr.h"
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamDownloadStatsTest, "ChunkStream.Stats.Download",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamDownloadStatsTest::RunTest(const FString& Parameters)
+{
+	struct FStatsState
+	{
+		TStrongObjectPtr<UChunkStreamDownloader> Downloader;
+		FChunkStreamDownloadStats FinalStats;
+		bool bSeenRegistered = false;
+		bool bDone = false;
+		EChunkStreamDownloadResult Result = EChunkStreamDownloadResult::InProgress;
+	};
+	
+	ChunkStreamTests::FMemoryServerRef Server = ChunkStreamTests::RegisterMemoryServer(TEXT("chunkstream-stats"));
+	
+	// the first chunk request after the HEAD fails so there is a retry to count
+	FChunkStreamMemoryFileSettings Settings;
+	Settings.FileSize = 3 * 1024 * 1024 + 321;
+	Settings.FailEveryNthRequest = 2;
+	const FString URL = TEXT("chunkstream-stats://files/stats.bin");
+	Server->AddFile(URL, Settings);
+	const FString SavePath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("ChunkStreamTests"), TEXT("stats.bin"));
+	
+	TSharedRef<FStatsState> State = MakeShared<FStatsState>();
+	State->Downloader.Reset(UChunkStreamDownloader::DownloadFileToStorage(nullptr, URL, SavePath));
+	TWeakPtr<FStatsState> WeakState = State;
+	State->Downloader->Native_DownloadFinished.AddLambda([WeakState](FChunkStreamResultParams Params)
+	{
+		if (TSharedPtr<FStatsState> PinnedState = WeakState.Pin())
+		{
+			PinnedState->FinalStats = Params.Downloader->GetStats();
+			PinnedState->Result = Params.DownloadTaskResult;
+			PinnedState->bDone = true;
+		}
+	});
+	State->Downloader->Activate();
+	
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, State, URL, SavePath, FileSize = Settings.FileSize, StartTime = FPlatformTime::Seconds()]()
+	{
+		if (!State->bDone)
+		{
+			State->bSeenRegistered |= UChunkStreamDownloader::GetAllDownloadStats().ContainsByPredicate([&URL](const FChunkStreamDownloadStats& Stats) { return Stats.URL == URL; });
+			if (FPlatformTime::Seconds() - StartTime < 60.0)
+			{
+				return false;
+			}
+			AddError(TEXT("Download from the memory transport timed out"));
+		}
+		else
+		{
+			const FChunkStreamDownloadStats& Stats = State->FinalStats;
+			TestTrue(TEXT("Download succeeded"), State->Result == EChunkStreamDownloadResult::Success);
+			TestTrue(TEXT("Listed by the module while running"), State->bSeenRegistered);
+			TestEqual(TEXT("Total bytes"), Stats.TotalBytes, static_cast<int64>(FileSize));
+			TestTrue(TEXT("Downloaded at least the file"), Stats.BytesDownloaded >= static_cast<int64>(FileSize));
+			TestTrue(TEXT("Written no more than the file"), Stats.BytesWritten <= static_cast<int64>(FileSize));
+			TestTrue(TEXT("Chunks counted"), Stats.Chunks > 0);
+			TestTrue(TEXT("Retries counted"), Stats.Retries > 0);
+			TestTrue(TEXT("Average rate measured"), Stats.AverageBytesPerSecond > 0.0);
+			TestEqual(TEXT("Nothing left"), Stats.ETASeconds, 0.0);
+			
+			const FChunkStreamDownloadStats Total = FChunkStreamDownloadStats::Aggregate({ Stats, Stats });
+			TestEqual(TEXT("Aggregate downloads"), Total.NumDownloads, 2);
+			TestEqual(TEXT("Aggregate bytes"), Total.BytesDownloaded, Stats.BytesDownloaded * 2);
+			TestEqual(TEXT("Aggregate retries"), Total.Retries, Stats.Retries * 2);
+		}
+		IFileManager::Get().Delete(*SavePath);
+		ChunkStreamTests::UnregisterMemoryServer(TEXT("chunkstream-stats"));
+		return true;
+	}));
+	
+	return true;
+}
+
+#endif //WITH_AUTOMATION_TESTS
@@ -0,0 +1,187 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#if WITH_AUTOMATION_TESTS
+#include "ChunkStreamTasks.h"
+#include "ChunkStreamMemoryTransport.h"
+#include "ChunkStreamTestHelpers.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include <atomic>
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamCancellationTokenTest, "ChunkStream.Tasks.CancellationToken",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamCancellationTokenTest::RunTest(const FString& Parameters)
+{
+	FChunkStreamCancellationToken Parent;
+	FChunkStreamCancellationToken Child = Parent.CreateChild();
+	FChunkStreamCancellationToken Copy = Child;
+	int32 Calls = 0;
+	int32 RemovedCalls = 0;
+	Child.AddCallback([&Calls]() { Calls++; });
+	Child.RemoveCallback(Child.AddCallback([&RemovedCalls]() { RemovedCalls++; }));
+	
+	FChunkStreamCancellationToken Sibling = Parent.CreateChild();
+	Sibling.Cancel();
+	TestTrue(TEXT("Sibling canceled"), Sibling.IsCanceled());
+	TestFalse(TEXT("Canceling a child leaves the parent"), Parent.IsCanceled());
+	TestFalse(TEXT("And its other children"), Child.IsCanceled());
+	
+	Parent.Cancel();
+	Parent.Cancel();
+	TestTrue(TEXT("Child canceled with its parent"), Child.IsCanceled());
+	TestTrue(TEXT("Copies share the state"), Copy.IsCanceled());
+	TestEqual(TEXT("Callback called once"), Calls, 1);
+	TestEqual(TEXT("Removed callback not called"), RemovedCalls, 0);
+	TestEqual(TEXT("Added after cancel is called straight away"), Copy.AddCallback([&Calls]() { Calls++; }), static_cast<uint64>(0));
+	TestEqual(TEXT("Called"), Calls, 2);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamTasksFanOutTest, "ChunkStream.Tasks.FanOut",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamTasksFanOutTest::RunTest(const FString& Parameters)
+{
+	ChunkStreamTests::FMemoryServerRef Server = ChunkStreamTests::RegisterMemoryServer(TEXT("chunkstream-tasks"));
+	const uint64 FileSize = 1024 * 1024 + 55;
+	const FString Directory = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("ChunkStreamTests"), TEXT("Tasks"));
+	
+	TArray<UE::Tasks::TTask<FChunkStreamResult>> Downloads;
+	for (int32 i = 0; i < 6; i++)
+	{
+		const FString URL = FString::Printf(TEXT("chunkstream-tasks://files/%d.bin"), i);
+		FChunkStreamMemoryFileSettings Settings;
+		Settings.FileSize = FileSize;
+		Server->AddFile(URL, Settings);
+		Downloads.Add(ChunkStreamTasks::DownloadFile(URL, FPaths::Combine(Directory, FString::Printf(TEXT("%d.bin"), i))));
+	}
+	// started from a worker, it hops to the game thread to start
+	const FString WorkerURL = TEXT("chunkstream-tasks://files/worker.bin");
+	FChunkStreamMemoryFileSettings WorkerSettings;
+	WorkerSettings.FileSize = FileSize;
+	Server->AddFile(WorkerURL, WorkerSettings);
+	UE::Tasks::TTask<UE::Tasks::TTask<FChunkStreamResult>> FromWorker = UE::Tasks::Launch(UE_SOURCE_LOCATION, [WorkerURL, Directory]()
+	{
+		return ChunkStreamTasks::DownloadFile(WorkerURL, FPaths::Combine(Directory, TEXT("worker.bin")));
+	});
+	
+	// the join and what follows it run on workers
+	UE::Tasks::TTask<TArray<FChunkStreamResult>> All = ChunkStreamTasks::WhenAll(Downloads);
+	TSharedRef<std::atomic<bool>, ESPMode::ThreadSafe> bContinuedOnGameThread = MakeShared<std::atomic<bool>, ESPMode::ThreadSafe>(false);
+	UE::Tasks::TTask<int32> Succeeded = UE::Tasks::Launch(UE_SOURCE_LOCATION, [All, bContinuedOnGameThread]() mutable
+	{
+		bContinuedOnGameThread->store(IsInGameThread());
+		int32 NumSucceeded = 0;
+		for (const FChunkStreamResult& Result : All.GetResult())
+		{
+			NumSucceeded += Result.IsSuccess() ? 1 : 0;
+		}
+		return NumSucceeded;
+	}, UE::Tasks::Prerequisites(All));
+	
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, All, Succeeded, FromWorker, bContinuedOnGameThread, FileSize, Directory,
+		StartTime = FPlatformTime::Seconds()]() mutable
+	{
+		const bool bDone = Succeeded.IsCompleted() && FromWorker.IsCompleted() && FromWorker.GetResult().IsCompleted();
+		if (!bDone && FPlatformTime::Seconds() - StartTime < 60.0)
+		{
+			return false;
+		}
+		if (!bDone)
+		{
+			AddError(TEXT("Download tasks timed out"));
+		}
+		else
+		{
+			TestEqual(TEXT("Every download succeeded"), Succeeded.GetResult(), 6);
+			TestFalse(TEXT("Continuation ran on a worker"), bContinuedOnGameThread->load());
+			TestTrue(TEXT("Started from a worker"), FromWorker.GetResult().GetResult().IsSuccess());
+			
+			const TArray64<uint8> Expected = ChunkStreamTests::MakeSynthetic(FileSize);
+			for (const FChunkStreamResult& Result : All.GetResult())
+			{
+				TArray64<uint8> Written;
+				TestTrue(TEXT("Read back"), FFileHelper::LoadFileToArray(Written, *Result.SavePath));
+				TestTrue(TEXT("File bytes"), Written == Expected);
+				TestEqual(TEXT("Stats of the download"), Result.Stats.BytesWritten, static_cast<int64>(FileSize));
+			}
+		}
+		IFileManager::Get().DeleteDirectory(*Directory, false, true);
+		ChunkStreamTests::UnregisterMemoryServer(TEXT("chunkstream-tasks"));
+		return true;
+	}));
+	
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamTasksCancelTest, "ChunkStream.Tasks.Cancel",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamTasksCancelTest::RunTest(const FString& Parameters)
+{
+	ChunkStreamTests::FMemoryServerRef Server = ChunkStreamTests::RegisterMemoryServer(TEXT("chunkstream-taskscancel"));
+	const FString Directory = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("ChunkStreamTests"), TEXT("TasksCancel"));
+	
+	// slow enough to still be running, more of them than ChunkStream.MaxConcurrentDownloads lets start
+	IConsoleVariable* MaxDownloads = IConsoleManager::Get().FindConsoleVariable(TEXT("ChunkStream.MaxConcurrentDownloads"));
+	const int32 OldMaxDownloads = MaxDownloads->GetInt();
+	MaxDownloads->Set(2);
+	FChunkStreamCancellationToken Token;
+	FChunkStreamCancellationToken Stage = Token.CreateChild();
+	TArray<UE::Tasks::TTask<FChunkStreamResult>> Downloads;
+	for (int32 i = 0; i < 4; i++)
+	{
+		const FString URL = FString::Printf(TEXT("chunkstream-taskscancel://files/%d.bin"), i);
+		FChunkStreamMemoryFileSettings Settings;
+		Settings.FileSize = 8 * 1024 * 1024;
+		Settings.BytesPerSecond = 64 * 1024;
+		Server->AddFile(URL, Settings);
+		Downloads.Add(ChunkStreamTasks::DownloadFile(URL, FPaths::Combine(Directory, FString::Printf(TEXT("%d.bin"), i)), i % 2 == 0 ? Token : Stage));
+	}
+	UE::Tasks::TTask<TArray<FChunkStreamResult>> All = ChunkStreamTasks::WhenAll(Downloads);
+	
+	// cancels from a worker once the first two are transferring
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([Token, StartTime = FPlatformTime::Seconds()]()
+	{
+		if (FPlatformTime::Seconds() - StartTime < 1.0)
+		{
+			return false;
+		}
+		UE::Tasks::Launch(UE_SOURCE_LOCATION, [Token]() { Token.Cancel(); });
+		return true;
+	}));
+	
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, All, Directory, MaxDownloads, OldMaxDownloads,
+		StartTime = FPlatformTime::Seconds()]() mutable
+	{
+		if (!All.IsCompleted() && FPlatformTime::Seconds() - StartTime < 30.0)
+		{
+			return false;
+		}
+		if (!All.IsCompleted())
+		{
+			AddError(TEXT("Canceled download tasks never completed"));
+		}
+		else
+		{
+			for (const FChunkStreamResult& Result : All.GetResult())
+			{
+				TestTrue(FString::Printf(TEXT("'%s' canceled"), *Result.URL), Result.Result == EChunkStreamDownloadResult::UserCancelled);
+				TestFalse(TEXT("Nothing saved"), IFileManager::Get().FileExists(*Result.SavePath));
+			}
+		}
+		IFileManager::Get().DeleteDirectory(*Directory, false, true);
+		MaxDownloads->Set(OldMaxDownloads);
+		ChunkStreamTests::UnregisterMemoryServer(TEXT("chunkstream-taskscancel"));
+		return true;
+	}));
+	
+	return true;
+}
+
+#endif //WITH_AUTOMATION_TESTS
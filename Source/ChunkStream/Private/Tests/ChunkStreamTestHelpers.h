@@ -0,0 +1,48 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#pragma once
+
+#if WITH_AUTOMATION_TESTS
+#include "CoreMinimal.h"
+#include "ChunkStreamMemoryTransport.h"
+#include "ChunkStreamTransport.h"
+
+/** Shared setup for tests that download from the in memory transport */
+namespace ChunkStreamTests
+{
+	typedef TSharedRef<FChunkStreamMemoryTransport, ESPMode::ThreadSafe> FMemoryServerRef;
+
+	// Serves Scheme from a new memory transport until UnregisterMemoryServer
+	inline FMemoryServerRef RegisterMemoryServer(const FString& Scheme)
+	{
+		FMemoryServerRef Server = MakeShared<FChunkStreamMemoryTransport, ESPMode::ThreadSafe>();
+		ChunkStreamTransport::RegisterScheme(Scheme, Server);
+		return Server;
+	}
+
+	inline void UnregisterMemoryServer(const FString& Scheme)
+	{
+		ChunkStreamTransport::RegisterScheme(Scheme, nullptr);
+	}
+
+	// The bytes the memory transport serves for [Offset, Offset + Num) of a synthetic file
+	inline TArray64<uint8> MakeSynthetic(uint64 Num, uint64 Offset = 0)
+	{
+		TArray64<uint8> Bytes;
+		Bytes.SetNumUninitialized(Num);
+		FChunkStreamMemoryTransport::FillSynthetic(Bytes.GetData(), Offset, Num);
+		return Bytes;
+	}
+
+	// Whether Data is the synthetic file's bytes starting at Offset
+	inline bool MatchesSynthetic(const uint8* Data, uint64 Num, uint64 Offset = 0)
+	{
+		return FMemory::Memcmp(Data, MakeSynthetic(Num, Offset).GetData(), Num) == 0;
+	}
+
+	inline bool MatchesSynthetic(const TArray64<uint8>& Data, uint64 Offset = 0)
+	{
+		return MatchesSynthetic(Data.GetData(), Data.Num(), Offset);
+	}
+}
+#endif //WITH_AUTOMATION_TESTS
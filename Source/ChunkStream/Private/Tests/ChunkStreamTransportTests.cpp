@@ -0,0 +1,100 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#if WITH_AUTOMATION_TESTS
+#include "ChunkStreamMemoryTransport.h"
+#include "ChunkStreamTestHelpers.h"
+#include "StreamChunkDownloader.h"
+#include "Misc/AutomationTest.h"
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamMemoryTransportTest, "ChunkStream.Transport.MemoryDownload",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamMemoryTransportTest::RunTest(const FString& Parameters)
+{
+	using StreamChunkDownloader::FByteRange;
+	
+	ChunkStreamTests::FMemoryServerRef Server = ChunkStreamTests::RegisterMemoryServer(TEXT("chunkstream-test"));
+	
+	// the whole file in ranged chunks, with every third request failing so the retry path runs
+	FChunkStreamMemoryFileSettings WholeSettings;
+	WholeSettings.FileSize = 5 * 1024 * 1024 + 123;
+	WholeSettings.PacketSize = 16 * 1024;
+	WholeSettings.FailEveryNthRequest = 3;
+	const FString WholeURL = TEXT("chunkstream-test://files/whole.bin");
+	Server->AddFile(WholeURL, WholeSettings);
+	
+	// sparse ranges from a server without multi-range support, they have to fall back to one request per range
+	FChunkStreamMemoryFileSettings SparseSettings;
+	SparseSettings.FileSize = 1024 * 1024;
+	SparseSettings.bMultiRange = false;
+	const FString SparseURL = TEXT("chunkstream-test://files/sparse.bin");
+	Server->AddFile(SparseURL, SparseSettings);
+	const TArray<FByteRange> SparseRanges = { FByteRange(100, 199), FByteRange(5000, 5999), FByteRange(700000, 700010) };
+	
+	struct FDownloadResult
+	{
+		TArray64<uint8> Data;
+		TArray<FByteRange> Received;
+		bool bDone = false;
+		EChunkStreamDownloadResult Result = EChunkStreamDownloadResult::InProgress;
+	};
+	auto StartDownload = [](const FString& URL, const TArray<FByteRange>& Ranges, uint64 FileSize, const TSharedRef<FDownloadResult>& Result)
+	{
+		Result->Data.SetNumZeroed(FileSize);
+		TSharedRef<FStreamChunkDownloader> Downloader = MakeShared<FStreamChunkDownloader>(URL, FString());
+		Downloader->SetRequestedRanges(Ranges);
+		Downloader->BeginDownload(1024 * 1024, FStreamDownloadProgressSignature(),
+			FOnSingleChunkCompleteSignature::CreateLambda([Result](TUniquePtr<StreamChunkDownloader::FChunkInfo>&& Chunk)
+			{
+				FMemory::Memcpy(Result->Data.GetData() + Chunk->StartOffset, Chunk->Data.GetData(), Chunk->EndOffset - Chunk->StartOffset + 1);
+				Result->Received.Add(FByteRange(Chunk->StartOffset, Chunk->EndOffset));
+			}),
+			FOnDownloadCompleteSignature::CreateLambda([Result](EChunkStreamDownloadResult InResult)
+			{
+				Result->Result = InResult;
+				Result->bDone = true;
+			}));
+		return Downloader;
+	};
+	
+	TSharedRef<FDownloadResult> Whole = MakeShared<FDownloadResult>();
+	TSharedRef<FDownloadResult> Sparse = MakeShared<FDownloadResult>();
+	TSharedRef<FStreamChunkDownloader> WholeDownloader = StartDownload(WholeURL, {}, WholeSettings.FileSize, Whole);
+	TSharedRef<FStreamChunkDownloader> SparseDownloader = StartDownload(SparseURL, SparseRanges, SparseSettings.FileSize, Sparse);
+	
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand(
+		[this, Server, Whole, Sparse, WholeDownloader, SparseDownloader, SparseRanges, WholeURL, SparseURL, StartTime = FPlatformTime::Seconds()]()
+		{
+			if (!Whole->bDone || !Sparse->bDone)
+			{
+				if (FPlatformTime::Seconds() - StartTime < 60.0)
+				{
+					return false;
+				}
+				AddError(TEXT("Downloads from the memory transport timed out"));
+			}
+			else
+			{
+				TestTrue(TEXT("Whole file succeeded"), Whole->Result == EChunkStreamDownloadResult::Success);
+				TestTrue(TEXT("Whole file bytes"), ChunkStreamTests::MatchesSynthetic(Whole->Data));
+				TestTrue(TEXT("Failed requests were retried"), Server->GetRequestCount(WholeURL) > 7);
+				
+				TestTrue(TEXT("Sparse ranges succeeded"), Sparse->Result == EChunkStreamDownloadResult::Success);
+				TestEqual(TEXT("One chunk per range"), Sparse->Received.Num(), SparseRanges.Num());
+				for (const FByteRange& Range : SparseRanges)
+				{
+					const bool bRangeMatches = ChunkStreamTests::MatchesSynthetic(Sparse->Data.GetData() + Range.Start, Range.End - Range.Start + 1, Range.Start);
+					TestTrue(FString::Printf(TEXT("Range %llu-%llu bytes"), Range.Start, Range.End), bRangeMatches);
+				}
+			}
+			WholeDownloader->Shutdown();
+			SparseDownloader->Shutdown();
+			ChunkStreamTests::UnregisterMemoryServer(TEXT("chunkstream-test"));
+			return true;
+		}));
+	
+	return true;
+}
+
+#endif //WITH_AUTOMATION_TESTS
@@ -0,0 +1,57 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#if WITH_AUTOMATION_TESTS
+#include "ChunkStreamMemoryTransport.h"
+#include "ChunkStreamTestHelpers.h"
+#include "ChunkStreamUncachedWriter.h"
+#include "HAL/FileManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamUncachedWriterTest, "ChunkStream.UncachedWriter",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamUncachedWriterTest::RunTest(const FString& Parameters)
+{
+	const FString Path = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("ChunkStreamTests"), TEXT("uncached.bin"));
+	FFileHelper::SaveArrayToFile(TArray<uint8>(), *Path);
+	TUniquePtr<FChunkStreamUncachedWriter> Writer = FChunkStreamUncachedWriter::Open(Path);
+	if (!Writer)
+	{
+		AddInfo(TEXT("Uncached writes aren't supported on this platform"));
+		IFileManager::Get().Delete(*Path);
+		return true;
+	}
+	AddInfo(Writer->IsDirect() ? TEXT("Using O_DIRECT") : TEXT("Using fadvise fallback"));
+	
+	// out of order like chunks, with partial blocks at either end and more than the bounce buffer in one write
+	const uint64 FileSize = 9 * 1024 * 1024 + 123;
+	const TArray64<uint8> Expected = ChunkStreamTests::MakeSynthetic(FileSize);
+	const TArray<TPair<uint64, uint64>> Writes = {
+		{ 4096, 8 * 1024 * 1024 - 1077 },
+		{ 8 * 1024 * 1024 + 4096, FileSize - (8 * 1024 * 1024 + 4096) },
+		{ 0, 100 },
+		{ 100, 3996 },
+		{ 8 * 1024 * 1024 + 4096 - 77, 77 },
+		{ 8 * 1024 * 1024 + 4096 - 77 - 1000, 1000 },
+	};
+	uint64 Covered = 0;
+	for (const TPair<uint64, uint64>& Write : Writes)
+	{
+		TestTrue(FString::Printf(TEXT("Write [%llu, +%llu)"), Write.Key, Write.Value), Writer->Write(Expected.GetData() + Write.Key, Write.Value, Write.Key));
+		Covered += Write.Value;
+	}
+	TestEqual(TEXT("Writes cover the file"), Covered, FileSize);
+	Writer.Reset();
+	
+	TArray64<uint8> Written;
+	TestTrue(TEXT("Read back"), FFileHelper::LoadFileToArray(Written, *Path));
+	TestEqual(TEXT("File size"), static_cast<uint64>(Written.Num()), FileSize);
+	TestTrue(TEXT("File bytes"), Written == Expected);
+	IFileManager::Get().Delete(*Path);
+	return true;
+}
+
+#endif //WITH_AUTOMATION_TESTS
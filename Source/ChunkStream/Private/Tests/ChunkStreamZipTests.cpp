@@ -0,0 +1,329 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#if WITH_AUTOMATION_TESTS
+#include "ChunkStreamMemoryTransport.h"
+#include "ChunkStreamTestHelpers.h"
+#include "ChunkStreamRemoteZip.h"
+#include "ChunkStreamZip.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+THIRD_PARTY_INCLUDES_START
+#include "zlib.h"
+THIRD_PARTY_INCLUDES_END
+
+namespace ChunkStreamZipTests
+{
+	// Minimal zip writer covering what the extractor needs to handle
+	struct FZipBuilder
+	{
+		TArray<uint8> Archive;
+		TArray<uint8> Directory;
+		int32 NumEntries = 0;
+
+		static void Put16(TArray<uint8>& Out, uint32 Value) { Out.Add(Value & 0xFF); Out.Add((Value >> 8) & 0xFF); }
+		static void Put32(TArray<uint8>& Out, uint32 Value) { Put16(Out, Value & 0xFFFF); Put16(Out, Value >> 16); }
+
+		void AddEntry(const FString& Name, const TArray<uint8>& Content, bool bDeflate, bool bDataDescriptor)
+		{
+			const FTCHARToUTF8 NameUtf8(*Name);
+			const uint32 Crc = crc32(0, Content.GetData(), Content.Num());
+			TArray<uint8> Data = Content;
+			if (bDeflate)
+			{
+				z_stream Stream;
+				FMemory::Memzero(Stream);
+				deflateInit2(&Stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+				Data.SetNumUninitialized(deflateBound(&Stream, Content.Num()));
+				Stream.next_in = const_cast<Bytef*>(Content.GetData());
+				Stream.avail_in = Content.Num();
+				Stream.next_out = Data.GetData();
+				Stream.avail_out = Data.Num();
+				deflate(&Stream, Z_FINISH);
+				Data.SetNum(Stream.total_out);
+				deflateEnd(&Stream);
+			}
+			const uint16 Flags = bDataDescriptor ? ChunkStreamZip::FlagDataDescriptor : 0;
+			const uint16 Method = bDeflate ? ChunkStreamZip::MethodDeflate : ChunkStreamZip::MethodStored;
+			const uint32 LocalOffset = Archive.Num();
+			
+			Put32(Archive, ChunkStreamZip::LocalFileHeaderSignature);
+			Put16(Archive, 20);
+			Put16(Archive, Flags);
+			Put16(Archive, Method);
+			Put32(Archive, 0);
+			Put32(Archive, bDataDescriptor ? 0 : Crc);
+			Put32(Archive, bDataDescriptor ? 0 : Data.Num());
+			Put32(Archive, bDataDescriptor ? 0 : Content.Num());
+			Put16(Archive, NameUtf8.Length());
+			Put16(Archive, 0);
+			Archive.Append(reinterpret_cast<const uint8*>(NameUtf8.Get()), NameUtf8.Length());
+			Archive.Append(Data);
+			if (bDataDescriptor)
+			{
+				Put32(Archive, ChunkStreamZip::DataDescriptorSignature);
+				Put32(Archive, Crc);
+				Put32(Archive, Data.Num());
+				Put32(Archive, Content.Num());
+			}
+			
+			Put32(Directory, ChunkStreamZip::CentralDirectorySignature);
+			Put16(Directory, 20);
+			Put16(Directory, 20);
+			Put16(Directory, Flags);
+			Put16(Directory, Method);
+			Put32(Directory, 0);
+			Put32(Directory, Crc);
+			Put32(Directory, Data.Num());
+			Put32(Directory, Content.Num());
+			Put16(Directory, NameUtf8.Length());
+			Put16(Directory, 0);
+			Put16(Directory, 0);
+			Put16(Directory, 0);
+			Put16(Directory, 0);
+			Put32(Directory, 0);
+			Put32(Directory, LocalOffset);
+			Directory.Append(reinterpret_cast<const uint8*>(NameUtf8.Get()), NameUtf8.Length());
+			NumEntries++;
+		}
+
+		TArray<uint8> Finish()
+		{
+			TArray<uint8> Result = Archive;
+			Result.Append(Directory);
+			Put32(Result, ChunkStreamZip::EndOfCentralDirectorySignature);
+			Put16(Result, 0);
+			Put16(Result, 0);
+			Put16(Result, NumEntries);
+			Put16(Result, NumEntries);
+			Put32(Result, Directory.Num());
+			Put32(Result, Archive.Num());
+			Put16(Result, 0);
+			return Result;
+		}
+	};
+
+	bool FeedInSlices(FChunkStreamZipExtractor& Extractor, const TArray<uint8>& Archive)
+	{
+		// uneven slices so headers and descriptors straddle chunk boundaries
+		const int32 Slices[] = { 3, 29, 4093, 65536 };
+		int32 Offset = 0;
+		int32 SliceIndex = 0;
+		while (Offset < Archive.Num())
+		{
+			const int32 Num = FMath::Min(Slices[SliceIndex++ % UE_ARRAY_COUNT(Slices)], Archive.Num() - Offset);
+			if (!Extractor.Process(Archive.GetData() + Offset, Num))
+			{
+				return false;
+			}
+			Offset += Num;
+		}
+		return true;
+	}
+	
+	struct FRemoteExtraction
+	{
+		TSharedPtr<FChunkStreamRemoteZip> RemoteZip;
+		FString TargetDir;
+		bool bDone = false;
+		EChunkStreamDownloadResult Result = EChunkStreamDownloadResult::InProgress;
+	};
+	
+	TSharedRef<FRemoteExtraction> StartRemoteExtraction(const FString& URL, const TArray<FString>& Names, const FString& TargetDir)
+	{
+		TSharedRef<FRemoteExtraction> Extraction = MakeShared<FRemoteExtraction>();
+		Extraction->TargetDir = TargetDir;
+		FPlatformFileManager::Get().GetPlatformFile().DeleteDirectoryRecursively(*TargetDir);
+		Extraction->RemoteZip = MakeShared<FChunkStreamRemoteZip>(URL);
+		TWeakPtr<FRemoteExtraction> WeakExtraction = Extraction;
+		Extraction->RemoteZip->ExtractEntries(Names, TargetDir, FOnDownloadCompleteSignature::CreateLambda([WeakExtraction](EChunkStreamDownloadResult Result)
+		{
+			if (TSharedPtr<FRemoteExtraction> Pinned = WeakExtraction.Pin())
+			{
+				Pinned->Result = Result;
+				Pinned->bDone = true;
+			}
+		}));
+		return Extraction;
+	}
+	
+	// Whether any request asked for a byte in [Start, End]
+	bool WasRangeRequested(const TArray<FString>& RangeHeaders, uint64 Start, uint64 End)
+	{
+		for (const FString& Header : RangeHeaders)
+		{
+			FString Ranges;
+			if (!Header.Split(TEXT("="), nullptr, &Ranges))
+			{
+				continue;
+			}
+			TArray<FString> Parts;
+			Ranges.ParseIntoArray(Parts, TEXT(","));
+			for (const FString& Part : Parts)
+			{
+				FString First;
+				FString Last;
+				if (Part.TrimStartAndEnd().Split(TEXT("-"), &First, &Last)
+					&& FCString::Strtoui64(*First, nullptr, 10) <= End && FCString::Strtoui64(*Last, nullptr, 10) >= Start)
+				{
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamZipExtractTest, "ChunkStream.Zip.Extract",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamZipExtractTest::RunTest(const FString& Parameters)
+{
+	using namespace ChunkStreamZipTests;
+	
+	TArray<uint8> Small;
+	Small.Append(reinterpret_cast<const uint8*>("stored entry"), 12);
+	TArray<uint8> Large;
+	Large.SetNumUninitialized(2 * 1024 * 1024);
+	for (int32 i = 0; i < Large.Num(); i++)
+	{
+		Large[i] = static_cast<uint8>((i * 7) ^ (i >> 11));
+	}
+	
+	FZipBuilder Builder;
+	Builder.AddEntry(TEXT("readme.txt"), Small, false, false);
+	Builder.AddEntry(TEXT("data/"), TArray<uint8>(), false, false);
+	Builder.AddEntry(TEXT("data/buffered.bin"), Large, true, false);
+	Builder.AddEntry(TEXT("data/streamed.bin"), Large, true, true);
+	const TArray<uint8> Archive = Builder.Finish();
+	
+	const FString TargetDir = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("ChunkStreamTests"), TEXT("ZipExtract"));
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.DeleteDirectoryRecursively(*TargetDir);
+	
+	{
+		FChunkStreamZipExtractor Extractor(TargetDir);
+		TestTrue(TEXT("Processed all slices"), FeedInSlices(Extractor, Archive));
+		TestTrue(TEXT("Central directory validated"), Extractor.Finish());
+		TestEqual(TEXT("Extracted entries"), Extractor.GetNumExtractedEntries(), 4);
+	}
+	
+	TArray<uint8> Loaded;
+	FFileHelper::LoadFileToArray(Loaded, *FPaths::Combine(TargetDir, TEXT("readme.txt")));
+	TestTrue(TEXT("Stored entry matches"), Loaded == Small);
+	FFileHelper::LoadFileToArray(Loaded, *FPaths::Combine(TargetDir, TEXT("data/buffered.bin")));
+	TestTrue(TEXT("Buffered entry matches"), Loaded == Large);
+	FFileHelper::LoadFileToArray(Loaded, *FPaths::Combine(TargetDir, TEXT("data/streamed.bin")));
+	TestTrue(TEXT("Streamed entry matches"), Loaded == Large);
+	
+	// a truncated archive has no central directory and must not finish
+	{
+		FChunkStreamZipExtractor Extractor(TargetDir);
+		Extractor.Process(Archive.GetData(), Archive.Num() - 30);
+		TestFalse(TEXT("Truncated archive fails"), Extractor.Finish());
+	}
+	
+	// entries must not escape the target directory
+	{
+		FZipBuilder Escaping;
+		Escaping.AddEntry(TEXT("../escaped.txt"), Small, false, false);
+		FChunkStreamZipExtractor Extractor(TargetDir);
+		TestFalse(TEXT("Path traversal rejected"), FeedInSlices(Extractor, Escaping.Finish()));
+		TestFalse(TEXT("Nothing written outside target"), PlatformFile.FileExists(*FPaths::Combine(FPaths::GetPath(TargetDir), TEXT("escaped.txt"))));
+	}
+	
+	// a second entry with the same name would silently replace the first
+	{
+		FZipBuilder Duplicated;
+		Duplicated.AddEntry(TEXT("readme.txt"), Small, false, false);
+		Duplicated.AddEntry(TEXT("readme.txt"), Large, true, false);
+		FChunkStreamZipExtractor Extractor(TargetDir);
+		const bool bProcessed = FeedInSlices(Extractor, Duplicated.Finish());
+		TestFalse(TEXT("Duplicate entry names rejected"), bProcessed && Extractor.Finish());
+		TestTrue(TEXT("Duplicate reported"), Extractor.GetError().Contains(TEXT("more than once")));
+	}
+	
+	PlatformFile.DeleteDirectoryRecursively(*TargetDir);
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(ChunkStreamZipRemoteTest, "ChunkStream.Zip.Remote",
+								 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool ChunkStreamZipRemoteTest::RunTest(const FString& Parameters)
+{
+	using namespace ChunkStreamZipTests;
+	
+	TArray<uint8> Small;
+	Small.Append(reinterpret_cast<const uint8*>("stored entry"), 12);
+	TArray<uint8> Large;
+	Large.SetNumUninitialized(2 * 1024 * 1024);
+	for (int32 i = 0; i < Large.Num(); i++)
+	{
+		Large[i] = static_cast<uint8>((i * 13) ^ (i >> 9));
+	}
+	
+	FZipBuilder Builder;
+	Builder.AddEntry(TEXT("readme.txt"), Small, false, false);
+	Builder.AddEntry(TEXT("data/buffered.bin"), Large, true, false);
+	const uint64 SkippedStart = Builder.Archive.Num();
+	Builder.AddEntry(TEXT("skipped.bin"), Large, false, false);
+	const uint64 SkippedEnd = Builder.Archive.Num() - 1;
+	Builder.AddEntry(TEXT("data/streamed.bin"), Large, true, true);
+	const TArray<uint8> Archive = Builder.Finish();
+	
+	// same archive with a byte of the stored entry flipped, its CRC no longer matches
+	TArray<uint8> Corrupt = Archive;
+	Corrupt[30 + FCStringAnsi::Strlen("readme.txt")] ^= 0xFF;
+	
+	const FString Scheme = TEXT("chunkstream-remotezip");
+	ChunkStreamTests::FMemoryServerRef Server = ChunkStreamTests::RegisterMemoryServer(Scheme);
+	FChunkStreamMemoryFileSettings Settings;
+	Settings.Data = MakeShared<TArray64<uint8>, ESPMode::ThreadSafe>(Archive.GetData(), Archive.Num());
+	const FString URL = Scheme + TEXT("://files/archive.zip");
+	Server->AddFile(URL, Settings);
+	Settings.Data = MakeShared<TArray64<uint8>, ESPMode::ThreadSafe>(Corrupt.GetData(), Corrupt.Num());
+	const FString CorruptURL = Scheme + TEXT("://files/corrupt.zip");
+	Server->AddFile(CorruptURL, Settings);
+	
+	const FString BaseDir = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("ChunkStreamTests"), TEXT("ZipRemote"));
+	TSharedRef<FRemoteExtraction> Selected = StartRemoteExtraction(URL, { TEXT("readme.txt"), TEXT("data/") }, FPaths::Combine(BaseDir, TEXT("Selected")));
+	TSharedRef<FRemoteExtraction> Missing = StartRemoteExtraction(URL, { TEXT("missing.bin") }, FPaths::Combine(BaseDir, TEXT("Missing")));
+	TSharedRef<FRemoteExtraction> Corrupted = StartRemoteExtraction(CorruptURL, { TEXT("readme.txt") }, FPaths::Combine(BaseDir, TEXT("Corrupt")));
+	
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, Server, Scheme, URL, BaseDir, Selected, Missing, Corrupted, Small, Large,
+		SkippedStart, SkippedEnd, StartTime = FPlatformTime::Seconds()]()
+	{
+		if (!(Selected->bDone && Missing->bDone && Corrupted->bDone) && FPlatformTime::Seconds() - StartTime < 30.0)
+		{
+			return false;
+		}
+		
+		TestTrue(TEXT("Selected entries extracted"), Selected->bDone && Selected->Result == EChunkStreamDownloadResult::Success);
+		TestEqual(TEXT("Central directory entries"), Selected->RemoteZip->GetEntries().Num(), 4);
+		TArray<uint8> Loaded;
+		FFileHelper::LoadFileToArray(Loaded, *FPaths::Combine(Selected->TargetDir, TEXT("readme.txt")));
+		TestTrue(TEXT("Stored entry matches"), Loaded == Small);
+		FFileHelper::LoadFileToArray(Loaded, *FPaths::Combine(Selected->TargetDir, TEXT("data/buffered.bin")));
+		TestTrue(TEXT("Buffered entry matches"), Loaded == Large);
+		FFileHelper::LoadFileToArray(Loaded, *FPaths::Combine(Selected->TargetDir, TEXT("data/streamed.bin")));
+		TestTrue(TEXT("Entry with a data descriptor matches"), Loaded == Large);
+		IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+		TestFalse(TEXT("Unselected entry not extracted"), PlatformFile.FileExists(*FPaths::Combine(Selected->TargetDir, TEXT("skipped.bin"))));
+		TestFalse(TEXT("Unselected entry never downloaded"), WasRangeRequested(Server->GetRangeHeaders(URL), SkippedStart, SkippedEnd));
+		
+		TestTrue(TEXT("Missing entry fails"), Missing->bDone && Missing->Result == EChunkStreamDownloadResult::ValidationFailed);
+		TestTrue(TEXT("Corrupt entry fails"), Corrupted->bDone && Corrupted->Result != EChunkStreamDownloadResult::Success);
+		TestFalse(TEXT("Corrupt entry removed"), PlatformFile.FileExists(*FPaths::Combine(Corrupted->TargetDir, TEXT("readme.txt"))));
+		
+		ChunkStreamTests::UnregisterMemoryServer(Scheme);
+		PlatformFile.DeleteDirectoryRecursively(*BaseDir);
+		return true;
+	}));
+	return true;
+}
+
+#endif //WITH_AUTOMATION_TESTS
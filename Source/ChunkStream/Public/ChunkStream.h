@@ -4,8 +4,11 @@
 
 #include "Modules/ModuleManager.h"
 #include "HAL/IConsoleManager.h"
+#include "ChunkStreamResume.h"
+#include "ChunkStreamConnectionPool.h"
 
 class UChunkStreamDownloader;
+struct FChunkStreamDownloadStats;
 
 class FChunkStreamModule : public IModuleInterface
 {
@@ -18,10 +21,29 @@ public:
 	void UpdateHttpVars();
 	int32 GetNumDownloadsThatCanStart();
 	bool CanStartMoreDownloads() ;
+	// Registered downloads that are running, each holds a connection of the pool
+	int32 GetNumActiveDownloads() const;
+	// Is a download waiting to start only because the pool has no connection for it
+	bool IsWaitingForConnection() const;
 	void RegisterDownloader( UChunkStreamDownloader* Downloader );
 	void UnRegisterDownloader( UChunkStreamDownloader* Downloader );
+	// Activates registered downloads waiting for a slot, eg after one finishes or pauses
+	void StartWaitingDownloads();
+	// Stats of every registered download, running, waiting for a slot or paused. Game thread
+	TArray<FChunkStreamDownloadStats> GetDownloadStats() const;
+	// Stats of every registered download summed together. Game thread
+	FChunkStreamDownloadStats GetAggregateStats() const;
+	// Temp files of downloads and the partial downloads left by earlier runs
+	FChunkStreamTempFiles& GetTempFiles() { return TempFiles; }
+	// Connections shared by the running downloads. Game thread
+	FChunkStreamConnectionPool& GetConnectionPool() { return ConnectionPool; }
 protected:
 	FConsoleVariableSinkHandle KitchenSinkHandle;
+	FDelegateHandle MemoryTrimHandle;
 
 	TArray<TWeakObjectPtr< UChunkStreamDownloader>> RegisteredDownloaders;
+
+	FChunkStreamTempFiles TempFiles;
+
+	FChunkStreamConnectionPool ConnectionPool;
 };
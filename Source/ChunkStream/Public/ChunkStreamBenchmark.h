@@ -0,0 +1,168 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Ticker.h"
+#include "ChunkStreamTypes.h"
+#include "UObject/StrongObjectPtr.h"
+
+class UChunkStreamDownloader;
+class FChunkStreamMemoryTransport;
+
+namespace ChunkStreamBenchmark
+{
+	// Threads whose CPU time a benchmark reports
+	enum class ECpuCounter : uint8
+	{
+		// Receiving bodies, the HTTP thread or the memory transport's serving threads
+		HttpThread,
+		// Writing chunks to storage on the task graph
+		Worker,
+		Num
+	};
+
+	/**
+	 * Adds the CPU time the calling thread spends in its scope to Counter while a benchmark is running.
+	 * Costs one relaxed load otherwise.
+	 */
+	class CHUNKSTREAM_API FScopedCpuTimer
+	{
+	public:
+		explicit FScopedCpuTimer(ECpuCounter InCounter);
+		~FScopedCpuTimer();
+	private:
+		ECpuCounter Counter;
+		uint64 StartNanoseconds;
+	};
+
+	// CPU time of the calling thread since it started, 0 where the platform can't tell
+	CHUNKSTREAM_API uint64 GetThreadCpuNanoseconds();
+}
+
+// One point of a sweep
+struct FChunkStreamBenchmarkCase
+{
+	uint64 FileSize = 0;
+	// ChunkStream.MaxChunkSize for the case
+	int32 ChunkSizeMB = 1;
+	// Downloads of the file running at once, ChunkStream.MaxConcurrentDownloads is raised to match
+	int32 Concurrency = 1;
+	bool bAcceptRanges = true;
+	int32 Repetition = 0;
+};
+
+struct FChunkStreamBenchmarkResult
+{
+	FChunkStreamBenchmarkCase Case;
+	// Every download succeeded with a file of the expected size
+	bool bSucceeded = false;
+	double Seconds = 0.0;
+	// All downloads of the case together
+	double MegabytesPerSecond = 0.0;
+	// From activation to the first progress with data, in milliseconds
+	double MeanTimeToFirstByteMs = 0.0;
+	double MaxTimeToFirstByteMs = 0.0;
+	// Highest resident memory sampled during the case and how far it rose from the start
+	uint64 PeakUsedPhysical = 0;
+	int64 PeakUsedPhysicalDelta = 0;
+	double HttpThreadCpuSeconds = 0.0;
+	double WorkerCpuSeconds = 0.0;
+	// Peak of each ChunkStream/* LLM tag, empty unless the process runs with -llm
+	TArray<TPair<FString, int64>> LLMTagPeaks;
+};
+
+struct FChunkStreamBenchmarkSettings
+{
+	// Swept as every combination, 1 KB to 10 GB files are supported
+	TArray<uint64> FileSizes = { 1024, 1024 * 1024, 64 * 1024 * 1024, 1024 * 1024 * 1024 };
+	TArray<int32> ChunkSizesMB = { 1, 8, 32 };
+	TArray<int32> Concurrencies = { 1, 4 };
+	TArray<bool> AcceptRanges = { true, false };
+	int32 Repetitions = 1;
+
+	// Throughput and latency of the stand-in server, 0 to measure the plugin alone
+	double BytesPerSecond = 0.0;
+	float LatencySeconds = 0.f;
+	int32 PacketSize = 64 * 1024;
+
+	// A case still running after this long fails and the sweep moves on
+	double CaseTimeoutSeconds = 3600.0;
+	// Where downloads and results go, Saved/ChunkStreamBenchmark when empty
+	FString OutputDirectory;
+
+	/**
+	 * Reads "Sizes=1K,4M,10G ChunkSizes=1,8 Concurrency=1,4 Ranges=1,0 Repeat=3 Rate=100M Latency=0.05 Timeout=600 Output=Dir",
+	 * anything left out keeps its default.
+	 * @return false if an argument couldn't be parsed
+	 */
+	bool ParseArguments(const FString& Arguments);
+};
+
+DECLARE_DELEGATE_OneParam(FOnChunkStreamBenchmarkComplete, const TArray<FChunkStreamBenchmarkResult>&);
+
+/**
+ * Runs UChunkStreamDownloader end to end against the in-process memory transport for every case of a sweep, one case at a time
+ * on the game thread ticker, and writes the results as CSV and JSON for comparing plugin versions.
+ * "ChunkStream.Benchmark <arguments>" in the console runs one with FChunkStreamBenchmarkSettings::ParseArguments.
+ */
+class CHUNKSTREAM_API FChunkStreamBenchmark : public TSharedFromThis<FChunkStreamBenchmark>
+{
+public:
+	explicit FChunkStreamBenchmark(const FChunkStreamBenchmarkSettings& InSettings);
+	~FChunkStreamBenchmark();
+
+	// OnComplete is called on the game thread once every case has run and the results are saved
+	void Start(const FOnChunkStreamBenchmarkComplete& OnComplete);
+	// Cancels the running case and skips the rest, the results so far are still saved
+	void Stop();
+	bool IsRunning() const { return TickHandle.IsValid(); }
+
+	const TArray<FChunkStreamBenchmarkResult>& GetResults() const { return Results; }
+	// Paths of the last saved results, empty until the sweep ends
+	const FString& GetCSVPath() const { return CSVPath; }
+	const FString& GetJSONPath() const { return JSONPath; }
+
+	static FString ToCSV(const TArray<FChunkStreamBenchmarkResult>& InResults);
+	static FString ToJSON(const TArray<FChunkStreamBenchmarkResult>& InResults);
+
+private:
+	struct FRunningDownload
+	{
+		TStrongObjectPtr<UChunkStreamDownloader> Downloader;
+		FString SavePath;
+		double FirstByteTime = -1.0;
+		bool bDone = false;
+		EChunkStreamDownloadResult Result = EChunkStreamDownloadResult::InProgress;
+	};
+
+	bool Tick(float DeltaTime);
+	void StartCase(const FChunkStreamBenchmarkCase& Case);
+	void FinishCase(bool bTimedOut);
+	void Finish();
+	void SampleMemory();
+	void SetIntCVar(const TCHAR* Name, int32 Value);
+	void RestoreCVars();
+
+	FChunkStreamBenchmarkSettings Settings;
+	TArray<FChunkStreamBenchmarkCase> Cases;
+	int32 NextCase = 0;
+	TArray<FChunkStreamBenchmarkResult> Results;
+	FOnChunkStreamBenchmarkComplete OnBenchmarkComplete;
+	FTSTicker::FDelegateHandle TickHandle;
+
+	TSharedPtr<FChunkStreamMemoryTransport, ESPMode::ThreadSafe> Server;
+	FString Scheme;
+	FString OutputDirectory;
+	FString CSVPath;
+	FString JSONPath;
+	// Values the sweep overwrote, put back when it ends
+	TMap<FString, int32> SavedCVars;
+
+	TArray<TSharedRef<FRunningDownload>> Downloads;
+	bool bCaseRunning = false;
+	double CaseStartTime = 0.0;
+	uint64 CaseStartUsedPhysical = 0;
+	uint64 CasePeakUsedPhysical = 0;
+	TArray<TPair<FString, int64>> CaseLLMTagPeaks;
+};
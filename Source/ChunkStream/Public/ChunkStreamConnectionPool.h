@@ -0,0 +1,44 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Ticker.h"
+
+class FStreamChunkDownloader;
+
+/**
+ * Connections shared by every running download, see ChunkStream.MaxConnections.
+ * Each running download holds one for its chunk requests, a download only starts when there is one for it (FChunkStreamModule::GetNumDownloadsThatCanStart).
+ * Connections left over go to hedges and to the download with the most left to fetch, which takes a range off the end of what it
+ * hasn't asked for yet, so a file's last bytes come over several connections rather than one. Downloads waiting to start come first.
+ * Game thread.
+ */
+class CHUNKSTREAM_API FChunkStreamConnectionPool
+{
+public:
+	// Lets the pool give Downloader extra connections until its chunk loop is done
+	void Register(const TSharedRef<FStreamChunkDownloader>& Downloader);
+
+	// Hands idle connections to the downloads that need them most
+	void Rebalance();
+
+	// Connections in use by all registered downloads
+	int32 GetNumConnections() const;
+	// Hedges and range helpers of all registered downloads, the connections beyond one per running download
+	int32 GetNumExtraConnections() const;
+	// Connections no running download holds, MAX_int32 when the pool is off
+	int32 GetNumFreeConnections() const;
+	// Can a download open a request besides its chunk request, a hedge or range helper, without taking a waiting download's connection
+	bool CanOpenExtraConnection() const;
+	// ChunkStream.MaxConnections, 0 when the pool is off
+	static int32 GetMaxConnections();
+
+	void Shutdown();
+
+private:
+	bool Tick(float DeltaTime);
+
+	TArray<TWeakPtr<FStreamChunkDownloader>> Downloaders;
+	FTSTicker::FDelegateHandle TickHandle;
+};
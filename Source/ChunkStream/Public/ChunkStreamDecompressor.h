@@ -0,0 +1,76 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ChunkStreamTypes.h"
+#include "ChunkStreamSequentialProcessor.h"
+
+class IFileHandle;
+
+/**
+ * Decodes a gzip, zlib/deflate or zstd download on the fly and appends the result to a file.
+ * Sits between the chunk handoff and storage so a precompressed asset never lands on disk compressed.
+ * The compressed bytes are what gets downloaded, so range requests keep working on them.
+ *
+ * zstd downloads made of several frames are decoded in parallel, one frame per worker, and written back in order.
+ * Frames larger than the parallel limit are streamed through a single decoder instead, as are frames whose header declares no size
+ * or an implausibly large one, and frames whose decoded size the memory budget (FChunkStreamMemoryBudget) can't cover right now.
+ */
+class CHUNKSTREAM_API FChunkStreamDecompressor : public IChunkStreamSequentialProcessor
+{
+public:
+	/**
+	 * @param InFormat - Format of the download, Auto detects it from the first bytes
+	 * @param InOutput - Handle the decoded bytes are appended to, not owned
+	 * @param bInTransportDecoded - The response had a Content-Encoding the HTTP layer already removed,
+	 *		data that doesn't match the format is then written as is instead of failing
+	 */
+	FChunkStreamDecompressor(EChunkStreamDecompression InFormat, IFileHandle* InOutput, bool bInTransportDecoded = false);
+	virtual ~FChunkStreamDecompressor() override;
+
+	virtual bool Process(const uint8* Data, uint64 Num) override;
+	virtual bool Finish() override;
+	virtual void Abort() override;
+
+	// Works out the format from the magic bytes at the start of a stream, None if it isn't compressed
+	static EChunkStreamDecompression DetectFormat(const uint8* Data, uint64 Num);
+
+	// Was the plugin built with zstd (WITH_CHUNKSTREAM_ZSTD)
+	static bool IsZstdAvailable();
+
+	// Decoded bytes written so far
+	uint64 GetBytesWritten() const { return BytesWritten; }
+
+	// Format being decoded, resolved from Auto once enough bytes have arrived
+	EChunkStreamDecompression GetFormat() const { return Format; }
+
+private:
+	// Picks the decoder once the first bytes are known
+	bool BeginDecoding(const uint8* Data, uint64 Num);
+	bool DecodeBytes(const uint8* Data, uint64 Num);
+	bool ProcessZlib(const uint8* Data, uint64 Num);
+	bool ProcessZstd(const uint8* Data, uint64 Num);
+	bool WriteOutput(const uint8* Data, uint64 Num);
+
+	struct FZlibState;
+	struct FZstdState;
+
+	EChunkStreamDecompression Format;
+	IFileHandle* Output = nullptr;
+	bool bTransportDecoded = false;
+	bool bStarted = false;
+	// Format didn't match and the data is being written as downloaded
+	bool bPassThrough = false;
+
+	// First bytes held until there are enough to detect the format
+	TArray<uint8> HeaderBytes;
+
+	// Scratch space decoders inflate into before writing
+	TArray64<uint8> OutputBuffer;
+
+	TUniquePtr<FZlibState> Zlib;
+	TUniquePtr<FZstdState> Zstd;
+
+	uint64 BytesWritten = 0;
+};
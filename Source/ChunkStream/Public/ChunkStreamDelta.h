@@ -0,0 +1,136 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/SecureHash.h"
+#include "StreamChunkDownloader.h"
+
+/**
+ * Block checksums of a file, all a delta download needs to know about the new version.
+ * Built when the file is published (see Build) and downloaded ahead of it.
+ */
+struct CHUNKSTREAM_API FChunkStreamBlockIndex
+{
+	// Bytes per block, the last block may be shorter
+	int32 BlockSize = 0;
+	uint64 FileSize = 0;
+	// SHA-1 of the whole file, checked once it has been assembled
+	FSHAHash FileHash;
+	// Rolling checksum and SHA-1 of each block
+	TArray<uint32> WeakSums;
+	TArray<FSHAHash> StrongSums;
+
+	int32 GetNumBlocks() const { return WeakSums.Num(); }
+	uint64 GetBlockStart(int32 Block) const { return static_cast<uint64>(Block) * BlockSize; }
+	uint64 GetBlockBytes(int32 Block) const { return FMath::Min<uint64>(BlockSize, FileSize - GetBlockStart(Block)); }
+
+	// Checksums the file at FilePath
+	static bool Build(const FString& FilePath, int32 InBlockSize, FChunkStreamBlockIndex& OutIndex);
+	static void Build(const uint8* Data, uint64 Num, int32 InBlockSize, FChunkStreamBlockIndex& OutIndex);
+
+	// Binary form of the index, as stored on the server. Loading fails on a corrupt or mismatched index
+	bool Serialize(FArchive& Ar);
+	bool SaveToFile(const FString& FilePath);
+	bool LoadFromFile(const FString& FilePath);
+	bool LoadFromMemory(const TArray<uint8>& Data);
+};
+
+namespace ChunkStreamDelta
+{
+	// rsync style checksum of a window of bytes that can be slid forward a byte at a time
+	struct FRollingChecksum
+	{
+		uint32 A = 0;
+		uint32 B = 0;
+
+		void Init(const uint8* Data, int64 Num)
+		{
+			A = 0;
+			B = 0;
+			for (int64 i = 0; i < Num; i++)
+			{
+				A += Data[i];
+				B += static_cast<uint32>(Num - i) * Data[i];
+			}
+		}
+
+		// Out leaves the window and In enters it
+		void Roll(uint8 Out, uint8 In, int64 WindowSize)
+		{
+			A += static_cast<uint32>(In) - Out;
+			B += A - static_cast<uint32>(WindowSize) * Out;
+		}
+
+		uint32 Get() const { return (A & 0xffff) | (B << 16); }
+	};
+
+	/**
+	 * Finds the full size blocks of Index that exist anywhere in the old file.
+	 * The old file is split into segments scanned in parallel, each rolling a checksum one byte at a time.
+	 * @param OutOldOffsets - For each block of Index, an offset in the old file holding the same bytes, or -1
+	 */
+	CHUNKSTREAM_API bool FindReusableBlocks(const FChunkStreamBlockIndex& Index, const FString& OldFilePath, TArray<int64>& OutOldOffsets);
+	CHUNKSTREAM_API void FindReusableBlocks(const FChunkStreamBlockIndex& Index, const uint8* OldData, uint64 OldSize, TArray<int64>& OutOldOffsets);
+}
+
+/**
+ * Updates a local file to a new version by downloading only the blocks that changed.
+ * Blocks of the new file found in the old one are copied from it, the rest are fetched as ranges through FStreamChunkDownloader.
+ * The assembled file is checked against the index's hash before it replaces SavePath. The server must support Range requests.
+ */
+class CHUNKSTREAM_API FChunkStreamDeltaDownload : public TSharedFromThis<FChunkStreamDeltaDownload>
+{
+public:
+	FChunkStreamDeltaDownload(const FString& InURL, const FChunkStreamBlockIndex& InIndex);
+	~FChunkStreamDeltaDownload();
+
+	/**
+	 * Builds the new version at SavePath from OldFilePath and the missing ranges of URL. SavePath may be OldFilePath.
+	 * OnComplete runs on the game thread. Call on the game thread.
+	 */
+	void Start(const FString& OldFilePath, const FString& SavePath, const FOnDownloadCompleteSignature& OnComplete);
+
+	// Stops the update, it completes with UserCancelled and the old file is left as it was
+	void Cancel();
+
+	// Bytes copied from the old file and fetched from the server, known once the old file has been scanned
+	uint64 GetReusedBytes() const { return ReusedBytes; }
+	uint64 GetFetchedBytes() const { return FetchedBytes; }
+
+private:
+	// Worker: scans the old file and copies the blocks it has into the temp file
+	void ReuseOldBlocks();
+	// Game thread: downloads whatever the old file didn't have
+	void StartMissingDownload(TArray<StreamChunkDownloader::FByteRange>&& Ranges);
+	void OnDeltaChunk(TUniquePtr<StreamChunkDownloader::FChunkInfo>&& Chunk);
+	// Marks the download as over, the worker then verifies the file or throws it away
+	void EndDeltaDownload(EChunkStreamDownloadResult Result);
+	// Writes queued chunks to the temp file, runs on one worker at a time
+	void DrainDeltaChunks();
+	// Checks the hash of the assembled file and moves it to SavePath, on the worker
+	EChunkStreamDownloadResult FinalizeFile();
+	void Finish(EChunkStreamDownloadResult Result);
+
+	FString URL;
+	FChunkStreamBlockIndex Index;
+	FString OldPath;
+	FString SavePath;
+	FString TempPath;
+	FOnDownloadCompleteSignature CompleteDelegate;
+
+	TSharedPtr<FStreamChunkDownloader> Downloader;
+	IFileHandle* TempFile = nullptr;
+
+	std::atomic<uint64> ReusedBytes{0};
+	std::atomic<uint64> FetchedBytes{0};
+	std::atomic<bool> bCanceled{false};
+	bool bRunning = false;
+
+	// Chunks waiting to be written, guarded by QueueLock
+	FCriticalSection QueueLock;
+	TArray<TUniquePtr<StreamChunkDownloader::FChunkInfo>> PendingChunks;
+	bool bDraining = false;
+	bool bDownloadDone = false;
+	EChunkStreamDownloadResult DownloadResult = EChunkStreamDownloadResult::InProgress;
+};
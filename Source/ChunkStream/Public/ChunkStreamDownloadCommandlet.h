@@ -0,0 +1,54 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "ChunkStreamDownloadCommandlet.generated.h"
+
+// One file of a download manifest
+struct FChunkStreamManifestEntry
+{
+	// Primary URL first, the rest are mirrors serving the same content
+	TArray<FString> URLs;
+	FString SavePath;
+	// Line of the manifest it came from, for errors
+	int32 Line = 0;
+};
+
+/**
+ * Downloads every file of a manifest without a game world, for warming caches and mirroring content on build and CI machines.
+ *
+ * UnrealEditor-Cmd <Project> -run=ChunkStreamDownload -Manifest=<File> [-Output=<Dir>] [-Concurrency=16] [-Timeout=<Seconds>]
+ *     [-StatsInterval=5] [-SkipExisting]
+ *
+ * Each manifest line is a file: its URLs, the primary first and then mirrors, and optionally where to save it, relative to
+ * -Output unless absolute. Without a save path the file goes to <Output>/<host>/<path> of its first URL. Empty lines and
+ * lines starting with # are skipped.
+ *
+ *     https://cdn.example.com/paks/base.pak https://mirror.example.com/paks/base.pak Paks/base.pak
+ *     https://cdn.example.com/movies/intro.mp4
+ *
+ * Aggregate throughput is logged every -StatsInterval seconds and for every file as it finishes. Returns 0 when every file
+ * downloaded, 1 otherwise.
+ */
+UCLASS()
+class CHUNKSTREAM_API UChunkStreamDownloadCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UChunkStreamDownloadCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+	/**
+	 * Reads the files of a manifest, save paths are made absolute against OutputDirectory.
+	 * @return false with OutError set when a line can't be used
+	 */
+	static bool ParseManifest(const FString& ManifestText, const FString& OutputDirectory, TArray<FChunkStreamManifestEntry>& OutEntries,
+		FString& OutError);
+
+	// <OutputDirectory>/<host>/<path> of URL, empty if the URL doesn't name a file
+	static FString GetMirrorPathForURL(const FString& URL, const FString& OutputDirectory);
+};
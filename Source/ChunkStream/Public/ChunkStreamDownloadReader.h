@@ -0,0 +1,115 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "GenericPlatform/GenericPlatformFile.h"
+#include "StreamChunkDownloader.h"
+
+/**
+ * Shared by a UChunkStreamDownloader and the readers opened on its download.
+ * Tracks which byte ranges are on disk and owns the read handle, so the file can be moved or deleted under the readers.
+ */
+class CHUNKSTREAM_API FChunkStreamDownloadReadState
+{
+public:
+	explicit FChunkStreamDownloadReadState(const TSharedPtr<FStreamChunkDownloader>& InDownloader) : Downloader(InDownloader) {}
+	~FChunkStreamDownloadReadState();
+
+	// File the download is being written to
+	void SetFilePath(const FString& InFilePath);
+
+	// Bytes [Start, End] have been written and flushed
+	void OnRangeWritten(uint64 Start, uint64 End, uint64 InTotalFileSize);
+
+	// Runs WhileReleased with the read handle closed and reads held off, for moving or deleting the file
+	void ReleaseFile(TFunctionRef<void()> WhileReleased);
+
+	// The download ended, readers of a successful one carry on from FinalPath. Only the first call counts
+	void Finish(bool bSuccess, const FString& FinalPath);
+
+	// Bytes from Offset that are on disk, up to the end of the written range holding it
+	uint64 GetWrittenBytesAt(uint64 Offset);
+
+	// Resolves true once [Offset, Offset + Bytes) is on disk, false if the download ends without it
+	TFuture<bool> WhenWritten(uint64 Offset, uint64 Bytes);
+
+	// Reads bytes that are on disk
+	bool ReadFromFile(uint8* Destination, uint64 Offset, uint64 Bytes);
+
+	// Bytes that arrived but aren't written yet, see FStreamChunkDownloader::CopyReceivedBytes
+	uint64 CopyReceivedBytes(uint8* Destination, uint64 Offset, uint64 MaxBytes);
+
+	// Moves Offset to the front of the download
+	void Prioritize(uint64 Offset);
+
+	// Size of the whole file, 0 until known
+	uint64 GetFileSize() const;
+
+	bool IsFinished() const { return bFinished; }
+
+private:
+	struct FWaiter
+	{
+		uint64 Start = 0;
+		uint64 End = 0;
+		TPromise<bool> Promise;
+	};
+
+	// Is [Start, End] written, caller holds RangeLock
+	bool IsWritten(uint64 Start, uint64 End) const;
+
+	TWeakPtr<FStreamChunkDownloader> Downloader;
+
+	FCriticalSection RangeLock;
+	TArray<StreamChunkDownloader::FByteRange> WrittenRanges;
+	TArray<FWaiter> Waiters;
+
+	// Guards the path and read handle, held while the file is moved
+	FCriticalSection FileLock;
+	FString FilePath;
+	IFileHandle* ReadHandle = nullptr;
+
+	std::atomic<uint64> TotalFileSize{0};
+	std::atomic<bool> bFinished{false};
+};
+
+/**
+ * IFileHandle on a file that is still downloading, see UChunkStreamDownloader::OpenReader.
+ * Reads of written bytes return straight away. Reads of missing bytes move them to the front of the download and wait,
+ * using bytes of the chunk in flight as soon as they arrive. They can't wait on the game thread and fail there instead.
+ * The reader keeps working on the final file once the download completes.
+ */
+class CHUNKSTREAM_API FChunkStreamDownloadReader : public IFileHandle
+{
+public:
+	explicit FChunkStreamDownloadReader(const TSharedRef<FChunkStreamDownloadReadState>& InState) : State(InState) {}
+
+	// Are the bytes written to disk already
+	bool IsAvailable(int64 Offset, int64 Bytes) const;
+
+	// Resolves true once the bytes are on disk, false if the download ends without them. Moves them to the front of the download
+	TFuture<bool> WhenAvailable(int64 Offset, int64 Bytes);
+
+	/**
+	 * Reads Bytes at Offset, waiting for any that haven't arrived.
+	 * @param TimeoutSeconds - Give up after this long, 0 waits until the download ends
+	 * @return false if the bytes aren't in the file, the download failed or the wait timed out
+	 */
+	bool ReadAt(uint8* Destination, int64 Bytes, int64 Offset, float TimeoutSeconds = 0.0f);
+
+	virtual int64 Tell() override { return Position; }
+	virtual bool Seek(int64 NewPosition) override;
+	virtual bool SeekFromEnd(int64 NewPositionRelativeToEnd = 0) override;
+	virtual bool Read(uint8* Destination, int64 BytesToRead) override;
+	virtual bool Write(const uint8* Source, int64 BytesToWrite) override { return false; }
+	virtual bool Flush(const bool bFullFlush = false) override { return true; }
+	virtual bool Truncate(int64 NewSize) override { return false; }
+	// -1 until the size of the download is known
+	virtual int64 Size() override;
+
+private:
+	TSharedRef<FChunkStreamDownloadReadState> State;
+	int64 Position = 0;
+};
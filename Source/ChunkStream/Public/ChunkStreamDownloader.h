@@ -4,6 +4,10 @@
 
 #include "CoreMinimal.h"
 #include "StreamChunkDownloader.h"
+#include "ChunkStreamSequentialProcessor.h"
+#include "ChunkStreamDownloadReader.h"
+#include "ChunkStreamResume.h"
+#include "ChunkStreamFileWriter.h"
 #include "Kismet/BlueprintAsyncActionBase.h"
 #include "UObject/Object.h"
 #include "ChunkStreamDownloader.generated.h"
@@ -12,6 +16,8 @@ class FChunkStreamDownloaderUtils
 {
 public:
 	static uint64 GetMaxChunkSize();
+	// Backend writing a download's chunks for the platform and size, null to write through the file's IFileHandle
+	static TUniquePtr<IChunkStreamFileWriter> CreateFileWriter(const FString& FilePath, uint64 TotalFileSize);
 };
 
 USTRUCT(BlueprintType)
@@ -32,6 +38,76 @@ struct FChunkStreamResultParams
 	
 };
 
+/**
+ * Live telemetry of a download, or of all registered downloads summed together.
+ * BufferedBytes and SecondsWaitingForWrite growing while the rate stays low points at storage, a low rate with nothing buffered at the network.
+ */
+USTRUCT(BlueprintType)
+struct FChunkStreamDownloadStats
+{
+	GENERATED_BODY()
+	// Empty for the aggregate
+	UPROPERTY(BlueprintReadOnly, Category = "ChunkStreamDownloader")
+	FString URL;
+	// Downloads the stats cover, 1 unless aggregated
+	UPROPERTY(BlueprintReadOnly, Category = "ChunkStreamDownloader")
+	int32 NumDownloads = 0;
+	UPROPERTY(BlueprintReadOnly, Category = "ChunkStreamDownloader")
+	EChunkStreamDownloadResult DownloadTaskResult = EChunkStreamDownloadResult::None;
+	// 0 -> 1, for the aggregate it is by bytes across downloads of known size
+	UPROPERTY(BlueprintReadOnly, Category = "ChunkStreamDownloader")
+	float Progress = 0.f;
+	// Received over the last second
+	UPROPERTY(BlueprintReadOnly, Category = "ChunkStreamDownloader")
+	double CurrentBytesPerSecond = 0.0;
+	// Received over the time the download has been active, waiting and paused time excluded
+	UPROPERTY(BlueprintReadOnly, Category = "ChunkStreamDownloader")
+	double AverageBytesPerSecond = 0.0;
+	// Seconds left at the current rate (the average while nothing is arriving), -1 if the size isn't known
+	UPROPERTY(BlueprintReadOnly, Category = "ChunkStreamDownloader")
+	double ETASeconds = -1.0;
+	// Size of the file, or of the requested ranges. 0 while unknown
+	UPROPERTY(BlueprintReadOnly, Category = "ChunkStreamDownloader")
+	int64 TotalBytes = 0;
+	// Bytes received from the network, retried bytes included
+	UPROPERTY(BlueprintReadOnly, Category = "ChunkStreamDownloader")
+	int64 BytesDownloaded = 0;
+	// Bytes of the download given to storage, or to the decompressor / extractor
+	UPROPERTY(BlueprintReadOnly, Category = "ChunkStreamDownloader")
+	int64 BytesWritten = 0;
+	// Completed chunks held in memory until they are written
+	UPROPERTY(BlueprintReadOnly, Category = "ChunkStreamDownloader")
+	int64 BufferedBytes = 0;
+	UPROPERTY(BlueprintReadOnly, Category = "ChunkStreamDownloader")
+	int32 Chunks = 0;
+	UPROPERTY(BlueprintReadOnly, Category = "ChunkStreamDownloader")
+	int32 Retries = 0;
+	UPROPERTY(BlueprintReadOnly, Category = "ChunkStreamDownloader")
+	int32 Stalls = 0;
+	// Seconds without data before a request counts as stalled, adapted to the packet timing seen so far. The aggregate has the longest
+	UPROPERTY(BlueprintReadOnly, Category = "ChunkStreamDownloader")
+	float StallThresholdSeconds = 0.f;
+	// Smoothed time between packets in milliseconds. The aggregate has the longest
+	UPROPERTY(BlueprintReadOnly, Category = "ChunkStreamDownloader")
+	float PacketGapMs = 0.f;
+	// Time spent waiting for a slot under ChunkStream.MaxConcurrentDownloads
+	UPROPERTY(BlueprintReadOnly, Category = "ChunkStreamDownloader")
+	double SecondsWaitingForSlot = 0.0;
+	// Time completed chunks spent queued before their write started, summed over chunks
+	UPROPERTY(BlueprintReadOnly, Category = "ChunkStreamDownloader")
+	double SecondsWaitingForWrite = 0.0;
+	// Time the download has been transferring
+	UPROPERTY(BlueprintReadOnly, Category = "ChunkStreamDownloader")
+	double SecondsActive = 0.0;
+
+	// Sums stats of several downloads, rates add up and the ETA is for all of them
+	static FChunkStreamDownloadStats Aggregate(const TArray<FChunkStreamDownloadStats>& Stats);
+	// Fills ETASeconds from the sizes and rates
+	void UpdateETA();
+	// One line summary for logs and the ChunkStream.Stats command
+	FString ToString() const;
+};
+
 DECLARE_MULTICAST_DELEGATE_OneParam(FNativeStreamOnDownloadProgress, FChunkStreamResultParams);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FStreamOnDownloadProgress, FChunkStreamResultParams,ResultParams);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FStreamOnDownloadFinished, FChunkStreamResultParams, ResultParams);
@@ -56,6 +132,25 @@ public:
 		const FString& FileSavePathAndName = TEXT("")
 			);
 
+	/** Download a file to storage from a ranked list of mirrors serving the same content.
+	 * Failed chunks move to the next mirror and ranged chunks are spread across mirrors by measured speed.
+	 * @param URLs : HTTPS URLs for the same file, the first is preferred. Without any the download fails with ValidationFailed when activated
+	 * @param FileSavePathAndName : Location to save to with the file name, eg C:/MyGame/MyFile.mp4
+	 */
+	UFUNCTION(BlueprintCallable,Category = "ChunkStreamDownloader",meta=(BlueprintInternalUseOnly=true,WorldContext="WorldContext",DefaultToSelf="WorldContext",HidePin="WorldContext"))
+	static UChunkStreamDownloader* DownloadFileToStorageFromMirrors(const UObject* WorldContext,const TArray<FString>& URLs,
+		const FString& FileSavePathAndName = TEXT("")
+			);
+
+	/** Download a zip archive and extract its entries into a directory as the data arrives.
+	 * The archive itself is never stored, only the extracted files. The central directory is validated once the download ends.
+	 * @param URL : HTTPS URL of the zip archive
+	 * @param ExtractToDirectory : Directory the entries are extracted into, eg C:/MyGame/Content/DLC
+	 */
+	UFUNCTION(BlueprintCallable,Category = "ChunkStreamDownloader",meta=(BlueprintInternalUseOnly=true,WorldContext="WorldContext",DefaultToSelf="WorldContext",HidePin="WorldContext"))
+	static UChunkStreamDownloader* DownloadAndExtractZip(const UObject* WorldContext,const FString& URL,
+		const FString& ExtractToDirectory
+			);
 
 	UFUNCTION(BlueprintCallable, Category = "ChunkStreamDownloader")
 	static FString LoadFileToString(const FString FilePath);
@@ -73,8 +168,43 @@ public:
 
 	UFUNCTION(BlueprintCallable, Category = "ChunkStreamDownloader")
 	bool CancelDownload();
+
+	/* Stop the transfer without losing it. The temp file and the bytes so far are kept, and the download's slot is given to the next waiting download.
+	 * @return false if the download has ended or is already paused
+	 */
+	UFUNCTION(BlueprintCallable, Category = "ChunkStreamDownloader")
+	bool Pause();
+	/* Continue a paused download from where it stopped. Waits for a slot like a new download when the max are running
+	 */
+	UFUNCTION(BlueprintCallable, Category = "ChunkStreamDownloader")
+	bool Resume();
+	UFUNCTION(BlueprintCallable, Category = "ChunkStreamDownloader")
+	bool IsPaused() const { return bPaused; }
+
+	/* Decode gzip / deflate / zstd downloads on the fly so the file is stored decompressed at FileSavePath.
+	 * The compressed bytes are what gets downloaded, so ranged requests still work. Call before the download is activated.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "ChunkStreamDownloader")
+	void SetDecompression(EChunkStreamDecompression InDecompression);
+	/**
+	 * Opens a reader on the file while it downloads, eg to start playing a video before it has finished.
+	 * Reads of written bytes return at once, reads of missing bytes are moved to the front of the download and wait for them.
+	 * Decompressed and extracted downloads aren't written at file offsets and return null.
+	 */
+	TSharedPtr<FChunkStreamDownloadReader> OpenReader();
+
 	UFUNCTION(BlueprintCallable, Category = "ChunkStreamDownloader")
 	float GetProgress() const { return CurrentResultParams.Progress; };
+
+	// Rates, byte counts and time spent waiting of this download
+	UFUNCTION(BlueprintCallable, Category = "ChunkStreamDownloader")
+	FChunkStreamDownloadStats GetStats() const;
+	// Stats of every registered download, running, waiting for a slot or paused
+	UFUNCTION(BlueprintCallable, Category = "ChunkStreamDownloader")
+	static TArray<FChunkStreamDownloadStats> GetAllDownloadStats();
+	// Stats of every registered download summed together
+	UFUNCTION(BlueprintCallable, Category = "ChunkStreamDownloader")
+	static FChunkStreamDownloadStats GetAggregateDownloadStats();
 	
 	UFUNCTION(BlueprintCallable, Category = "ChunkStreamDownloader")
 	bool IsComplete() const { return bCompleted; }
@@ -88,20 +218,70 @@ public:
 	
 	UPROPERTY(BlueprintReadOnly, Category = "ChunkStreamDownloader")
 	FString URL;
+	// Fallback sources for URL, in preferred order
+	UPROPERTY(BlueprintReadOnly, Category = "ChunkStreamDownloader")
+	TArray<FString> MirrorURLs;
 	// Where to save the file, name and extension included: eg C:/MyGame/Video.mp4
 	UPROPERTY(BlueprintReadOnly, Category = "ChunkStreamDownloader")
 	FString FileSavePath;
+	// How the download is decoded before being stored
+	UPROPERTY(BlueprintReadOnly, Category = "ChunkStreamDownloader")
+	EChunkStreamDecompression Decompression = EChunkStreamDecompression::None;
+	// When set the download is a zip archive extracted here instead of being saved to FileSavePath
+	UPROPERTY(BlueprintReadOnly, Category = "ChunkStreamDownloader")
+	FString ExtractDirectory;
 
 protected:
 	UPROPERTY(BlueprintReadOnly, Category = "ChunkStreamDownloader")
 	bool bCanceled;
+	UPROPERTY(BlueprintReadOnly, Category = "ChunkStreamDownloader")
+	bool bPaused = false;
 	
 	void OnDownloadProgress(uint64 BytesReceived , float InProgress);
 	void OnChunkCompleted(TUniquePtr<StreamChunkDownloader::FChunkInfo>&&  ChunkData);
 	void WriteChunkToFile(TUniquePtr<StreamChunkDownloader::FChunkInfo>&&  ChunkData);
 	void OnDownloadComplete(EChunkStreamDownloadResult Result);
 	void Completed(EChunkStreamDownloadResult InResult);
-	bool OpenFileForWriting(const FString& InFilePath);
+	/*
+	 * Opens the temp file, replacing any file already there unless bKeepExisting
+	 */
+	bool OpenFileForWriting(const FString& InFilePath, bool bKeepExisting = false);
+	/*
+	 * Starts the transfer into the temp file, once any partial download an earlier run left has been claimed
+	 */
+	void StartTransfer(bool bResuming);
+	/*
+	 * The server said whether the bytes an earlier run left in the temp file are still valid
+	 */
+	void OnResumeChecked(bool bAccepted);
+	/*
+	 * Records a written range in the resume metadata so a later run can carry on from it, saved at most every ChunkStream.ResumeSaveInterval.
+	 * Caller holds WriteFileLock
+	 */
+	void SaveResumeData(uint64 Start, uint64 End);
+	// Saves ranges recorded since the last save, if any. Caller holds WriteFileLock
+	void FlushResumeData();
+	// Puts what a buffered FileWriter holds on storage and records it as written. Caller holds WriteFileLock
+	void FlushFileWriter();
+	// Does the server give what is needed to resume this download later
+	bool CanSaveResumeData() const;
+	/*
+	 * Does this download go through a sequential processor instead of being written at chunk offsets
+	 */
+	bool UsesSequentialProcessor() const { return Decompression != EChunkStreamDecompression::None || IsExtractingZip(); }
+	/*
+	 * Is the download extracted rather than written to a file, nothing is written to the temp path in that case
+	 */
+	bool IsExtractingZip() const { return !ExtractDirectory.IsEmpty(); }
+	/*
+	 * Creates the processor for the download mode, called on the first chunk once the response is known
+	 */
+	TUniquePtr<IChunkStreamSequentialProcessor> CreateSequentialProcessor();
+	/*
+	 * Feeds chunks to SequentialProcessor in file order, holding back any that arrive early. Caller holds WriteFileLock
+	 * @param return: false if the processor failed
+	 */
+	bool ProcessChunkInOrder(TUniquePtr<StreamChunkDownloader::FChunkInfo>&& ChunkData);
 	void CloseFile();
 	/*
 	 *  Move the file from Temp location to FileSavePath
@@ -109,7 +289,7 @@ protected:
 	 */
 	bool MoveTempFileToFinalSave();
 	/* 
-	 * Get a temp file name for this save path for the download to stream to
+	 * Get a temp file name for this save path for the download to stream to, a hidden file in the same directory
 	 */
 	static FString GetTempPathForSavePath(const FString& SavePath);
 
@@ -121,6 +301,53 @@ protected:
 	TSharedPtr<class FStreamChunkDownloader> StreamChunkDownloader;
 	IFileHandle* OpenFile = nullptr;
 
+	// Written ranges and the read handle shared with readers from OpenReader
+	TSharedPtr<FChunkStreamDownloadReadState> ReadState;
+
+	// What is on storage for a later run to resume from, saved next to the temp file as chunks are written
+	FChunkStreamResumeData ResumeData;
+	// ResumeData has ranges the saved copy doesn't, and when it was last saved
+	bool bResumeDataDirty = false;
+	double LastResumeSaveTime = 0.0;
+
+	// Consumer of the download in file order, when not writing the raw bytes
+	TUniquePtr<IChunkStreamSequentialProcessor> SequentialProcessor;
+	// Chunks that arrived before the ones preceding them, keyed by start offset
+	TMap<uint64, TUniquePtr<StreamChunkDownloader::FChunkInfo>> OutOfOrderChunks;
+	// Offset of the next byte the sequential processor expects
+	uint64 NextSequentialOffset = 0;
+
+	// Output file chunks were received straight into, see ChunkStream.MappedWrites. Flushed and released with the file
+	TSharedPtr<FChunkStreamMappedFile, ESPMode::ThreadSafe> MappedFile;
+
+	// Writes chunks instead of OpenFile where the platform has something better, see FChunkStreamDownloaderUtils::CreateFileWriter
+	TUniquePtr<IChunkStreamFileWriter> FileWriter;
+	bool bFileWriterChecked = false;
+	// Written to a buffered FileWriter but not flushed yet
+	TArray<StreamChunkDownloader::FByteRange> UnflushedRanges;
+	uint64 UnflushedBytes = 0;
+	uint64 UnflushedTotalFileSize = 0;
+	// Chunks handed to write tasks that haven't started writing, a buffered writer is flushed once none are left
+	std::atomic<int32> NumQueuedWrites{0};
+
 	bool bCompleted = false;
 	std::atomic<bool> bChunkPendingWrite{false};
+	// A partial download to resume from is being looked for, and moved to the temp path, on a worker. The download counts as active meanwhile
+	bool bClaimingResumable = false;
+
+	// Starts counting active time, ending any wait for a slot. Game thread
+	void StartStatsClock();
+	// Stops counting active and waiting time, eg on pause or completion. Game thread
+	void StopStatsClock();
+
+	// Stats totals, updated from the write tasks
+	std::atomic<uint64> StatsBytesWritten{0};
+	std::atomic<uint64> StatsBufferedBytes{0};
+	std::atomic<int32> StatsChunks{0};
+	std::atomic<uint64> StatsWriteWaitCycles{0};
+	// Stats time accounting on the game thread, a start time is 0 while not in that state
+	double ActiveSinceTime = 0.0;
+	double ActiveSeconds = 0.0;
+	double WaitingForSlotSinceTime = 0.0;
+	double WaitingForSlotSeconds = 0.0;
 };
@@ -0,0 +1,28 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Writes downloaded chunks at their offsets in a download's file, in place of the file's IFileHandle.
+ * Platform backends that do better than a Seek / Write / Flush per chunk implement this, see FChunkStreamDownloaderUtils::CreateFileWriter.
+ * Not thread safe, the owner serializes writes.
+ */
+class IChunkStreamFileWriter
+{
+public:
+	virtual ~IChunkStreamFileWriter() = default;
+
+	// Writes Num bytes at Offset, returns once they are on storage, or once they are queued if IsBuffered
+	virtual bool Write(const uint8* Data, uint64 Num, uint64 Offset) = 0;
+
+	// Waits for the writes queued since the last Flush and puts them on storage, false if any of them failed
+	virtual bool Flush() { return true; }
+
+	// Write keeps the bytes and returns before they are written, they are only on storage after Flush
+	virtual bool IsBuffered() const { return false; }
+
+	// Name of the backend for logs
+	virtual const TCHAR* GetName() const = 0;
+};
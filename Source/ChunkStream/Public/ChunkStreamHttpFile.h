@@ -0,0 +1,162 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GenericPlatform/GenericPlatformFile.h"
+#include "HAL/Event.h"
+#include "StreamChunkDownloader.h"
+
+struct FChunkStreamHttpFileSettings
+{
+	// Bytes per cached block, reads are fetched in whole blocks
+	int64 BlockSize = 1024 * 1024;
+
+	// Blocks kept in memory
+	int32 MaxMemoryBlocks = 64;
+
+	// Directory for a disk tier that blocks evicted from memory move to, empty for memory only
+	FString DiskCacheDirectory;
+
+	// Blocks kept in the disk tier
+	int32 MaxDiskBlocks = 1024;
+
+	// Most blocks prefetched ahead of a handle that reads sequentially
+	int32 MaxReadaheadBlocks = 8;
+};
+
+/**
+ * Read-only random access to a file on a server, served by ranged GETs through FStreamChunkDownloader.
+ * Fetched blocks are kept in an LRU memory cache, optionally backed by an LRU disk tier, and shared by every handle of the file.
+ * Reads block the calling thread until their blocks arrive, so they must not wait on the game thread (cached reads are fine there).
+ */
+class CHUNKSTREAM_API FChunkStreamHttpFile : public TSharedFromThis<FChunkStreamHttpFile>
+{
+public:
+	/**
+	 * Sends a HEAD request for the size and range support of URL.
+	 * The future is set with null if the file can't be opened, eg the server doesn't report a size.
+	 */
+	static TFuture<TSharedPtr<FChunkStreamHttpFile>> Open(const FString& URL, const FChunkStreamHttpFileSettings& Settings = FChunkStreamHttpFileSettings());
+
+	// For when the size is already known, no request is made until the first read
+	FChunkStreamHttpFile(const FString& InURL, uint64 InFileSize, const FChunkStreamHttpFileSettings& InSettings = FChunkStreamHttpFileSettings());
+	~FChunkStreamHttpFile();
+
+	// New handle with its own position, reading through this file's cache
+	TUniquePtr<IFileHandle> CreateHandle();
+
+	/**
+	 * Reads Bytes at Offset, waiting for any blocks that aren't cached. Thread safe.
+	 * @return false if the range is outside the file or a block failed to download
+	 */
+	bool ReadAt(uint8* Destination, int64 Bytes, int64 Offset);
+
+	// Starts fetching any blocks of the range that aren't cached or already on their way
+	void Prefetch(int64 Offset, int64 Bytes);
+
+	// Is every block of the range in memory or on disk
+	bool IsCached(int64 Offset, int64 Bytes);
+
+	uint64 GetFileSize() const { return FileSize; }
+	const FString& GetURL() const { return URL; }
+	const FChunkStreamHttpFileSettings& GetSettings() const { return Settings; }
+
+	// Block lookups served from memory, from the disk tier and from the network
+	uint64 GetMemoryHits() const { return MemoryHits; }
+	uint64 GetDiskHits() const { return DiskHits; }
+	uint64 GetBlocksFetched() const { return BlocksFetched; }
+
+private:
+	using FBlockData = TSharedPtr<TArray64<uint8>, ESPMode::ThreadSafe>;
+
+	struct FCachedBlock
+	{
+		FBlockData Data;
+		uint64 LastUse = 0;
+	};
+
+	// Block being downloaded, readers wait on Done
+	struct FBlockFetch
+	{
+		FEventRef Done{EEventMode::ManualReset};
+		std::atomic<bool> bFailed{false};
+		// Request the block belongs to
+		uint32 FetchId = 0;
+	};
+
+	// Block whose bytes are split over several chunks
+	struct FPartialBlock
+	{
+		FBlockData Data;
+		int64 Filled = 0;
+	};
+
+	int64 GetNumBlocks() const { return (static_cast<int64>(FileSize) + Settings.BlockSize - 1) / Settings.BlockSize; }
+	int64 GetBlockBytes(int64 BlockIndex) const;
+
+	// Returns the block, waiting for it to download if needed. Null if it failed
+	FBlockData WaitForBlock(int64 BlockIndex);
+
+	// Starts fetches for the missing blocks in [FirstBlock, LastBlock], contiguous missing blocks share a request
+	void RequestBlocks(int64 FirstBlock, int64 LastBlock);
+	void StartFetch(int64 FirstBlock, int64 LastBlock);
+	void OnBlockChunk(TUniquePtr<StreamChunkDownloader::FChunkInfo>&& Chunk);
+	void OnFetchComplete(EChunkStreamDownloadResult Result, int64 FirstBlock, int64 LastBlock, uint32 FetchId);
+
+	// Cache access, caller holds CacheLock
+	FBlockData FindCachedBlock(int64 BlockIndex);
+	void AddToMemory(int64 BlockIndex, FBlockData Data);
+	void WriteToDisk(int64 BlockIndex, const TArray64<uint8>& Data);
+	FBlockData ReadFromDisk(int64 BlockIndex);
+
+	FString URL;
+	uint64 FileSize = 0;
+	FChunkStreamHttpFileSettings Settings;
+
+	FCriticalSection CacheLock;
+	TMap<int64, FCachedBlock> MemoryBlocks;
+	TMap<int64, TSharedPtr<FBlockFetch, ESPMode::ThreadSafe>> InFlight;
+	TMap<int64, FPartialBlock> PartialBlocks;
+	// Requests in progress by fetch id
+	TMap<uint32, TSharedPtr<FStreamChunkDownloader>> Fetchers;
+	uint32 NextFetchId = 0;
+	uint64 UseCounter = 0;
+
+	// Disk tier, one slot per block in a scratch file deleted with this object
+	FString DiskCachePath;
+	IFileHandle* DiskFile = nullptr;
+	TMap<int64, int32> DiskSlots;
+	TArray<int64> SlotBlocks;
+	TArray<uint64> SlotLastUse;
+
+	std::atomic<uint64> MemoryHits{0};
+	std::atomic<uint64> DiskHits{0};
+	std::atomic<uint64> BlocksFetched{0};
+};
+
+/**
+ * IFileHandle over an FChunkStreamHttpFile. Tracks its own position and grows a readahead window while reads are sequential.
+ * Writes and truncation fail, the file is read-only.
+ */
+class CHUNKSTREAM_API FChunkStreamHttpFileHandle : public IFileHandle
+{
+public:
+	explicit FChunkStreamHttpFileHandle(const TSharedRef<FChunkStreamHttpFile>& InFile) : File(InFile) {}
+
+	virtual int64 Tell() override { return Position; }
+	virtual bool Seek(int64 NewPosition) override;
+	virtual bool SeekFromEnd(int64 NewPositionRelativeToEnd = 0) override;
+	virtual bool Read(uint8* Destination, int64 BytesToRead) override;
+	virtual bool Write(const uint8* Source, int64 BytesToWrite) override { return false; }
+	virtual bool Flush(const bool bFullFlush = false) override { return true; }
+	virtual bool Truncate(int64 NewSize) override { return false; }
+	virtual int64 Size() override { return static_cast<int64>(File->GetFileSize()); }
+
+private:
+	TSharedRef<FChunkStreamHttpFile> File;
+	int64 Position = 0;
+	// Where the last read ended, a read starting here is sequential
+	int64 SequentialEnd = -1;
+	int32 ReadaheadBlocks = 0;
+};
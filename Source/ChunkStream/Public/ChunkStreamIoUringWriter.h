@@ -0,0 +1,69 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ChunkStreamFileWriter.h"
+
+/**
+ * Writes chunks through an io_uring, so a single thread keeps the disk queue deep.
+ * Chunks are copied into ChunkStream.IoUringQueueDepth buffers of ChunkStream.IoUringSegmentSize, registered with the ring once when the file opens,
+ * and written from there. Writes stay in flight across chunks, Flush waits for them and syncs the file. Where registering fails
+ * (RLIMIT_MEMLOCK on older kernels) the same buffers are written unregistered.
+ * Linux with liburing only (WITH_CHUNKSTREAM_IO_URING), Open returns null elsewhere or when the kernel has no io_uring.
+ */
+class CHUNKSTREAM_API FChunkStreamIoUringWriter : public IChunkStreamFileWriter
+{
+public:
+	virtual ~FChunkStreamIoUringWriter() override;
+
+	// Opens the existing file at Path, null if io_uring isn't available
+	static TUniquePtr<FChunkStreamIoUringWriter> Open(const FString& Path);
+
+	virtual bool Write(const uint8* Data, uint64 Num, uint64 Offset) override;
+	virtual bool Flush() override;
+	virtual bool IsBuffered() const override { return true; }
+	virtual const TCHAR* GetName() const override { return TEXT("io_uring"); }
+
+private:
+	FChunkStreamIoUringWriter() = default;
+
+	// A buffer and the part of the file it is writing
+	struct FSlot
+	{
+		uint64 Offset = 0;
+		uint32 Num = 0;
+		// Bytes of it already written, a short write goes again for the rest
+		uint32 Written = 0;
+	};
+
+	// Queues the rest of Slot's write, submitted by the next Submit
+	bool Prepare(uint32 Slot);
+	// Hands prepared writes to the kernel
+	bool Submit();
+	// Handles completions, waiting for one if bWait
+	bool Reap(bool bWait);
+	// Waits for every submitted write, the buffers can't be released or unregistered before
+	bool Drain();
+	// The ring can't be trusted any more, waits for what it still holds and stops using it
+	void Abandon();
+	uint8* GetSlotMemory(uint32 Slot) const { return Buffers + static_cast<uint64>(Slot) * SegmentSize; }
+
+	int32 Handle = -1;
+	uint32 QueueDepth = 0;
+	uint32 SegmentSize = 0;
+	// io_uring, opaque so liburing stays out of the header
+	struct io_uring* Ring = nullptr;
+	// QueueDepth buffers of SegmentSize, one allocation
+	uint8* Buffers = nullptr;
+	TArray<FSlot> Slots;
+	TArray<uint32> FreeSlots;
+	// Writes prepared but not submitted, and submitted but not completed
+	uint32 NumPrepared = 0;
+	uint32 NumInFlight = 0;
+	bool bFixedBuffers = false;
+	// A write failed since the last Flush
+	bool bFailed = false;
+	// The ring failed, nothing more can be trusted to it
+	bool bBroken = false;
+};
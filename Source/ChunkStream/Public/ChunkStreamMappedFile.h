@@ -0,0 +1,35 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * A download's file preallocated to its full size and mapped writable, so received bytes are copied straight into it
+ * rather than into a chunk buffer that is written later. Written ranges are flushed back per chunk, see Flush.
+ * POSIX platforms only, Create returns null elsewhere: Windows won't share the file with a second writer while the download's own handle is open.
+ */
+class CHUNKSTREAM_API FChunkStreamMappedFile
+{
+public:
+	~FChunkStreamMappedFile();
+
+	// Maps the file at Path, extending it to Size, null if the platform can't or there isn't the space
+	static TSharedPtr<FChunkStreamMappedFile, ESPMode::ThreadSafe> Create(const FString& Path, uint64 Size);
+
+	uint8* GetData() const { return Data; }
+	uint64 GetSize() const { return Size; }
+
+	/**
+	 * Writes [Offset, Offset + Num) back to storage.
+	 * @param bWait - false only starts writing it back, true returns once it is on storage
+	 */
+	bool Flush(uint64 Offset, uint64 Num, bool bWait);
+
+private:
+	FChunkStreamMappedFile() = default;
+
+	uint8* Data = nullptr;
+	uint64 Size = 0;
+	int32 Handle = -1;
+};
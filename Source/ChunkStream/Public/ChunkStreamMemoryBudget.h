@@ -0,0 +1,78 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+#include <atomic>
+
+/**
+ * Bytes of a chunk buffer counted against FChunkStreamMemoryBudget, given back when destroyed.
+ * Move only, it travels with the buffer it pays for.
+ */
+class CHUNKSTREAM_API FChunkStreamMemoryReservation
+{
+public:
+	FChunkStreamMemoryReservation() = default;
+	FChunkStreamMemoryReservation(FChunkStreamMemoryReservation&& Other) : Bytes(Other.Bytes) { Other.Bytes = 0; }
+	FChunkStreamMemoryReservation& operator=(FChunkStreamMemoryReservation&& Other);
+	FChunkStreamMemoryReservation(const FChunkStreamMemoryReservation&) = delete;
+	FChunkStreamMemoryReservation& operator=(const FChunkStreamMemoryReservation&) = delete;
+	~FChunkStreamMemoryReservation() { Reset(); }
+
+	uint64 Num() const { return Bytes; }
+	bool IsValid() const { return Bytes > 0; }
+	// Gives back anything over NewBytes
+	void Shrink(uint64 NewBytes);
+	// Moves up to SplitBytes of this into a reservation of its own
+	FChunkStreamMemoryReservation Split(uint64 SplitBytes);
+	// Takes over the bytes of Other, for a buffer that grew
+	void Append(FChunkStreamMemoryReservation&& Other);
+	void Reset();
+
+private:
+	friend class FChunkStreamMemoryBudget;
+	explicit FChunkStreamMemoryReservation(uint64 InBytes) : Bytes(InBytes) {}
+
+	uint64 Bytes = 0;
+};
+
+/**
+ * Process wide limit on the bytes all downloads hold in chunk buffers, in flight and queued for writing, see ChunkStream.MemoryBudgetMB.
+ * Downloads reserve a chunk's buffer before requesting it and get a smaller chunk, or wait, when the budget is short.
+ * Platform memory warnings lower the budget for a while, see FChunkStreamModule.
+ * Thread safe.
+ */
+class CHUNKSTREAM_API FChunkStreamMemoryBudget
+{
+public:
+	static FChunkStreamMemoryBudget& Get();
+
+	/**
+	 * Reserve up to WantedBytes, and at least MinBytes, of what is left of the budget.
+	 * Returns an invalid reservation when less than MinBytes is left, unless nothing is reserved at all, so one download always makes progress.
+	 */
+	FChunkStreamMemoryReservation TryReserve(uint64 WantedBytes, uint64 MinBytes);
+
+	// Reserve Bytes even over the budget, for data that is already arriving
+	FChunkStreamMemoryReservation ReserveOverBudget(uint64 Bytes);
+
+	// Limit right now in bytes, lowered under memory pressure, 0 when unlimited
+	uint64 GetBudget() const;
+	// Bytes reserved by all downloads
+	uint64 GetReserved() const { return Reserved.load(std::memory_order_relaxed); }
+	// Is the budget lowered after a platform memory warning
+	bool IsUnderMemoryPressure() const;
+
+	// A platform memory warning came, lowers the budget for ChunkStream.MemoryPressureSeconds
+	void OnMemoryPressure();
+
+private:
+	friend class FChunkStreamMemoryReservation;
+	void Release(uint64 Bytes);
+
+	// Reserved only changes under it, it is read without
+	mutable FCriticalSection Lock;
+	std::atomic<uint64> Reserved{0};
+	std::atomic<double> PressureEndTime{0.0};
+};
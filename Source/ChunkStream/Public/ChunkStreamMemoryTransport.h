@@ -0,0 +1,112 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ChunkStreamTransport.h"
+
+// Misbehaviour of the loopback server for one request
+enum class EChunkStreamMemoryFault : uint8
+{
+	None,
+	// The connection drops half way through the body
+	Disconnect,
+	// The body arrives TrickleBytes at a time every TrickleIntervalSeconds, like a slowloris server
+	Trickle,
+	// Content-Length is FaultBytes short and the body stops there, the request still succeeds
+	ShortContentLength,
+	// Content-Length promises FaultBytes more than the body, the connection closes before them
+	LongContentLength,
+	// The Range header is ignored and the whole file comes back with a 200
+	IgnoreRange,
+	// FaultBytes more of the file follow a single range 206
+	ExtraBytes,
+	// FailureStatusCode and no body, several in a row make a burst
+	ServiceUnavailable,
+	// The status code comes FaultDelaySeconds late, then the response goes on as usual
+	Delay,
+};
+
+// How the loopback server answers requests for one URL
+struct FChunkStreamMemoryFileSettings
+{
+	// Size of the file, its bytes are FChunkStreamMemoryTransport::GetSyntheticByte of their offset unless Data is set
+	uint64 FileSize = 0;
+	// Served instead of synthetic bytes when set, FileSize is then ignored
+	TSharedPtr<const TArray64<uint8>, ESPMode::ThreadSafe> Data;
+
+	// Body throughput of each request in bytes per second, 0 for as fast as the reader takes it
+	double BytesPerSecond = 0.0;
+	// Seconds before each request gets its status code
+	float LatencySeconds = 0.f;
+	// Bytes per body callback, like one socket read
+	int32 PacketSize = 64 * 1024;
+
+	// Range requests get a 206, otherwise the whole file with a 200
+	bool bAcceptRanges = true;
+	// Requests for several ranges get a multipart/byteranges 206, otherwise the whole file with a 200
+	bool bMultiRange = true;
+	// Sent as the ETag header when set, eg to resume a partial download
+	FString ETag;
+
+	// Every Nth request for the URL is answered with FailureStatusCode and no body, 0 for never
+	int32 FailEveryNthRequest = 0;
+	int32 FailureStatusCode = 503;
+	// The connection drops after this many body bytes of a request, 0 for never
+	uint64 DisconnectAfterBytes = 0;
+
+	// Faults taken in turn, request N gets Faults[(N - 1) % Faults.Num()]. HEAD requests are always answered normally
+	TArray<EChunkStreamMemoryFault> Faults;
+	int32 TrickleBytes = 16;
+	float TrickleIntervalSeconds = 2.f;
+	// How far a wrong Content-Length is off and how many extra bytes follow a range
+	uint64 FaultBytes = 4096;
+	float FaultDelaySeconds = 10.f;
+};
+
+/**
+ * In-process server for tests and benchmarks, requests go through the same downloader code as HTTP without a network.
+ * Register it for a scheme and use URLs of that scheme:
+ *
+ *	TSharedRef<FChunkStreamMemoryTransport, ESPMode::ThreadSafe> Server = MakeShared<FChunkStreamMemoryTransport, ESPMode::ThreadSafe>();
+ *	Server->AddFile(TEXT("mem://files/big.bin"), Settings);
+ *	ChunkStreamTransport::RegisterScheme(TEXT("mem"), Server);
+ *
+ * Each request is served from its own thread. Status, headers and body arrive on that thread and progress and completion
+ * on the game thread, as with UE's HTTP module.
+ */
+class CHUNKSTREAM_API FChunkStreamMemoryTransport : public IChunkStreamTransport, public TSharedFromThis<FChunkStreamMemoryTransport, ESPMode::ThreadSafe>
+{
+public:
+	// Serves Settings at URL, replacing anything already there. Requests in flight keep the settings they started with
+	void AddFile(const FString& URL, const FChunkStreamMemoryFileSettings& Settings);
+	void RemoveFile(const FString& URL);
+
+	// Requests answered for URL so far, failures included
+	int32 GetRequestCount(const FString& URL) const;
+	// Range header of each request for URL so far in the order they arrived, empty for requests without one
+	TArray<FString> GetRangeHeaders(const FString& URL) const;
+
+	// Content of synthetic files, every offset gets a byte that differs from its neighbours so misplaced data shows up
+	static uint8 GetSyntheticByte(uint64 Offset);
+	static void FillSynthetic(uint8* Destination, uint64 Offset, uint64 Num);
+
+	virtual FChunkStreamRequestRef CreateRequest() override;
+
+	/**
+	 * Settings of URL for a request that is starting, counting the request and recording its Range header.
+	 * @return false if nothing is served at URL
+	 */
+	bool BeginRequest(const FString& URL, const FString& RangeHeader, FChunkStreamMemoryFileSettings& OutSettings, int32& OutRequestNumber);
+
+private:
+	struct FServedFile
+	{
+		FChunkStreamMemoryFileSettings Settings;
+		int32 RequestCount = 0;
+		TArray<FString> RangeHeaders;
+	};
+
+	mutable FCriticalSection FilesLock;
+	TMap<FString, FServedFile> Files;
+};
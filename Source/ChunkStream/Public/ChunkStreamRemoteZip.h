@@ -0,0 +1,92 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ChunkStreamZip.h"
+#include "StreamChunkDownloader.h"
+
+// Called on the game thread once the central directory has been read, or failed to
+DECLARE_DELEGATE_OneParam(FOnRemoteZipDirectoryRead, bool /* bSuccess */);
+
+/**
+ * Reads a zip archive on a server without downloading all of it.
+ * The central directory is fetched with a ranged request for the end of the file, then only the entries
+ * asked for are downloaded, one range per entry through FStreamChunkDownloader, and extracted as they arrive.
+ * The server must support Range requests.
+ */
+class CHUNKSTREAM_API FChunkStreamRemoteZip : public TSharedFromThis<FChunkStreamRemoteZip>
+{
+public:
+	explicit FChunkStreamRemoteZip(const FString& InURL);
+	~FChunkStreamRemoteZip();
+
+	// Fetches and parses the central directory. Call on the game thread
+	void ReadCentralDirectory(const FOnRemoteZipDirectoryRead& OnComplete);
+
+	/**
+	 * Downloads and extracts the named entries into TargetDirectory, reading the central directory first if needed.
+	 * Names are as stored in the archive with forward slashes, a name ending in / selects everything under that directory.
+	 * OnComplete runs on the game thread. Call on the game thread.
+	 */
+	void ExtractEntries(const TArray<FString>& EntryNames, const FString& TargetDirectory, const FOnDownloadCompleteSignature& OnComplete);
+
+	// Stops whatever is in progress, an extraction completes with UserCancelled and its files are removed
+	void Cancel();
+
+	bool IsCentralDirectoryRead() const { return bDirectoryRead; }
+	const TArray<ChunkStreamZip::FEntry>& GetEntries() const { return Entries; }
+	const ChunkStreamZip::FEntry* FindEntry(const FString& Name) const;
+	uint64 GetArchiveSize() const { return ArchiveSize; }
+
+private:
+	void OnSizeReceived(const FChunkStreamResponsePtr& Response);
+	void OnTailFetched();
+	bool ParseDirectory(const uint8* Data, uint64 Num, const ChunkStreamZip::FCentralDirectoryLocation& Location);
+	void FinishDirectoryRead(bool bSuccess, const FString& Error = FString());
+
+	// Downloads one range of the archive into FetchBuffer, OnFetched runs on the game thread
+	void FetchRange(const StreamChunkDownloader::FByteRange& Range, TFunction<void(bool)>&& OnFetched);
+
+	void StartExtraction();
+	void OnExtractChunk(TUniquePtr<StreamChunkDownloader::FChunkInfo>&& Chunk);
+	// Marks the entry download as over, the worker then finishes or aborts the extractor
+	void EndExtractionDownload(EChunkStreamDownloadResult Result);
+	// Feeds queued chunks to the extractor in order, runs on one worker at a time
+	void DrainExtractChunks();
+	void FinishExtraction(EChunkStreamDownloadResult Result);
+
+	FString URL;
+	uint64 ArchiveSize = 0;
+	bool bAcceptsRanges = false;
+
+	// Used for the HEAD request
+	TSharedPtr<FStreamChunkDownloader> SizeRequest;
+	// Ranged download in progress
+	TSharedPtr<FStreamChunkDownloader> Downloader;
+
+	// Bytes of a fetched range and the archive offset they start at
+	TArray64<uint8> FetchBuffer;
+	uint64 FetchBufferStart = 0;
+	FCriticalSection FetchLock;
+
+	bool bDirectoryRead = false;
+	bool bReadingDirectory = false;
+	TArray<ChunkStreamZip::FEntry> Entries;
+	uint64 CentralDirectoryOffset = 0;
+	TArray<FOnRemoteZipDirectoryRead> DirectoryReadDelegates;
+
+	// Extraction in progress
+	TArray<FString> RequestedNames;
+	FString ExtractDirectory;
+	FOnDownloadCompleteSignature ExtractCompleteDelegate;
+	TUniquePtr<FChunkStreamZipExtractor> Extractor;
+
+	// Chunks waiting for the extractor, guarded by QueueLock
+	FCriticalSection QueueLock;
+	TArray<TUniquePtr<StreamChunkDownloader::FChunkInfo>> PendingChunks;
+	bool bDraining = false;
+	bool bExtractDownloadDone = false;
+	bool bExtracting = false;
+	EChunkStreamDownloadResult ExtractDownloadResult = EChunkStreamDownloadResult::InProgress;
+};
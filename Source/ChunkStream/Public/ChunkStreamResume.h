@@ -0,0 +1,98 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "StreamChunkDownloader.h"
+
+/**
+ * What a partial download has on storage, saved next to its temp file as <temp file>.csmeta
+ * so a later run can carry on from it.
+ */
+struct CHUNKSTREAM_API FChunkStreamResumeData
+{
+	FString URL;
+	uint64 TotalFileSize = 0;
+	// Validators of the server's file, it has to report the same ones for the bytes to be kept
+	FString ETag;
+	FString LastModified;
+	// Ranges that were written and flushed, sorted and merged
+	TArray<StreamChunkDownloader::FByteRange> WrittenRanges;
+	// Last save, UTC
+	FDateTime UpdatedTime;
+
+	uint64 GetWrittenBytes() const;
+
+	// Writes the metadata for TempPath, replacing any from before
+	bool Save(const FString& TempPath);
+	// False if TempPath has no metadata or it can't be parsed
+	static bool Load(const FString& TempPath, FChunkStreamResumeData& OutData);
+	static bool Delete(const FString& TempPath);
+	static FString GetMetaPath(const FString& TempPath) { return TempPath + TEXT(".csmeta"); }
+};
+
+/**
+ * Temp files of downloads, and the partial downloads earlier runs left behind.
+ * A download's temp file is a hidden sibling of its save path, so finishing it is a rename on the same volume.
+ * The directories they are made in are recorded, and at startup a sweep indexes them on a worker thread, deletes files that can't be resumed or are
+ * over the ChunkStream.TempMaxAgeHours / ChunkStream.TempMaxSizeMB budget, and keeps the newest per URL for the next download of it.
+ */
+class CHUNKSTREAM_API FChunkStreamTempFiles
+{
+public:
+	~FChunkStreamTempFiles();
+
+	// Where temp files go when the download has no save path, and where older versions put them all
+	static FString GetTempDirectory();
+	// Hidden file next to SavePath the download is written to, "Dir/.Name.ext.cstmp"
+	static FString GetTempPathForSavePath(const FString& SavePath);
+	// Is Filename one GetTempPathForSavePath makes, the sweep only touches those outside GetTempDirectory
+	static bool IsTempFileName(const FString& Filename);
+
+	void StartSweep();
+	// Blocks until a running sweep is done
+	void WaitForSweep();
+	bool IsSweepComplete() const { return bSweepComplete; }
+
+	// A download is using TempPath, the sweep leaves it alone until it is released. Its directory is recorded for later sweeps
+	void Acquire(const FString& TempPath);
+	void Release(const FString& TempPath);
+
+	/**
+	 * Looks for a partial download of URL to carry on from. One left at another temp path is moved to TempPath.
+	 * Before the sweep is done only TempPath itself is checked.
+	 * @return false if there is none, TempPath is then overwritten by the download
+	 */
+	bool ClaimResumable(const FString& URL, const FString& TempPath, FChunkStreamResumeData& OutData);
+
+	/**
+	 * ClaimResumable on a worker, moving a partial download from another volume is a copy of it.
+	 * OnClaimed runs on the game thread with whether one was claimed and its metadata.
+	 */
+	void ClaimResumableAsync(const FString& URL, const FString& TempPath, TFunction<void(bool, FChunkStreamResumeData&&)>&& OnClaimed);
+
+	// Partial downloads the sweep kept, by URL
+	int32 GetNumResumable() const;
+
+private:
+	void Sweep();
+
+	// File listing the directories temp files were made in, for sweeps after a crash
+	static FString GetDirectoryListPath();
+	// Rewrites the directory list, caller holds Lock
+	void SaveDirectories() const;
+
+	mutable FCriticalSection Lock;
+	// Newest resumable temp file for each URL, found by the sweep
+	TMap<FString, FString> ResumableByURL;
+	// Temp files downloads are using
+	TSet<FString> InUse;
+	// Directories temp files have been made in besides GetTempDirectory
+	TSet<FString> Directories;
+
+	TFuture<void> SweepFuture;
+	std::atomic<bool> bSweepComplete{false};
+	// Claims from ClaimResumableAsync, waited for on shutdown
+	TArray<TFuture<void>> Claims;
+};
@@ -0,0 +1,38 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Consumes a download strictly in file order instead of writing chunks at their offsets.
+ * Used when what ends up on storage is not a 1:1 copy of the bytes downloaded (decompression, archive extraction).
+ * The owner guarantees calls are serialized and in order, chunks arriving early are held back until their turn.
+ */
+class IChunkStreamSequentialProcessor
+{
+public:
+	virtual ~IChunkStreamSequentialProcessor() = default;
+
+	/**
+	 * Consume the next bytes of the download.
+	 * @return false on an unrecoverable error, see GetError()
+	 */
+	virtual bool Process(const uint8* Data, uint64 Num) = 0;
+
+	/**
+	 * Called once after the last byte has been processed on a successful download.
+	 * Flushes anything still buffered and validates the stream ended cleanly.
+	 * @return false if the stream was truncated or invalid
+	 */
+	virtual bool Finish() = 0;
+
+	// Called instead of Finish when the download fails or is canceled, drops any pending work
+	virtual void Abort() {}
+
+	// Description of the last error for logging
+	const FString& GetError() const { return Error; }
+
+protected:
+	FString Error;
+};
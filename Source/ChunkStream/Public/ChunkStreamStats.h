@@ -0,0 +1,16 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#pragma once
+
+#if !defined(CHUNKSTREAM_API)
+	#error "ChunkStreamStats.h should only be included from within the plugin module"
+#endif
+
+#include "Stats/Stats.h"
+
+// "stat ChunkStream" in the console
+DECLARE_STATS_GROUP(TEXT("ChunkStream"), STATGROUP_ChunkStream, STATCAT_Advanced);
+
+// Stall thresholds and packet gaps are per download, see FChunkStreamDownloadStats
+// Number of stalls detected since startup
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Stalls Detected"), STAT_ChunkStreamStallsDetected, STATGROUP_ChunkStream, );
@@ -0,0 +1,76 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ChunkStreamDownloader.h"
+#include "Tasks/Task.h"
+
+/**
+ * Cancels the downloads started with it, and those of tokens created from it with CreateChild.
+ * Copies share one state, every function can be called from any thread.
+ */
+class CHUNKSTREAM_API FChunkStreamCancellationToken
+{
+public:
+	FChunkStreamCancellationToken();
+
+	void Cancel() const;
+	bool IsCanceled() const;
+
+	// A token canceled along with this one, canceling it leaves this one running. Eg a stage of a pipeline
+	FChunkStreamCancellationToken CreateChild() const;
+
+	/**
+	 * Callback is called once, on the thread that cancels, or straight away when the token is already canceled.
+	 * @return id for RemoveCallback, 0 if it was called straight away
+	 */
+	uint64 AddCallback(TFunction<void()> Callback) const;
+	void RemoveCallback(uint64 CallbackId) const;
+
+private:
+	struct FState;
+	TSharedRef<FState, ESPMode::ThreadSafe> State;
+};
+
+// How a download started through ChunkStreamTasks ended
+struct FChunkStreamResult
+{
+	FString URL;
+	FString SavePath;
+	EChunkStreamDownloadResult Result = EChunkStreamDownloadResult::None;
+	int32 HttpStatusCode = 0;
+	// When the download ended, empty if it was canceled before it started
+	FChunkStreamDownloadStats Stats;
+
+	bool IsSuccess() const { return Result == EChunkStreamDownloadResult::Success; }
+};
+
+/**
+ * UE::Tasks front end of UChunkStreamDownloader, for composing downloads without delegates:
+ *
+ *	FChunkStreamCancellationToken Token;
+ *	TArray<UE::Tasks::TTask<FChunkStreamResult>> Downloads;
+ *	for (const FString& Name : FileNames)
+ *	{
+ *		Downloads.Add(ChunkStreamTasks::DownloadFile(BaseURL / Name, Directory / Name, Token));
+ *	}
+ *	UE::Tasks::TTask<TArray<FChunkStreamResult>> All = ChunkStreamTasks::WhenAll(Downloads);
+ *	UE::Tasks::Launch(UE_SOURCE_LOCATION, [All]() mutable { Install(All.GetResult()); }, UE::Tasks::Prerequisites(All));
+ *
+ * A download's task completes as the downloader does on the game thread, its continuations run on worker threads rather than there.
+ * Starting a download from another thread costs one hop to the game thread, where the downloader lives.
+ */
+namespace ChunkStreamTasks
+{
+	// Downloads URL to SavePath like UChunkStreamDownloader::DownloadFileToStorage, under ChunkStream.MaxConcurrentDownloads
+	CHUNKSTREAM_API UE::Tasks::TTask<FChunkStreamResult> DownloadFile(const FString& URL, const FString& SavePath,
+		const FChunkStreamCancellationToken& CancellationToken = FChunkStreamCancellationToken());
+
+	// Downloads from the first of URLs, the rest are mirrors, like UChunkStreamDownloader::DownloadFileToStorageFromMirrors
+	CHUNKSTREAM_API UE::Tasks::TTask<FChunkStreamResult> DownloadFileFromMirrors(const TArray<FString>& URLs, const FString& SavePath,
+		const FChunkStreamCancellationToken& CancellationToken = FChunkStreamCancellationToken());
+
+	// Completes once every download has, with their results in the same order
+	CHUNKSTREAM_API UE::Tasks::TTask<TArray<FChunkStreamResult>> WhenAll(const TArray<UE::Tasks::TTask<FChunkStreamResult>>& Downloads);
+}
@@ -0,0 +1,96 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#pragma once
+
+#if !defined(CHUNKSTREAM_API)
+	#error "ChunkStreamTrace.h should only be included from within the plugin module"
+#endif
+
+#include "CoreMinimal.h"
+#include "Trace/Trace.h"
+
+#define CHUNKSTREAM_TRACE_ENABLED UE_TRACE_ENABLED
+
+#if CHUNKSTREAM_TRACE_ENABLED
+// "-trace=default,ChunkStream" puts every chunk request of every download on the Insights timeline
+UE_TRACE_CHANNEL_EXTERN(ChunkStreamChannel, CHUNKSTREAM_API)
+#endif
+
+/**
+ * Download lifecycle for Unreal Insights.
+ * On the ChunkStream channel each chunk request is a timing region with bookmarks for retries and stalls, and every step is also
+ * a ChunkStream.ChunkEvent for analysis outside the timeline. The ChunkStream/* counters are on the counters channel.
+ */
+namespace ChunkStreamTrace
+{
+	// Type of a ChunkStream.ChunkEvent
+	enum class EChunkEvent : uint8
+	{
+		RequestStart,
+		FirstByte,
+		LastByte,
+		RequestEnd,
+		HandOff,
+		WriteStart,
+		WriteEnd,
+		Retry,
+		Stall,
+	};
+
+#if CHUNKSTREAM_TRACE_ENABLED
+	// Id that ties the events of one download together
+	uint32 NewDownloadId();
+	void DownloadStart(uint32 DownloadId, const FString& URL);
+
+	// A request for the chunk at StartOffset, Bytes is how much it asks for
+	void RequestStart(uint32 DownloadId, uint64 StartOffset, uint64 Bytes, uint32 Attempt);
+	void FirstByte(uint32 DownloadId, uint64 StartOffset);
+	void LastByte(uint32 DownloadId, uint64 StartOffset, uint64 Bytes);
+	// Same StartOffset and Attempt as the RequestStart it ends, Bytes is how much arrived
+	void RequestEnd(uint32 DownloadId, uint64 StartOffset, uint32 Attempt, uint64 Bytes, bool bSucceeded);
+	// A finished chunk given to the download's owner
+	void HandOff(uint32 DownloadId, uint64 StartOffset, uint64 Bytes);
+	// A chunk waiting for a write, its bytes count as buffered until the FScopedWrite for it ends
+	void WriteQueued(uint64 Bytes);
+	void Retry(uint32 DownloadId, uint64 StartOffset, uint32 Attempt, float DelaySeconds);
+	void Stall(uint32 DownloadId, uint64 StartOffset, double SecondsWithoutData);
+
+	// Requested bytes that haven't arrived, Delta is negative as they do
+	void AddBytesInFlight(int64 Delta);
+	// Body bytes received by any download, for the throughput counter
+	void AddBytesReceived(uint64 Num);
+	void SetDownloadCounts(int32 Active, int32 Waiting);
+
+	// Write of a handed off chunk, ends its buffering
+	class FScopedWrite
+	{
+	public:
+		FScopedWrite(uint32 InDownloadId, uint64 InStartOffset, uint64 InBytes);
+		~FScopedWrite();
+	private:
+		uint32 DownloadId;
+		uint64 StartOffset;
+		uint64 Bytes;
+	};
+#else
+	inline uint32 NewDownloadId() { return 0; }
+	inline void DownloadStart(uint32, const FString&) {}
+	inline void RequestStart(uint32, uint64, uint64, uint32) {}
+	inline void FirstByte(uint32, uint64) {}
+	inline void LastByte(uint32, uint64, uint64) {}
+	inline void RequestEnd(uint32, uint64, uint32, uint64, bool) {}
+	inline void HandOff(uint32, uint64, uint64) {}
+	inline void WriteQueued(uint64) {}
+	inline void Retry(uint32, uint64, uint32, float) {}
+	inline void Stall(uint32, uint64, double) {}
+	inline void AddBytesInFlight(int64) {}
+	inline void AddBytesReceived(uint64) {}
+	inline void SetDownloadCounts(int32, int32) {}
+
+	class FScopedWrite
+	{
+	public:
+		FScopedWrite(uint32, uint64, uint64) {}
+	};
+#endif
+}
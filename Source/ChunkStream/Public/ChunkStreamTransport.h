@@ -0,0 +1,89 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Status and headers of a transport response.
+ * Mirrors the part of IHttpResponse the downloader reads, so UE's HTTP module and other backends look the same to it.
+ */
+class IChunkStreamResponse
+{
+public:
+	virtual ~IChunkStreamResponse() = default;
+
+	virtual int32 GetResponseCode() const = 0;
+	// Empty when the header wasn't sent
+	virtual FString GetHeader(const FString& HeaderName) const = 0;
+};
+
+using FChunkStreamResponsePtr = TSharedPtr<IChunkStreamResponse, ESPMode::ThreadSafe>;
+
+// Status code of the response, may be called on the transport's thread
+DECLARE_DELEGATE_OneParam(FOnChunkStreamStatusCode, int32 /* StatusCode */);
+// A response header, before the body. May be called on the transport's thread
+DECLARE_DELEGATE_TwoParams(FOnChunkStreamHeader, const FString& /* Name */, const FString& /* Value */);
+// Body bytes received so far by the request, on the game thread
+DECLARE_DELEGATE_OneParam(FOnChunkStreamProgress, uint64 /* BytesReceived */);
+// Body data as it arrives, on the transport's thread. Setting InOutLength to 0 fails the request
+DECLARE_DELEGATE_TwoParams(FOnChunkStreamBody, void* /* Data */, int64& /* InOutLength */);
+// The request finished, on the game thread. bSucceeded is false when the connection failed or the request was canceled
+DECLARE_DELEGATE_TwoParams(FOnChunkStreamRequestComplete, FChunkStreamResponsePtr /* Response */, bool /* bSucceeded */);
+
+/**
+ * One request through a transport. Set it up, bind the delegates, then ProcessRequest.
+ * The transport keeps the request alive until it completes, owners only need a weak pointer to cancel it.
+ */
+class IChunkStreamRequest : public TSharedFromThis<IChunkStreamRequest, ESPMode::ThreadSafe>
+{
+public:
+	virtual ~IChunkStreamRequest() = default;
+
+	virtual void SetVerb(const FString& Verb) = 0;
+	virtual void SetURL(const FString& URL) = 0;
+	virtual void SetHeader(const FString& Name, const FString& Value) = 0;
+	// Seconds before the request fails, 0 for no timeout
+	virtual void SetTimeout(float Seconds) = 0;
+
+	// False if the request couldn't be started, the complete delegate isn't called then
+	virtual bool ProcessRequest() = 0;
+	// Stops the request, it still completes (unsuccessfully) afterwards
+	virtual void CancelRequest() = 0;
+
+	FOnChunkStreamStatusCode& OnStatusCode() { return StatusCodeDelegate; }
+	FOnChunkStreamHeader& OnHeader() { return HeaderDelegate; }
+	FOnChunkStreamProgress& OnProgress() { return ProgressDelegate; }
+	FOnChunkStreamBody& OnBody() { return BodyDelegate; }
+	FOnChunkStreamRequestComplete& OnComplete() { return CompleteDelegate; }
+
+protected:
+	FOnChunkStreamStatusCode StatusCodeDelegate;
+	FOnChunkStreamHeader HeaderDelegate;
+	FOnChunkStreamProgress ProgressDelegate;
+	FOnChunkStreamBody BodyDelegate;
+	FOnChunkStreamRequestComplete CompleteDelegate;
+};
+
+using FChunkStreamRequestRef = TSharedRef<IChunkStreamRequest, ESPMode::ThreadSafe>;
+
+// Creates requests for the URLs of one scheme
+class IChunkStreamTransport
+{
+public:
+	virtual ~IChunkStreamTransport() = default;
+
+	virtual FChunkStreamRequestRef CreateRequest() = 0;
+};
+
+namespace ChunkStreamTransport
+{
+	/**
+	 * Sends requests for URLs starting with Scheme:// through Transport instead of UE's HTTP module,
+	 * eg a loopback server for tests and benchmarks. A null Transport removes the scheme.
+	 */
+	CHUNKSTREAM_API void RegisterScheme(const FString& Scheme, const TSharedPtr<IChunkStreamTransport, ESPMode::ThreadSafe>& Transport);
+
+	// Request for URL through the transport registered for its scheme, or UE's HTTP module
+	CHUNKSTREAM_API FChunkStreamRequestRef CreateRequest(const FString& URL);
+}
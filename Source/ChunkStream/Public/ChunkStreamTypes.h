@@ -19,5 +19,17 @@ enum class EChunkStreamDownloadResult : uint8
 	UserCancelled   ,       // User explicitly called CancelDownload()
 	WaitingForOtherDownload, //  Max active downloads is currently reached, so this task is waiting for a space
 	InProgress,
-	Success // Download completed
+	Success, // Download completed
+	Paused   // Paused with Pause(), the bytes so far are kept until Resume()
+};
+
+// How the downloaded bytes are decoded before being written to storage
+UENUM(BlueprintType)
+enum class EChunkStreamDecompression : uint8
+{
+	None = 0,   // Write the bytes exactly as downloaded
+	Auto,       // Detect gzip, zlib or zstd from the first bytes, anything else is written as is
+	Gzip,       // gzip stream (.gz), concatenated members are supported
+	Deflate,    // zlib wrapped or raw deflate stream
+	Zstd        // zstd frames (.zst), requires the plugin to be built with zstd
 };
@@ -0,0 +1,41 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ChunkStreamFileWriter.h"
+
+/**
+ * Writes a download's file without leaving it in the OS page cache, so a huge download doesn't evict the game's own hot assets.
+ * Uses O_DIRECT through an aligned bounce buffer where the filesystem allows it, the partial blocks at either end of a write
+ * and filesystems refusing O_DIRECT go through the cache and are synced and dropped with posix_fadvise(DONTNEED) after.
+ * Linux and Android only, Open returns null elsewhere.
+ */
+class CHUNKSTREAM_API FChunkStreamUncachedWriter : public IChunkStreamFileWriter
+{
+public:
+	virtual ~FChunkStreamUncachedWriter() override;
+
+	// Opens the existing file at Path, null if the platform can't write around the cache or the file can't be opened
+	static TUniquePtr<FChunkStreamUncachedWriter> Open(const FString& Path);
+
+	virtual bool Write(const uint8* Data, uint64 Num, uint64 Offset) override;
+	virtual const TCHAR* GetName() const override { return IsDirect() ? TEXT("O_DIRECT") : TEXT("fadvise"); }
+
+	// Is O_DIRECT used, false when every write goes through the cache and is dropped after
+	bool IsDirect() const { return DirectHandle >= 0; }
+
+	// Block size O_DIRECT offsets, sizes and memory are aligned to
+	static constexpr uint64 Alignment = 4096;
+
+private:
+	FChunkStreamUncachedWriter() = default;
+
+	bool WriteAll(int32 Handle, const uint8* Data, uint64 Num, uint64 Offset);
+
+	int32 DirectHandle = -1;
+	int32 BufferedHandle = -1;
+	// Chunk data isn't allocated aligned, O_DIRECT writes are copied through this
+	uint8* BounceBuffer = nullptr;
+	static constexpr uint64 BounceBufferSize = 4 * 1024 * 1024;
+};
@@ -0,0 +1,198 @@
+﻿// Copyright (C) 2025 Isaac Cooper - All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "ChunkStreamSequentialProcessor.h"
+
+class IFileHandle;
+
+namespace ChunkStreamZip
+{
+	static constexpr uint32 LocalFileHeaderSignature = 0x04034b50;
+	static constexpr uint32 DataDescriptorSignature = 0x08074b50;
+	static constexpr uint32 CentralDirectorySignature = 0x02014b50;
+	static constexpr uint32 EndOfCentralDirectorySignature = 0x06054b50;
+	static constexpr uint32 Zip64EndOfCentralDirectorySignature = 0x06064b50;
+	static constexpr uint32 Zip64EndOfCentralDirectoryLocatorSignature = 0x07064b50;
+
+	// Fixed part of the records, before the variable length name / extra / comment
+	static constexpr uint32 LocalFileHeaderSize = 30;
+	static constexpr uint32 CentralDirectoryHeaderSize = 46;
+	static constexpr uint32 EndOfCentralDirectorySize = 22;
+	static constexpr uint32 Zip64EndOfCentralDirectorySize = 56;
+	static constexpr uint32 Zip64EndOfCentralDirectoryLocatorSize = 20;
+
+	static constexpr uint16 MethodStored = 0;
+	static constexpr uint16 MethodDeflate = 8;
+
+	static constexpr uint16 FlagEncrypted = 1 << 0;
+	// Sizes and crc follow the data in a data descriptor
+	static constexpr uint16 FlagDataDescriptor = 1 << 3;
+
+	// One file in the archive as described by a local or central directory header
+	struct FEntry
+	{
+		FString Name;
+		uint16 Flags = 0;
+		uint16 Method = 0;
+		uint32 Crc32 = 0;
+		uint64 CompressedSize = 0;
+		uint64 UncompressedSize = 0;
+		// Offset of the local file header from the start of the archive (central directory only)
+		uint64 LocalHeaderOffset = 0;
+		// Sizes came from a zip64 extra field
+		bool bZip64 = false;
+
+		bool IsDirectory() const { return Name.EndsWith(TEXT("/")); }
+	};
+
+	// Where the central directory is, read from the end of central directory records
+	struct FCentralDirectoryLocation
+	{
+		uint64 Offset = 0;
+		uint64 Size = 0;
+		uint64 NumEntries = 0;
+	};
+
+	// Little endian readers, the caller checks the bounds
+	inline uint16 ReadU16(const uint8* Data) { return static_cast<uint16>(Data[0] | (Data[1] << 8)); }
+	inline uint32 ReadU32(const uint8* Data) { return static_cast<uint32>(Data[0]) | (static_cast<uint32>(Data[1]) << 8) | (static_cast<uint32>(Data[2]) << 16) | (static_cast<uint32>(Data[3]) << 24); }
+	inline uint64 ReadU64(const uint8* Data) { return static_cast<uint64>(ReadU32(Data)) | (static_cast<uint64>(ReadU32(Data + 4)) << 32); }
+
+	/**
+	 * Parses a local file header. Data must hold the whole header including name and extra field.
+	 * @return false if it isn't a valid header
+	 */
+	CHUNKSTREAM_API bool ParseLocalFileHeader(const uint8* Data, uint64 Num, FEntry& OutEntry);
+
+	/**
+	 * Parses every central directory header in Data, which starts at the first header.
+	 * @param OutConsumed - Bytes taken by the headers, the end of central directory records follow
+	 */
+	CHUNKSTREAM_API bool ParseCentralDirectory(const uint8* Data, uint64 Num, TArray<FEntry>& OutEntries, uint64& OutConsumed);
+
+	/**
+	 * Finds the central directory from the tail of an archive.
+	 * @param Tail - Last bytes of the archive, must include the end of central directory record (and zip64 records if any)
+	 * @param TailOffset - Offset of Tail[0] in the archive
+	 */
+	CHUNKSTREAM_API bool FindCentralDirectory(const uint8* Tail, uint64 Num, uint64 TailOffset, FCentralDirectoryLocation& OutLocation);
+
+	/**
+	 * Turns an entry name into a path inside TargetDirectory.
+	 * Rejects absolute paths and ".." so an archive can't write outside the target (zip slip).
+	 */
+	CHUNKSTREAM_API bool MakeSafeOutputPath(const FString& TargetDirectory, const FString& EntryName, FString& OutPath);
+
+	/**
+	 * Inflates one whole entry's data and writes it to OutPath, validating size and crc.
+	 * @return empty on success, otherwise the error
+	 */
+	CHUNKSTREAM_API FString ExtractEntryFromMemory(const FEntry& Entry, const uint8* Data, uint64 Num, const FString& OutPath);
+}
+
+/**
+ * Extracts a zip archive while it downloads, driven by the local file headers.
+ * Nothing but the extracted files is written, so the archive itself never needs space on storage.
+ *
+ * Small deflated entries with known sizes are buffered and inflated in parallel on worker threads.
+ * Larger entries, and entries whose sizes only come in a data descriptor, are inflated inline as the bytes arrive.
+ * The central directory at the end of the archive is checked against what was extracted in Finish().
+ */
+class CHUNKSTREAM_API FChunkStreamZipExtractor : public IChunkStreamSequentialProcessor
+{
+public:
+	explicit FChunkStreamZipExtractor(const FString& InTargetDirectory);
+	virtual ~FChunkStreamZipExtractor() override;
+
+	virtual bool Process(const uint8* Data, uint64 Num) override;
+	virtual bool Finish() override;
+	// Waits for workers and deletes the files extracted so far
+	virtual void Abort() override;
+
+	/**
+	 * For a stream of selected entries rather than a whole archive, see FChunkStreamRemoteZip.
+	 * Finish() then checks the extracted entries against these central directory entries instead of expecting a directory in the stream.
+	 */
+	void SetExpectedEntries(const TArray<ChunkStreamZip::FEntry>& InEntries);
+
+	// Entries (files and directories) extracted so far
+	int32 GetNumExtractedEntries() const { return Extracted.Num(); }
+
+private:
+	enum class EState : uint8
+	{
+		Signature,
+		LocalHeader,
+		EntryData,
+		DataDescriptor,
+		CentralDirectory,
+		Failed
+	};
+
+	// Copies bytes into HeaderBuffer until it holds Needed bytes, returns true once it does
+	bool Gather(const uint8*& Data, uint64& Num, uint64 Needed);
+	bool OnSignature();
+	bool OnLocalHeader();
+	// OutConsumed is how many bytes of Data belonged to the entry
+	bool ProcessEntryData(const uint8* Data, uint64 Num, uint64& OutConsumed);
+	bool OnDataDescriptor();
+	bool BeginInlineEntry();
+	bool FinishEntry(uint32 ActualCrc, uint64 ActualSize);
+	bool DispatchBufferedEntry();
+	bool CollectFinishedTasks(bool bWaitAll);
+	void CloseEntryFile();
+	bool Fail(const FString& InError);
+	// Checks what was extracted matches the central directory
+	bool ValidateExtracted(const TArray<ChunkStreamZip::FEntry>& Directory);
+
+	struct FInflater;
+
+	FString TargetDirectory;
+	EState State = EState::Signature;
+
+	// Partial signature / header / descriptor bytes spanning chunk boundaries
+	TArray<uint8> HeaderBuffer;
+	// Fixed size of the local header currently being read, name and extra lengths known after 30 bytes
+	uint64 LocalHeaderNeeded = 0;
+
+	// Entry currently being read
+	ChunkStreamZip::FEntry Entry;
+	FString EntryOutputPath;
+	// Compressed bytes of the current entry consumed so far
+	uint64 EntryConsumed = 0;
+	// Current entry is being buffered for a worker rather than inflated inline
+	bool bBufferEntry = false;
+	TArray64<uint8> EntryBuffer;
+
+	// Inline extraction state
+	IFileHandle* EntryFile = nullptr;
+	TUniquePtr<FInflater> Inflater;
+	uint32 EntryCrc = 0;
+	uint64 EntryWritten = 0;
+
+	// Data descriptor bytes to read, depends on the optional signature and zip64
+	uint64 DescriptorNeeded = 0;
+
+	// Entries extracted on workers, result is empty or the error
+	TArray<TFuture<FString>> Tasks;
+	int32 MaxTasks = 2;
+
+	// Bytes of the archive consumed so far
+	uint64 StreamOffset = 0;
+	// Everything from the first central directory header to the end of the archive
+	TArray64<uint8> CentralDirectoryBytes;
+	uint64 CentralDirectoryOffset = 0;
+
+	// Central directory entries given by the owner, when the stream holds no directory
+	TArray<ChunkStreamZip::FEntry> ExpectedEntries;
+	bool bHasExpectedEntries = false;
+
+	// Entries extracted, checked against the central directory
+	TArray<ChunkStreamZip::FEntry> Extracted;
+	TArray<FString> CreatedFiles;
+	// Output path of every entry so far, a second entry with the same path would overwrite the first
+	TSet<FString> EntryOutputPaths;
+};
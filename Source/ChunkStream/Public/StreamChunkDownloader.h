@@ -4,6 +4,9 @@
 
 #include "CoreMinimal.h"
 #include "ChunkStreamTypes.h"
+#include "ChunkStreamTransport.h"
+#include "ChunkStreamMappedFile.h"
+#include "ChunkStreamMemoryBudget.h"
 #include "Interfaces/IHttpRequest.h"
 #include "Async/Future.h"
 #include "Containers/Ticker.h"
@@ -24,6 +27,8 @@
 	using BytesType = uint64; 
 #endif
 
+class FStreamChunkDownloader;
+class FChunkStreamConnectionPool;
 
 namespace StreamChunkDownloader
 {
@@ -45,6 +50,12 @@ namespace StreamChunkDownloader
 		// Total size of the file being downloaded (if known, api may not send total size)
 		uint64 TotalFileSize = 0;
 		
+		// Set when the bytes were received straight into this output file at StartOffset, Data is then empty
+		TSharedPtr<FChunkStreamMappedFile, ESPMode::ThreadSafe> MappedFile;
+		
+		// What Data is counted as in the global memory budget, given back with the chunk
+		FChunkStreamMemoryReservation Memory;
+		
 		FChunkInfo() = default;
 		
 		// NO COPY!
@@ -54,6 +65,204 @@ namespace StreamChunkDownloader
 		FChunkInfo(FChunkInfo&& Other) = default;
 		FChunkInfo &operator=(FChunkInfo&& Other) = default;
 	};
+
+	/**
+	 * One source URL serving the same content, with its measured health.
+	 * Mirrors are kept in the ranked order they were supplied in, index 0 being the primary URL.
+	 */
+	struct FMirrorState
+	{
+		FString URL;
+
+		// Smoothed throughput in bytes per second measured over completed chunks (0 until measured)
+		double Throughput = 0.0;
+
+		// Credit for weighted striping, mirrors with higher throughput gain credit faster
+		double StripeCredit = 0.0;
+
+		// Failures since the last successful chunk from this mirror
+		int32 ConsecutiveFailures = 0;
+
+		// Mirror is not picked for new chunks until this time (FPlatformTime::Seconds) after failing
+		double CooldownUntil = 0.0;
+
+		FMirrorState() = default;
+		explicit FMirrorState(const FString& InURL) : URL(InURL) {}
+
+		// Clears the failures, a request that moved Bytes in Seconds also moves Throughput toward its rate
+		void RecordSuccess(uint64 Bytes, double Seconds);
+		// Cools the mirror down for BackoffBaseSeconds * BackoffMultiplier ^ failures
+		void RecordFailure(float BackoffBaseSeconds, float BackoffMultiplier);
+	};
+
+	// Inclusive byte range of a file, as sent in a Range header
+	struct FByteRange
+	{
+		uint64 Start = 0;
+		uint64 End = 0;
+
+		FByteRange() = default;
+		FByteRange(uint64 InStart, uint64 InEnd) : Start(InStart), End(InEnd) {}
+
+		uint64 Num() const { return End - Start + 1; }
+
+		/**
+		 * Adds Range to a sorted list of ranges, merging it with any it overlaps or touches.
+		 * @return index of the range that now contains it
+		 */
+		static int32 AddMerged(TArray<FByteRange>& Ranges, const FByteRange& Range)
+		{
+			// lists stay short, most downloads merge into a single range
+			int32 Index = 0;
+			while (Index < Ranges.Num() && Ranges[Index].Start < Range.Start)
+			{
+				Index++;
+			}
+			Ranges.Insert(Range, Index);
+			if (Index > 0 && Ranges[Index - 1].End + 1 >= Ranges[Index].Start)
+			{
+				Ranges[Index - 1].End = FMath::Max(Ranges[Index - 1].End, Ranges[Index].End);
+				Ranges.RemoveAt(Index);
+				Index--;
+			}
+			while (Index + 1 < Ranges.Num() && Ranges[Index].End + 1 >= Ranges[Index + 1].Start)
+			{
+				Ranges[Index].End = FMath::Max(Ranges[Index].End, Ranges[Index + 1].End);
+				Ranges.RemoveAt(Index + 1);
+			}
+			return Index;
+		}
+
+		// Index of the range in a sorted list that contains Offset, or INDEX_NONE
+		static int32 FindContaining(const TArray<FByteRange>& Ranges, uint64 Offset)
+		{
+			for (int32 i = 0; i < Ranges.Num() && Ranges[i].Start <= Offset; i++)
+			{
+				if (Offset <= Ranges[i].End)
+				{
+					return i;
+				}
+			}
+			return INDEX_NONE;
+		}
+	};
+
+	// One range of a multi-range request and the bytes received into it so far
+	struct FMultiRangePart
+	{
+		TUniquePtr<FChunkInfo> Chunk;
+		uint64 Received = 0;
+	};
+
+	// A range taken from the end of what's left of a download by an idle connection of FChunkStreamConnectionPool
+	struct FRangeHelper
+	{
+		TUniquePtr<FChunkInfo> Chunk;
+		uint64 Received = 0;
+		int32 ResponseCode = 0;
+		uint32 Serial = 0;
+		TWeakPtr<IChunkStreamRequest, ESPMode::ThreadSafe> Request;
+		// Mirror the range is fetched from
+		int32 MirrorIndex = INDEX_NONE;
+		double StartTime = 0.0;
+		// 0 until the first byte
+		double LastDataReceivedTime = 0.0;
+	};
+
+	/**
+	 * A download's range helpers, and the FChunkStreamConnectionPool the connections for them and for hedges come from.
+	 * Without a pool the download takes no range helpers and hedges without asking for a connection.
+	 * Not thread safe, the download guards it with its ChunkDataLock.
+	 */
+	class FRangeHelperSet
+	{
+	public:
+		void SetPool(FChunkStreamConnectionPool* InPool) { Pool = InPool; }
+		void SetAllowed(bool bAllow) { bAllowed = bAllow; }
+		// Range helpers are allowed and there is a pool to get connections for them from
+		bool IsEnabled() const { return bAllowed && Pool != nullptr; }
+
+		// Lets the pool give Downloader extra connections, if there is one
+		void Register(const TSharedRef<FStreamChunkDownloader>& Downloader) const;
+		// Can the download open a request besides its chunk request, true without a pool
+		bool CanOpenExtraConnection() const;
+
+		// Serial for a new helper, its callbacks find it by it
+		uint32 NextSerial() { return ++Serial; }
+		void Add(TUniquePtr<FRangeHelper>&& Helper) { Helpers.Add(MoveTemp(Helper)); }
+		FRangeHelper* Find(uint32 HelperSerial) const;
+		// Takes the helper out, null if it was already dropped
+		TUniquePtr<FRangeHelper> Remove(uint32 HelperSerial);
+		// Takes every helper out, so their requests can be canceled
+		TArray<TUniquePtr<FRangeHelper>> RemoveAll();
+		int32 Num() const { return Helpers.Num(); }
+		const TArray<TUniquePtr<FRangeHelper>>& GetHelpers() const { return Helpers; }
+
+		// Adds the ranges the helpers are fetching to the sorted ranges
+		void AddClaimedRanges(TArray<FByteRange>& Ranges) const;
+		// Start of the first helper range that begins after Offset, MAX_uint64 if there is none
+		uint64 GetNextStart(uint64 Offset) const;
+		// Counts each helper against the mirror it fetches from
+		void CountRequestsPerMirror(TArrayView<int32> RequestsPerMirror) const;
+
+	private:
+		TArray<TUniquePtr<FRangeHelper>> Helpers;
+		uint32 Serial = 0;
+		bool bAllowed = true;
+		// Owned by the module, outlives the downloads
+		FChunkStreamConnectionPool* Pool = nullptr;
+	};
+
+	/**
+	 * Splits a 206 response to a multi-range request into the ranges it holds, as the body streams in.
+	 * A multipart/byteranges body is a boundary line, headers with a Content-Range, a blank line then that range's bytes, per part.
+	 * Servers may also answer with a single range (eg when the requested ranges were merged), described by the Content-Range header.
+	 */
+	class FMultipartRangeParser
+	{
+	public:
+		// Called with bytes of the body that belong at Offset in the file
+		using FOnRangeData = TFunctionRef<void(uint64 Offset, const uint8* Data, uint64 Num)>;
+
+		/**
+		 * Prepares for a response body with these headers.
+		 * @return false if the response is neither multipart/byteranges nor a single Content-Range
+		 */
+		bool Reset(const FString& ContentType, const FString& ContentRange);
+
+		// Parses more of the body, false once it doesn't follow the format
+		bool Feed(const uint8* Data, uint64 Num, FOnRangeData OnRangeData);
+
+		// The final boundary was read
+		bool IsComplete() const { return State == EState::Done; }
+
+		// Parses "bytes 0-499/1234" or "bytes 0-499/*"
+		static bool ParseContentRange(const FString& Value, FByteRange& OutRange);
+
+	private:
+		enum class EState : uint8
+		{
+			// Looking for the next boundary line, also skips the line break ending a part's body
+			Boundary,
+			// Part headers up to a blank line
+			Headers,
+			Body,
+			Done,
+			Error
+		};
+
+		bool ProcessLine(const FString& Line);
+
+		EState State = EState::Error;
+		// "--" followed by the boundary from Content-Type
+		FString Delimiter;
+		// Header line being assembled across Feed calls
+		TArray<uint8> LineBuffer;
+		// Range of the current part and the file offset of its next byte
+		FByteRange PartRange;
+		bool bPartHasRange = false;
+		uint64 BodyOffset = 0;
+	};
 }
 
 // Called periodically during download with bytes received and progress percentage (0.0 - 1.0)
@@ -65,6 +274,9 @@ DECLARE_DELEGATE_OneParam(FOnSingleChunkCompleteSignature, TUniquePtr<StreamChun
 // Called when the entire download finishes
 DECLARE_DELEGATE_OneParam(FOnDownloadCompleteSignature, EChunkStreamDownloadResult);
 
+// Called once the server's answer shows whether bytes from an earlier download can be kept
+DECLARE_DELEGATE_OneParam(FOnResumeCheckedSignature, bool /* accepted */);
+
 
 /**
  * Handles downloading large files in chunks to avoid running out of memory.
@@ -77,7 +289,8 @@ DECLARE_DELEGATE_OneParam(FOnDownloadCompleteSignature, EChunkStreamDownloadResu
 class FStreamChunkDownloader : public TSharedFromThis<FStreamChunkDownloader>
 {
 public:
-	FStreamChunkDownloader()=default;
+	// Always has a mirror, even one without a URL, the chunk loop indexes them
+	FStreamChunkDownloader() : FStreamChunkDownloader(FString(), FString()) {}
 
 	// Basic constructor - provide the URL and content type for the file you want to download
 	FStreamChunkDownloader( const FString& InURL,const FString& InContentType) :
@@ -85,10 +298,69 @@ public:
 		bCanceled(false),
 		MaxRetryCount(3), CurrentRetryCount(0), RetryBackoffBaseSeconds(1.0f), RetryBackoffMultiplier(2.0f)
 	{
+		Mirrors.Emplace(InURL);
+	}
+
+	// Mirror constructor - URLs are a ranked list of sources for the same content, first being the primary
+	FStreamChunkDownloader( const TArray<FString>& InURLs,const FString& InContentType) :
+		FStreamChunkDownloader(InURLs.Num() > 0 ? InURLs[0] : FString(), InContentType)
+	{
+		for (int32 i = 1; i < InURLs.Num(); i++)
+		{
+			AddMirrorURL(InURLs[i]);
+		}
 	}
 
 	~FStreamChunkDownloader();
 
+	/**
+	 * Adds a fallback source for the same content. Must be called before BeginDownload.
+	 * Failed chunks move to the next healthy mirror, and in range mode chunks are striped
+	 * across mirrors in proportion to their measured throughput.
+	 */
+	void AddMirrorURL(const FString& InMirrorURL);
+
+	/**
+	 * Only download these byte ranges of the file instead of all of it. Must be called before BeginDownload.
+	 * Ranges are downloaded in the order given, each split into chunks of at most MaxChunkSize that are handed off with their file offsets.
+	 * The server has to honour Range, a ranged request answered with the whole file (200) is retried and fails the download once retries run out.
+	 */
+	void SetRequestedRanges(const TArray<StreamChunkDownloader::FByteRange>& InRanges);
+	bool HasRequestedRanges() const { return RequestedRanges.Num() > 0; }
+
+	/**
+	 * Supply the file size and range support so BeginDownload skips the HEAD request.
+	 * For when they are already known, eg from an earlier request for the same file. Must be called before BeginDownload.
+	 */
+	void SetKnownFileInfo(uint64 InTotalFileSize, bool bInAcceptsRanges);
+
+	/**
+	 * Continue a download an earlier run left partly written, so ranges it already has aren't downloaded again.
+	 * They are only kept if the HEAD response reports the same size and ETag or Last-Modified, and the server accepts ranges.
+	 * OnChecked runs before any chunk is handed off, with false when the owner has to discard them. Must be called before BeginDownload.
+	 */
+	void SetResumeData(const TArray<StreamChunkDownloader::FByteRange>& InRanges, uint64 InTotalFileSize,
+		const FString& InETag, const FString& InLastModified, const FOnResumeCheckedSignature& OnChecked);
+
+	/**
+	 * Receive straight into the file at Path, mapped once the file size is known, instead of into chunk buffers.
+	 * Handed off chunks then carry the mapping rather than data. Only whole files of a known size without a transfer encoding are mapped,
+	 * anything else, or a platform that can't map, uses chunk buffers as usual. Must be called before BeginDownload.
+	 */
+	void SetMappedOutput(const FString& Path) { MappedOutputPath = Path; }
+
+	/**
+	 * Lets idle connections of FChunkStreamConnectionPool fetch ranges of this download alongside its own requests, on by default once there is a pool (SetConnectionPool).
+	 * Their chunks are handed off out of file order, owners that need the file in order turn it off. Must be called before BeginDownload.
+	 */
+	void SetAllowRangeHelpers(bool bAllow) { RangeHelpers.SetAllowed(bAllow); }
+
+	/**
+	 * Pool this download takes range helper and hedge connections from, registered with when the chunk loop starts.
+	 * Without one there are no range helpers and hedges aren't limited. Must be called before BeginDownload.
+	 */
+	void SetConnectionPool(FChunkStreamConnectionPool* Pool) { RangeHelpers.SetPool(Pool); }
+
 	/**
 	 * Starts the download process.
 	 * 
@@ -109,51 +381,188 @@ public:
 	 * @param Timeout - Request timeout in seconds (0 = no timeout)
 	 * @return Future containing the HTTP response (or nullptr on failure)
 	 */
-	TFuture<const FHttpResponsePtr&> RequestDownloadTotalSize(const FString& InURL, float Timeout);
+	TFuture<const FChunkStreamResponsePtr&> RequestDownloadTotalSize(const FString& InURL, float Timeout);
 
 	/**
 	 * Parses the Content-Length header from an HTTP response.
 	 * Returns 0 if the header is missing, invalid, or the response has encoding (gzip/deflate).
 	 */
-	static uint64 GetFileSizeFromRequest( FHttpResponsePtr Response, bool bSuccess) ;
+	static uint64 GetFileSizeFromRequest( FChunkStreamResponsePtr Response, bool bSuccess) ;
 
 	/**
 	 * Checks if the server supports HTTP range requests (Accept-Ranges header).
 	 * Range requests let us download specific byte ranges, which is more reliable for large files.
 	 */
-	static bool DoesApiAcceptRanges( FHttpResponsePtr Response, bool bSuccess) ;
+	static bool DoesApiAcceptRanges( FChunkStreamResponsePtr Response, bool bSuccess) ;
 	
 	/**
 	 * Detects if the response uses content encoding like gzip or deflate.
 	 * When encoding is present, Unreal automatically decompresses the stream,
 	 * so we can't rely on Content-Length and should use actual received data sizes instead.
 	 */
-	static bool DoesResponseHaveEncoding(const FHttpResponsePtr& Response);
+	static bool DoesResponseHaveEncoding(const FChunkStreamResponsePtr& Response);
 	
 	// Stop the download if it is in progress
 	bool CancelDownload();
 	// Shutdown and cleanup without broadcasting any progress delegates
 	void Shutdown();
+
+	/**
+	 * Stops the transfer at the current byte without ending the download. The bytes of the chunk in flight are handed off.
+	 * @return false if the download hasn't started, has ended or is already paused
+	 */
+	bool Pause();
+
+	/**
+	 * Continues a paused download from the first byte it doesn't have, with a ranged request.
+	 * A server that doesn't accept ranges is downloaded from the start again.
+	 */
+	bool Resume();
+	bool IsPaused() const { return bPaused; }
 	
 	// Has the download been canceled
 	bool IsCanceled() const { return bCanceled; }
 	bool HasStarted() const { return bHasStarted;}
 	int32 GetHttpStatusCode() const { return ChunkDownloadResponseCode.load(std::memory_order_relaxed); }
+	// Content-Encoding the server reported for the file, empty if none. The HTTP layer has already decoded it
+	const FString& GetResponseEncoding() const { return ResponseEncodingType; }
+	// Validators from the HEAD response, empty if the server didn't send them
+	const FString& GetETag() const { return ETag; }
+	const FString& GetLastModified() const { return LastModified; }
+	// Size of the whole file, 0 until known or if the server didn't report it
+	uint64 GetTotalFileSize() const { return TotalFileSize; }
+	// Did the server advertise Accept-Ranges
+	bool DoesServerAcceptRanges() const { return bApiAcceptsRanges; }
+	// Id of the download in the ChunkStream trace channel, 0 before it starts
+	uint32 GetTraceId() const { return TraceId; }
+
+	// Body bytes received from the network, including ones a failed request received before it was retried. Thread safe
+	uint64 GetBytesReceived() const { return BytesReceived.load(std::memory_order_relaxed); }
+	// Bytes received per second over the last second, 0 once data stops arriving. Thread safe
+	double GetCurrentBytesPerSecond() const;
+	int32 GetNumRetries() const { return NumRetries.load(std::memory_order_relaxed); }
+	int32 GetNumStalls() const { return NumStalls.load(std::memory_order_relaxed); }
+	// Bytes the download hands off in total, the requested ranges or the whole file. 0 while the size isn't known
+	uint64 GetBytesToDownload() const { return HasRequestedRanges() ? RequestedBytesTotal : TotalFileSize; }
+
+	/**
+	 * Copies bytes of the chunk in flight that have arrived but haven't been handed off yet. Thread safe.
+	 * Lets readers of an in progress download use data before its chunk completes.
+	 * @return bytes copied from Offset, 0 if Offset isn't in the received part of the active chunk
+	 */
+	uint64 CopyReceivedBytes(uint8* Destination, uint64 Offset, uint64 MaxBytes);
+
+	/**
+	 * Ask for the file to be downloaded from Offset next, ahead of the bytes before it. Thread safe.
+	 * Takes effect when the next chunk starts. The download carries on from there to the end of the file, then fills in what it skipped.
+	 * Only whole file downloads using ranges can jump ahead, otherwise this is ignored.
+	 */
+	void PrioritizeOffset(uint64 Offset);
+
+	/**
+	 * Ask servers for the stored representation (Accept-Encoding: identity) instead of a transfer compressed one.
+	 * Used when the owner decompresses the file itself, so ranges and Content-Length stay usable.
+	 * Must be called before BeginDownload.
+	 */
+	void SetRequestIdentityEncoding(bool bInRequestIdentity) { bRequestIdentityEncoding = bInRequestIdentity; }
+
+	// Seconds without data before the request in flight is considered stalled
+	float GetStallThreshold() const { return StallDetectionTimeout; }
+	// Smoothed gap between packets as of the last stall check, in seconds. Game thread
+	float GetPacketGap() const { return PacketGapAtLastCheck; }
+
+	// Requests this download has open, its chunk request, a hedge and range helpers. Game thread
+	int32 GetNumConnections() const;
+	// Requests open besides the chunk request, a hedge and range helpers, counted against ChunkStream.MaxConnections. Game thread
+	int32 GetNumExtraConnections() const;
+	// Has the chunk loop handed off the whole file or ended
+	bool IsChunkLoopFinished() const { return bChunkLoopFinished || bCanceled; }
+	// Bytes of the largest range no request has claimed yet, 0 when the download can't use range helpers. Game thread
+	uint64 GetStealableBytes() const;
+	/**
+	 * Starts a range helper on the end of the largest unclaimed range, for an idle connection of FChunkStreamConnectionPool.
+	 * The front half of the range is left to the chunk loop. Game thread
+	 * @return false if no range of at least MinBytes could be taken
+	 */
+	bool StartRangeHelper(uint64 MinBytes);
+
+	// URL of the mirror serving the current request
+	const FString& GetActiveURL() const { return Mirrors.IsValidIndex(ActiveMirrorIndex) ? Mirrors[ActiveMirrorIndex].URL : URL; }
+	const TArray<StreamChunkDownloader::FMirrorState>& GetMirrors() const { return Mirrors; }
+
+	// 2xx codes the downloader accepts for a chunk
+	static bool IsSuccessStatusCode(int32 StatusCode) { return StatusCode == 200 || StatusCode == 206 || StatusCode == 201; }
+	// Codes worth retrying on the same or another mirror (timeouts, throttling, server errors)
+	static bool IsRetryableStatusCode(int32 StatusCode) { return StatusCode == 408 || StatusCode == 429 || StatusCode >= 500; }
 protected:
 
 	// Cancels the download internally and notifies the owner with a specific reason
 	void InternalCancelDownload(EChunkStreamDownloadResult Reason, const FString& ErrorMessage = FString(), bool bFromShutdown=false);
 	
 	// Called internally after we successfully retrieve the file size
-	void OnTotalSizeReceived(const FHttpResponsePtr& Response);
+	void OnTotalSizeReceived(const FChunkStreamResponsePtr& Response);
 	
 	// Called internally if we fail to get the file size (will attempt download anyway)
 	void OnFailedToGetTotalFileSize();
+
+	// Starts the chunk loop once the file size and range support are known
+	void StartChunkDownloads();
+
+	// Marks the ranges from SetResumeData as downloaded if the server still has the same file, and tells the owner
+	void ApplyResumeData();
+
+	// Maps the file from SetMappedOutput if this download can be received into it
+	void MapOutputFile();
+
+	// Where the active chunk's bytes go, the mapped output file or its buffer
+	uint8* GetActiveChunkData() const;
+
+	// Moves past requested ranges that are done, returns false when none are left
+	bool AdvanceRequestedRange();
+
+	// Takes the offset given to PrioritizeOffset and decides where the next chunk starts
+	void ApplyPriorityOffset();
+
+	// Moves LastChunkEndOffset past ranges that were downloaded ahead of it
+	void SkipDownloadedAhead();
+
+	// Records a chunk downloaded ahead of the sequential position and, unless it came from a range helper, moves AheadCursor past it
+	void AddDownloadedAheadRange(uint64 Start, uint64 End, bool bMoveAheadCursor = true);
+
+	// Start of the first range downloaded ahead or being fetched by a range helper that begins after Offset, MAX_uint64 if there is none
+	uint64 GetNextDownloadedAheadStart(uint64 Offset) const;
+
+	// Next byte of the file in sequential order
+	uint64 GetSequentialOffset() const { return LastChunkEndOffset == 0 ? 0 : LastChunkEndOffset + 1; }
+
+	// Sends the HEAD request to a mirror, moving down the list if it fails
+	void RequestTotalSizeFromMirror(int32 MirrorIndex);
+
+	// Picks the mirror for the next chunk, weighted by measured throughput in range mode
+	void SelectMirrorForNextChunk();
+
+	// Index of the next mirror to fail over to that is not cooling down, or INDEX_NONE
+	int32 FindFailoverMirror() const;
+	// Mirror not cooling down with the fewest of this download's requests, so range helpers spread the load. Caller holds ChunkDataLock
+	int32 FindRangeHelperMirror() const;
+
+	// Mirror bookkeeping after a chunk request finishes
+	void OnMirrorChunkSucceeded(uint64 BytesReceived, double Seconds);
+	void OnMirrorChunkFailed();
+
+	// Total attempts allowed per chunk, every mirror gets MaxRetryCount tries
+	int32 GetMaxRetryAttempts() const { return MaxRetryCount * FMath::Max(1, Mirrors.Num()); }
 	
 	// Validates that the current chunk's byte range is sensible before downloading
 	bool IsValidChunkRange() const
 	{
 		check(ActiveChunk);
+		if (HasRequestedRanges())
+		{
+			// ranges can be a single byte
+			return ActiveChunk->StartOffset <= ActiveChunk->EndOffset
+				&& (bUnknownTotalSize || ActiveChunk->EndOffset < TotalFileSize);
+		}
 		if (!bUnknownTotalSize)
 		{
 			
@@ -173,16 +582,25 @@ protected:
 	 */
 	TFuture<bool> DownloadChunk( );
 
+	// Starts DownloadChunk for the active chunk and routes the result to OnChunkRequestFinished
+	void StartActiveChunkRequest();
+
+	// Decides between moving on, retrying (possibly on another mirror) or failing the download
+	void OnChunkRequestFinished(bool bRequestSucceeded);
+
 	bool ValidateStatusCode();
 	
 	// Handles progress updates during a chunk download and forwards to the owners callback
-	void OnChunkDownloadProgress(const BytesType& BytesReceived);
+	void OnChunkDownloadProgress(uint64 BytesReceived);
 	
-	// Called when a chunk request finishes
-	void ChunkDownloadRequestComplete(FHttpRequestPtr Request, FHttpResponsePtr Response, bool bSuccess);
+	// Called when a chunk request finishes, returns true if the chunk was completed (by it or a hedge) and handed off
+	bool ChunkDownloadRequestComplete(FChunkStreamResponsePtr Response, bool bSuccess);
 	
 	// Figures out if there are more chunks to download and starts the next one
 	void ProcessNextChunk();
+
+	// Starts the next chunk, or completes the download when there are none left. Holds off while paused
+	void StartNextChunkOrFinish();
 	
 	// Called when all chunks have been downloaded successfully
 	void OnAllChunksDownloaded();
@@ -201,28 +619,78 @@ protected:
 	void OnChunkStream(void* DataPtr, int64& InOutLength);
 	// Stall detection incase of network problems
 	void CheckForStall();
+
+	// Recomputes StallDetectionTimeout from the packet gap / first byte estimates, clamped by the ChunkStream.StallTimeout CVars
+	void UpdateStallThreshold();
+
+	// Adds an inter-packet gap or time to first byte sample (called under ChunkDataLock)
+	void RecordPacketTiming(double Now);
+
+	/**
+	 * Hedging for chunks that trickle without fully stalling.
+	 * When the active chunk's throughput falls well below the median of recent chunks, a duplicate
+	 * request for its remaining bytes is sent (to another mirror when there is one). Whichever
+	 * request finishes first completes the chunk and the other is canceled.
+	 */
+	void CheckForSlowChunk();
+	// false if there was no memory for the copy or the request didn't start
+	bool StartHedgeRequest();
+	void OnHedgeStream(void* DataPtr, int64& InOutLength, uint32 Serial);
+	void OnHedgeRequestComplete(bool bSuccess, uint32 Serial);
+	// Drops any hedge in flight, its late callbacks are ignored. Safe on the http thread, the request is canceled from the game thread
+	void CancelHedge();
+
+	// Can idle pool connections fetch ranges of this download
+	bool CanUseRangeHelpers() const;
+	// Ranges from the sequential position to the end of the file that no request has and that weren't downloaded ahead, in order
+	TArray<StreamChunkDownloader::FByteRange> GetUnclaimedRanges() const;
+	/**
+	 * Moves the start of the next chunk past ranges range helpers are fetching.
+	 * @return false if every byte left is with a helper, the chunk loop then waits for them
+	 */
+	bool SkipRangeHelperRanges();
+	void OnRangeHelperStream(void* DataPtr, int64& InOutLength, uint32 Serial);
+	void OnRangeHelperComplete(bool bSuccess, uint32 Serial);
+	// Drops the range helpers in flight, their ranges go back to the chunk loop. Caller holds ChunkDataLock
+	void CancelRangeHelpers();
+	// Cancels range helpers that got no data for the stall threshold, the chunk loop fetches their ranges instead
+	void CheckForStalledRangeHelpers();
+	// Counts body bytes toward the totals and the current rate. Caller holds ChunkDataLock
+	void AddReceivedBytes(int64 Num);
+	// Median of the recent per chunk throughput samples, 0 if there are too few
+	double GetMedianChunkThroughput() const;
 	
 	// Calculates the retry delay using exponential backoff
 	float CalculateRetryDelay() const;
 	
 	// Retries the current chunk download after a delay
 	void RetryChunkDownload();
+
+	// Reserves the next chunk's buffer in the memory budget, false when the budget has too little left
+	bool ReserveChunkMemory();
+	// Polls the budget until the next chunk's buffer fits, then carries on with the chunk loop
+	void WaitForChunkMemory();
+
+	// Groups the next small requested ranges, up to MaxBatchBytes, into MultiRangeParts. Leaves it empty when a single range request is better
+	void BuildMultiRangeBatch(uint64 MaxBatchBytes);
+
+	// Range header value for the request in flight
+	FString GetRangeHeader() const;
+
+	// Streams the body of a multi-range response into the parts it covers
+	void OnMultiRangeStream(void* DataPtr, int64& InOutLength);
+
+	// Hands off the parts of a multi-range request in order, up to the first one that is incomplete
+	void HandOffMultiRangeParts();
 	
-	// Helper to create and configure an HTTP request with appropriate headers
-	static FHttpRequestType MakeHttpRequest( const FString& URL,
+	// Helper to create and configure a request with appropriate headers, through the transport for the URL's scheme
+	static FChunkStreamRequestRef MakeHttpRequest( const FString& URL,
 		const FString& Verb,
 		float Timeout,
 		const FString& ContentType);
 	
-	// Returns the progress delegate in a way that works across UE4/UE5
-	static FHttpProgressDelegate& GetHttpProgressDelegate(FHttpRequestType& Request)
-	{
-#ifdef OLD_HTTP
-		return Request->OnRequestProgress();
-#else
-		return Request->OnRequestProgress64();
-#endif
-	}
+	// Adds the headers every request from this downloader carries
+	void ApplyCommonHeaders(const FChunkStreamRequestRef& Request) const;
 	
 	// Helper to get a weak pointer to this object (for safe async callbacks). DO NOT CALL IN CONSTRUCTOR!
 	TWeakPtr<FStreamChunkDownloader> GetWeakThis() { return AsShared().ToWeakPtr(); };
@@ -233,24 +701,93 @@ protected:
 	FOnDownloadCompleteSignature OnDownloadCompleteDelegate;
 	
 	// Protects ActiveChunk from concurrent access during streaming (HTTP thread) and handoff
-	FCriticalSection ChunkDataLock;
+	mutable FCriticalSection ChunkDataLock;
 
 	FTSTicker::FDelegateHandle StallTickHandle;
 	FTSTicker::FDelegateHandle RetryHandle;
+	FTSTicker::FDelegateHandle MemoryWaitHandle;
 	
 	TFuture<bool> CurrentDownloadFuture;
 	
 	// Reference to the current HTTP request 
-	TWeakPtr<IHttpRequest> CurrentHttpRequest;
+	TWeakPtr<IChunkStreamRequest, ESPMode::ThreadSafe> CurrentHttpRequest;
+
+	// Duplicate request racing the tail of the active chunk
+	TWeakPtr<IChunkStreamRequest, ESPMode::ThreadSafe> HedgeHttpRequest;
+
+	// Buffer for the hedge, covers [HedgeStartInChunk, end of the active chunk]
+	TUniquePtr<StreamChunkDownloader::FChunkInfo> HedgeChunk;
+
+	// Bytes the hedge has received into HedgeChunk
+	uint64 HedgeChunkOffset = 0;
+
+	// Chunk relative offset the hedge range starts at
+	uint64 HedgeStartInChunk = 0;
+
+	// Bytes the primary request had received when the hedge won, for its mirror's throughput
+	uint64 PrimaryBytesAtHedgeWin = 0;
+
+	int32 HedgeMirrorIndex = INDEX_NONE;
+	double HedgeStartTime = 0.0;
+	double HedgeLastDataReceivedTime = 0.0;
+	std::atomic<int32> HedgeResponseCode{0};
+
+	// Incremented whenever a hedge is started or dropped so callbacks from old hedges are ignored
+	uint32 HedgeSerial = 0;
+
+	// Only one hedge is raced per chunk
+	bool bHedgedThisChunk = false;
+
+	// Set when the hedge completed the active chunk, the primary's completion then hands it off
+	bool bHedgeWon = false;
+
+	// Ranges fetched by idle pool connections, added and removed on the game thread under ChunkDataLock
+	StreamChunkDownloader::FRangeHelperSet RangeHelpers;
+	// The chunk loop has nothing left to request until the range helpers finish
+	bool bWaitingForRangeHelpers = false;
+	bool bChunkLoopFinished = false;
+
+	// Throughput of recently completed chunks in bytes per second, oldest first
+	TArray<double> RecentChunkThroughputs;
 	
 	// The URL were downloading from
 	FString URL;
-	
+
+	// Ranked sources for the content, index 0 is URL
+	TArray<StreamChunkDownloader::FMirrorState> Mirrors;
+
+	// Mirror used by the request in flight
+	int32 ActiveMirrorIndex = 0;
+
+	// Time the current chunk request was started, used to measure mirror throughput
+	double ChunkRequestStartTime = 0.0;
+
+	// True between starting a chunk request and its completion
+	std::atomic<bool> bChunkRequestInFlight{false};
+
 	// Content type to set in request headers
 	FString ContentType;
 	
 	// Type of encoding detected in response (gzip, deflate, etc.)
 	FString ResponseEncodingType;
+
+	// ETag and Last-Modified headers of the HEAD response
+	FString ETag;
+	FString LastModified;
+
+	// Ranges an earlier download wrote and what it knew of the file, see SetResumeData
+	TArray<StreamChunkDownloader::FByteRange> ResumeRanges;
+	uint64 ResumeFileSize = 0;
+	FString ResumeETag;
+	FString ResumeLastModified;
+	FOnResumeCheckedSignature OnResumeCheckedDelegate;
+
+	// File to receive into, see SetMappedOutput, and its mapping once made
+	FString MappedOutputPath;
+	TSharedPtr<FChunkStreamMappedFile, ESPMode::ThreadSafe> MappedFile;
+
+	// Send Accept-Encoding: identity with every request
+	bool bRequestIdentityEncoding = false;
 	
 	// Maximum chunk size in bytes (configured at download start)
 	uint64 MaxChunkSize;
@@ -263,14 +800,97 @@ protected:
 	
 	// Write position within the current chunk (atomic because streaming happens on HTTP thread)
 	std::atomic<uint64> CurrentChunkOffset = 0;
+
+	// Bytes the last completed chunk request received
+	uint64 LastChunkBytesReceived = 0;
 	
 	// Last byte offset that was completed in previous chunks (used to calculate next chunk range)
 	uint64 LastChunkEndOffset = 0;
 	
 	// Total size of the file (0 if unknown)
 	uint64 TotalFileSize = 0;
-	// Time in seconds between no data recieved to decide its stalled and try restart the chunk
+
+	// Byte ranges to download instead of the whole file, in the order they are handed off
+	TArray<StreamChunkDownloader::FByteRange> RequestedRanges;
+
+	// Range in RequestedRanges being downloaded and the next offset to request within it
+	int32 RequestedRangeIndex = 0;
+	uint64 RequestedRangeCursor = 0;
+
+	// Bytes of the requested ranges handed off so far and in total, for progress
+	uint64 RequestedBytesCompleted = 0;
+	uint64 RequestedBytesTotal = 0;
+
+	// Size and range support were given by the owner, no HEAD request is needed
+	bool bHasKnownFileInfo = false;
+
+	// A ranged request was answered with the whole file, set from the HTTP thread
+	std::atomic<bool> bServerIgnoredRange{false};
+
+	// Trace state of the request in flight, its region is ended under the chunk and attempt it began with
+	uint32 TraceId = 0;
+	uint64 TraceRequestOffset = 0;
+	uint32 TraceRequestAttempt = 0;
+	// Requested bytes of the request in flight that haven't arrived
+	int64 TraceBytesInFlight = 0;
+	bool bTraceFirstByte = false;
+
+	// Totals for the stats API, read from any thread
+	std::atomic<uint64> BytesReceived{0};
+	std::atomic<int32> NumRetries{0};
+	std::atomic<int32> NumStalls{0};
+
+	// Received bytes of the rate window being measured and the rate of the last one, the window is updated under ChunkDataLock
+	double RateWindowStartTime = 0.0;
+	uint64 RateWindowBytes = 0;
+	std::atomic<double> LastWindowBytesPerSecond{0.0};
+	std::atomic<double> LastWindowEndTime{0.0};
+
+	// Ranges fetched by the request in flight when it asks for several at once, empty for a single range.
+	// ActiveChunk then only spans them and holds no data, each part is handed off as its own chunk
+	TArray<StreamChunkDownloader::FMultiRangePart> MultiRangeParts;
+
+	// Parses the body of a multi-range response, guarded by ChunkDataLock
+	StreamChunkDownloader::FMultipartRangeParser MultiRangeParser;
+	bool bMultiRangeParserReady = false;
+
+	// Headers of the response in flight the multi-range parser needs, set from the HTTP thread under ChunkDataLock
+	FString ResponseContentType;
+	FString ResponseContentRange;
+
+	// A server didn't answer a multi-range request properly, ranges are requested one at a time from then on
+	bool bMultiRangeUnsupported = false;
+
+	// Offset a reader is waiting on, MAX_uint64 when there is none. Set from any thread
+	std::atomic<uint64> PendingPriorityOffset{MAX_uint64};
+
+	// Next offset to download ahead of the sequential position, MAX_uint64 while downloading in order
+	uint64 AheadCursor = MAX_uint64;
+
+	// Ranges downloaded ahead of LastChunkEndOffset, sorted and merged
+	TArray<StreamChunkDownloader::FByteRange> DownloadedAheadRanges;
+	uint64 DownloadedAheadBytes = 0;
+
+	// The active chunk was started from AheadCursor
+	bool bActiveChunkIsAhead = false;
+	// Time in seconds between no data recieved to decide its stalled and try restart the chunk.
+	// Recomputed every stall check from the observed packet gaps (see UpdateStallThreshold)
 	float StallDetectionTimeout=14.0f;
+
+	// Smoothed gap between packets within a request and its mean deviation, in seconds
+	double SmoothedPacketGap = 0.0;
+	double PacketGapDeviation = 0.0;
+	int32 PacketGapSamples = 0;
+	// SmoothedPacketGap copied out by UpdateStallThreshold, for stats on the game thread
+	float PacketGapAtLastCheck = 0.f;
+
+	// Smoothed time from starting a request to its first byte and its mean deviation, in seconds
+	double SmoothedFirstByteTime = 0.0;
+	double FirstByteTimeDeviation = 0.0;
+	int32 FirstByteSamples = 0;
+
+	// Has the request in flight received any data yet
+	bool bReceivedFirstByte = false;
 	
 	// HTTP request timeout in seconds
 	float TimeoutInSeconds=0.0f;
@@ -291,6 +911,16 @@ protected:
 	bool bShouldUseRanges = true;
 
 	bool bHasStarted = false;
+	// Set by Pause, no new requests are started until Resume
+	bool bPaused = false;
+	// The chunk loop stopped for the pause and Resume has to restart it
+	bool bPausedMidLoop = false;
+	// A retry is waiting on its backoff delay
+	bool bRetryPending = false;
+	// The next chunk is waiting for the memory budget, see WaitForChunkMemory
+	bool bWaitingForMemory = false;
+	// Budget reserved for the next chunk's buffer, InitNewChunk sizes the chunk to it
+	FChunkStreamMemoryReservation NextChunkMemory;
 	// Tracks if the last chunk received any data (used for unknown-size downloads)
 	bool bLastChunkHadData = true;
 	// Did the last chunk end its stream before expected end range, if so the file should be complete